@@ -1,6 +1,11 @@
 #ifndef RN_ADDRESS_H
 #define RN_ADDRESS_H
 
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -21,6 +26,36 @@ struct RnAddressIPv6
 typedef struct RnAddressIPv4 RnAddressIPv4;
 typedef struct RnAddressIPv6 RnAddressIPv6;
 
+struct sockaddr_in;
+struct sockaddr_in6;
+
+bool rnAddressEqualsIPv4(RnAddressIPv4 a, RnAddressIPv4 b);
+bool rnAddressEqualsIPv6(RnAddressIPv6 a, RnAddressIPv6 b);
+
+#define rnAddressEquals(a, b)                                                                      \
+    RN_SELECT2(&(a), RnAddressIPv4, rnAddressEqualsIPv4, RnAddressIPv6, rnAddressEqualsIPv6)(a, b)
+
+/**
+ * Conversions from and to socket API addresses, whose bytes are in network
+ * order.
+ */
+RnAddressIPv4 rnAddressFromNetworkIPv4(struct sockaddr_in net);
+RnAddressIPv6 rnAddressFromNetworkIPv6(struct sockaddr_in6 net);
+
+struct sockaddr_in rnAddressToNetworkIPv4(RnAddressIPv4 ipv4);
+struct sockaddr_in6 rnAddressToNetworkIPv6(RnAddressIPv6 ipv6);
+
+/**
+ * IPv4 addresses as dual-stack sockets report them, ::ffff:a.b.c.d with the
+ * same port, see rnSocketOpenDualStack. Unmapping an address that is not
+ * IPv4-mapped yields 0.0.0.0.
+ */
+RnAddressIPv6 rnAddressMapIPv4(RnAddressIPv4 ipv4);
+
+bool rnAddressIsMappedIPv4(RnAddressIPv6 ipv6);
+
+RnAddressIPv4 rnAddressUnmapIPv4(RnAddressIPv6 ipv6);
+
 #ifdef __cplusplus
 }
 #endif
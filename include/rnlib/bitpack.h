@@ -0,0 +1,55 @@
+#ifndef RN_BITPACK_H
+#define RN_BITPACK_H
+
+#include "packet.h"
+#include "util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RN_BITPACK_BITS_MAX 32
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum RnBitpackKernel
+{
+    RN_BITPACK_SCALAR,
+    RN_BITPACK_SSE41,
+    RN_BITPACK_AVX2,
+};
+
+/**
+ * Packs `count` values of `bits` width (1 to 32) into `body` at `cursor` and
+ * advances it, laid out exactly as `count` consecutive rnPacketBufferWrite
+ * calls would. Returns RN_OOM without writing if the values do not fit.
+ *
+ * The fastest kernel supported by the running CPU is selected on first use.
+ */
+int rnBitpackWrite(
+      uint64_t *body, size_t body_qwords, RnPacketBufferCursor *cursor, const uint32_t *values,
+      size_t count, uint32_t bits);
+
+/**
+ * Unpacks `count` values of `bits` width from `body` at `cursor` and advances
+ * it. Returns RN_OOM without reading if the body holds fewer values.
+ */
+int rnBitpackRead(
+      const uint64_t *body, size_t body_qwords, RnPacketBufferCursor *cursor,
+      OUT uint32_t *values, size_t count, uint32_t bits);
+
+enum RnBitpackKernel rnBitpackKernel();
+
+/**
+ * Overrides kernel selection, e.g. to benchmark or verify kernels against each
+ * other. Selecting a kernel the CPU does not support falls back to scalar.
+ */
+void rnBitpackSelectKernel(enum RnBitpackKernel kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_BITPACK_H
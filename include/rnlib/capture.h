@@ -0,0 +1,107 @@
+#ifndef RN_CAPTURE_H
+#define RN_CAPTURE_H
+
+#include "address.h"
+#include "util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RN_CAPTURE_VERSION 1
+
+/**
+ * Records datagrams but does not hand egress data to the operating system.
+ * Used when replaying a capture, so that replies go nowhere.
+ */
+#define RN_CAPTURE_SUPPRESS_EGRESS 0x1
+
+/**
+ * Also records the state of every connection on the socket once its handshake
+ * completed, so that replays can verify what the session sent afterwards.
+ * Such captures hold session keys and salts, treat them like snapshots.
+ */
+#define RN_CAPTURE_SESSIONS 0x2
+
+#define RN_CAPTURE_END 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum RnCaptureDirection
+{
+    RN_CAPTURE_INGRESS,
+    RN_CAPTURE_EGRESS,
+    // not a datagram: the connection with the peer at the address, see RN_CAPTURE_SESSIONS
+    RN_CAPTURE_SESSION,
+};
+
+/**
+ * A single captured datagram. Only the address matching `family` is valid.
+ * Session records hold rnConnectionSnapshotLayout (4) and the connection's
+ * snapshot record, see rnConnectionSave.
+ */
+struct RnCaptureRecord
+{
+    uint64_t timestamp; // rnClockMonotonic at capture
+    enum RnCaptureDirection direction;
+    uint8_t family;
+    uint16_t data_size;
+
+    RnAddressIPv4 ipv4;
+    RnAddressIPv6 ipv6;
+};
+
+typedef struct RnCapture RnCapture;
+typedef struct RnCaptureReader RnCaptureReader;
+typedef struct RnCaptureRecord RnCaptureRecord;
+
+/**
+ * Opens an append-only capture file at `path`. A NULL path records nothing,
+ * which combined with RN_CAPTURE_SUPPRESS_EGRESS turns a socket into a sink.
+ *
+ * A capture is written by a single thread, attach one capture per socket when
+ * sockets are serviced from different threads. Failing to open or write the
+ * file reports errno.
+ */
+int rnCaptureOpen(const char *path, uint32_t flags, OUT RnCapture **out);
+int rnCaptureClose(IN RnCapture *capture);
+
+uint32_t rnCaptureFlags(const RnCapture *capture);
+
+#define RN_CAPTURE_DECL(IP)                                                                        \
+    int rnCaptureWrite##IP(                                                                        \
+          RnCapture *capture, enum RnCaptureDirection direction, const RnAddress##IP *address,     \
+          const uint8_t *data, size_t data_size);
+
+RN_CAPTURE_DECL(IPv4)
+RN_CAPTURE_DECL(IPv6)
+
+#undef RN_CAPTURE_DECL
+
+#define rnCaptureWrite(capture, direction, address, ...)                                           \
+    RN_SELECT2(address, RnAddressIPv4, rnCaptureWriteIPv4, RnAddressIPv6, rnCaptureWriteIPv6)(     \
+          capture, direction, address, __VA_ARGS__)
+
+/**
+ * Reports errno if `path` cannot be read, EINVAL if it is no capture or one of
+ * another RN_CAPTURE_VERSION.
+ */
+int rnCaptureReaderOpen(const char *path, OUT RnCaptureReader **out);
+int rnCaptureReaderClose(IN RnCaptureReader *reader);
+
+/**
+ * Reads the next record and its datagram into `data`, which must hold at least
+ * `data_capacity` bytes. Returns RN_CAPTURE_END once the capture is exhausted,
+ * EINVAL for a record of unknown family or direction.
+ */
+int rnCaptureReaderNext(
+      RnCaptureReader *reader, OUT RnCaptureRecord *record, OUT uint8_t *data,
+      size_t data_capacity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_CAPTURE_H
@@ -0,0 +1,41 @@
+#ifndef RN_CHECKSUM_H
+#define RN_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum RnChecksumKernel
+{
+    RN_CHECKSUM_SCALAR,
+    RN_CHECKSUM_ARMV8,
+    RN_CHECKSUM_SSE42,
+};
+
+/**
+ * CRC32C (Castagnoli) of `size` bytes at `data`, continuing from the checksum
+ * `crc` of the bytes before them, 0 to start.
+ *
+ * The fastest kernel supported by the running CPU is selected on first use.
+ * SSE4.2 and ARMv8 kernels run three interleaved lanes of crc32 instructions
+ * and fold them with a carry-less multiply, well below a nanosecond per byte.
+ */
+uint32_t rnChecksumCrc32c(uint32_t crc, const void *data, size_t size);
+
+enum RnChecksumKernel rnChecksumKernel();
+
+/**
+ * Overrides kernel selection, e.g. to benchmark or verify kernels against each
+ * other. Selecting a kernel the CPU does not support falls back to scalar.
+ */
+void rnChecksumSelectKernel(enum RnChecksumKernel kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_CHECKSUM_H
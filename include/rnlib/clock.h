@@ -0,0 +1,142 @@
+#ifndef RN_CLOCK_H
+#define RN_CLOCK_H
+
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Clock requests carry the sender's time, responses echo it along with the
+ * responder's time and tick schedule. Neither is ever entropy coded.
+ */
+#define RN_CLOCK_REQUEST_PACKET_TYPE  (UINT16_MAX - 6)
+#define RN_CLOCK_RESPONSE_PACKET_TYPE (UINT16_MAX - 7)
+
+// samples the estimate is filtered from, the first ones are taken in a quick burst
+#define RN_CLOCK_SAMPLES  16
+#define RN_CLOCK_BURST    4
+#define RN_CLOCK_BURST_NS (100ull * 1000000)
+
+// a request per interval keeps the estimate fresh and the session alive
+#define RN_CLOCK_INTERVAL_NS (1000ull * 1000000)
+
+// responses taking longer say nothing useful about the offset
+#define RN_CLOCK_RTT_MAX_NS (1000ull * 1000000)
+
+// crystals drift by tens of ppm, larger estimates are noise
+#define RN_CLOCK_DRIFT_MAX 500e-6
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Monotonic time in nanoseconds since an unspecified epoch. All timestamps
+ * produced by the library share this clock.
+ */
+uint64_t rnClockMonotonic();
+
+/**
+ * Tick `n` starts at `origin + n * period` on the clock of whoever runs the
+ * ticks. A period of 0 means no ticks.
+ */
+struct RnClockTicks
+{
+    uint64_t origin;
+    uint64_t period;
+};
+
+/**
+ * One request and its response: the peer's clock read `remote_at` when the
+ * local clock read `at`, halfway through the round trip of `rtt`.
+ */
+struct RnClockSample
+{
+    uint64_t at;
+    uint64_t remote_at;
+    uint64_t rtt;
+};
+
+/**
+ * Estimate of a peer's monotonic clock as `offset` ahead of the local one at
+ * local time `offset_at`, running `drift` faster since, e.g. 10e-6 for a peer
+ * clock gaining 10 us per second. `rtt` is the round trip of the sample the
+ * offset came from. `ticks` are the local ticks advertised to the peer,
+ * `remote_ticks` the peer's as last advertised.
+ */
+struct RnClockSync
+{
+    struct RnClockSample samples[RN_CLOCK_SAMPLES];
+    uint32_t count;
+    uint64_t next_at;
+
+    bool synchronized;
+    int64_t offset;
+    uint64_t offset_at;
+    double drift;
+    uint64_t rtt;
+
+    struct RnClockTicks ticks;
+    struct RnClockTicks remote_ticks;
+};
+
+typedef struct RnClockTicks RnClockTicks;
+typedef struct RnClockSample RnClockSample;
+typedef struct RnClockSync RnClockSync;
+
+/**
+ * NTP-style offset and drift estimation against a peer's monotonic clock as
+ * plain state, the connection sends the requests and reports the responses.
+ *
+ * Of the samples kept, the offset is taken from the one with the shortest round
+ * trip, queueing delays only ever lengthen it and skew the midpoint. Drift is
+ * the least squares slope of the samples whose round trip stayed within twice
+ * the shortest.
+ */
+void rnClockSyncInit(OUT RnClockSync *sync, uint64_t now);
+
+/**
+ * Whether a request is due at `now`, schedules the next one if so.
+ */
+bool rnClockSyncDue(RnClockSync *sync, uint64_t now);
+
+/**
+ * Records the response to a request sent at `sent_at` and received at `now`,
+ * the peer's clock read `remote_at` in between. Implausible ones are ignored.
+ */
+void rnClockSyncSample(
+      RnClockSync *sync, uint64_t sent_at, uint64_t remote_at, const RnClockTicks *remote_ticks,
+      uint64_t now);
+
+/**
+ * The peer's clock at local time `local`, and the inverse. Both are identities
+ * until the first sample.
+ */
+uint64_t rnClockSyncRemote(const RnClockSync *sync, uint64_t local);
+
+uint64_t rnClockSyncLocal(const RnClockSync *sync, uint64_t remote);
+
+/**
+ * The peer's tick in progress at local time `local`, 0 before the first one
+ * or while the peer advertised none.
+ */
+uint64_t rnClockSyncTick(const RnClockSync *sync, uint64_t local);
+
+/**
+ * The earliest of the peer's ticks that input sent at `now` or later can still
+ * make with `margin` nanoseconds to spare, and the local time to send it at so
+ * that it arrives just that early. Sending right before the tick rather than
+ * right after the last one saves up to a full tick of queueing on the peer.
+ * False until synchronized with a peer that advertised ticks.
+ */
+bool rnClockSyncTickTarget(
+      const RnClockSync *sync, uint64_t now, uint64_t margin, OUT uint64_t *tick,
+      OUT uint64_t *send_at);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_CLOCK_H
@@ -1,9 +1,27 @@
 #ifndef RN_CONNECTION_H
 #define RN_CONNECTION_H
 
+#include "clock.h"
 #include "cryptography.h"
+#include "fec.h"
 #include "handshake.h"
+#include "metrics.h"
 #include "packet.h"
+#include "pmtu.h"
+#include "poly1305.h"
+#include "socket.h"
+
+/**
+ * Servers challenge a peer's new address before moving the session to it, the
+ * response echoes the challenge's random token. Neither is ever entropy coded.
+ * Further challenges wait for RN_CONNECTION_PATH_INTERVAL_NS.
+ */
+#define RN_CONNECTION_PATH_CHALLENGE_PACKET_TYPE (UINT16_MAX - 3)
+#define RN_CONNECTION_PATH_RESPONSE_PACKET_TYPE  (UINT16_MAX - 4)
+#define RN_CONNECTION_PATH_INTERVAL_NS           (250ull * 1000000)
+
+// packets rnConnectionReadPackets verifies at once, a few rounds of the widest Poly1305 kernel
+#define RN_CONNECTION_READ_BATCH (RN_POLY1305_LANES * 4)
 
 #ifdef __cplusplus
 extern "C"
@@ -15,6 +33,12 @@ enum RnConnectionReadResult
     RN_CONNECTION_READ_AVAILABLE,
     RN_CONNECTION_READ_EMPTY,
     RN_CONNECTION_READ_HANDSHAKE,
+    // path MTU probe, clock request or their responses, consumed by the connection
+    RN_CONNECTION_READ_PROBE,
+    // path challenge answered, the connection moved to the challenged address
+    RN_CONNECTION_READ_MIGRATED,
+    // parity packet with nothing to recover, consumed by the connection
+    RN_CONNECTION_READ_PARITY,
     RN_CONNECTION_READ_ERROR_SEQUENCE,
     RN_CONNECTION_READ_ERROR_CONTEXT,
     RN_CONNECTION_READ_ERROR_VERIFY,
@@ -25,17 +49,134 @@ enum RnConnectionWriteResult
     RN_CONNECTION_WRITE_OK,
     RN_CONNECTION_WRITE_ERROR_CONTEXT,
     RN_CONNECTION_WRITE_ERROR_AUTHENTICATE,
+    // the datagram exceeds rnConnectionPayloadMax
+    RN_CONNECTION_WRITE_ERROR_SIZE,
+};
+
+enum RnConnectionRole
+{
+    RN_CONNECTION_CLIENT,
+    RN_CONNECTION_SERVER,
 };
 
 #define RN_CONNECTION_DECL(TYPE, IP, BUFFER)                                                       \
     typedef struct RnConnection##TYPE##IP RnConnection##TYPE##IP;                                  \
                                                                                                    \
-    void rnConnectionEstablishHandshake(RnConnection##TYPE##IP *connection);                       \
+    int rnConnectionOpen##TYPE##IP(                                                                \
+          RnSocket##IP *socket, const RnAddress##IP *address, enum RnConnectionRole role,          \
+          OUT RnConnection##TYPE##IP **out);                                                       \
+                                                                                                   \
+    int rnConnectionClose##TYPE##IP(IN RnConnection##TYPE##IP *connection);                        \
+                                                                                                   \
+    enum RnHandshakeStep rnConnectionHandshakeStep##TYPE##IP(                                      \
+          const RnConnection##TYPE##IP *connection);                                               \
+                                                                                                   \
+    void rnConnectionMetrics##TYPE##IP(                                                            \
+          const RnConnection##TYPE##IP *connection, OUT RnMetricsCounters *out);                   \
+                                                                                                   \
+    void rnConnectionEstablishHandshake##TYPE##IP(RnConnection##TYPE##IP *connection);             \
+                                                                                                   \
+    /**                                                                                            \
+     * Largest datagram in bytes confirmed to reach the peer, RN_PACKET_BYTES_BASE until probing   \
+     * found more. Safe to call from any thread, see rnPacketBufferLimit.                          \
+     */                                                                                            \
+    uint16_t rnConnectionPayloadMax##TYPE##IP(const RnConnection##TYPE##IP *connection);           \
+                                                                                                   \
+    /**                                                                                            \
+     * Sends the path MTU probe due at `now`, if any, once the handshake completed. Call at least  \
+     * every RN_PMTU_POLL_INTERVAL_NS.                                                             \
+     */                                                                                            \
+    void rnConnectionProbePath##TYPE##IP(RnConnection##TYPE##IP *connection, uint64_t now);        \
+                                                                                                   \
+    /**                                                                                            \
+     * Sends the clock request due at `now`, if any, once the handshake completed. Requests keep   \
+     * the session alive and refine rnConnectionClock, a quick burst right after connecting and    \
+     * one per RN_CLOCK_INTERVAL_NS after. Call at least every RN_PMTU_POLL_INTERVAL_NS.           \
+     */                                                                                            \
+    void rnConnectionSyncClock##TYPE##IP(RnConnection##TYPE##IP *connection, uint64_t now);        \
+                                                                                                   \
+    /**                                                                                            \
+     * Tick schedule on the local clock advertised to the peer in clock responses, typically set   \
+     * by servers. Peers align their sends to it with rnClockSyncTickTarget.                       \
+     */                                                                                            \
+    void rnConnectionSetTicks##TYPE##IP(                                                           \
+          RnConnection##TYPE##IP *connection, const RnClockTicks *ticks);                          \
+                                                                                                   \
+    /**                                                                                            \
+     * Estimate of the peer's clock and its advertised ticks, see clock.h. Only valid on the       \
+     * thread the connection is used on.                                                           \
+     */                                                                                            \
+    const RnClockSync *rnConnectionClock##TYPE##IP(const RnConnection##TYPE##IP *connection);      \
+                                                                                                   \
+    /**                                                                                            \
+     * Identifies the session in the wire data of every packet once connected, so that servers     \
+     * find it when the peer's address changes. 0 for insecure connections and while connecting.   \
+     */                                                                                            \
+    uint32_t rnConnectionId##TYPE##IP(const RnConnection##TYPE##IP *connection);                   \
+                                                                                                   \
+    const RnAddress##IP *rnConnectionAddress##TYPE##IP(const RnConnection##TYPE##IP *connection);  \
                                                                                                    \
-    enum RnConnectionReadResult rnConnectionReadPacket(                                            \
+    /**                                                                                            \
+     * Sends a path challenge to `address` after a verified packet arrived from it. The answer     \
+     * reads as RN_CONNECTION_READ_MIGRATED, by then rnConnectionAddress is `address`.             \
+     */                                                                                            \
+    void rnConnectionValidatePath##TYPE##IP(                                                       \
+          RnConnection##TYPE##IP *connection, const RnAddress##IP *address);                       \
+                                                                                                   \
+    /**                                                                                            \
+     * Snapshot records of a connection, for a restarted process to continue its session without   \
+     * a new handshake. Records are only valid for builds of the library with the same layout,     \
+     * as told by rnConnectionSnapshotLayout. Fold it into the snapshot kind, see snapshot.h.      \
+     */                                                                                            \
+    size_t rnConnectionSnapshotSize##TYPE##IP(void);                                               \
+                                                                                                   \
+    uint32_t rnConnectionSnapshotLayout##TYPE##IP(void);                                           \
+                                                                                                   \
+    void rnConnectionSave##TYPE##IP(const RnConnection##TYPE##IP *connection, OUT void *record);   \
+                                                                                                   \
+    int rnConnectionRestore##TYPE##IP(                                                             \
+          RnSocket##IP *socket, const void *record, OUT RnConnection##TYPE##IP **out);             \
+                                                                                                   \
+    /**                                                                                            \
+     * Protects the configured packet types with XOR parity, see fec.h, replacing any previous     \
+     * configuration. An all zero config turns it off. A packet rebuilt from the parity reads as   \
+     * RN_CONNECTION_READ_AVAILABLE with its own type and sequence, a parity with nothing to       \
+     * rebuild as RN_CONNECTION_READ_PARITY. Not carried over by rnConnectionSave.                 \
+     */                                                                                            \
+    int rnConnectionConfigureFec##TYPE##IP(                                                        \
+          RnConnection##TYPE##IP *connection, const RnFecConfig *config);                          \
+                                                                                                   \
+    /**                                                                                            \
+     * Entropy codes the bodies of the configured packet types, see entropy.h, replacing any       \
+     * previous configuration. Bodies that would not shrink go out as is. Both peers have to       \
+     * configure the same models, a coded body without one reads as                                \
+     * RN_CONNECTION_READ_ERROR_CONTEXT. Not carried over by rnConnectionSave.                     \
+     */                                                                                            \
+    void rnConnectionConfigureEntropy##TYPE##IP(                                                   \
+          RnConnection##TYPE##IP *connection, const RnEntropyConfig *config);                      \
+                                                                                                   \
+    /**                                                                                            \
+     * Constant time checks of a received datagram ahead of any cryptography: its connection id    \
+     * as received, its source address and its sequence window. RN_CONNECTION_READ_AVAILABLE if    \
+     * it is worth passing on to rnConnectionReadPacket, the error it would fail with otherwise.   \
+     */                                                                                            \
+    enum RnConnectionReadResult rnConnectionScreen##TYPE##IP(                                      \
+          const RnConnection##TYPE##IP *connection, const RnPacketBuffer##BUFFER *buffer,          \
+          const RnAddress##IP *source);                                                            \
+                                                                                                   \
+    enum RnConnectionReadResult rnConnectionReadPacket##TYPE##IP(                                  \
           RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer);                     \
                                                                                                    \
-    enum RnConnectionWriteResult rnConnectionWritePacket(                                          \
+    /**                                                                                            \
+     * Reads `count` packets as many rnConnectionReadPacket calls would, packets of the same       \
+     * connection in order. Authenticated connections verify up to RN_CONNECTION_READ_BATCH tags   \
+     * at once, see poly1305.h, the other types read one by one.                                   \
+     */                                                                                            \
+    void rnConnectionReadPackets##TYPE##IP(                                                        \
+          RnConnection##TYPE##IP *const *connections, RnPacketBuffer##BUFFER *const *buffers,      \
+          size_t count, OUT enum RnConnectionReadResult *results);                                 \
+                                                                                                   \
+    enum RnConnectionWriteResult rnConnectionWritePacket##TYPE##IP(                                \
           RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer);
 
 /**
@@ -90,8 +231,80 @@ RN_CONNECTION_DECL(Encrypted, IPv6, Secure)
 RN_CONNECTION_DECL(Insecure, IPv4, Insecure)
 RN_CONNECTION_DECL(Insecure, IPv6, Insecure)
 
+/**
+ * Integrity mode of insecure connections, off by default. Enabled connections
+ * fold a CRC32C of header and body into the salt of their packets, corrupted
+ * datagrams then fail with RN_CONNECTION_READ_ERROR_VERIFY. The checksum costs
+ * a fraction of a nanosecond per byte on CPUs with crc32 instructions, see
+ * checksum.h.
+ *
+ * Checksummed packets are verified regardless of the setting and enable it on
+ * the receiving connection, only one of the peers has to opt in.
+ */
+void rnConnectionSetIntegrityIPv4(RnConnectionInsecureIPv4 *connection, bool enabled);
+void rnConnectionSetIntegrityIPv6(RnConnectionInsecureIPv6 *connection, bool enabled);
+
+#define rnConnectionSetIntegrity(connection, ...)                                                  \
+    RN_SELECT2(                                                                                    \
+          connection, RnConnectionInsecureIPv4, rnConnectionSetIntegrityIPv4,                      \
+          RnConnectionInsecureIPv6, rnConnectionSetIntegrityIPv6)(connection, __VA_ARGS__)
+
 #undef RN_CONNECTION_DECL
 
+#define RN_CONNECTION_SELECT(NAME, CONNECTION)                                                     \
+    RN_SELECT6(                                                                                    \
+          CONNECTION, RnConnectionAuthenticatedIPv4, NAME##AuthenticatedIPv4,                      \
+          RnConnectionAuthenticatedIPv6, NAME##AuthenticatedIPv6, RnConnectionEncryptedIPv4,       \
+          NAME##EncryptedIPv4, RnConnectionEncryptedIPv6, NAME##EncryptedIPv6,                     \
+          RnConnectionInsecureIPv4, NAME##InsecureIPv4, RnConnectionInsecureIPv6,                  \
+          NAME##InsecureIPv6)
+
+#define RN_CONNECTION_CALL(NAME, CONNECTION, ...)                                                  \
+    RN_CONNECTION_SELECT(NAME, CONNECTION)(CONNECTION, __VA_ARGS__)
+
+#define rnConnectionOpen(socket, address, role, out)                                               \
+    RN_CONNECTION_SELECT(rnConnectionOpen, *(out))(socket, address, role, out)
+#define rnConnectionRestore(socket, record, out)                                                   \
+    RN_CONNECTION_SELECT(rnConnectionRestore, *(out))(socket, record, out)
+#define rnConnectionReadPackets(connections, ...)                                                  \
+    RN_CONNECTION_SELECT(rnConnectionReadPackets, *(connections))(connections, __VA_ARGS__)
+#define rnConnectionClose(connection)                                                              \
+    RN_CONNECTION_SELECT(rnConnectionClose, connection)(connection)
+#define rnConnectionHandshakeStep(connection)                                                      \
+    RN_CONNECTION_SELECT(rnConnectionHandshakeStep, connection)(connection)
+#define rnConnectionEstablishHandshake(connection)                                                 \
+    RN_CONNECTION_SELECT(rnConnectionEstablishHandshake, connection)(connection)
+#define rnConnectionPayloadMax(connection)                                                         \
+    RN_CONNECTION_SELECT(rnConnectionPayloadMax, connection)(connection)
+#define rnConnectionClock(connection)                                                              \
+    RN_CONNECTION_SELECT(rnConnectionClock, connection)(connection)
+#define rnConnectionId(connection)                                                                 \
+    RN_CONNECTION_SELECT(rnConnectionId, connection)(connection)
+#define rnConnectionAddress(connection)                                                            \
+    RN_CONNECTION_SELECT(rnConnectionAddress, connection)(connection)
+#define rnConnectionMetrics(connection, ...)                                                       \
+    RN_CONNECTION_CALL(rnConnectionMetrics, connection, __VA_ARGS__)
+#define rnConnectionProbePath(connection, ...)                                                     \
+    RN_CONNECTION_CALL(rnConnectionProbePath, connection, __VA_ARGS__)
+#define rnConnectionSyncClock(connection, ...)                                                     \
+    RN_CONNECTION_CALL(rnConnectionSyncClock, connection, __VA_ARGS__)
+#define rnConnectionSetTicks(connection, ...)                                                      \
+    RN_CONNECTION_CALL(rnConnectionSetTicks, connection, __VA_ARGS__)
+#define rnConnectionValidatePath(connection, ...)                                                  \
+    RN_CONNECTION_CALL(rnConnectionValidatePath, connection, __VA_ARGS__)
+#define rnConnectionSave(connection, ...)                                                          \
+    RN_CONNECTION_CALL(rnConnectionSave, connection, __VA_ARGS__)
+#define rnConnectionConfigureFec(connection, ...)                                                  \
+    RN_CONNECTION_CALL(rnConnectionConfigureFec, connection, __VA_ARGS__)
+#define rnConnectionConfigureEntropy(connection, ...)                                              \
+    RN_CONNECTION_CALL(rnConnectionConfigureEntropy, connection, __VA_ARGS__)
+#define rnConnectionScreen(connection, ...)                                                        \
+    RN_CONNECTION_CALL(rnConnectionScreen, connection, __VA_ARGS__)
+#define rnConnectionReadPacket(connection, ...)                                                    \
+    RN_CONNECTION_CALL(rnConnectionReadPacket, connection, __VA_ARGS__)
+#define rnConnectionWritePacket(connection, ...)                                                   \
+    RN_CONNECTION_CALL(rnConnectionWritePacket, connection, __VA_ARGS__)
+
 #ifdef __cplusplus
 }
 #endif
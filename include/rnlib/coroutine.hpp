@@ -0,0 +1,1249 @@
+#ifndef RN_COROUTINE_HPP
+#define RN_COROUTINE_HPP
+
+#include "clock.h"
+#include "connection.h"
+#include "filter.h"
+#include "poller.h"
+#include "socket.h"
+#include "util.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define RN_COROUTINE_BATCH                 64
+#define RN_COROUTINE_INBOX_CAPACITY        8
+#define RN_COROUTINE_HANDSHAKE_ATTEMPTS    10
+#define RN_COROUTINE_HANDSHAKE_INTERVAL_NS 250000000ull
+#define RN_COROUTINE_HANDSHAKE_TIMEOUT_NS  5000000000ull
+
+/**
+ * C++20 coroutine layer over connections, driven by a single-threaded Scheduler
+ * that waits on its sockets through RnPoller:
+ *
+ *   rn::Task<> session(rn::Scheduler<rn::EncryptedIPv4> &scheduler,
+ *                      rn::Connection<rn::EncryptedIPv4> &connection)
+ *   {
+ *       while (const RnPacketBufferSecure *packet = co_await connection.receive())
+ *       {
+ *           RnPacketBufferSecure reply = ...;
+ *           co_await connection.send(reply);
+ *       }
+ *   }
+ *
+ *   rn::Task<> serve(rn::Scheduler<rn::EncryptedIPv4> &scheduler)
+ *   {
+ *       while (rn::Connection<rn::EncryptedIPv4> *connection = co_await scheduler.accept())
+ *       {
+ *           scheduler.spawn(session(scheduler, *connection));
+ *       }
+ *   }
+ *
+ * Coroutine frames come from a per-thread FramePool and awaiters live inside
+ * the frames, awaiting never allocates. Exceptions are not supported, an
+ * exception escaping a coroutine terminates.
+ */
+namespace rn
+{
+
+/**
+ * Power of two size classes from 64 bytes to 4 KiB carved from 64 KiB slabs.
+ * Slabs are only released with the pool, so spawning and finishing coroutines
+ * at a steady rate stays off the system allocator. Larger frames fall back to
+ * operator new.
+ */
+class FramePool
+{
+public:
+    static constexpr size_t CLASS_MIN   = 64;
+    static constexpr size_t CLASS_COUNT = 7;
+    static constexpr size_t SLAB_SIZE   = 64 * 1024;
+
+    FramePool() = default;
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    ~FramePool()
+    {
+        for (void *slab : slabs)
+        {
+            ::operator delete(slab);
+        }
+    }
+
+    void *allocate(size_t size)
+    {
+        size_t index = sizeClass(size);
+        if (index == CLASS_COUNT)
+        {
+            return ::operator new(size);
+        }
+
+        if (free[index] == nullptr)
+        {
+            refill(index);
+        }
+
+        Block *block = free[index];
+        free[index]  = block->next;
+        return block;
+    }
+
+    void deallocate(void *frame, size_t size) noexcept
+    {
+        size_t index = sizeClass(size);
+        if (index == CLASS_COUNT)
+        {
+            ::operator delete(frame);
+            return;
+        }
+
+        Block *block = static_cast<Block *>(frame);
+        block->next  = free[index];
+        free[index]  = block;
+    }
+
+    /** Pool of the calling thread, used by every Task frame. */
+    static FramePool &local()
+    {
+        static thread_local FramePool pool;
+        return pool;
+    }
+
+private:
+    struct Block
+    {
+        Block *next;
+    };
+
+    static size_t sizeClass(size_t size)
+    {
+        size_t index = 0;
+        for (size_t block = CLASS_MIN; block < size && index < CLASS_COUNT; block <<= 1)
+        {
+            ++index;
+        }
+
+        return index;
+    }
+
+    void refill(size_t index)
+    {
+        size_t block = CLASS_MIN << index;
+        char *slab   = static_cast<char *>(::operator new(SLAB_SIZE));
+        slabs.push_back(slab);
+
+        for (size_t offset = SLAB_SIZE; offset >= block; offset -= block)
+        {
+            deallocate(slab + offset - block, block);
+        }
+    }
+
+    Block *free[CLASS_COUNT] = {};
+    std::vector<void *> slabs;
+};
+
+namespace detail
+{
+
+struct PromiseBase
+{
+    std::coroutine_handle<> continuation;
+
+    // detached root coroutines are linked into their scheduler and free
+    // themselves on completion
+    std::coroutine_handle<> self;
+    PromiseBase *prev = nullptr;
+    PromiseBase *next = nullptr;
+
+    static void *operator new(size_t size)
+    {
+        return FramePool::local().allocate(size);
+    }
+
+    static void operator delete(void *frame, size_t size) noexcept
+    {
+        FramePool::local().deallocate(frame, size);
+    }
+
+    void unlink() noexcept
+    {
+        prev->next = next;
+        next->prev = prev;
+        prev = next = nullptr;
+    }
+
+    struct FinalAwaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            PromiseBase &promise = handle.promise();
+            if (promise.next != nullptr)
+            {
+                promise.unlink();
+                handle.destroy();
+                return std::noop_coroutine();
+            }
+
+            return promise.continuation ? promise.continuation : std::noop_coroutine();
+        }
+
+        void await_resume() noexcept { }
+    };
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        std::terminate();
+    }
+};
+
+template <typename T> struct Promise : PromiseBase
+{
+    T value {};
+
+    void return_value(T result)
+    {
+        value = std::move(result);
+    }
+
+    T result()
+    {
+        return std::move(value);
+    }
+};
+
+template <> struct Promise<void> : PromiseBase
+{
+    void return_void() noexcept { }
+    void result() noexcept { }
+};
+
+struct Timer
+{
+    uint64_t deadline;
+    size_t index;
+    std::coroutine_handle<> handle;
+
+    // called on expiry before `handle` is scheduled, NULL for plain sleeps
+    void (*expired)(Timer *timer);
+};
+
+} // namespace detail
+
+/**
+ * Lazily started coroutine, runs once awaited or spawned on a Scheduler.
+ */
+template <typename T = void> class Task
+{
+public:
+    struct promise_type : detail::Promise<T>
+    {
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    Task(Task &&other) noexcept : handle(std::exchange(other.handle, {})) { }
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+            {
+                handle.destroy();
+            }
+
+            handle = std::exchange(other.handle, {});
+        }
+
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume()
+    {
+        return handle.promise().result();
+    }
+
+    /** Hands ownership of the frame to the caller, see Scheduler::spawn. */
+    std::coroutine_handle<promise_type> release() noexcept
+    {
+        return std::exchange(handle, {});
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> coroutine) : handle(coroutine) { }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+#define RN_COROUTINE_KIND(TYPE, IP, BUFFER)                                                        \
+    struct TYPE##IP                                                                                \
+    {                                                                                              \
+        using Connection = RnConnection##TYPE##IP;                                                 \
+        using Socket     = RnSocket##IP;                                                           \
+        using Address    = RnAddress##IP;                                                          \
+        using Buffer     = RnPacketBuffer##BUFFER;                                                 \
+                                                                                                   \
+        static Buffer createBuffer(uint16_t type)                                                  \
+        {                                                                                          \
+            return rnPacketBufferCreate##BUFFER(type);                                             \
+        }                                                                                          \
+    };
+
+RN_COROUTINE_KIND(Authenticated, IPv4, Secure)
+RN_COROUTINE_KIND(Authenticated, IPv6, Secure)
+
+RN_COROUTINE_KIND(Encrypted, IPv4, Secure)
+RN_COROUTINE_KIND(Encrypted, IPv6, Secure)
+
+RN_COROUTINE_KIND(Insecure, IPv4, Insecure)
+RN_COROUTINE_KIND(Insecure, IPv6, Insecure)
+
+#undef RN_COROUTINE_KIND
+
+template <typename Kind> class Scheduler;
+
+/**
+ * Connection owned by a Scheduler. Verified packets queue in a small inbox
+ * until received, ingress beyond RN_COROUTINE_INBOX_CAPACITY is dropped.
+ */
+template <typename Kind> class Connection
+{
+public:
+    using Address = typename Kind::Address;
+    using Buffer  = typename Kind::Buffer;
+
+    struct ReceiveAwaiter
+    {
+        Connection *connection;
+        const Buffer *result;
+        std::coroutine_handle<> handle;
+
+        bool await_ready() noexcept
+        {
+            if (connection->inbox_count == 0)
+            {
+                return false;
+            }
+
+            result = connection->take();
+            return true;
+        }
+
+        void await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle               = awaiting;
+            connection->receiver = this;
+        }
+
+        const Buffer *await_resume() noexcept
+        {
+            return result;
+        }
+    };
+
+    struct SendAwaiter
+    {
+        enum RnConnectionWriteResult result;
+
+        bool await_ready() noexcept
+        {
+            return true;
+        }
+
+        void await_suspend(std::coroutine_handle<>) noexcept { }
+
+        enum RnConnectionWriteResult await_resume() noexcept
+        {
+            return result;
+        }
+    };
+
+    struct StepAwaiter : detail::Timer
+    {
+        Scheduler<Kind> *scheduler;
+        Connection *connection;
+        enum RnHandshakeStep result;
+
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle                  = awaiting;
+            expired                 = &StepAwaiter::timeout;
+            connection->step_waiter = this;
+            scheduler->arm(this);
+        }
+
+        enum RnHandshakeStep await_resume() noexcept
+        {
+            return result;
+        }
+
+        static void timeout(detail::Timer *timer) noexcept
+        {
+            StepAwaiter *awaiter = static_cast<StepAwaiter *>(timer);
+            awaiter->connection->step_waiter = nullptr;
+            awaiter->result                  = awaiter->connection->step();
+        }
+    };
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    /**
+     * Next verified packet, or NULL once the connection is closed. The packet
+     * stays valid until the next receive.
+     */
+    ReceiveAwaiter receive() noexcept
+    {
+        release();
+        return ReceiveAwaiter { this, nullptr, {} };
+    }
+
+    /**
+     * Datagram sockets never block on send, the awaiter completes right away
+     * and only keeps call sites uniform with receive.
+     */
+    SendAwaiter send(Buffer &buffer) noexcept
+    {
+        return SendAwaiter { rnConnectionWritePacket(connection, &buffer) };
+    }
+
+    /**
+     * Suspends until the handshake step changes or `timeout_ns` passed, yields
+     * the current step. Closed connections yield RN_HANDSHAKE_DISCONNECTED.
+     */
+    StepAwaiter progress(uint64_t timeout_ns) noexcept
+    {
+        StepAwaiter awaiter {};
+        awaiter.deadline   = rnClockMonotonic() + timeout_ns;
+        awaiter.scheduler  = scheduler;
+        awaiter.connection = this;
+        awaiter.result     = RN_HANDSHAKE_DISCONNECTED;
+        return awaiter;
+    }
+
+    enum RnHandshakeStep step() const noexcept
+    {
+        return rnConnectionHandshakeStep(connection);
+    }
+
+    const Address &address() const noexcept
+    {
+        return peer;
+    }
+
+    typename Kind::Connection *handle() const noexcept
+    {
+        return connection;
+    }
+
+    /** Packets dropped because the inbox was full. */
+    uint64_t dropped() const noexcept
+    {
+        return drops;
+    }
+
+private:
+    friend class Scheduler<Kind>;
+
+    Connection(Scheduler<Kind> *owner, const Address &address, uint32_t token)
+        : scheduler(owner), peer(address), socket_token(token)
+    {
+    }
+
+    const Buffer *take() noexcept
+    {
+        holding = true;
+        return &inbox[inbox_head];
+    }
+
+    void release() noexcept
+    {
+        if (holding)
+        {
+            holding    = false;
+            inbox_head = (inbox_head + 1) % RN_COROUTINE_INBOX_CAPACITY;
+            --inbox_count;
+        }
+    }
+
+    bool deliver(const Buffer &buffer) noexcept
+    {
+        if (inbox_count == RN_COROUTINE_INBOX_CAPACITY)
+        {
+            ++drops;
+            return false;
+        }
+
+        // copy only up to the end of the received body
+        uint32_t tail = (inbox_head + inbox_count) % RN_COROUTINE_INBOX_CAPACITY;
+        size_t size   = offsetof(Buffer, body) + (buffer.meta.body_size + 7) / 8 * 8;
+        std::memcpy(&inbox[tail], &buffer, size);
+        ++inbox_count;
+        return true;
+    }
+
+    Scheduler<Kind> *scheduler;
+    typename Kind::Connection *connection = nullptr;
+    Address peer;
+    uint32_t socket_token;
+    enum RnConnectionRole role = RN_CONNECTION_SERVER;
+    bool announced             = false;
+    uint64_t opened_at         = 0;
+
+    ReceiveAwaiter *receiver = nullptr;
+    StepAwaiter *step_waiter = nullptr;
+    Connection *accept_next  = nullptr;
+
+    Buffer inbox[RN_COROUTINE_INBOX_CAPACITY];
+    uint32_t inbox_head  = 0;
+    uint32_t inbox_count = 0;
+    bool holding         = false;
+    uint64_t drops       = 0;
+};
+
+/**
+ * Runs coroutines on the calling thread and waits on its sockets while they
+ * are all suspended. Like reactor I/O threads, schedulers open a server
+ * connection for every unknown address, run its handshake and hand it out
+ * through accept once connected.
+ *
+ * Either call run until stop, or call poll from an existing loop.
+ */
+template <typename Kind> class Scheduler
+{
+public:
+    using Address    = typename Kind::Address;
+    using Buffer     = typename Kind::Buffer;
+    using Socket     = typename Kind::Socket;
+    using Connection = rn::Connection<Kind>;
+
+    struct AcceptAwaiter
+    {
+        Scheduler *scheduler;
+        Connection *result;
+        std::coroutine_handle<> handle;
+
+        bool await_ready() noexcept
+        {
+            result = scheduler->dequeueAccept();
+            return result != nullptr || scheduler->stopped;
+        }
+
+        void await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle              = awaiting;
+            scheduler->acceptor = this;
+        }
+
+        Connection *await_resume() noexcept
+        {
+            return result;
+        }
+    };
+
+    struct SleepAwaiter : detail::Timer
+    {
+        Scheduler *scheduler;
+
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        void await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            handle = awaiting;
+            scheduler->arm(this);
+        }
+
+        void await_resume() noexcept { }
+    };
+
+    Scheduler()
+    {
+        roots.prev = roots.next = &roots;
+    }
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    /**
+     * Destroys every coroutine still suspended on the scheduler and closes all
+     * connections.
+     */
+    ~Scheduler()
+    {
+        while (roots.next != &roots)
+        {
+            std::coroutine_handle<> self = roots.next->self;
+            roots.next->unlink();
+            self.destroy();
+        }
+
+        for (auto &entry : connections)
+        {
+            rnConnectionClose(entry.second->connection);
+            delete entry.second;
+        }
+
+        if (poller != nullptr)
+        {
+            rnPollerClose(poller);
+        }
+
+        rnFilterFree(&filter);
+    }
+
+    /**
+     * Waits on `sockets`, which stay owned by the caller, and reports the
+     * result of the first failing poller call. Handshake packets are rate
+     * limited per source address as configured by `filter_config`, which also
+     * bounds how many connections all sources together may open.
+     */
+    int open(
+          Socket *const *sockets, uint32_t socket_count, const RnPollerConfig &config,
+          const RnFilterConfig &filter_config = {})
+    {
+        int result = rnFilterInit(&filter, &filter_config, rnClockMonotonic());
+        if (result != RN_OK)
+        {
+            return result;
+        }
+
+        result = rnPollerOpen(&config, &poller);
+        if (result != RN_OK)
+        {
+            return result;
+        }
+
+        for (uint32_t i = 0; i < socket_count; ++i)
+        {
+            result = rnPollerAdd(poller, sockets[i], i);
+            if (result != RN_OK)
+            {
+                return result;
+            }
+
+            this->sockets.push_back(sockets[i]);
+        }
+
+        return RN_OK;
+    }
+
+    /** Starts a detached coroutine, its frame is freed once it completes. */
+    void spawn(Task<> task)
+    {
+        auto handle               = task.release();
+        detail::PromiseBase &root = handle.promise();
+
+        root.self        = handle;
+        root.prev        = &roots;
+        root.next        = roots.next;
+        roots.next->prev = &root;
+        roots.next       = &root;
+
+        schedule(handle);
+    }
+
+    /**
+     * Opens a client connection to `address` on the socket at index `socket`,
+     * NULL on failure. Drive its handshake with rn::handshake.
+     */
+    Connection *connect(const Address &address, uint32_t socket = 0)
+    {
+        return openConnection(address, socket, RN_CONNECTION_CLIENT);
+    }
+
+    /**
+     * Closes `connection` and wakes its waiters with NULL or
+     * RN_HANDSHAKE_DISCONNECTED. `connection` must not be used after.
+     */
+    void close(Connection *connection)
+    {
+        connections.erase(Key { connection->peer, connection->socket_token });
+
+        auto route = routes.find(rnConnectionId(connection->connection));
+        if (route != routes.end() && route->second == connection)
+        {
+            routes.erase(route);
+        }
+
+        if (connection->receiver != nullptr)
+        {
+            connection->receiver->result = nullptr;
+            schedule(connection->receiver->handle);
+        }
+
+        if (connection->step_waiter != nullptr)
+        {
+            disarm(connection->step_waiter);
+            connection->step_waiter->result = RN_HANDSHAKE_DISCONNECTED;
+            schedule(connection->step_waiter->handle);
+        }
+
+        Connection *previous = nullptr;
+        for (Connection *queued = accept_head; queued != nullptr; queued = queued->accept_next)
+        {
+            if (queued == connection)
+            {
+                (previous != nullptr ? previous->accept_next : accept_head) = queued->accept_next;
+                accept_tail = accept_tail == queued ? previous : accept_tail;
+                break;
+            }
+
+            previous = queued;
+        }
+
+        rnConnectionClose(connection->connection);
+        delete connection;
+    }
+
+    /**
+     * Next server connection that completed its handshake, NULL once stopped.
+     * Only one coroutine may wait on accept at a time.
+     */
+    AcceptAwaiter accept() noexcept
+    {
+        return AcceptAwaiter { this, nullptr, {} };
+    }
+
+    SleepAwaiter sleep(uint64_t duration_ns) noexcept
+    {
+        SleepAwaiter awaiter {};
+        awaiter.deadline  = rnClockMonotonic() + duration_ns;
+        awaiter.scheduler = this;
+        return awaiter;
+    }
+
+    /**
+     * Runs ready coroutines, then waits up to `timeout_ns` for ingress or the
+     * next timer and runs whatever that woke up. Path MTU probes and clock
+     * requests are sent from here as well, and server connections whose
+     * handshake has not completed within RN_COROUTINE_HANDSHAKE_TIMEOUT_NS are
+     * closed, so that sources which never finish one do not pile up.
+     */
+    int poll(uint64_t timeout_ns)
+    {
+        runReady();
+
+        uint64_t now = rnClockMonotonic();
+        if (!ready.empty())
+        {
+            timeout_ns = 0;
+        }
+        else if (!timers.empty())
+        {
+            uint64_t until = timers[0]->deadline > now ? timers[0]->deadline - now : 0;
+            timeout_ns     = until < timeout_ns ? until : timeout_ns;
+        }
+
+        if (!connections.empty())
+        {
+            uint64_t until = probe_at > now ? probe_at - now : 0;
+            timeout_ns     = until < timeout_ns ? until : timeout_ns;
+        }
+
+        uint32_t tokens[16];
+        uint32_t count = 0;
+
+        int result = rnPollerWait(poller, timeout_ns, tokens, 16, &count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            ingress(tokens[i]);
+        }
+
+        now = rnClockMonotonic();
+        while (!timers.empty() && timers[0]->deadline <= now)
+        {
+            detail::Timer *timer = timers[0];
+            disarm(timer);
+            expire(timer);
+        }
+
+        if (now >= probe_at)
+        {
+            probe_at = now + RN_PMTU_POLL_INTERVAL_NS;
+            for (auto entry = connections.begin(); entry != connections.end();)
+            {
+                // close only erases the entry already stepped past
+                Connection *connection = (entry++)->second;
+                if (connection->role == RN_CONNECTION_SERVER &&
+                    connection->step() != RN_HANDSHAKE_CONNECTED &&
+                    now - connection->opened_at >= RN_COROUTINE_HANDSHAKE_TIMEOUT_NS)
+                {
+                    close(connection);
+                    continue;
+                }
+
+                rnConnectionProbePath(connection->connection, now);
+                rnConnectionSyncClock(connection->connection, now);
+            }
+        }
+
+        runReady();
+        return result;
+    }
+
+    /** Polls until stop is called, usually from a coroutine. */
+    int run()
+    {
+        while (!stopped)
+        {
+            int result = poll(RN_POLLER_WAIT_FOREVER);
+            if (result != RN_OK)
+            {
+                return result;
+            }
+        }
+
+        return RN_OK;
+    }
+
+    /** Makes run return and wakes a pending accept with NULL. */
+    void stop() noexcept
+    {
+        stopped = true;
+        if (acceptor != nullptr)
+        {
+            schedule(std::exchange(acceptor, nullptr)->handle);
+        }
+    }
+
+private:
+    friend class rn::Connection<Kind>;
+
+    struct Key
+    {
+        Address address;
+        uint32_t socket;
+
+        bool operator==(const Key &other) const noexcept
+        {
+            return socket == other.socket &&
+                   std::memcmp(&address, &other.address, sizeof address) == 0;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const noexcept
+        {
+            const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&key.address);
+            uint32_t hash        = 2166136261u ^ key.socket;
+
+            for (size_t i = 0; i < sizeof key.address; ++i)
+            {
+                hash = (hash ^ bytes[i]) * 16777619u;
+            }
+
+            return hash;
+        }
+    };
+
+    Connection *openConnection(
+          const Address &address, uint32_t socket, enum RnConnectionRole role)
+    {
+        if (socket >= sockets.size())
+        {
+            return nullptr;
+        }
+
+        Connection *connection = new (std::nothrow) Connection(this, address, socket);
+        if (connection == nullptr)
+        {
+            return nullptr;
+        }
+
+        if (rnConnectionOpen(sockets[socket], &address, role, &connection->connection) != RN_OK)
+        {
+            delete connection;
+            return nullptr;
+        }
+
+        connection->role      = role;
+        connection->opened_at = rnClockMonotonic();
+        connections.emplace(Key { address, socket }, connection);
+        return connection;
+    }
+
+    void ingress(uint32_t token)
+    {
+        for (int batch = 0; batch < RN_COROUTINE_BATCH; ++batch)
+        {
+            Key key;
+            scratch.meta.connection_id = 0;
+
+            size_t size = rnPacketBufferWireCapacity(&scratch);
+            if (rnSocketReceiveData(
+                      sockets[token], &key.address, rnPacketBufferWireData(&scratch), &size) !=
+                RN_OK)
+            {
+                break;
+            }
+
+            if (rnPacketBufferWireReceived(&scratch, size) != RN_OK)
+            {
+                continue;
+            }
+
+            key.socket = token;
+
+            // junk and floods are dropped here, ahead of any cryptography
+            if (scratch.head.type == RN_HANDSHAKE_PACKET_TYPE &&
+                !rnFilterAdmit(&filter, &key.address, sizeof key.address, rnClockMonotonic()))
+            {
+                continue;
+            }
+
+            auto found             = connections.find(key);
+            Connection *connection = found != connections.end() ? found->second : nullptr;
+
+            // unknown addresses carrying an id are known peers on a new path, never new ones
+            if (connection == nullptr && scratch.meta.connection_id != 0)
+            {
+                auto route = routes.find(scratch.meta.connection_id);
+                if (route != routes.end() && route->second->socket_token == token)
+                {
+                    connection = route->second;
+                }
+            }
+            else if (connection == nullptr && scratch.head.type == RN_HANDSHAKE_PACKET_TYPE &&
+                     rnFilterAdmitOpen(&filter, rnClockMonotonic()))
+            {
+                connection = openConnection(key.address, token, RN_CONNECTION_SERVER);
+            }
+
+            if (connection == nullptr ||
+                rnConnectionScreen(connection->connection, &scratch, &key.address) !=
+                      RN_CONNECTION_READ_AVAILABLE)
+            {
+                continue;
+            }
+
+            enum RnConnectionReadResult read_result =
+                  rnConnectionReadPacket(connection->connection, &scratch);
+            if (read_result == RN_CONNECTION_READ_MIGRATED)
+            {
+                migrate(connection);
+                continue;
+            }
+
+            // only verified datagrams may start moving the session elsewhere
+            if (read_result == RN_CONNECTION_READ_AVAILABLE &&
+                std::memcmp(&connection->peer, &key.address, sizeof key.address) != 0)
+            {
+                rnConnectionValidatePath(connection->connection, &key.address);
+            }
+
+            if (read_result == RN_CONNECTION_READ_HANDSHAKE)
+            {
+                rnConnectionEstablishHandshake(connection->connection);
+                advance(connection);
+            }
+            else if (read_result == RN_CONNECTION_READ_AVAILABLE && connection->deliver(scratch))
+            {
+                if (connection->receiver != nullptr)
+                {
+                    connection->receiver->result = connection->take();
+                    schedule(std::exchange(connection->receiver, nullptr)->handle);
+                }
+            }
+        }
+    }
+
+    // rekeys a session whose path challenge was answered from a new address
+    void migrate(Connection *connection)
+    {
+        const Address *address = rnConnectionAddress(connection->connection);
+        if (connections.contains(Key { *address, connection->socket_token }))
+        {
+            return;
+        }
+
+        connections.erase(Key { connection->peer, connection->socket_token });
+        connection->peer = *address;
+        connections.emplace(Key { connection->peer, connection->socket_token }, connection);
+    }
+
+    void advance(Connection *connection)
+    {
+        if (connection->step_waiter != nullptr)
+        {
+            disarm(connection->step_waiter);
+            connection->step_waiter->result = connection->step();
+            schedule(std::exchange(connection->step_waiter, nullptr)->handle);
+        }
+
+        if (connection->role != RN_CONNECTION_SERVER || connection->announced ||
+            connection->step() != RN_HANDSHAKE_CONNECTED)
+        {
+            return;
+        }
+
+        connection->announced = true;
+
+        // colliding ids leave the newcomer unable to migrate, nothing worse
+        uint32_t id = rnConnectionId(connection->connection);
+        if (id != 0)
+        {
+            routes.emplace(id, connection);
+        }
+
+        if (acceptor != nullptr)
+        {
+            acceptor->result = connection;
+            schedule(std::exchange(acceptor, nullptr)->handle);
+            return;
+        }
+
+        connection->accept_next = nullptr;
+        if (accept_tail != nullptr)
+        {
+            accept_tail->accept_next = connection;
+        }
+        else
+        {
+            accept_head = connection;
+        }
+
+        accept_tail = connection;
+    }
+
+    Connection *dequeueAccept() noexcept
+    {
+        Connection *connection = accept_head;
+        if (connection != nullptr)
+        {
+            accept_head = connection->accept_next;
+            if (accept_head == nullptr)
+            {
+                accept_tail = nullptr;
+            }
+        }
+
+        return connection;
+    }
+
+    void schedule(std::coroutine_handle<> handle)
+    {
+        ready.push_back(handle);
+    }
+
+    void runReady()
+    {
+        while (!ready.empty())
+        {
+            running.swap(ready);
+            for (std::coroutine_handle<> handle : running)
+            {
+                handle.resume();
+            }
+
+            running.clear();
+        }
+    }
+
+    // binary min-heap on deadline, timers remember their index for removal
+
+    void arm(detail::Timer *timer)
+    {
+        timer->index = timers.size();
+        timers.push_back(timer);
+        siftUp(timer->index);
+    }
+
+    void disarm(detail::Timer *timer)
+    {
+        size_t index = timer->index;
+        size_t last  = timers.size() - 1;
+        if (index != last)
+        {
+            place(index, timers[last]);
+            timers.pop_back();
+            siftDown(index);
+            siftUp(index);
+        }
+        else
+        {
+            timers.pop_back();
+        }
+    }
+
+    void expire(detail::Timer *timer)
+    {
+        if (timer->expired != nullptr)
+        {
+            timer->expired(timer);
+        }
+
+        schedule(timer->handle);
+    }
+
+    void place(size_t index, detail::Timer *timer)
+    {
+        timers[index] = timer;
+        timer->index  = index;
+    }
+
+    void siftUp(size_t index)
+    {
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / 2;
+            if (timers[parent]->deadline <= timers[index]->deadline)
+            {
+                break;
+            }
+
+            detail::Timer *timer = timers[index];
+            place(index, timers[parent]);
+            place(parent, timer);
+            index = parent;
+        }
+    }
+
+    void siftDown(size_t index)
+    {
+        for (;;)
+        {
+            size_t smallest = index;
+            size_t left     = index * 2 + 1;
+            size_t right    = left + 1;
+
+            if (left < timers.size() && timers[left]->deadline < timers[smallest]->deadline)
+            {
+                smallest = left;
+            }
+
+            if (right < timers.size() && timers[right]->deadline < timers[smallest]->deadline)
+            {
+                smallest = right;
+            }
+
+            if (smallest == index)
+            {
+                break;
+            }
+
+            detail::Timer *timer = timers[index];
+            place(index, timers[smallest]);
+            place(smallest, timer);
+            index = smallest;
+        }
+    }
+
+    RnPoller *poller = nullptr;
+    RnFilter filter  = {};
+    std::vector<Socket *> sockets;
+    std::unordered_map<Key, Connection *, KeyHash> connections;
+    std::unordered_map<uint32_t, Connection *> routes;
+
+    std::vector<std::coroutine_handle<>> ready;
+    std::vector<std::coroutine_handle<>> running;
+    std::vector<detail::Timer *> timers;
+    detail::PromiseBase roots;
+
+    AcceptAwaiter *acceptor = nullptr;
+    Connection *accept_head = nullptr;
+    Connection *accept_tail = nullptr;
+    bool stopped            = false;
+    uint64_t probe_at       = 0;
+
+    Buffer scratch = Kind::createBuffer(0);
+};
+
+/**
+ * Drives the handshake of `connection` to completion, resending the current
+ * handshake packet every `interval_ns` without progress. Yields false once
+ * `attempts` resends went unanswered or the connection was closed.
+ */
+template <typename Kind>
+Task<bool> handshake(
+      Connection<Kind> &connection, uint32_t attempts = RN_COROUTINE_HANDSHAKE_ATTEMPTS,
+      uint64_t interval_ns = RN_COROUTINE_HANDSHAKE_INTERVAL_NS)
+{
+    enum RnHandshakeStep step = connection.step();
+    if (step == RN_HANDSHAKE_DISCONNECTED && attempts > 0)
+    {
+        rnConnectionEstablishHandshake(connection.handle());
+        step = connection.step();
+    }
+
+    uint32_t resends = 0;
+    while (step != RN_HANDSHAKE_CONNECTED)
+    {
+        enum RnHandshakeStep next = co_await connection.progress(interval_ns);
+        if (next == RN_HANDSHAKE_DISCONNECTED)
+        {
+            co_return false;
+        }
+
+        if (next == step)
+        {
+            if (++resends >= attempts)
+            {
+                co_return false;
+            }
+
+            rnConnectionEstablishHandshake(connection.handle());
+        }
+
+        step = connection.step();
+    }
+
+    co_return true;
+}
+
+} // namespace rn
+
+#endif // RN_COROUTINE_HPP
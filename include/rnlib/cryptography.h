@@ -1,8 +1,23 @@
 #ifndef RN_CRYPTOGRAPHY_H
 #define RN_CRYPTOGRAPHY_H
 
+#include "util.h"
+
 #include <stdint.h>
 
+/**
+ * Egress moves on to the next key epoch once it wrote RN_SESSION_EPOCH_NONCES
+ * packets with its key, well before the 32 bit nonce could repeat. Ingress
+ * keeps accepting the previous epoch for RN_SESSION_EPOCH_OVERLAP_NS after
+ * switching, for packets reordered across the switch. Tests lower the former
+ * to cross epochs quickly.
+ */
+#ifndef RN_SESSION_EPOCH_NONCES
+    #define RN_SESSION_EPOCH_NONCES (1u << 31)
+#endif
+
+#define RN_SESSION_EPOCH_OVERLAP_NS (2ull * 1000000000)
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -36,7 +51,82 @@ int rnKeyPairComputeSessionClient(
  * server key pair and client public key.
  */
 int rnKeyPairComputeSessionServer(
-      const KeyPair &server_keys, const KeyBuffer &client_pubkey, OUT RnKeyPair *out);
+      const RnKeyPair *server_keys, const RnKeyBuffer *client_pubkey, OUT RnKeyPair *out);
+
+enum RnSessionEpoch
+{
+    RN_SESSION_EPOCH_CURRENT,
+    RN_SESSION_EPOCH_PREVIOUS,
+    RN_SESSION_EPOCH_NEXT,
+};
+
+/**
+ * Keys of one direction, `next` is derived as soon as `key` comes into use so
+ * that switching epochs never waits on the key derivation.
+ */
+struct RnSessionDirection
+{
+    uint32_t epoch;
+    RnKeyBuffer key;
+    RnKeyBuffer next;
+};
+
+struct RnSessionKeys
+{
+    struct RnSessionDirection egress;
+    struct RnSessionDirection ingress;
+
+    // accepted until `ingress_previous_until`, zeroed once it passed
+    RnKeyBuffer ingress_previous;
+    uint64_t ingress_previous_until;
+};
+
+typedef struct RnSessionKeys RnSessionKeys;
+
+/**
+ * Sets up epoch 0 from a session key pair as computed by
+ * rnKeyPairComputeSessionClient or rnKeyPairComputeSessionServer, whose `pub`
+ * key is used for egress and `sec` key for ingress.
+ *
+ * Every epoch's key is derived from the one before it and the old key wiped,
+ * both sides step through the same keys without further key exchange. Packets
+ * carry the low bit of their epoch as the RN_PACKET_PROTOCOL_KEY_PHASE bit of
+ * their header.
+ */
+int rnSessionKeysInit(OUT RnSessionKeys *keys, const RnKeyPair *session);
+
+/**
+ * Zeroes all keys.
+ */
+void rnSessionKeysClear(RnSessionKeys *keys);
+
+/**
+ * Key phase bit to set in the header of egress packets.
+ */
+uint16_t rnSessionKeysEgressPhase(const RnSessionKeys *keys);
+
+/**
+ * Switches egress to the next epoch, the caller restarts its nonces at 0.
+ */
+int rnSessionKeysEgressAdvance(RnSessionKeys *keys);
+
+/**
+ * Key phase bit of ingress packets of the current epoch.
+ */
+uint16_t rnSessionKeysIngressPhase(const RnSessionKeys *keys);
+
+/**
+ * Picks the key to verify an ingress packet of key phase `phase` with. The
+ * other phase is the previous epoch during the overlap, the next one after.
+ */
+const RnKeyBuffer *rnSessionKeysIngressSelect(
+      RnSessionKeys *keys, uint16_t phase, uint64_t now, OUT enum RnSessionEpoch *epoch);
+
+/**
+ * Switches ingress to the next epoch once a packet of it verified, keeping
+ * the current key as the previous one for the overlap.
+ */
+int rnSessionKeysIngressAdvance(RnSessionKeys *keys, uint64_t now);
 
 #ifdef __cplusplus
 }
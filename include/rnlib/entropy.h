@@ -0,0 +1,106 @@
+#ifndef RN_ENTROPY_H
+#define RN_ENTROPY_H
+
+#include "util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Codes are limited so that every code resolves with a single lookup.
+ */
+#define RN_ENTROPY_CODE_BITS_MAX 11
+#define RN_ENTROPY_LOOKUP_SIZE   (1u << RN_ENTROPY_CODE_BITS_MAX)
+
+/**
+ * Serialized models hold one 4 bit code length per byte value.
+ */
+#define RN_ENTROPY_TABLE_BYTES 128
+
+/**
+ * Encoded data starts with the decoded size as a little endian uint16.
+ */
+#define RN_ENTROPY_PREFIX_BYTES 2
+
+// packet types entropy coded per connection at most
+#define RN_ENTROPY_TYPES_MAX 8
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Static canonical Huffman model over byte values.
+ *
+ * Game traffic is small and repetitive, so instead of adapting per packet a
+ * model is trained offline from captured traffic for each packet type (see
+ * tools/entropy.c) and compiled in as a RN_ENTROPY_TABLE_BYTES table. Every
+ * byte value is assigned a code, so any input can be encoded.
+ */
+struct RnEntropyModel
+{
+    // codes are bit reversed, the stream is written least significant bit first
+    uint16_t codes[256];
+    uint8_t lengths[256];
+
+    // indexed by the next RN_ENTROPY_CODE_BITS_MAX bits, holds symbol << 4 | length
+    uint16_t lookup[RN_ENTROPY_LOOKUP_SIZE];
+};
+
+typedef struct RnEntropyModel RnEntropyModel;
+
+/**
+ * Packet types a connection entropy codes and the model trained for each. Entries
+ * without a model are unused. Models are referenced rather than copied and must
+ * outlive the connections they are configured for.
+ */
+struct RnEntropyConfig
+{
+    struct RnEntropyConfigType
+    {
+        uint16_t type;
+        const RnEntropyModel *model;
+    } types[RN_ENTROPY_TYPES_MAX];
+};
+
+typedef struct RnEntropyConfig RnEntropyConfig;
+
+/**
+ * Derives length limited code lengths from byte frequencies and serializes
+ * them into `table`. Zero frequencies are treated as one.
+ */
+void rnEntropyTrain(const uint64_t frequencies[256], OUT uint8_t table[RN_ENTROPY_TABLE_BYTES]);
+
+/**
+ * Builds a model from a serialized table. Returns RN_OOM if the table does
+ * not describe a complete prefix code.
+ */
+int rnEntropyModelCreate(const uint8_t table[RN_ENTROPY_TABLE_BYTES], OUT RnEntropyModel *model);
+
+/**
+ * Model configured for `type`, NULL if its bodies are sent as is.
+ */
+const RnEntropyModel *rnEntropyConfigModel(const RnEntropyConfig *config, uint16_t type);
+
+/**
+ * Encodes `data` into `out`. Returns RN_OOM if the encoding does not fit
+ * `out_capacity`, which callers use to fall back to sending data as is.
+ */
+int rnEntropyEncode(
+      const RnEntropyModel *model, const uint8_t *data, size_t data_size, OUT uint8_t *out,
+      size_t out_capacity, OUT size_t *out_size);
+
+/**
+ * Decodes `data` into `out`. Returns RN_OOM if the decoded size exceeds
+ * `out_capacity` or `data` is truncated.
+ */
+int rnEntropyDecode(
+      const RnEntropyModel *model, const uint8_t *data, size_t data_size, OUT uint8_t *out,
+      size_t out_capacity, OUT size_t *out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_ENTROPY_H
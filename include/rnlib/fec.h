@@ -0,0 +1,92 @@
+#ifndef RN_FEC_H
+#define RN_FEC_H
+
+#include "util.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Parity packets list the type and sequences of their group and carry the XOR
+ * of the members' bodies. They are never entropy coded.
+ */
+#define RN_FEC_PARITY_PACKET_TYPE (UINT16_MAX - 5)
+
+// packet types protected per connection, and packets per parity packet at most
+#define RN_FEC_TYPES_MAX 4
+#define RN_FEC_GROUP_MAX 16
+
+// body bytes protected at most, larger packets of a protected type go out unprotected
+#define RN_FEC_PAYLOAD_MAX 256
+
+// type (2), count (1), reserved (1), size XOR (2), sequences (2 each) and the parity itself
+#define RN_FEC_PARITY_BYTES_MAX (6 + RN_FEC_GROUP_MAX * 2 + RN_FEC_PAYLOAD_MAX)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Packet types to protect and the number of packets each parity packet covers,
+ * 2 to RN_FEC_GROUP_MAX. Entries with a group size of 0 are unused. A group of
+ * `group_size` packets costs one parity packet of the size of its largest
+ * member and recovers any single packet of the group lost on the way.
+ */
+struct RnFecConfig
+{
+    struct RnFecConfigType
+    {
+        uint16_t type;
+        uint8_t group_size;
+    } types[RN_FEC_TYPES_MAX];
+};
+
+typedef struct RnFecConfig RnFecConfig;
+typedef struct RnFec RnFec;
+
+/**
+ * XOR parity forward error correction as plain state, the connection sends
+ * the parity packets and feeds in what it verified.
+ *
+ * Senders fold every protected packet into the parity of its type's current
+ * group and emit the parity once the group is complete. Receivers keep the
+ * last RN_FEC_GROUP_MAX protected packets of each type, a parity packet with
+ * exactly one of its members missing rebuilds that member without waiting for
+ * a retransmission. Both peers have to protect the same types, group sizes may
+ * differ per direction.
+ */
+int rnFecOpen(const RnFecConfig *config, OUT RnFec **out);
+
+void rnFecClose(IN RnFec *fec);
+
+bool rnFecProtects(const RnFec *fec, uint16_t type);
+
+/**
+ * Folds a sent packet's body into its group, true once the group is
+ * complete and `parity` holds the body of the parity packet to send.
+ */
+bool rnFecEncode(
+      RnFec *fec, uint16_t type, uint16_t sequence, const void *data, size_t size,
+      OUT uint8_t parity[RN_FEC_PARITY_BYTES_MAX], OUT size_t *parity_size);
+
+/**
+ * Keeps a verified packet's body for rebuilding a group member.
+ */
+void rnFecRemember(RnFec *fec, uint16_t type, uint16_t sequence, const void *data, size_t size);
+
+/**
+ * Rebuilds the body of the one member of the parity's group that never arrived
+ * into `data`, which has room for RN_FEC_PAYLOAD_MAX bytes, along with its type
+ * and sequence. False if none or more than one are missing.
+ */
+bool rnFecRecover(
+      RnFec *fec, const void *parity, size_t parity_size, OUT uint16_t *type,
+      OUT uint16_t *sequence, OUT void *data, OUT size_t *size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_FEC_H
@@ -0,0 +1,92 @@
+#ifndef RN_FILTER_H
+#define RN_FILTER_H
+
+#include "util.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RN_FILTER_DEPTH              4
+#define RN_FILTER_WIDTH_DEFAULT      4096
+#define RN_FILTER_RATE_DEFAULT       10
+#define RN_FILTER_BURST_DEFAULT      20
+#define RN_FILTER_OPEN_RATE_DEFAULT  500
+#define RN_FILTER_OPEN_BURST_DEFAULT 64
+#define RN_FILTER_DRAIN_NS           (100ull * 1000000)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Sources may send `rate` datagrams per second on average and up to `burst`
+ * at once. `width` counters per row bound the memory, zeroes pick defaults.
+ *
+ * All sources together may open `open_rate` connections per second on average
+ * and up to `open_burst` at once, see rnFilterAdmitOpen.
+ */
+struct RnFilterConfig
+{
+    uint32_t width;
+    uint32_t rate;
+    uint16_t burst;
+    uint32_t open_rate;
+    uint16_t open_burst;
+};
+
+/**
+ * Per-source token buckets folded into a count-min sketch of RN_FILTER_DEPTH
+ * rows. Each counter holds the tokens spent by the sources hashing to it and
+ * drains at `rate` every RN_FILTER_DRAIN_NS. A source's spending is the
+ * smallest of its counters. Collisions only ever overestimate, so a source
+ * within its budget may rarely be throttled, but a flooding source never
+ * passes more than its budget.
+ *
+ * Row hashes are keyed randomly per filter, sources cannot aim for each
+ * other's counters.
+ *
+ * Per-source budgets do not hold back many distinct sources, each of which is
+ * within its own, so opening connections is limited globally on top by a single
+ * bucket. It refills a token every `open_interval` nanoseconds, is full again
+ * at `open_at` and holds `open_tolerance / open_interval + 1` tokens.
+ */
+struct RnFilter
+{
+    uint16_t *counters;
+    uint32_t mask;
+    uint32_t rate;
+    uint16_t burst;
+    uint64_t keys[RN_FILTER_DEPTH];
+    uint64_t drained_at;
+
+    uint64_t open_interval;
+    uint64_t open_tolerance;
+    uint64_t open_at;
+};
+
+typedef struct RnFilterConfig RnFilterConfig;
+typedef struct RnFilter RnFilter;
+
+int rnFilterInit(OUT RnFilter *filter, const RnFilterConfig *config, uint64_t now);
+
+void rnFilterFree(RnFilter *filter);
+
+/**
+ * Spends a token of `source` at `now`, false if it has none left.
+ */
+bool rnFilterAdmit(RnFilter *filter, const void *source, size_t size, uint64_t now);
+
+/**
+ * Spends a token of the budget shared by all sources for opening a connection,
+ * false if it has none left. Admit the source first, so that a single one
+ * cannot use up the shared budget.
+ */
+bool rnFilterAdmitOpen(RnFilter *filter, uint64_t now);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_FILTER_H
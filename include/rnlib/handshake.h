@@ -4,7 +4,7 @@
 #include "cryptography.h"
 #include "packet.h"
 
-#include <bool.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #define RN_HANDSHAKE_PACKET_TYPE UINT16_MAX
@@ -14,6 +14,15 @@ extern "C"
 {
 #endif
 
+/**
+ * Clients connect with their public key or salt, servers challenge them with
+ * the connection context or their own salt, clients respond with the context
+ * or the combined salt and servers confirm. Clients resend their current step
+ * until answered, servers answer every resent step again.
+ *
+ * Servers are connected once they confirmed, clients once the confirmation or
+ * any verified packet of the session arrived.
+ */
 enum RnHandshakeStep
 {
     RN_HANDSHAKE_DISCONNECTED,
@@ -26,24 +35,87 @@ enum RnHandshakeStep
     RN_HANDSHAKE_CONNECTED,
 };
 
+/**
+ * `keys` is the ephemeral pair of this side, its secret key is wiped as soon as
+ * `session` is derived from it and the peer's `pubkey`. `confirm` is set by
+ * connected servers whose confirmation the client evidently missed.
+ */
+struct RnHandshakeSecure
+{
+    enum RnHandshakeStep step;
+    RnKeyPair keys;
+    RnKeyBuffer pubkey;
+    uint64_t context;
+    RnKeyPair session;
+    bool session_ready;
+    bool confirm;
+};
+
+/**
+ * `salt` is this side's own until the salts are combined, servers keep the
+ * client's in `peer_salt` until its response proves the combination.
+ */
+struct RnHandshakeInsecure
+{
+    enum RnHandshakeStep step;
+    uint64_t salt;
+    uint64_t peer_salt;
+    bool confirm;
+};
+
 #define RN_HANDSHAKE_DECL(TYPE)                                                \
     typedef struct RnHandshake##TYPE RnHandshake##TYPE;                        \
                                                                                \
-    RnHandshake##TYPE rnHandshakeCreate##TYPE();                               \
-                                                                               \
-    bool rnHandshakeReadPacketClient(                                          \
-          RnHandshake##TYPE *handshake, RnPacketBuffer##TYPE *buffer);         \
-    bool rnHandshakeWritePacketClient(                                         \
+    /* true once connected, handshake packets are ignored where unexpected */  \
+    bool rnHandshakeReadPacketClient##TYPE(                                    \
+          RnHandshake##TYPE *handshake, const RnPacketBuffer##TYPE *buffer);   \
+    bool rnHandshakeWritePacketClient##TYPE(                                   \
           RnHandshake##TYPE *handshake, OUT RnPacketBuffer##TYPE *buffer);     \
                                                                                \
-    bool rnHandshakeReadPacketServer(                                          \
-          RnHandshake##TYPE *handshake, RnPacketBuffer##TYPE *buffer);         \
-    bool rnHandshakeWritePacketServer(                                         \
+    bool rnHandshakeReadPacketServer##TYPE(                                    \
+          RnHandshake##TYPE *handshake, const RnPacketBuffer##TYPE *buffer);   \
+    bool rnHandshakeWritePacketServer##TYPE(                                   \
           RnHandshake##TYPE *handshake, OUT RnPacketBuffer##TYPE *buffer);
 
 RN_HANDSHAKE_DECL(Secure)
 RN_HANDSHAKE_DECL(Insecure)
 
+#undef RN_HANDSHAKE_DECL
+
+#define RN_HANDSHAKE_SELECT(NAME, HANDSHAKE)                                   \
+    RN_SELECT2(                                                                \
+          HANDSHAKE, RnHandshakeSecure, NAME##Secure, RnHandshakeInsecure,     \
+          NAME##Insecure)
+
+#define rnHandshakeReadPacketClient(handshake, buffer)                         \
+    RN_HANDSHAKE_SELECT(rnHandshakeReadPacketClient, handshake)(               \
+          handshake, buffer)
+#define rnHandshakeWritePacketClient(handshake, buffer)                        \
+    RN_HANDSHAKE_SELECT(rnHandshakeWritePacketClient, handshake)(              \
+          handshake, buffer)
+
+#define rnHandshakeReadPacketServer(handshake, buffer)                         \
+    RN_HANDSHAKE_SELECT(rnHandshakeReadPacketServer, handshake)(               \
+          handshake, buffer)
+#define rnHandshakeWritePacketServer(handshake, buffer)                        \
+    RN_HANDSHAKE_SELECT(rnHandshakeWritePacketServer, handshake)(              \
+          handshake, buffer)
+
+/**
+ * Starts out with the ephemeral key pair of this side, which the handshake
+ * keeps until the session key pair is derived.
+ */
+RnHandshakeSecure rnHandshakeCreateSecure(const RnKeyPair *keys);
+
+RnHandshakeInsecure rnHandshakeCreateInsecure(uint64_t salt);
+
+/**
+ * Moves the session key pair out once both public keys were exchanged, false
+ * before and after. The ephemeral secret key is wiped as soon as the session
+ * is derived, the handshake's copy of the session when it is taken.
+ */
+bool rnHandshakeTakeSession(RnHandshakeSecure *handshake, OUT RnKeyPair *out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,122 @@
+#ifndef RN_IMPAIRMENT_H
+#define RN_IMPAIRMENT_H
+
+#include "socket.h"
+#include "util.h"
+
+#include <stdint.h>
+
+/**
+ * Largest datagram an impaired socket can hold in flight, larger datagrams are
+ * rejected by rnImpairmentSendData with EMSGSIZE.
+ */
+#define RN_IMPAIRMENT_DATAGRAM_MAX 2048
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Network conditions applied to egress datagrams. Probabilities are in [0, 1],
+ * zero disables the respective impairment.
+ *
+ * Loss follows a Gilbert-Elliott model: while in the good state datagrams are
+ * lost with probability `loss`, in the bad state with `burst_loss`. Before
+ * each datagram the model enters the bad state with `burst_enter` and leaves it
+ * again with `burst_exit`, so 1 / `burst_exit` is the mean burst length.
+ */
+struct RnImpairmentConfig
+{
+    uint32_t latency_us;
+    uint32_t jitter_us;
+
+    float loss;
+    float burst_enter;
+    float burst_exit;
+    float burst_loss;
+
+    float reorder;
+    uint32_t reorder_us;
+    float duplicate;
+
+    uint32_t bandwidth_kbps;
+    uint32_t queue_limit;
+    uint64_t seed;
+};
+
+struct RnImpairmentStats
+{
+    uint64_t submitted;
+    uint64_t delivered;
+    uint64_t lost;
+    uint64_t duplicated;
+    uint64_t reordered;
+    uint64_t overflowed;
+};
+
+typedef struct RnImpairmentConfig RnImpairmentConfig;
+typedef struct RnImpairmentStats RnImpairmentStats;
+
+/**
+ * Impaired sockets wrap an open socket and delay, drop, duplicate and reorder
+ * the datagrams sent through them. Ingress is passed through untouched, wrap
+ * both ends of a connection to impair both directions.
+ *
+ * Delayed datagrams are released on every send and receive call, or explicitly
+ * via rnImpairmentFlush, which returns the nanoseconds until the next datagram
+ * is due or UINT64_MAX if none are held.
+ *
+ * Code that only knows the plain socket, such as connections and reactors, is
+ * impaired by attaching the wrapper to it with rnSocketSetImpairment.
+ */
+#define RN_IMPAIRMENT_DECL(IP)                                                                     \
+    typedef struct RnImpairedSocket##IP RnImpairedSocket##IP;                                      \
+                                                                                                   \
+    int rnImpairmentOpen##IP(                                                                      \
+          RnSocket##IP *socket, const RnImpairmentConfig *config,                                  \
+          OUT RnImpairedSocket##IP **out);                                                         \
+                                                                                                   \
+    int rnImpairmentClose##IP(IN RnImpairedSocket##IP *impaired);                                  \
+                                                                                                   \
+    int rnImpairmentSendData##IP(                                                                  \
+          RnImpairedSocket##IP *impaired, const RnAddress##IP *address, const uint8_t *data,       \
+          size_t data_size);                                                                       \
+                                                                                                   \
+    int rnImpairmentReceiveData##IP(                                                               \
+          RnImpairedSocket##IP *impaired, OUT RnAddress##IP *address, OUT uint8_t *data,           \
+          OUT size_t *data_size);                                                                  \
+                                                                                                   \
+    uint64_t rnImpairmentFlush##IP(RnImpairedSocket##IP *impaired);                                \
+                                                                                                   \
+    void rnImpairmentStats##IP(                                                                    \
+          const RnImpairedSocket##IP *impaired, OUT RnImpairmentStats *out);
+
+RN_IMPAIRMENT_DECL(IPv4)
+RN_IMPAIRMENT_DECL(IPv6)
+
+#undef RN_IMPAIRMENT_DECL
+
+#define RN_IMPAIRMENT_SELECT(NAME, IMPAIRED)                                                       \
+    RN_SELECT2(IMPAIRED, RnImpairedSocketIPv4, NAME##IPv4, RnImpairedSocketIPv6, NAME##IPv6)
+
+#define RN_IMPAIRMENT_CALL(NAME, IMPAIRED, ...)                                                    \
+    RN_IMPAIRMENT_SELECT(NAME, IMPAIRED)(IMPAIRED, __VA_ARGS__)
+
+#define rnImpairmentOpen(socket, ...) RN_SOCKET_CALL(rnImpairmentOpen, socket, __VA_ARGS__)
+#define rnImpairmentClose(impaired)                                                                \
+    RN_IMPAIRMENT_SELECT(rnImpairmentClose, impaired)(impaired)
+#define rnImpairmentSendData(impaired, ...)                                                        \
+    RN_IMPAIRMENT_CALL(rnImpairmentSendData, impaired, __VA_ARGS__)
+#define rnImpairmentReceiveData(impaired, ...)                                                     \
+    RN_IMPAIRMENT_CALL(rnImpairmentReceiveData, impaired, __VA_ARGS__)
+#define rnImpairmentFlush(impaired)                                                                \
+    RN_IMPAIRMENT_SELECT(rnImpairmentFlush, impaired)(impaired)
+#define rnImpairmentStats(impaired, ...)                                                           \
+    RN_IMPAIRMENT_CALL(rnImpairmentStats, impaired, __VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_IMPAIRMENT_H
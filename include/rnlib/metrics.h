@@ -0,0 +1,228 @@
+#ifndef RN_METRICS_H
+#define RN_METRICS_H
+
+#include "clock.h"
+#include "util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RN_METRICS_HISTOGRAM_SUB_BITS 4
+#define RN_METRICS_HISTOGRAM_SUB_MASK ((1u << RN_METRICS_HISTOGRAM_SUB_BITS) - 1)
+#define RN_METRICS_HISTOGRAM_BUCKETS  (64u << RN_METRICS_HISTOGRAM_SUB_BITS)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum RnMetricsCounter
+{
+    RN_METRICS_PACKETS_IN,
+    RN_METRICS_PACKETS_OUT,
+    RN_METRICS_BYTES_IN,
+    RN_METRICS_BYTES_OUT,
+
+    RN_METRICS_DROPS_SEQUENCE,
+    RN_METRICS_DROPS_CONTEXT,
+    RN_METRICS_DROPS_VERIFY,
+
+    // one counter per RnHandshakeStep, incremented on entering that step
+    RN_METRICS_HANDSHAKE_DISCONNECTED,
+    RN_METRICS_HANDSHAKE_CLIENT_CONNECT,
+    RN_METRICS_HANDSHAKE_SERVER_CHALLENGE,
+    RN_METRICS_HANDSHAKE_CLIENT_RESPONSE,
+    RN_METRICS_HANDSHAKE_SERVER_CONNECTED,
+    RN_METRICS_HANDSHAKE_CONNECTED,
+
+    RN_METRICS_RETRANSMITS,
+
+    RN_METRICS_COUNTER_COUNT,
+};
+
+enum RnMetricsLatency
+{
+    RN_METRICS_LATENCY_HANDSHAKE,
+    RN_METRICS_LATENCY_INGRESS,
+    RN_METRICS_LATENCY_EGRESS,
+
+    RN_METRICS_LATENCY_COUNT,
+};
+
+/**
+ * Log-linear (HDR-style) histogram of nanosecond values. Values below
+ * 2^SUB_BITS are counted exactly and every power of two above is split into
+ * 2^SUB_BITS equally sized buckets, bounding the relative error to 1/16 over
+ * the full 64 bit range.
+ */
+struct RnMetricsHistogram
+{
+    uint64_t counts[RN_METRICS_HISTOGRAM_BUCKETS];
+    uint64_t total;
+};
+
+struct RnMetricsCounters
+{
+    uint64_t values[RN_METRICS_COUNTER_COUNT];
+};
+
+/**
+ * Per-thread metrics storage. Each shard is written by exactly one thread, so
+ * updates are plain relaxed stores without any read-modify-write contention,
+ * and shards are padded to cache lines to avoid false sharing.
+ */
+struct RnMetricsShard
+{
+    struct RnMetricsCounters counters;
+    struct RnMetricsHistogram latency[RN_METRICS_LATENCY_COUNT];
+    struct RnMetricsShard *next;
+
+} __attribute__((aligned(64)));
+
+struct RnMetricsSnapshot
+{
+    struct RnMetricsCounters counters;
+    struct RnMetricsHistogram latency[RN_METRICS_LATENCY_COUNT];
+};
+
+typedef struct RnMetricsHistogram RnMetricsHistogram;
+typedef struct RnMetricsCounters RnMetricsCounters;
+typedef struct RnMetricsShard RnMetricsShard;
+typedef struct RnMetricsSnapshot RnMetricsSnapshot;
+
+extern RN_THREAD_LOCAL RnMetricsShard *rxMetricsLocalShard;
+
+/**
+ * Allocates and publishes the calling thread's shard. Shards are never freed
+ * so that snapshots remain valid after a thread exits.
+ */
+RnMetricsShard *rxMetricsShardRegister();
+
+/**
+ * Aggregates every thread's shard into `out`. Safe to call from any thread
+ * while others keep counting, values are eventually consistent.
+ */
+void rnMetricsSnapshot(OUT RnMetricsSnapshot *out);
+
+/**
+ * Writes `snapshot` in Prometheus text exposition format, returning the number
+ * of bytes written or RN_OOM if `text` is too small.
+ */
+int rnMetricsExport(const RnMetricsSnapshot *snapshot, OUT char *text, size_t text_size);
+
+/**
+ * Returns the lower bound of the bucket holding the given percentile in [0, 1].
+ */
+uint64_t rnMetricsHistogramPercentile(const RnMetricsHistogram *histogram, double percentile);
+
+static inline uint32_t rnMetricsHistogramBucket(uint64_t value)
+{
+    if (value <= RN_METRICS_HISTOGRAM_SUB_MASK)
+    {
+        return (uint32_t)value;
+    }
+
+    uint32_t exponent = 63 - __builtin_clzll(value);
+    uint32_t shift    = exponent - RN_METRICS_HISTOGRAM_SUB_BITS;
+    uint32_t sub      = (uint32_t)(value >> shift) & RN_METRICS_HISTOGRAM_SUB_MASK;
+
+    return ((shift + 1) << RN_METRICS_HISTOGRAM_SUB_BITS) | sub;
+}
+
+static inline void rxMetricsIncrement(uint64_t *value, uint64_t amount)
+{
+    // single writer per shard, a relaxed store keeps readers tear-free
+    __atomic_store_n(value, *value + amount, __ATOMIC_RELAXED);
+}
+
+static inline void rnMetricsHistogramRecord(RnMetricsHistogram *histogram, uint64_t value)
+{
+    rxMetricsIncrement(&histogram->counts[rnMetricsHistogramBucket(value)], 1);
+    rxMetricsIncrement(&histogram->total, 1);
+}
+
+static inline RnMetricsShard *rxMetricsShard()
+{
+    RnMetricsShard *shard = rxMetricsLocalShard;
+    if (shard == NULL)
+    {
+        shard = rxMetricsShardRegister();
+    }
+
+    return shard;
+}
+
+#ifndef RN_METRICS_DISABLED
+
+static inline void rnMetricsCount(enum RnMetricsCounter counter, uint64_t amount)
+{
+    RnMetricsShard *shard = rxMetricsShard();
+    if (shard != NULL)
+    {
+        rxMetricsIncrement(&shard->counters.values[counter], amount);
+    }
+}
+
+/**
+ * Start of a latency sample passed to rnMetricsRecordLatency, no clock is read
+ * when metrics are disabled.
+ */
+static inline uint64_t rnMetricsClock()
+{
+    return rnClockMonotonic();
+}
+
+static inline void rnMetricsRecordLatency(enum RnMetricsLatency latency, uint64_t ns)
+{
+    RnMetricsShard *shard = rxMetricsShard();
+    if (shard != NULL)
+    {
+        rnMetricsHistogramRecord(&shard->latency[latency], ns);
+    }
+}
+
+/**
+ * Counts into both the per-connection counters and the global per-thread
+ * shard. Per-connection counters belong to the thread owning the connection.
+ */
+static inline void rnMetricsCountConnection(
+      RnMetricsCounters *connection, enum RnMetricsCounter counter, uint64_t amount)
+{
+    rxMetricsIncrement(&connection->values[counter], amount);
+    rnMetricsCount(counter, amount);
+}
+
+#else
+
+static inline void rnMetricsCount(enum RnMetricsCounter counter, uint64_t amount)
+{
+    (void)counter;
+    (void)amount;
+}
+
+static inline uint64_t rnMetricsClock()
+{
+    return 0;
+}
+
+static inline void rnMetricsRecordLatency(enum RnMetricsLatency latency, uint64_t ns)
+{
+    (void)latency;
+    (void)ns;
+}
+
+static inline void rnMetricsCountConnection(
+      RnMetricsCounters *connection, enum RnMetricsCounter counter, uint64_t amount)
+{
+    (void)connection;
+    (void)counter;
+    (void)amount;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_METRICS_H
@@ -2,7 +2,12 @@
 #define RN_PACKET_H
 
 #include "cryptography.h"
+#include "entropy.h"
+#include "quantize.h"
+#include "util.h"
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #define RN_NET_MTU_MIN_IPV4 576
@@ -11,30 +16,82 @@
 #define RN_UDP_HEADER_MIN_IPV4 28
 #define RN_UDP_HEADER_MIN_IPV6 48
 
-#define RN_NET_PAYLOAD_SAFE_IPV4 RN_NET_MTU_MIN_IPV4 - RN_UDP_HEADER_MIN_IPV4
-#define RN_NET_PAYLOAD_SAFE_IPV6 RN_NET_MTU_MIN_IPV6 - RN_UDP_HEADER_MIN_IPV6
+#define RN_NET_MTU_ETHERNET 1500
+
+#define RN_NET_PAYLOAD_SAFE_IPV4     (RN_NET_MTU_MIN_IPV4 - RN_UDP_HEADER_MIN_IPV4)
+#define RN_NET_PAYLOAD_SAFE_IPV6     (RN_NET_MTU_MIN_IPV6 - RN_UDP_HEADER_MIN_IPV6)
+#define RN_NET_PAYLOAD_ETHERNET_IPV4 (RN_NET_MTU_ETHERNET - RN_UDP_HEADER_MIN_IPV4)
+
+/**
+ * Every path starts out sending datagrams of at most RN_PACKET_BYTES_BASE and
+ * is probed up to RN_PACKET_BYTES_MAX, see pmtu.h. Buffers created by value
+ * have room for the maximum, jumbo frame networks may raise it.
+ */
+#define RN_PACKET_BYTES_BASE RN_NET_PAYLOAD_SAFE_IPV6
 
 #ifndef RN_PACKET_BYTES_MAX
-    #define RN_PACKET_BYTES_MAX RN_NET_PAYLOAD_SAFE_IPV6
+    #define RN_PACKET_BYTES_MAX RN_NET_PAYLOAD_ETHERNET_IPV4
 #endif
 
+// secure datagrams lead with the 4 byte connection id, then the tag and the header
+#define RN_PACKET_BODY_QWORDS_SECURE   ((RN_PACKET_BYTES_MAX - 4) / 8 - 3)
+#define RN_PACKET_BODY_QWORDS_INSECURE (RN_PACKET_BYTES_MAX / 8 - 2)
+
+// largest datagrams a buffer created by value holds
+#define RN_PACKET_WIRE_MAX_SECURE   (RN_PACKET_BYTES_MAX - 4)
+#define RN_PACKET_WIRE_MAX_INSECURE RN_PACKET_BYTES_MAX
+
+/**
+ * Set in the header type of packets whose body is entropy coded, application
+ * packet types must stay below it. Types from RN_PACKET_TYPE_RESERVED on, such
+ * as RN_HANDSHAKE_PACKET_TYPE, belong to the library and are never coded.
+ */
+#define RN_PACKET_TYPE_COMPRESSED 0x8000
+#define RN_PACKET_TYPE_RESERVED   0xFFF0
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+/**
+ * Bookkeeping ahead of the wire data. `body_size` is the length of the
+ * serialized or received body in bytes, `body_capacity` the bytes the body has
+ * room for. Neither is sent.
+ *
+ * `connection_id` leads the wire data of secure buffers so that servers can
+ * route packets of peers whose address changed, see rnConnectionId. Insecure
+ * buffers never send it.
+ */
 struct RnPacketBufferMetaData
 {
-    uint32_t connection_id;
     uint16_t body_size;
+    uint16_t body_capacity;
+    uint32_t connection_id;
 };
 
+typedef struct RnPacketBufferMetaData RnPacketBufferMetaData;
+
 struct RnPacketBufferCursor
 {
     uint_fast16_t qword;
     uint_fast8_t bit;
 };
 
+typedef struct RnPacketBufferCursor RnPacketBufferCursor;
+
+/**
+ * Set in the header protocol of secure packets authenticated with an odd key
+ * epoch, see RnSessionKeys.
+ */
+#define RN_PACKET_PROTOCOL_KEY_PHASE 0x8000
+
+/**
+ * Set in the header protocol of insecure packets whose salt carries a CRC32C
+ * of their header and body, see rnConnectionSetIntegrity.
+ */
+#define RN_PACKET_PROTOCOL_CHECKSUM 0x4000
+
 struct RnPacketHeader
 {
     uint16_t protocol;
@@ -47,46 +104,297 @@ typedef struct RnPacketHeader RnPacketHeader;
 
 struct RnPacketBufferSecure
 {
-    uint8_t[16] auth;
-    PacketHeader head;
-    uint64_t body[RN_PACKET_BYTES_MAX / 8 - 3];
+    RnPacketBufferMetaData meta;
+    uint8_t auth[16];
+    RnPacketHeader head;
+    uint64_t body[RN_PACKET_BODY_QWORDS_SECURE];
 
 } __attribute__((aligned(64)));
 
 struct RnPacketBufferInsecure
 {
+    RnPacketBufferMetaData meta;
     uint64_t salt;
-    PacketHeader head;
-    uint64_t body[RN_PACKET_BYTES_MAX / 8 - 2];
+    RnPacketHeader head;
+    uint64_t body[RN_PACKET_BODY_QWORDS_INSECURE];
 
 } __attribute__((aligned(64)));
 
 typedef struct RnPacketBufferSecure RnPacketBufferSecure;
 typedef struct RnPacketBufferInsecure RnPacketBufferInsecure;
 
+/**
+ * Offset of the wire data within a buffer.
+ */
+#define RN_PACKET_WIRE_OFFSET_SECURE   offsetof(RnPacketBufferSecure, meta.connection_id)
+#define RN_PACKET_WIRE_OFFSET_INSECURE sizeof(RnPacketBufferMetaData)
+
+/**
+ * Functions below exist once per buffer type, suffixed Secure and Insecure, and
+ * are called by their plain name, see RN_SELECT2.
+ */
+#define RN_PACKET_BUFFER_SELECT(NAME, BUFFER)                                                      \
+    RN_SELECT2(BUFFER, RnPacketBufferSecure, NAME##Secure, RnPacketBufferInsecure, NAME##Insecure)
+
+#define RN_PACKET_BUFFER_CALL(NAME, BUFFER, ...)                                                   \
+    RN_PACKET_BUFFER_SELECT(NAME, BUFFER)(BUFFER, __VA_ARGS__)
+
 RnPacketBufferSecure rnPacketBufferCreateSecure(uint16_t type);
 RnPacketBufferInsecure rnPacketBufferCreateInsecure(uint16_t type);
 
-int rnPacketBufferSerializeBool(RnPacketBufferSecure *, bool);
-int rnPacketBufferSerializeBool(RnPacketBufferInsecure *, bool);
+/**
+ * Heap buffers with room for `body_capacity` bytes of body, rounded up to whole
+ * qwords and capped at the body of buffers created by value, for packet types
+ * known to stay small. They work with every packet buffer function but must
+ * only ever be passed by pointer.
+ */
+int rnPacketBufferOpenSecure(
+      uint16_t type, uint16_t body_capacity, OUT RnPacketBufferSecure **out);
+int rnPacketBufferOpenInsecure(
+      uint16_t type, uint16_t body_capacity, OUT RnPacketBufferInsecure **out);
+
+int rnPacketBufferCloseSecure(IN RnPacketBufferSecure *);
+int rnPacketBufferCloseInsecure(IN RnPacketBufferInsecure *);
+
+#define rnPacketBufferClose(buffer) RN_PACKET_BUFFER_SELECT(rnPacketBufferClose, buffer)(buffer)
+
+/**
+ * Datagram view of a buffer. The wire data starts at the connection id or salt
+ * and spans the header and the serialized body only, so small packets are
+ * sent small.
+ */
+uint8_t *rnPacketBufferWireDataSecure(RnPacketBufferSecure *);
+uint8_t *rnPacketBufferWireDataInsecure(RnPacketBufferInsecure *);
+
+size_t rnPacketBufferWireSizeSecure(const RnPacketBufferSecure *);
+size_t rnPacketBufferWireSizeInsecure(const RnPacketBufferInsecure *);
+
+size_t rnPacketBufferWireCapacitySecure(const RnPacketBufferSecure *);
+size_t rnPacketBufferWireCapacityInsecure(const RnPacketBufferInsecure *);
+
+#define rnPacketBufferWireData(buffer)                                                             \
+    RN_PACKET_BUFFER_SELECT(rnPacketBufferWireData, buffer)(buffer)
+#define rnPacketBufferWireSize(buffer)                                                             \
+    RN_PACKET_BUFFER_SELECT(rnPacketBufferWireSize, buffer)(buffer)
+#define rnPacketBufferWireCapacity(buffer)                                                         \
+    RN_PACKET_BUFFER_SELECT(rnPacketBufferWireCapacity, buffer)(buffer)
+
+/**
+ * Takes the size of a datagram received into the wire data as the body size
+ * and zeroes the rest of its last qword, reads fail past it. Datagrams shorter
+ * than a header are rejected with RN_OOM.
+ */
+int rnPacketBufferWireReceivedSecure(RnPacketBufferSecure *, size_t);
+int rnPacketBufferWireReceivedInsecure(RnPacketBufferInsecure *, size_t);
+
+#define rnPacketBufferWireReceived(buffer, ...)                                                    \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWireReceived, buffer, __VA_ARGS__)
+
+/**
+ * Extends the serialized body up to `cursor`, for bodies written directly such
+ * as schemas. Writes through packet buffer functions do so on their own.
+ */
+void rnPacketBufferCommitSecure(RnPacketBufferSecure *, const RnPacketBufferCursor *);
+void rnPacketBufferCommitInsecure(RnPacketBufferInsecure *, const RnPacketBufferCursor *);
+
+#define rnPacketBufferCommit(buffer, ...)                                                          \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferCommit, buffer, __VA_ARGS__)
+
+/**
+ * Writes and reads whole integers and keys at `cursor` and advances it.
+ * Writes past the body capacity and reads past the body fail with RN_OOM.
+ */
+#define RN_PACKET_BUFFER_INT_DECL(BUFFER, NAME, TYPE)                                              \
+    int rnPacketBufferWrite##NAME##BUFFER(                                                         \
+          RnPacketBuffer##BUFFER *, RnPacketBufferCursor *, TYPE);                                 \
+    int rnPacketBufferRead##NAME##BUFFER(                                                          \
+          const RnPacketBuffer##BUFFER *, RnPacketBufferCursor *, OUT TYPE *);
+
+#define RN_PACKET_BUFFER_INTS_DECL(BUFFER)                                                         \
+    RN_PACKET_BUFFER_INT_DECL(BUFFER, Bool, bool)                                                  \
+    RN_PACKET_BUFFER_INT_DECL(BUFFER, UInt8, uint8_t)                                              \
+    RN_PACKET_BUFFER_INT_DECL(BUFFER, UInt16, uint16_t)                                            \
+    RN_PACKET_BUFFER_INT_DECL(BUFFER, UInt32, uint32_t)                                            \
+    RN_PACKET_BUFFER_INT_DECL(BUFFER, UInt64, uint64_t)
+
+RN_PACKET_BUFFER_INTS_DECL(Secure)
+RN_PACKET_BUFFER_INTS_DECL(Insecure)
+
+#undef RN_PACKET_BUFFER_INTS_DECL
+#undef RN_PACKET_BUFFER_INT_DECL
+
+#define rnPacketBufferWriteBool(buffer, ...)                                                       \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteBool, buffer, __VA_ARGS__)
+#define rnPacketBufferWriteUInt8(buffer, ...)                                                      \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteUInt8, buffer, __VA_ARGS__)
+#define rnPacketBufferWriteUInt16(buffer, ...)                                                     \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteUInt16, buffer, __VA_ARGS__)
+#define rnPacketBufferWriteUInt32(buffer, ...)                                                     \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteUInt32, buffer, __VA_ARGS__)
+#define rnPacketBufferWriteUInt64(buffer, ...)                                                     \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteUInt64, buffer, __VA_ARGS__)
+
+#define rnPacketBufferReadBool(buffer, ...)                                                        \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadBool, buffer, __VA_ARGS__)
+#define rnPacketBufferReadUInt8(buffer, ...)                                                       \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadUInt8, buffer, __VA_ARGS__)
+#define rnPacketBufferReadUInt16(buffer, ...)                                                      \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadUInt16, buffer, __VA_ARGS__)
+#define rnPacketBufferReadUInt32(buffer, ...)                                                      \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadUInt32, buffer, __VA_ARGS__)
+#define rnPacketBufferReadUInt64(buffer, ...)                                                      \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadUInt64, buffer, __VA_ARGS__)
+
+int rnPacketBufferWriteKeySecure(
+      RnPacketBufferSecure *, RnPacketBufferCursor *, const RnKeyBuffer *);
+int rnPacketBufferWriteKeyInsecure(
+      RnPacketBufferInsecure *, RnPacketBufferCursor *, const RnKeyBuffer *);
+
+int rnPacketBufferReadKeySecure(
+      const RnPacketBufferSecure *, RnPacketBufferCursor *, OUT RnKeyBuffer *);
+int rnPacketBufferReadKeyInsecure(
+      const RnPacketBufferInsecure *, RnPacketBufferCursor *, OUT RnKeyBuffer *);
+
+#define rnPacketBufferWriteKey(buffer, ...)                                                        \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteKey, buffer, __VA_ARGS__)
+#define rnPacketBufferReadKey(buffer, ...)                                                         \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadKey, buffer, __VA_ARGS__)
+
+/**
+ * Pads the datagram to RN_PACKET_BYTES_BASE. Only handshake packets sent by
+ * clients are padded, servers can then answer them without amplifying spoofed
+ * traffic.
+ */
+void rnPacketBufferWritePaddingSecure(RnPacketBufferSecure *, RnPacketBufferCursor *);
+void rnPacketBufferWritePaddingInsecure(RnPacketBufferInsecure *, RnPacketBufferCursor *);
+
+#define rnPacketBufferWritePadding(buffer, ...)                                                    \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWritePadding, buffer, __VA_ARGS__)
+
+/**
+ * Pads the datagram to `wire_size` bytes, e.g. for path MTU probes. Fails with
+ * RN_OOM if the buffer has no room for it.
+ */
+int rnPacketBufferWritePaddingToSecure(RnPacketBufferSecure *, RnPacketBufferCursor *, size_t);
+int rnPacketBufferWritePaddingToInsecure(
+      RnPacketBufferInsecure *, RnPacketBufferCursor *, size_t);
+
+#define rnPacketBufferWritePaddingTo(buffer, ...)                                                  \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWritePaddingTo, buffer, __VA_ARGS__)
+
+/**
+ * Caps the body capacity so that the datagram never exceeds `wire_size` bytes,
+ * usually rnConnectionPayloadMax, writes past it then fail with RN_OOM.
+ */
+void rnPacketBufferLimitSecure(RnPacketBufferSecure *, size_t);
+void rnPacketBufferLimitInsecure(RnPacketBufferInsecure *, size_t);
+
+#define rnPacketBufferLimit(buffer, ...)                                                           \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferLimit, buffer, __VA_ARGS__)
+
+/**
+ * Bulk packs `count` values of `bits` width, see rnBitpackWrite.
+ */
+int rnPacketBufferWriteArraySecure(
+      RnPacketBufferSecure *, RnPacketBufferCursor *, const uint32_t *, size_t, uint32_t);
+int rnPacketBufferWriteArrayInsecure(
+      RnPacketBufferInsecure *, RnPacketBufferCursor *, const uint32_t *, size_t, uint32_t);
+
+int rnPacketBufferReadArraySecure(
+      const RnPacketBufferSecure *, RnPacketBufferCursor *, OUT uint32_t *, size_t, uint32_t);
+int rnPacketBufferReadArrayInsecure(
+      const RnPacketBufferInsecure *, RnPacketBufferCursor *, OUT uint32_t *, size_t, uint32_t);
+
+#define rnPacketBufferWriteArray(buffer, ...)                                                      \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteArray, buffer, __VA_ARGS__)
+#define rnPacketBufferReadArray(buffer, ...)                                                       \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadArray, buffer, __VA_ARGS__)
+
+/**
+ * Quantized encodings, see quantize.h. Floats and vectors take `range->bits`
+ * per component, quaternions 2 + 3 * `bits`. Variable length integers are
+ * zigzag encoded and take 8 bits per 7 bits of magnitude.
+ */
+int rnPacketBufferWriteFloatSecure(
+      RnPacketBufferSecure *, RnPacketBufferCursor *, const RnQuantizeRange *, float);
+int rnPacketBufferWriteFloatInsecure(
+      RnPacketBufferInsecure *, RnPacketBufferCursor *, const RnQuantizeRange *, float);
+
+int rnPacketBufferReadFloatSecure(
+      const RnPacketBufferSecure *, RnPacketBufferCursor *, const RnQuantizeRange *, OUT float *);
+int rnPacketBufferReadFloatInsecure(
+      const RnPacketBufferInsecure *, RnPacketBufferCursor *, const RnQuantizeRange *,
+      OUT float *);
+
+int rnPacketBufferWriteVector3Secure(
+      RnPacketBufferSecure *, RnPacketBufferCursor *, const RnQuantizeRange *, const RnVector3 *);
+int rnPacketBufferWriteVector3Insecure(
+      RnPacketBufferInsecure *, RnPacketBufferCursor *, const RnQuantizeRange *,
+      const RnVector3 *);
+
+int rnPacketBufferReadVector3Secure(
+      const RnPacketBufferSecure *, RnPacketBufferCursor *, const RnQuantizeRange *,
+      OUT RnVector3 *);
+int rnPacketBufferReadVector3Insecure(
+      const RnPacketBufferInsecure *, RnPacketBufferCursor *, const RnQuantizeRange *,
+      OUT RnVector3 *);
+
+int rnPacketBufferWriteQuaternionSecure(
+      RnPacketBufferSecure *, RnPacketBufferCursor *, uint32_t, const RnQuaternion *);
+int rnPacketBufferWriteQuaternionInsecure(
+      RnPacketBufferInsecure *, RnPacketBufferCursor *, uint32_t, const RnQuaternion *);
+
+int rnPacketBufferReadQuaternionSecure(
+      const RnPacketBufferSecure *, RnPacketBufferCursor *, uint32_t, OUT RnQuaternion *);
+int rnPacketBufferReadQuaternionInsecure(
+      const RnPacketBufferInsecure *, RnPacketBufferCursor *, uint32_t, OUT RnQuaternion *);
 
-int rnPacketBufferSerializeUInt8(RnPacketBufferSecure *, uint8_t);
-int rnPacketBufferSerializeUInt8(RnPacketBufferInsecure *, uint8_t);
+int rnPacketBufferWriteVarIntSecure(RnPacketBufferSecure *, RnPacketBufferCursor *, int64_t);
+int rnPacketBufferWriteVarIntInsecure(RnPacketBufferInsecure *, RnPacketBufferCursor *, int64_t);
 
-int rnPacketBufferSerializeUInt16(RnPacketBufferSecure *, uint16_t);
-int rnPacketBufferSerializeUInt16(RnPacketBufferInsecure *, uint16_t);
+int rnPacketBufferReadVarIntSecure(
+      const RnPacketBufferSecure *, RnPacketBufferCursor *, OUT int64_t *);
+int rnPacketBufferReadVarIntInsecure(
+      const RnPacketBufferInsecure *, RnPacketBufferCursor *, OUT int64_t *);
 
-int rnPacketBufferSerializeUInt32(RnPacketBufferSecure *, uint32_t);
-int rnPacketBufferSerializeUInt32(RnPacketBufferInsecure *, uint32_t);
+#define rnPacketBufferWriteFloat(buffer, ...)                                                      \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteFloat, buffer, __VA_ARGS__)
+#define rnPacketBufferReadFloat(buffer, ...)                                                       \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadFloat, buffer, __VA_ARGS__)
+#define rnPacketBufferWriteVector3(buffer, ...)                                                    \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteVector3, buffer, __VA_ARGS__)
+#define rnPacketBufferReadVector3(buffer, ...)                                                     \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadVector3, buffer, __VA_ARGS__)
+#define rnPacketBufferWriteQuaternion(buffer, ...)                                                 \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteQuaternion, buffer, __VA_ARGS__)
+#define rnPacketBufferReadQuaternion(buffer, ...)                                                  \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadQuaternion, buffer, __VA_ARGS__)
+#define rnPacketBufferWriteVarInt(buffer, ...)                                                     \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferWriteVarInt, buffer, __VA_ARGS__)
+#define rnPacketBufferReadVarInt(buffer, ...)                                                      \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferReadVarInt, buffer, __VA_ARGS__)
 
-int rnPacketBufferSerializeUInt64(RnPacketBufferSecure *, uint64_t);
-int rnPacketBufferSerializeUInt64(RnPacketBufferInsecure *, uint64_t);
+/**
+ * Optional compression stage between serialization and authentication. Entropy
+ * codes the body up to `cursor` with the model trained for the packet type,
+ * moves `cursor` to the end of the coded body and flags the header type with
+ * RN_PACKET_TYPE_COMPRESSED. Bodies that would not shrink are left untouched.
+ *
+ * Decompression undoes this after verification and is a no-op on bodies that
+ * are not flagged.
+ */
+int rnPacketBufferCompressSecure(
+      RnPacketBufferSecure *, RnPacketBufferCursor *, const RnEntropyModel *);
+int rnPacketBufferCompressInsecure(
+      RnPacketBufferInsecure *, RnPacketBufferCursor *, const RnEntropyModel *);
 
-int rnPacketBufferSerializeKeyBuffer(RnPacketBufferSecure *, const RnKeyBuffer *);
-int rnPacketBufferSerializeKeyBuffer(RnPacketBufferInsecure *, const RnKeyBuffer *);
+int rnPacketBufferDecompressSecure(RnPacketBufferSecure *, const RnEntropyModel *);
+int rnPacketBufferDecompressInsecure(RnPacketBufferInsecure *, const RnEntropyModel *);
 
-void rnPacketBufferSerializePadding(RnPacketBufferSecure *);
-void rnPacketBufferSerializePadding(RnPacketBufferInsecure *);
+#define rnPacketBufferCompress(buffer, ...)                                                        \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferCompress, buffer, __VA_ARGS__)
+#define rnPacketBufferDecompress(buffer, ...)                                                      \
+    RN_PACKET_BUFFER_CALL(rnPacketBufferDecompress, buffer, __VA_ARGS__)
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,96 @@
+#ifndef RN_PMTU_H
+#define RN_PMTU_H
+
+#include "util.h"
+
+#include <stdint.h>
+
+/**
+ * Probes are padded authenticated packets of the probed datagram size, their
+ * acknowledgements echo the size received. Neither is ever entropy coded.
+ */
+#define RN_PMTU_PROBE_PACKET_TYPE (UINT16_MAX - 1)
+#define RN_PMTU_ACK_PACKET_TYPE   (UINT16_MAX - 2)
+
+// unacknowledged probes are resent after the timeout, a size fails after all attempts
+#define RN_PMTU_PROBE_ATTEMPTS   3
+#define RN_PMTU_PROBE_TIMEOUT_NS (500ull * 1000000)
+
+// a completed search re-confirms its size to detect black holes, and is retried after a while
+#define RN_PMTU_CONFIRM_NS (30ull * 1000000000)
+#define RN_PMTU_RAISE_NS   (600ull * 1000000000)
+
+// callers should poll rnPmtuProbeDue, or rnConnectionProbePath, at least this often
+#define RN_PMTU_POLL_INTERVAL_NS (50ull * 1000000)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum RnPmtuState
+{
+    // confirming the base size again after a black hole
+    RN_PMTU_BASE,
+    // binary searching between the confirmed size and the smallest failed one
+    RN_PMTU_SEARCHING,
+    // holding the confirmed size, periodically re-confirming it
+    RN_PMTU_SEARCH_COMPLETE,
+    // not even the base size got through, waiting to retry
+    RN_PMTU_ERROR,
+};
+
+/**
+ * Sizes are UDP payload bytes and always whole qwords. `confirmed` is the
+ * largest size known to reach the peer, `high` the smallest size known or
+ * assumed not to. At most one probe is in flight, `next_at` is when the next
+ * one is due and `searched_at` when the last search completed.
+ */
+struct RnPmtu
+{
+    enum RnPmtuState state;
+    uint16_t base;
+    uint16_t confirmed;
+    uint16_t high;
+    uint16_t max;
+    uint16_t probe_size;
+    uint8_t probe_count;
+    uint64_t probe_sent_at;
+    uint64_t searched_at;
+    uint64_t next_at;
+};
+
+typedef struct RnPmtu RnPmtu;
+
+/**
+ * Datagram packetization layer path MTU discovery (RFC 8899) as a plain state
+ * machine, the connection sends the probes and reports their acknowledgements.
+ *
+ * Every path starts out at `base`, which the handshake already proved, and is
+ * searched up to `max`, both rounded down to whole qwords. A confirmed size
+ * that stops getting through reverts the path to `base` rather than to the
+ * next smaller size, black holes are rare and the base is always safe.
+ */
+void rnPmtuInit(OUT RnPmtu *pmtu, uint16_t base, uint16_t max, uint64_t now);
+
+/**
+ * Size of the probe to send at `now`, 0 if none is due. Resends the probe in
+ * flight once it timed out and counts it lost after RN_PMTU_PROBE_ATTEMPTS.
+ */
+uint16_t rnPmtuProbeDue(RnPmtu *pmtu, uint64_t now);
+
+/**
+ * Records the acknowledgement of a probe of `size`, stale ones are ignored.
+ */
+void rnPmtuProbeAcked(RnPmtu *pmtu, uint16_t size, uint64_t now);
+
+/**
+ * Largest confirmed size, safe to read from any thread.
+ */
+uint16_t rnPmtuConfirmed(const RnPmtu *pmtu);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_PMTU_H
@@ -0,0 +1,88 @@
+#ifndef RN_POLLER_H
+#define RN_POLLER_H
+
+#include "socket.h"
+#include "util.h"
+
+#include <stdint.h>
+
+#define RN_POLLER_WAIT_FOREVER UINT64_MAX
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Spinning is adaptive: the spin window follows the observed gap between
+ * datagrams within [spin_min_us, spin_max_us] and decays towards spin_min_us
+ * while the sockets are idle. A spin_max_us of 0 always blocks right away.
+ *
+ * busy_poll_us and busy_poll_budget are applied to sockets as they are added,
+ * see rnSocketSetBusyPoll. 0 leaves the socket unchanged.
+ */
+struct RnPollerConfig
+{
+    uint32_t spin_min_us;
+    uint32_t spin_max_us;
+    uint32_t busy_poll_us;
+    uint32_t busy_poll_budget;
+};
+
+typedef struct RnPollerConfig RnPollerConfig;
+typedef struct RnPoller RnPoller;
+
+/**
+ * Waits for ingress on many sockets at once, backed by epoll on Linux and by
+ * poll or WSAPoll elsewhere. Waits first spin with non-blocking polls and only
+ * then block, trading CPU time for microsecond wakeups while traffic flows.
+ *
+ * Readiness is level triggered, callers drain ready sockets until
+ * rnSocketReceiveData fails. A poller is used by a single thread, apart from
+ * rnPollerWake.
+ */
+int rnPollerOpen(const RnPollerConfig *config, OUT RnPoller **out);
+int rnPollerClose(IN RnPoller *poller);
+
+#define RN_POLLER_DECL(IP)                                                                         \
+    /** `token` is reported by rnPollerWait once the socket is readable. */                        \
+    int rnPollerAdd##IP(RnPoller *poller, RnSocket##IP *socket, uint32_t token);                   \
+                                                                                                   \
+    int rnPollerRemove##IP(RnPoller *poller, RnSocket##IP *socket);
+
+RN_POLLER_DECL(IPv4)
+RN_POLLER_DECL(IPv6)
+
+#undef RN_POLLER_DECL
+
+#define rnPollerAdd(poller, socket, ...)                                                           \
+    RN_SOCKET_SELECT(rnPollerAdd, socket)(poller, socket, __VA_ARGS__)
+#define rnPollerRemove(poller, socket)                                                             \
+    RN_SOCKET_SELECT(rnPollerRemove, socket)(poller, socket)
+
+/**
+ * Waits up to `timeout_ns` for readable sockets and stores up to `capacity`
+ * of their tokens. `count` is 0 on timeout or once woken. epoll keeps to
+ * timeouts below a millisecond, poll and WSAPoll round them up.
+ */
+int rnPollerWait(
+      RnPoller *poller, uint64_t timeout_ns, OUT uint32_t *tokens, uint32_t capacity,
+      OUT uint32_t *count);
+
+/**
+ * Ends the wait in progress, or else the next one, right away. Callable from
+ * any thread, wakes before a wait collapse into one. WSAPoll has nothing to
+ * wake it by, its waits always run to their timeout.
+ */
+int rnPollerWake(RnPoller *poller);
+
+/**
+ * Current adaptive spin window in nanoseconds.
+ */
+uint64_t rnPollerSpinWindow(const RnPoller *poller);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_POLLER_H
@@ -0,0 +1,61 @@
+#ifndef RN_POLY1305_H
+#define RN_POLY1305_H
+
+#include "util.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// packets verified at once by the widest kernel, batches of this size keep every lane busy
+#define RN_POLY1305_LANES 4
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum RnPoly1305Kernel
+{
+    RN_POLY1305_SCALAR,
+    RN_POLY1305_AVX2,
+};
+
+/**
+ * A 16 byte Poly1305 `tag` to check against `size` bytes at `data` under its
+ * own single-use 32 byte `key`, as crypto_onetimeauth_verify does.
+ */
+struct RnPoly1305Job
+{
+    const uint8_t *data;
+    size_t size;
+    const uint8_t *tag;
+    const uint8_t *key;
+};
+
+typedef struct RnPoly1305Job RnPoly1305Job;
+
+/**
+ * Verifies `count` independent tags, `valid[i]` is whether that of `jobs[i]`
+ * matches, exactly as crypto_onetimeauth_verify would decide.
+ *
+ * The fastest kernel supported by the running CPU is selected on first use.
+ * The AVX2 kernel runs RN_POLY1305_LANES messages through the same vector
+ * instructions, one per lane, messages of different lengths only cost the
+ * blocks of the longest. Scalar verification is left to libsodium.
+ */
+void rnPoly1305VerifyBatch(const RnPoly1305Job *jobs, size_t count, OUT bool *valid);
+
+enum RnPoly1305Kernel rnPoly1305Kernel();
+
+/**
+ * Overrides kernel selection, e.g. to benchmark or verify kernels against each
+ * other. Selecting a kernel the CPU does not support falls back to scalar.
+ */
+void rnPoly1305SelectKernel(enum RnPoly1305Kernel kernel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_POLY1305_H
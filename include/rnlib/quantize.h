@@ -0,0 +1,136 @@
+#ifndef RN_QUANTIZE_H
+#define RN_QUANTIZE_H
+
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Smallest-three quaternions drop the largest component, the remaining three
+ * are bounded by +-1/sqrt(2).
+ */
+#define RN_QUANTIZE_QUATERNION_BOUND 0.70710678f
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Maps floats in [min, max] onto `bits` wide unsigned integers. Values outside
+ * the range are clamped.
+ */
+struct RnQuantizeRange
+{
+    float min;
+    float max;
+    uint32_t bits;
+};
+
+struct RnVector3
+{
+    float x;
+    float y;
+    float z;
+};
+
+struct RnQuaternion
+{
+    float x;
+    float y;
+    float z;
+    float w;
+};
+
+/**
+ * Index of the dropped component followed by the other three in x, y, z, w
+ * order, each quantized to the same bit count.
+ */
+struct RnQuantizedQuaternion
+{
+    uint8_t largest;
+    uint32_t components[3];
+};
+
+typedef struct RnQuantizeRange RnQuantizeRange;
+typedef struct RnVector3 RnVector3;
+typedef struct RnQuaternion RnQuaternion;
+typedef struct RnQuantizedQuaternion RnQuantizedQuaternion;
+
+/**
+ * Creates a range using the fewest bits (at most 32) that resolve steps of
+ * `precision` between `min` and `max`.
+ */
+RnQuantizeRange rnQuantizeRangeCreate(float min, float max, float precision);
+
+/**
+ * Ranges and quaternions quantize to 1 to 32 bits, 0 bits would leave a single
+ * step and no range to divide into it.
+ */
+static inline bool rnQuantizeBitsValid(uint32_t bits)
+{
+    return bits >= 1 && bits <= 32;
+}
+
+static inline uint32_t rnQuantizeFloat(const RnQuantizeRange *range, float value)
+{
+    if (!rnQuantizeBitsValid(range->bits))
+    {
+        return 0;
+    }
+
+    double steps = (double)((1ull << range->bits) - 1);
+
+    if (value <= range->min)
+    {
+        return 0;
+    }
+
+    if (value >= range->max)
+    {
+        return (uint32_t)steps;
+    }
+
+    double normalized = ((double)value - range->min) / ((double)range->max - range->min);
+    return (uint32_t)(normalized * steps + 0.5);
+}
+
+static inline float rnDequantizeFloat(const RnQuantizeRange *range, uint32_t value)
+{
+    if (!rnQuantizeBitsValid(range->bits))
+    {
+        return range->min;
+    }
+
+    double steps = (double)((1ull << range->bits) - 1);
+    return (float)(range->min + (double)value / steps * ((double)range->max - range->min));
+}
+
+/**
+ * Quantizes a unit quaternion to its three smallest components. `q` and `-q`
+ * describe the same rotation, so the dropped component is always restored as
+ * positive.
+ */
+RnQuantizedQuaternion rnQuantizeQuaternion(const RnQuaternion *quaternion, uint32_t bits);
+RnQuaternion rnDequantizeQuaternion(const RnQuantizedQuaternion *quantized, uint32_t bits);
+
+/**
+ * Maps signed integers onto unsigned ones so that small magnitudes of either
+ * sign stay small: 0, -1, 1, -2, 2 become 0, 1, 2, 3, 4.
+ */
+static inline uint64_t rnZigzagEncode(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline int64_t rnZigzagDecode(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_QUANTIZE_H
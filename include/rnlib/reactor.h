@@ -0,0 +1,212 @@
+#ifndef RN_REACTOR_H
+#define RN_REACTOR_H
+
+#include "connection.h"
+#include "filter.h"
+#include "poller.h"
+#include "ring.h"
+#include "socket.h"
+#include "util.h"
+
+#include <stdint.h>
+
+#define RN_REACTOR_RING_DEFAULT         1024
+#define RN_REACTOR_CONNECTIONS_DEFAULT  4096
+#define RN_REACTOR_IDLE_DEFAULT_US      100
+#define RN_REACTOR_HANDSHAKE_DEFAULT_MS 5000
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+enum RnReactorEventKind
+{
+    // I/O thread to application: a verified and decrypted packet
+    RN_REACTOR_PACKET,
+    // I/O thread to application: handshake of `connection` completed
+    RN_REACTOR_CONNECTED,
+
+    // application to I/O thread: open a client connection to `address`
+    RN_REACTOR_CONNECT,
+    // application to I/O thread: close `connection`, it must not be used after
+    RN_REACTOR_DISCONNECT,
+};
+
+/**
+ * Idle I/O threads wait on their socket via RnPoller as configured by `poll`,
+ * rnReactorSubmit wakes them. They block for at most `idle_us` so that probes
+ * and handshake timeouts keep running, and egress is still picked up in time
+ * where the poller cannot be woken.
+ *
+ * Handshake packets are rate limited per source address as configured by
+ * `filter`, ahead of any cryptography, and connections are opened for them
+ * within the budget `filter` shares among all sources. Connections whose
+ * handshake has not completed within `handshake_ms` are closed, so that
+ * sources which never finish one do not hold on to `connections_max`.
+ *
+ * Every connection protects the packet types in `fec` with parity packets, see
+ * rnConnectionConfigureFec. Zero initialized, nothing is protected.
+ *
+ * Sessions in the snapshot at `snapshot` are adopted before the I/O threads
+ * start, see rnReactorHandover. A missing or incompatible snapshot starts out
+ * without sessions, NULL skips adoption.
+ */
+struct RnReactorConfig
+{
+    uint32_t ring_capacity;
+    uint32_t connections_max;
+    uint32_t idle_us;
+    uint32_t handshake_ms;
+    RnPollerConfig poll;
+    RnFilterConfig filter;
+    RnFecConfig fec;
+    const char *snapshot;
+};
+
+/**
+ * Counters of a single I/O thread, written by it and read with relaxed loads.
+ * `ingress_filtered` counts datagrams dropped before verification, drops in
+ * the kernel ahead of the I/O thread are counted by its socket, see
+ * rnSocketStats.
+ */
+struct RnReactorStats
+{
+    uint64_t ingress_events;
+    uint64_t ingress_overflows;
+    uint64_t ingress_filtered;
+    uint64_t egress_packets;
+    uint64_t egress_failures;
+    uint64_t connections;
+};
+
+typedef struct RnReactorConfig RnReactorConfig;
+typedef struct RnReactorStats RnReactorStats;
+
+/**
+ * Reactors run one dedicated I/O thread per socket. I/O threads own their
+ * socket and every connection on it: they receive, sequence check, verify and
+ * decrypt ingress, answer handshakes, and authenticate, encrypt and send
+ * egress. Application threads never block on the network. IPv6 reactors on
+ * sockets from rnSocketOpenDualStack serve IPv4 peers on the same threads.
+ *
+ * Every I/O thread exchanges events with the application through a pair of
+ * single-producer single-consumer rings, so each I/O thread must be serviced
+ * by exactly one application thread at a time; one application thread may
+ * service several I/O threads. Events are used in place:
+ *
+ *   RnReactorEventAuthenticatedIPv4 *event;
+ *   while ((event = rnReactorPeek(reactor, thread)) != NULL)
+ *   {
+ *       ...
+ *       rnReactorConsume(reactor, thread);
+ *   }
+ *
+ *   event = rnReactorAcquire(reactor, thread);
+ *   if (event != NULL)
+ *   {
+ *       event->kind       = RN_REACTOR_PACKET;
+ *       event->connection = connection;
+ *       event->buffer     = rnPacketBufferCreateSecure(type);
+ *       ... serialize into event->buffer ...
+ *       rnReactorSubmit(reactor, thread);
+ *   }
+ *
+ * Acquired events are ring slots as last used, serializers OR into the body
+ * so every field, the buffer included, must be set anew before submitting.
+ *
+ * Connections are only ever touched by their I/O thread, pointers handed to
+ * the application serve as handles. Unknown addresses sending to a socket get
+ * a server connection opened for them, RN_REACTOR_CONNECTED is raised once
+ * their handshake completes. Those whose first datagram fails verification or
+ * whose handshake times out are closed without the application ever seeing
+ * them. Ingress is dropped when the application falls behind and its ring is
+ * full.
+ *
+ * I/O threads also probe the path MTU of their connections. Egress larger than
+ * rnConnectionPayloadMax counts as a failure, bound buffers by it through
+ * rnPacketBufferLimit.
+ *
+ * Secure sessions survive address changes of their peer: datagrams from an
+ * unknown address that carry a known rnConnectionId are verified by that
+ * session, which then challenges the new address and moves there once the
+ * challenge is answered. Handles stay the same throughout.
+ */
+#define RN_REACTOR_DECL(TYPE, IP, BUFFER)                                                          \
+    struct RnReactorEvent##TYPE##IP                                                                \
+    {                                                                                              \
+        enum RnReactorEventKind kind;                                                              \
+        RnConnection##TYPE##IP *connection;                                                        \
+        RnAddress##IP address;                                                                     \
+        RnPacketBuffer##BUFFER buffer;                                                             \
+    };                                                                                             \
+                                                                                                   \
+    typedef struct RnReactorEvent##TYPE##IP RnReactorEvent##TYPE##IP;                              \
+    typedef struct RnReactor##TYPE##IP RnReactor##TYPE##IP;                                        \
+                                                                                                   \
+    int rnReactorOpen##TYPE##IP(                                                                   \
+          RnSocket##IP *const *sockets, uint32_t socket_count, const RnReactorConfig *config,      \
+          OUT RnReactor##TYPE##IP **out);                                                          \
+                                                                                                   \
+    /** Stops and joins all I/O threads and closes their connections. */                           \
+    int rnReactorClose##TYPE##IP(IN RnReactor##TYPE##IP *reactor);                                 \
+                                                                                                   \
+    /**                                                                                            \
+     * Stops and joins all I/O threads, saves their connections into a snapshot at `path` and      \
+     * closes the reactor. A new process opening a reactor on the same sockets, passed on through  \
+     * rnSocketAdopt in the same order, continues the sessions from RnReactorConfig.snapshot       \
+     * without new handshakes. Their handles reach the application as RN_REACTOR_CONNECTED.        \
+     */                                                                                            \
+    int rnReactorHandover##TYPE##IP(IN RnReactor##TYPE##IP *reactor, const char *path);            \
+                                                                                                   \
+    uint32_t rnReactorThreadCount##TYPE##IP(const RnReactor##TYPE##IP *reactor);                   \
+                                                                                                   \
+    RnReactorEvent##TYPE##IP *rnReactorPeek##TYPE##IP(                                             \
+          RnReactor##TYPE##IP *reactor, uint32_t thread);                                          \
+    void rnReactorConsume##TYPE##IP(RnReactor##TYPE##IP *reactor, uint32_t thread);                \
+                                                                                                   \
+    RnReactorEvent##TYPE##IP *rnReactorAcquire##TYPE##IP(                                          \
+          RnReactor##TYPE##IP *reactor, uint32_t thread);                                          \
+    void rnReactorSubmit##TYPE##IP(RnReactor##TYPE##IP *reactor, uint32_t thread);                 \
+                                                                                                   \
+    void rnReactorStats##TYPE##IP(                                                                 \
+          const RnReactor##TYPE##IP *reactor, uint32_t thread, OUT RnReactorStats *out);
+
+RN_REACTOR_DECL(Authenticated, IPv4, Secure)
+RN_REACTOR_DECL(Authenticated, IPv6, Secure)
+
+RN_REACTOR_DECL(Encrypted, IPv4, Secure)
+RN_REACTOR_DECL(Encrypted, IPv6, Secure)
+
+RN_REACTOR_DECL(Insecure, IPv4, Insecure)
+RN_REACTOR_DECL(Insecure, IPv6, Insecure)
+
+#undef RN_REACTOR_DECL
+
+#define RN_REACTOR_SELECT(NAME, REACTOR)                                                           \
+    RN_SELECT6(                                                                                    \
+          REACTOR, RnReactorAuthenticatedIPv4, NAME##AuthenticatedIPv4,                            \
+          RnReactorAuthenticatedIPv6, NAME##AuthenticatedIPv6, RnReactorEncryptedIPv4,             \
+          NAME##EncryptedIPv4, RnReactorEncryptedIPv6, NAME##EncryptedIPv6, RnReactorInsecureIPv4, \
+          NAME##InsecureIPv4, RnReactorInsecureIPv6, NAME##InsecureIPv6)
+
+#define RN_REACTOR_CALL(NAME, REACTOR, ...)                                                        \
+    RN_REACTOR_SELECT(NAME, REACTOR)(REACTOR, __VA_ARGS__)
+
+#define rnReactorOpen(sockets, socket_count, config, out)                                          \
+    RN_REACTOR_SELECT(rnReactorOpen, *(out))(sockets, socket_count, config, out)
+#define rnReactorClose(reactor) RN_REACTOR_SELECT(rnReactorClose, reactor)(reactor)
+#define rnReactorHandover(reactor, ...) RN_REACTOR_CALL(rnReactorHandover, reactor, __VA_ARGS__)
+#define rnReactorThreadCount(reactor)                                                              \
+    RN_REACTOR_SELECT(rnReactorThreadCount, reactor)(reactor)
+#define rnReactorPeek(reactor, ...)    RN_REACTOR_CALL(rnReactorPeek, reactor, __VA_ARGS__)
+#define rnReactorConsume(reactor, ...) RN_REACTOR_CALL(rnReactorConsume, reactor, __VA_ARGS__)
+#define rnReactorAcquire(reactor, ...) RN_REACTOR_CALL(rnReactorAcquire, reactor, __VA_ARGS__)
+#define rnReactorSubmit(reactor, ...)  RN_REACTOR_CALL(rnReactorSubmit, reactor, __VA_ARGS__)
+#define rnReactorStats(reactor, ...)   RN_REACTOR_CALL(rnReactorStats, reactor, __VA_ARGS__)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_REACTOR_H
@@ -0,0 +1,118 @@
+#ifndef RN_RING_H
+#define RN_RING_H
+
+#include "util.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * Lock-free single-producer single-consumer rings.
+ *
+ *   RN_RING_DEFINE(Event, struct Event)
+ *
+ * defines RnRingEvent holding a power of two number of slots. Slots are used
+ * in place: the producer acquires a slot, fills it and publishes it, the
+ * consumer peeks at the oldest published slot and releases it once done, so
+ * large entries such as packet buffers are never copied in or out.
+ *
+ * Each side caches the other side's index and only reloads it when the ring
+ * looks full or empty, keeping cache line transfers to about one per batch.
+ */
+#define RN_RING_DEFINE(NAME, TYPE)                                                                 \
+    struct RnRing##NAME                                                                            \
+    {                                                                                              \
+        TYPE *slots;                                                                               \
+        uint32_t mask;                                                                             \
+                                                                                                   \
+        __attribute__((aligned(64))) uint32_t head;                                                \
+        uint32_t tail_cached;                                                                      \
+                                                                                                   \
+        __attribute__((aligned(64))) uint32_t tail;                                                \
+        uint32_t head_cached;                                                                      \
+    };                                                                                             \
+                                                                                                   \
+    typedef struct RnRing##NAME RnRing##NAME;                                                      \
+                                                                                                   \
+    static inline int rnRing##NAME##Init(RnRing##NAME *ring, uint32_t capacity)                    \
+    {                                                                                              \
+        uint32_t size = 1;                                                                         \
+        while (size < capacity)                                                                    \
+        {                                                                                          \
+            size <<= 1;                                                                            \
+        }                                                                                          \
+                                                                                                   \
+        *ring = (RnRing##NAME) {                                                                   \
+            .slots = calloc(size, sizeof(TYPE)),                                                   \
+            .mask  = size - 1,                                                                     \
+        };                                                                                         \
+                                                                                                   \
+        return ring->slots != NULL ? RN_OK : RN_OOM;                                               \
+    }                                                                                              \
+                                                                                                   \
+    static inline void rnRing##NAME##Free(RnRing##NAME *ring)                                      \
+    {                                                                                              \
+        free(ring->slots);                                                                         \
+    }                                                                                              \
+                                                                                                   \
+    /**                                                                                            \
+     * Producer side, the slot `offset` slots past the next one to publish, so that a batch can    \
+     * be filled before publishing it slot by slot. NULL while the ring has no room for it.        \
+     */                                                                                            \
+    static inline TYPE *rnRing##NAME##AcquireAt(RnRing##NAME *ring, uint32_t offset)               \
+    {                                                                                              \
+        uint32_t head = ring->head + offset;                                                       \
+        if (head - ring->tail_cached > ring->mask)                                                 \
+        {                                                                                          \
+            ring->tail_cached = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);                    \
+            if (head - ring->tail_cached > ring->mask)                                             \
+            {                                                                                      \
+                return NULL;                                                                       \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return &ring->slots[head & ring->mask];                                                    \
+    }                                                                                              \
+                                                                                                   \
+    /** Producer side, returns NULL while the ring is full. */                                     \
+    static inline TYPE *rnRing##NAME##Acquire(RnRing##NAME *ring)                                  \
+    {                                                                                              \
+        return rnRing##NAME##AcquireAt(ring, 0);                                                   \
+    }                                                                                              \
+                                                                                                   \
+    static inline void rnRing##NAME##Publish(RnRing##NAME *ring)                                   \
+    {                                                                                              \
+        __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);                           \
+    }                                                                                              \
+                                                                                                   \
+    /** Consumer side, returns NULL while the ring is empty. */                                    \
+    static inline TYPE *rnRing##NAME##Peek(RnRing##NAME *ring)                                     \
+    {                                                                                              \
+        if (ring->tail == ring->head_cached)                                                       \
+        {                                                                                          \
+            ring->head_cached = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);                    \
+            if (ring->tail == ring->head_cached)                                                   \
+            {                                                                                      \
+                return NULL;                                                                       \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return &ring->slots[ring->tail & ring->mask];                                              \
+    }                                                                                              \
+                                                                                                   \
+    static inline void rnRing##NAME##Release(RnRing##NAME *ring)                                   \
+    {                                                                                              \
+        __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);                           \
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_RING_H
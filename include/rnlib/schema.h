@@ -0,0 +1,124 @@
+#ifndef RN_SCHEMA_H
+#define RN_SCHEMA_H
+
+#include "packet.h"
+#include "util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Schemas describe fixed packet layouts as X-macro field lists and generate
+ * specialized read and write functions for them. Every field's bit offset is
+ * a compile time constant, so once inlined a schema write compiles down to a
+ * handful of shifts and ORs without any cursor state.
+ *
+ *   #define RN_MOVEMENT_FIELDS(FIELD) \
+ *       FIELD(entity, uint16_t, 11)   \
+ *       FIELD(x, uint16_t, 14)        \
+ *       FIELD(y, uint16_t, 14)
+ *
+ *   RN_SCHEMA_DEFINE(Movement, RN_MOVEMENT_FIELDS)
+ *
+ * defines RnSchemaMovement along with rnSchemaWriteMovement and
+ * rnSchemaReadMovement operating on a packet buffer body. Fields are at most
+ * 64 bits wide and laid out exactly as consecutive rnPacketBufferWrite calls
+ * would, so schema and cursor serialization can be mixed by continuing at
+ * RN_SCHEMA_CURSOR(NAME).
+ *
+ * Writes OR into the body and thus expect it to be zeroed, as created by
+ * rnPacketBufferCreate. They are unchecked, buffers from rnPacketBufferOpen or
+ * shrunk by rnPacketBufferLimit have to pass RN_SCHEMA_FITS first.
+ */
+
+/**
+ * Largest schema that fits the body of every packet buffer type. Schemas past
+ * RN_PACKET_BYTES_BASE only fit paths with a larger rnConnectionPayloadMax.
+ */
+#define RN_SCHEMA_BITS_MAX (RN_PACKET_BODY_QWORDS_SECURE * 64)
+
+#define RN_SCHEMA_BITS(NAME) (sizeof(struct RnSchemaLayout##NAME))
+
+#define RN_SCHEMA_FITS(NAME, BUFFER)                                                               \
+    (RN_SCHEMA_BITS(NAME) <= (size_t)(BUFFER)->meta.body_capacity * 8)
+
+#define RN_SCHEMA_CURSOR(NAME)                                                                     \
+    ((RnPacketBufferCursor) { RN_SCHEMA_BITS(NAME) / 64, RN_SCHEMA_BITS(NAME) % 64 })
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+static inline __attribute__((always_inline)) void rxSchemaWrite(
+      uint64_t *body, size_t offset, size_t bits, uint64_t value)
+{
+    size_t qword = offset / 64;
+    size_t bit   = offset % 64;
+
+    value &= bits == 64 ? UINT64_MAX : (1ull << bits) - 1;
+
+    body[qword] |= value << bit;
+    if (bit + bits > 64)
+    {
+        body[qword + 1] |= value >> (64 - bit);
+    }
+}
+
+static inline __attribute__((always_inline)) uint64_t rxSchemaRead(
+      const uint64_t *body, size_t offset, size_t bits)
+{
+    size_t qword = offset / 64;
+    size_t bit   = offset % 64;
+
+    uint64_t value = body[qword] >> bit;
+    if (bit + bits > 64)
+    {
+        value |= body[qword + 1] << (64 - bit);
+    }
+
+    return value & (bits == 64 ? UINT64_MAX : (1ull << bits) - 1);
+}
+
+// layout structs use one char per bit, offsetof then yields bit offsets
+#define RN_SCHEMA_LAYOUT_FIELD(NAME, TYPE, BITS) char NAME[BITS];
+#define RN_SCHEMA_STRUCT_FIELD(NAME, TYPE, BITS) TYPE NAME;
+
+#define RN_SCHEMA_WRITE_FIELD(NAME, TYPE, BITS)                                                    \
+    rxSchemaWrite(body, offsetof(RxSchemaLayout, NAME), BITS, (uint64_t)in->NAME);
+
+#define RN_SCHEMA_READ_FIELD(NAME, TYPE, BITS)                                                     \
+    out->NAME = (TYPE)rxSchemaRead(body, offsetof(RxSchemaLayout, NAME), BITS);
+
+#define RN_SCHEMA_DEFINE(NAME, FIELDS)                                                             \
+    struct RnSchemaLayout##NAME                                                                    \
+    {                                                                                              \
+        FIELDS(RN_SCHEMA_LAYOUT_FIELD)                                                             \
+    };                                                                                             \
+                                                                                                   \
+    typedef char RxSchemaFits##NAME[RN_SCHEMA_BITS(NAME) <= RN_SCHEMA_BITS_MAX ? 1 : -1];          \
+                                                                                                   \
+    struct RnSchema##NAME                                                                          \
+    {                                                                                              \
+        FIELDS(RN_SCHEMA_STRUCT_FIELD)                                                             \
+    };                                                                                             \
+                                                                                                   \
+    typedef struct RnSchema##NAME RnSchema##NAME;                                                  \
+                                                                                                   \
+    static inline void rnSchemaWrite##NAME(uint64_t *body, const RnSchema##NAME *in)               \
+    {                                                                                              \
+        typedef struct RnSchemaLayout##NAME RxSchemaLayout;                                        \
+        FIELDS(RN_SCHEMA_WRITE_FIELD)                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static inline void rnSchemaRead##NAME(const uint64_t *body, OUT RnSchema##NAME *out)           \
+    {                                                                                              \
+        typedef struct RnSchemaLayout##NAME RxSchemaLayout;                                        \
+        FIELDS(RN_SCHEMA_READ_FIELD)                                                               \
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_SCHEMA_H
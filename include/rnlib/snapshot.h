@@ -0,0 +1,62 @@
+#ifndef RN_SNAPSHOT_H
+#define RN_SNAPSHOT_H
+
+#include "util.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define RN_SNAPSHOT_VERSION 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct RnSnapshot RnSnapshot;
+
+/**
+ * Memory-mapped files of fixed size records handing state over to another
+ * process, e.g. live sessions across a server restart. Records are written in
+ * place and only become visible under `path` once committed, readers never see
+ * a partial snapshot.
+ *
+ * Snapshots hold session keys. They are created readable by the owner only and
+ * are wiped and removed once adopted, keep them on a memory backed file system
+ * such as /dev/shm so that keys never reach a disk.
+ *
+ * `kind` and `record_size` identify the layout, a snapshot of a different
+ * layout or RN_SNAPSHOT_VERSION fails to open with EINVAL.
+ */
+int rnSnapshotCreate(
+      const char *path, uint32_t kind, uint32_t record_size, uint32_t capacity,
+      OUT RnSnapshot **out);
+
+/**
+ * Record at `index`, NULL past the capacity of a created snapshot or the count
+ * of an opened one.
+ */
+void *rnSnapshotRecord(RnSnapshot *snapshot, uint32_t index);
+
+/**
+ * Publishes the first `count` records under the path given to
+ * rnSnapshotCreate and releases the snapshot.
+ */
+int rnSnapshotCommit(IN RnSnapshot *snapshot, uint32_t count);
+
+int rnSnapshotOpen(
+      const char *path, uint32_t kind, uint32_t record_size, OUT RnSnapshot **out);
+
+uint32_t rnSnapshotCount(const RnSnapshot *snapshot);
+
+/**
+ * Wipes and removes the snapshot, adopted or abandoned state must not be
+ * adopted twice.
+ */
+int rnSnapshotClose(IN RnSnapshot *snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_SNAPSHOT_H
@@ -2,34 +2,152 @@
 #define RN_SOCKET_H
 
 #include "address.h"
+#include "capture.h"
 #include "util.h"
 
+#include <stdint.h>
+
+// autotuning grows socket buffers up to this many bytes by default
+#define RN_SOCKET_BUFFER_MAX_DEFAULT (8u << 20)
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+/**
+ * Counters of a single socket, written by the thread using it and read with
+ * relaxed loads.
+ *
+ * `ingress_dropped` counts datagrams the kernel dropped for want of receive
+ * buffer, as of the latest datagram received. `ingress_latency_ns` smooths the
+ * time from the kernel timestamping a datagram to it being received. Both stay
+ * 0 outside Linux. Buffer sizes are as reported by the kernel, which on Linux
+ * includes its bookkeeping overhead.
+ */
+struct RnSocketStats
+{
+    uint64_t ingress_datagrams;
+    uint64_t ingress_dropped;
+    uint64_t ingress_latency_ns;
+    uint64_t ingress_latency_max_ns;
+    uint64_t buffer_grows;
+    uint32_t receive_buffer;
+    uint32_t send_buffer;
+};
+
+typedef struct RnSocketStats RnSocketStats;
+
 int rnSocketsInitialize();
 int rnSocketsCleanup();
 
 #define RN_SOCKET_DECL(IP)                                                     \
     typedef struct RnSocket##IP RnSocket##IP;                                  \
+    struct RnImpairedSocket##IP;                                               \
+                                                                               \
+    int rnSocketOpen##IP(                                                      \
+          const RnAddress##IP *host, OUT RnSocket##IP **handle);               \
+                                                                               \
+    int rnSocketClose##IP(IN RnSocket##IP *handle);                            \
+                                                                               \
+    /**                                                                        \
+     * Wraps a bound UDP socket inherited from another process, e.g. one       \
+     * handing over its sessions on restart, see rnReactorHandover.            \
+     */                                                                        \
+    int rnSocketAdopt##IP(int handle, OUT RnSocket##IP **out);                 \
+                                                                               \
+    /**                                                                        \
+     * Records every datagram passing through the socket into `capture`,       \
+     * NULL detaches the current capture.                                      \
+     */                                                                        \
+    void rnSocketSetCapture##IP(RnSocket##IP *socket, RnCapture *capture);     \
                                                                                \
-    int rnSocketOpen(const RnAddress##IP *host, OUT RnSocket##IP **handle);    \
+    /** Capture attached by rnSocketSetCapture, NULL if none. */               \
+    RnCapture *rnSocketCapture##IP(const RnSocket##IP *socket);                \
                                                                                \
-    int rnSocketClose(IN RnSocket##IP *handle);                                \
+    /**                                                                        \
+     * Sends every datagram through `impairment`, which must wrap `socket`,    \
+     * see rnImpairmentOpen. Delayed datagrams are released whenever the       \
+     * socket sends or receives. NULL detaches the current impairment.         \
+     */                                                                        \
+    void rnSocketSetImpairment##IP(                                            \
+          RnSocket##IP *socket, struct RnImpairedSocket##IP *impairment);      \
                                                                                \
-    int rnSocketSendData(                                                      \
-          const RnSocket##IP *socket, const RnAddress##IP *address,            \
+    /** Native handle, e.g. for waiting on the socket via RnPoller. */         \
+    int rnSocketHandle##IP(const RnSocket##IP *socket);                        \
+                                                                               \
+    /**                                                                        \
+     * Lets blocking waits on the socket busy poll the device queue for up to  \
+     * `microseconds` before sleeping, 0 disables. `budget` caps the packets   \
+     * handled per poll, 0 keeps the kernel default. No-op outside Linux.      \
+     */                                                                        \
+    int rnSocketSetBusyPoll##IP(                                               \
+          RnSocket##IP *socket, uint32_t microseconds, uint32_t budget);       \
+                                                                               \
+    /**                                                                        \
+     * Receive buffers grow when a burst drained from the socket came close to \
+     * filling them or the kernel dropped datagrams, send buffers when sending \
+     * would block. Both grow up to `bytes`, bounded by net.core.rmem_max and  \
+     * wmem_max on Linux. 0 stops autotuning, RN_SOCKET_BUFFER_MAX_DEFAULT is  \
+     * the default.                                                            \
+     */                                                                        \
+    void rnSocketSetBufferMax##IP(RnSocket##IP *socket, uint32_t bytes);       \
+                                                                               \
+    void rnSocketStats##IP(                                                    \
+          const RnSocket##IP *socket, OUT RnSocketStats *out);                 \
+                                                                               \
+    int rnSocketSendData##IP(                                                  \
+          RnSocket##IP *socket, const RnAddress##IP *address,                  \
           const uint8_t *data, size_t data_size);                              \
                                                                                \
-    int rnSocketReceiveData(                                                   \
-          const RnSocket##IP *socket, OUT RnAddress##IP *address,              \
+    int rnSocketReceiveData##IP(                                               \
+          RnSocket##IP *socket, OUT RnAddress##IP *address,                    \
           OUT uint8_t *data, OUT size_t *data_size);
 
 RN_SOCKET_DECL(IPv4)
 RN_SOCKET_DECL(IPv6)
 
+#define RN_SOCKET_SELECT(NAME, SOCKET)                                         \
+    RN_SELECT2(SOCKET, RnSocketIPv4, NAME##IPv4, RnSocketIPv6, NAME##IPv6)
+
+#define RN_SOCKET_CALL(NAME, SOCKET, ...)                                      \
+    RN_SOCKET_SELECT(NAME, SOCKET)(SOCKET, __VA_ARGS__)
+
+#define rnSocketOpen(host, ...)                                                \
+    RN_SELECT2(                                                                \
+          host, RnAddressIPv4, rnSocketOpenIPv4, RnAddressIPv6,                \
+          rnSocketOpenIPv6)(host, __VA_ARGS__)
+#define rnSocketClose(socket)                                                  \
+    RN_SOCKET_SELECT(rnSocketClose, socket)(socket)
+#define rnSocketAdopt(handle, out)                                             \
+    RN_SOCKET_SELECT(rnSocketAdopt, *(out))(handle, out)
+#define rnSocketSetCapture(socket, ...)                                        \
+    RN_SOCKET_CALL(rnSocketSetCapture, socket, __VA_ARGS__)
+#define rnSocketCapture(socket)                                                \
+    RN_SOCKET_SELECT(rnSocketCapture, socket)(socket)
+#define rnSocketSetImpairment(socket, ...)                                     \
+    RN_SOCKET_CALL(rnSocketSetImpairment, socket, __VA_ARGS__)
+#define rnSocketHandle(socket)                                                 \
+    RN_SOCKET_SELECT(rnSocketHandle, socket)(socket)
+#define rnSocketSetBusyPoll(socket, ...)                                       \
+    RN_SOCKET_CALL(rnSocketSetBusyPoll, socket, __VA_ARGS__)
+#define rnSocketSetBufferMax(socket, ...)                                      \
+    RN_SOCKET_CALL(rnSocketSetBufferMax, socket, __VA_ARGS__)
+#define rnSocketStats(socket, ...)                                             \
+    RN_SOCKET_CALL(rnSocketStats, socket, __VA_ARGS__)
+#define rnSocketSendData(socket, ...)                                          \
+    RN_SOCKET_CALL(rnSocketSendData, socket, __VA_ARGS__)
+#define rnSocketReceiveData(socket, ...)                                       \
+    RN_SOCKET_CALL(rnSocketReceiveData, socket, __VA_ARGS__)
+
+/**
+ * Opens an IPv6 socket that also serves IPv4 peers, e.g. bound to [::]. IPv4
+ * peers show up as IPv4-mapped addresses and are sent to the same way, see
+ * rnAddressMapIPv4, so a single socket, reactor thread and set of IPv6
+ * connections serve both families.
+ */
+int rnSocketOpenDualStack(const RnAddressIPv6 *host, OUT RnSocketIPv6 **out);
+
 #undef RN_SOCKET_DECL
 
 #ifdef __cplusplus
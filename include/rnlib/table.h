@@ -0,0 +1,89 @@
+#ifndef RN_TABLE_H
+#define RN_TABLE_H
+
+#include "util.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// bytes per key at most, enough for an RnAddressIPv6 or a connection id
+#define RN_TABLE_KEY_MAX 24
+
+#define RN_TABLE_CAPACITY_DEFAULT 1024
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct RnTable RnTable;
+
+/**
+ * Concurrent read-mostly table from fixed size keys to pointers, e.g. from
+ * addresses or connection ids to connections for several I/O threads receiving
+ * on the same port.
+ *
+ * Lookups are wait-free: they take no lock and write nothing but the calling
+ * reader's own cache line, once per read section. Writers are serialized by a
+ * spin lock and never block readers. Removed slots are only ever reused for
+ * the same key, so readers never see a key change under them, and the table is
+ * rebuilt into a fresh array once removals or growth call for it.
+ *
+ * Replaced arrays, and whatever the caller retires, are reclaimed RCU-style:
+ * every reader announces the epoch it entered its read section in, memory
+ * retired in an epoch is released once no reader is left in it or before.
+ * Readers `0` to `readers_max - 1` are numbered by the caller, typically one
+ * per I/O thread.
+ */
+int rnTableOpen(uint32_t key_size, uint32_t capacity, uint32_t readers_max, OUT RnTable **out);
+
+/**
+ * Releases the table and everything retired, no reader may be in a section.
+ */
+void rnTableClose(IN RnTable *table);
+
+/**
+ * Read sections bracket lookups and any use of the values found. Holding one
+ * across a batch of datagrams rather than per lookup keeps the cost at a store
+ * and a fence per batch. Sections must not nest.
+ */
+void rnTableReadBegin(RnTable *table, uint32_t reader);
+
+void rnTableReadEnd(RnTable *table, uint32_t reader);
+
+/**
+ * Value of `key`, NULL if absent. Only within a read section.
+ */
+void *rnTableFind(const RnTable *table, const void *key);
+
+/**
+ * Inserts or replaces the value of `key`, which must not be NULL.
+ */
+int rnTableInsert(RnTable *table, const void *key, void *value);
+
+/**
+ * Removes `key` and returns its value, NULL if absent. Readers may still hold
+ * the value until it is retired or the table synchronized.
+ */
+void *rnTableRemove(RnTable *table, const void *key);
+
+/**
+ * Calls `release` on `pointer` once no reader can hold it anymore, e.g. with
+ * the value just removed.
+ */
+int rnTableRetire(RnTable *table, void *pointer, void (*release)(void *));
+
+/**
+ * Waits until every read section entered before the call ended. Never from
+ * within a read section.
+ */
+void rnTableSynchronize(RnTable *table);
+
+uint32_t rnTableCount(const RnTable *table);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RN_TABLE_H
@@ -1,11 +1,60 @@
 #ifndef RN_UTIL_H
 #define RN_UTIL_H
 
-#define IN___
+#define IN
 #define INOUT
-#define __OUT
+#define OUT
 
-#define RN_OK 0
+#define RN_OK  0
+#define RN_OOM -1
+
+#ifdef _MSC_VER
+    #define RN_THREAD_LOCAL __declspec(thread)
+#else
+    #define RN_THREAD_LOCAL __thread
+#endif
+
+/**
+ * Functions stamped out per buffer, address, socket or connection type carry
+ * the type in their name, e.g. rnPacketBufferWireSizeSecure. Headers map the
+ * plain name onto them by the pointer type of one argument, through _Generic
+ * in C and overload resolution in C++. Neither evaluates that argument.
+ */
+#ifdef __cplusplus
+    #include <cstddef>
+    #include <tuple>
+    #include <type_traits>
+
+template <typename X, typename T, typename... Rest> constexpr std::size_t rxSelectIndex()
+{
+    if constexpr (std::is_same_v<X, T>)
+    {
+        return 0;
+    }
+    else
+    {
+        return 1 + rxSelectIndex<X, Rest...>();
+    }
+}
+
+template <typename... T, typename X, typename... F> constexpr auto rxSelect(X *, F... functions)
+{
+    return std::get<rxSelectIndex<std::remove_cv_t<X>, T...>()>(std::tuple<F...>(functions...));
+}
+
+    #define RN_SELECT_ARG(X) static_cast<std::remove_cvref_t<decltype(X)>>(nullptr)
+
+    #define RN_SELECT2(X, T1, F1, T2, F2) rxSelect<T1, T2>(RN_SELECT_ARG(X), F1, F2)
+    #define RN_SELECT6(X, T1, F1, T2, F2, T3, F3, T4, F4, T5, F5, T6, F6)                          \
+        rxSelect<T1, T2, T3, T4, T5, T6>(RN_SELECT_ARG(X), F1, F2, F3, F4, F5, F6)
+#else
+    #define RN_SELECT2(X, T1, F1, T2, F2)                                                          \
+        _Generic((X), T1 *: F1, const T1 *: F1, T2 *: F2, const T2 *: F2)
+    #define RN_SELECT6(X, T1, F1, T2, F2, T3, F3, T4, F4, T5, F5, T6, F6)                          \
+        _Generic(                                                                                  \
+              (X), T1 *: F1, const T1 *: F1, T2 *: F2, const T2 *: F2, T3 *: F3, const T3 *: F3,   \
+              T4 *: F4, const T4 *: F4, T5 *: F5, const T5 *: F5, T6 *: F6, const T6 *: F6)
+#endif
 
 #ifdef __cplusplus
 extern "C"
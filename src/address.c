@@ -10,7 +10,7 @@
     #include <sys/socket.h>
 #endif
 
-bool rnAddressEquals(RnAddressIPv4 a, RnAddressIPv4 b)
+bool rnAddressEqualsIPv4(RnAddressIPv4 a, RnAddressIPv4 b)
 {
     int octets = 0;
     for (int i = 0; i < 4; ++i)
@@ -21,7 +21,7 @@ bool rnAddressEquals(RnAddressIPv4 a, RnAddressIPv4 b)
     return octets == 4 && a.port == b.port;
 }
 
-bool rnAddressEquals(RnAddressIPv6 a, RnAddressIPv6 b)
+bool rnAddressEqualsIPv6(RnAddressIPv6 a, RnAddressIPv6 b)
 {
     int groups = 0;
     for (int i = 0; i < 8; ++i)
@@ -32,9 +32,9 @@ bool rnAddressEquals(RnAddressIPv6 a, RnAddressIPv6 b)
     return groups == 8 && a.port == b.port;
 }
 
-RnAddressIPv4 rnAddressFromNetwork(sockaddr_in net)
+RnAddressIPv4 rnAddressFromNetworkIPv4(struct sockaddr_in net)
 {
-    RnAddresIPv4 ipv4;
+    RnAddressIPv4 ipv4;
 
     uint8_t *net_bytes = (uint8_t *)&net.sin_addr.s_addr;
     for (int i = 0; i < 4; ++i)
@@ -46,7 +46,7 @@ RnAddressIPv4 rnAddressFromNetwork(sockaddr_in net)
     return ipv4;
 }
 
-RnAddressIPv6 rnAddressFromNetwork(sockaddr_in6 net)
+RnAddressIPv6 rnAddressFromNetworkIPv6(struct sockaddr_in6 net)
 {
     RnAddressIPv6 ipv6;
 
@@ -60,11 +60,11 @@ RnAddressIPv6 rnAddressFromNetwork(sockaddr_in6 net)
     return ipv6;
 }
 
-sockaddr_in rnAddressToNetwork(RnAddressIPv4 ipv4)
+struct sockaddr_in rnAddressToNetworkIPv4(RnAddressIPv4 ipv4)
 {
-    sockaddr_in net { .sin_family = AF_INET };
+    struct sockaddr_in net = { .sin_family = AF_INET };
 
-    uint8_t *net_bytes = (uint8_t *)net.sin_addr.s_addr;
+    uint8_t *net_bytes = (uint8_t *)&net.sin_addr.s_addr;
     for (int i = 0; i < 4; ++i)
     {
         net_bytes[i] = ipv4.octets[3 - i];
@@ -74,9 +74,9 @@ sockaddr_in rnAddressToNetwork(RnAddressIPv4 ipv4)
     return net;
 }
 
-sockaddr_in6 rnAddressToNetwork(RnAddressIPv6 ipv6)
+struct sockaddr_in6 rnAddressToNetworkIPv6(RnAddressIPv6 ipv6)
 {
-    sockaddr_in6 net { .sin6_family = AF_INET6 };
+    struct sockaddr_in6 net = { .sin6_family = AF_INET6 };
 
     uint8_t *host_bytes = (uint8_t *)ipv6.groups;
     for (int i = 0; i < 16; ++i)
@@ -87,3 +87,49 @@ sockaddr_in6 rnAddressToNetwork(RnAddressIPv6 ipv6)
     net.sin6_port = htons(ipv6.port);
     return net;
 }
+
+// both types hold their bytes in reverse network order, see rnAddressFromNetwork
+RnAddressIPv6 rnAddressMapIPv4(RnAddressIPv4 ipv4)
+{
+    RnAddressIPv6 ipv6 = { .port = ipv4.port };
+
+    uint8_t *host_bytes = (uint8_t *)ipv6.groups;
+    for (int i = 0; i < 4; ++i)
+    {
+        host_bytes[i] = ipv4.octets[i];
+    }
+
+    host_bytes[4] = 0xff;
+    host_bytes[5] = 0xff;
+    return ipv6;
+}
+
+bool rnAddressIsMappedIPv4(RnAddressIPv6 ipv6)
+{
+    const uint8_t *host_bytes = (const uint8_t *)ipv6.groups;
+
+    int zeros = 0;
+    for (int i = 6; i < 16; ++i)
+    {
+        zeros += host_bytes[i] == 0;
+    }
+
+    return zeros == 10 && host_bytes[4] == 0xff && host_bytes[5] == 0xff;
+}
+
+RnAddressIPv4 rnAddressUnmapIPv4(RnAddressIPv6 ipv6)
+{
+    RnAddressIPv4 ipv4 = { .port = ipv6.port };
+    if (!rnAddressIsMappedIPv4(ipv6))
+    {
+        return ipv4;
+    }
+
+    const uint8_t *host_bytes = (const uint8_t *)ipv6.groups;
+    for (int i = 0; i < 4; ++i)
+    {
+        ipv4.octets[i] = host_bytes[i];
+    }
+
+    return ipv4;
+}
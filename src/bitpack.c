@@ -0,0 +1,331 @@
+#include "../include/rnlib/bitpack.h"
+
+#include <stdbool.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define RN_BITPACK_X86 1
+    #include <immintrin.h>
+#endif
+
+/**
+ * Accumulates bit fields of up to 64 bits into whole qwords, so that packing
+ * costs one store per qword rather than a cursor update per value.
+ */
+struct RxBitpackWriter
+{
+    uint64_t *out;
+    uint64_t acc;
+    uint32_t fill;
+};
+
+static inline void rxBitpackEmit(struct RxBitpackWriter *writer, uint64_t value, uint32_t bits)
+{
+    writer->acc |= value << writer->fill;
+
+    uint32_t fill = writer->fill + bits;
+    if (fill >= 64)
+    {
+        *writer->out++ |= writer->acc;
+        writer->acc = writer->fill ? value >> (64 - writer->fill) : 0;
+        fill -= 64;
+    }
+
+    writer->fill = fill;
+}
+
+static inline void rxBitpackFinish(struct RxBitpackWriter *writer)
+{
+    if (writer->fill > 0)
+    {
+        *writer->out |= writer->acc;
+    }
+}
+
+static void rxBitpackWriteScalar(
+      struct RxBitpackWriter *writer, const uint32_t *values, size_t count, uint32_t bits)
+{
+    uint64_t mask = (1ull << bits) - 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        rxBitpackEmit(writer, values[i] & mask, bits);
+    }
+}
+
+static void rxBitpackReadScalar(
+      const uint64_t *body, uint64_t offset, uint32_t *values, size_t count, uint32_t bits)
+{
+    uint64_t mask = (1ull << bits) - 1;
+    for (size_t i = 0; i < count; ++i, offset += bits)
+    {
+        uint64_t qword = offset / 64;
+        uint32_t bit   = offset % 64;
+
+        uint64_t value = body[qword] >> bit;
+        if (bit + bits > 64)
+        {
+            value |= body[qword + 1] << (64 - bit);
+        }
+
+        values[i] = (uint32_t)(value & mask);
+    }
+}
+
+#ifdef RN_BITPACK_X86
+
+/**
+ * Merges adjacent values pairwise inside 64 bit lanes, turning 4 values of
+ * `bits` width into 2 fields of 2 * `bits`, or a single field of 4 * `bits`
+ * when that still fits 64 bits.
+ */
+__attribute__((target("sse4.1"))) static void rxBitpackWriteSSE41(
+      struct RxBitpackWriter *writer, const uint32_t *values, size_t count, uint32_t bits)
+{
+    const __m128i mask     = _mm_set1_epi32((int)((1ull << bits) - 1));
+    const __m128i low      = _mm_set1_epi64x(0xFFFFFFFF);
+    const __m128i shift    = _mm_cvtsi32_si128((int)bits);
+    const __m128i shift_x2 = _mm_cvtsi32_si128((int)bits * 2);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i x     = _mm_and_si128(_mm_loadu_si128((const __m128i *)(values + i)), mask);
+        __m128i even  = _mm_and_si128(x, low);
+        __m128i odd   = _mm_srli_epi64(x, 32);
+        __m128i pairs = _mm_or_si128(even, _mm_sll_epi64(odd, shift));
+
+        if (bits <= 16)
+        {
+            __m128i quad = _mm_or_si128(pairs, _mm_sll_epi64(_mm_srli_si128(pairs, 8), shift_x2));
+            rxBitpackEmit(writer, (uint64_t)_mm_cvtsi128_si64(quad), bits * 4);
+        }
+        else
+        {
+            rxBitpackEmit(writer, (uint64_t)_mm_cvtsi128_si64(pairs), bits * 2);
+            rxBitpackEmit(writer, (uint64_t)_mm_extract_epi64(pairs, 1), bits * 2);
+        }
+    }
+
+    rxBitpackWriteScalar(writer, values + i, count - i, bits);
+}
+
+/**
+ * As the SSE4.1 kernel on 8 values at a time, additionally merging the two
+ * 128 bit halves into a single field for widths up to 8 bits.
+ */
+__attribute__((target("avx2"))) static void rxBitpackWriteAVX2(
+      struct RxBitpackWriter *writer, const uint32_t *values, size_t count, uint32_t bits)
+{
+    const __m256i mask     = _mm256_set1_epi32((int)((1ull << bits) - 1));
+    const __m256i low      = _mm256_set1_epi64x(0xFFFFFFFF);
+    const __m128i shift    = _mm_cvtsi32_si128((int)bits);
+    const __m128i shift_x2 = _mm_cvtsi32_si128((int)bits * 2);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(values + i)), mask);
+        __m256i even  = _mm256_and_si256(x, low);
+        __m256i odd   = _mm256_srli_epi64(x, 32);
+        __m256i pairs = _mm256_or_si256(even, _mm256_sll_epi64(odd, shift));
+
+        if (bits <= 16)
+        {
+            __m256i quads = _mm256_or_si256(
+                  pairs, _mm256_sll_epi64(_mm256_srli_si256(pairs, 8), shift_x2));
+
+            uint64_t first  = (uint64_t)_mm256_extract_epi64(quads, 0);
+            uint64_t second = (uint64_t)_mm256_extract_epi64(quads, 2);
+
+            if (bits <= 8)
+            {
+                rxBitpackEmit(writer, first | second << (bits * 4), bits * 8);
+            }
+            else
+            {
+                rxBitpackEmit(writer, first, bits * 4);
+                rxBitpackEmit(writer, second, bits * 4);
+            }
+        }
+        else
+        {
+            rxBitpackEmit(writer, (uint64_t)_mm256_extract_epi64(pairs, 0), bits * 2);
+            rxBitpackEmit(writer, (uint64_t)_mm256_extract_epi64(pairs, 1), bits * 2);
+            rxBitpackEmit(writer, (uint64_t)_mm256_extract_epi64(pairs, 2), bits * 2);
+            rxBitpackEmit(writer, (uint64_t)_mm256_extract_epi64(pairs, 3), bits * 2);
+        }
+    }
+
+    rxBitpackWriteScalar(writer, values + i, count - i, bits);
+}
+
+/**
+ * Gathers 4 unaligned qwords at the byte offsets of 4 consecutive fields and
+ * shifts each field into place. Fields are at most 32 bits wide, so a field
+ * starting anywhere within a byte is always covered by the qword gathered.
+ */
+__attribute__((target("avx2"))) static void rxBitpackReadAVX2(
+      const uint64_t *body, size_t body_qwords, uint64_t offset, uint32_t *values, size_t count,
+      uint32_t bits)
+{
+    const long long *bytes = (const long long *)body;
+    const __m256i mask     = _mm256_set1_epi64x((long long)((1ull << bits) - 1));
+    const __m256i seven    = _mm256_set1_epi64x(7);
+    const __m256i compact  = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+    const __m128i step     = _mm_set1_epi32((int)bits * 4);
+
+    __m128i lanes   = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32((int)bits));
+    __m128i offsets = _mm_add_epi32(_mm_set1_epi32((int)offset), lanes);
+
+    // the last lane's qword load must stay inside the body
+    size_t body_bytes = body_qwords * 8;
+
+    size_t i = 0;
+    for (; i + 4 <= count && (offset + (i + 3) * bits) / 8 + 8 <= body_bytes; i += 4)
+    {
+        __m256i wide   = _mm256_cvtepu32_epi64(offsets);
+        __m128i index  = _mm_srli_epi32(offsets, 3);
+        __m256i loaded = _mm256_i32gather_epi64(bytes, index, 1);
+
+        __m256i fields = _mm256_and_si256(
+              _mm256_srlv_epi64(loaded, _mm256_and_si256(wide, seven)), mask);
+
+        __m256i packed = _mm256_permutevar8x32_epi32(fields, compact);
+        _mm_storeu_si128((__m128i *)(values + i), _mm256_castsi256_si128(packed));
+
+        offsets = _mm_add_epi32(offsets, step);
+    }
+
+    rxBitpackReadScalar(body, offset + i * bits, values + i, count - i, bits);
+}
+
+#endif
+
+static int rxBitpackSelected = -1;
+
+static enum RnBitpackKernel rxBitpackDetect()
+{
+#ifdef RN_BITPACK_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return RN_BITPACK_AVX2;
+    }
+
+    if (__builtin_cpu_supports("sse4.1"))
+    {
+        return RN_BITPACK_SSE41;
+    }
+#endif
+
+    return RN_BITPACK_SCALAR;
+}
+
+enum RnBitpackKernel rnBitpackKernel()
+{
+    int kernel = __atomic_load_n(&rxBitpackSelected, __ATOMIC_RELAXED);
+    if (kernel < 0)
+    {
+        kernel = rxBitpackDetect();
+        __atomic_store_n(&rxBitpackSelected, kernel, __ATOMIC_RELAXED);
+    }
+
+    return (enum RnBitpackKernel)kernel;
+}
+
+void rnBitpackSelectKernel(enum RnBitpackKernel kernel)
+{
+    if (kernel > rxBitpackDetect())
+    {
+        kernel = RN_BITPACK_SCALAR;
+    }
+
+    __atomic_store_n(&rxBitpackSelected, (int)kernel, __ATOMIC_RELAXED);
+}
+
+static bool rxBitpackFits(
+      size_t body_qwords, const RnPacketBufferCursor *cursor, size_t count, uint32_t bits)
+{
+    uint64_t begin = (uint64_t)cursor->qword * 64 + cursor->bit;
+    return bits > 0 && bits <= RN_BITPACK_BITS_MAX &&
+           begin + (uint64_t)count * bits <= (uint64_t)body_qwords * 64;
+}
+
+int rnBitpackWrite(
+      uint64_t *body, size_t body_qwords, RnPacketBufferCursor *cursor, const uint32_t *values,
+      size_t count, uint32_t bits)
+{
+    if (!rxBitpackFits(body_qwords, cursor, count, bits))
+    {
+        return RN_OOM;
+    }
+
+    struct RxBitpackWriter writer = {
+        .out  = body + cursor->qword,
+        .acc  = 0,
+        .fill = cursor->bit,
+    };
+
+    switch (rnBitpackKernel())
+    {
+#ifdef RN_BITPACK_X86
+        case RN_BITPACK_AVX2:
+        {
+            rxBitpackWriteAVX2(&writer, values, count, bits);
+            break;
+        }
+
+        case RN_BITPACK_SSE41:
+        {
+            rxBitpackWriteSSE41(&writer, values, count, bits);
+            break;
+        }
+#endif
+
+        default:
+        {
+            rxBitpackWriteScalar(&writer, values, count, bits);
+            break;
+        }
+    }
+
+    rxBitpackFinish(&writer);
+
+    cursor->qword = (uint_fast16_t)(writer.out - body);
+    cursor->bit   = (uint_fast8_t)writer.fill;
+    return RN_OK;
+}
+
+int rnBitpackRead(
+      const uint64_t *body, size_t body_qwords, RnPacketBufferCursor *cursor,
+      OUT uint32_t *values, size_t count, uint32_t bits)
+{
+    if (!rxBitpackFits(body_qwords, cursor, count, bits))
+    {
+        return RN_OOM;
+    }
+
+    uint64_t offset = (uint64_t)cursor->qword * 64 + cursor->bit;
+
+    switch (rnBitpackKernel())
+    {
+#ifdef RN_BITPACK_X86
+        // there is no SSE4.1 gather, the scalar reader is already branch-free
+        case RN_BITPACK_AVX2:
+        {
+            rxBitpackReadAVX2(body, body_qwords, offset, values, count, bits);
+            break;
+        }
+#endif
+
+        default:
+        {
+            rxBitpackReadScalar(body, offset, values, count, bits);
+            break;
+        }
+    }
+
+    offset += (uint64_t)count * bits;
+    cursor->qword = (uint_fast16_t)(offset / 64);
+    cursor->bit   = (uint_fast8_t)(offset % 64);
+    return RN_OK;
+}
@@ -0,0 +1,263 @@
+#include "../include/rnlib/capture.h"
+#include "../include/rnlib/clock.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Capture files start with an 8 byte header followed by a sequence of records,
+ * all fields in host byte order:
+ *
+ *   header  | magic "RNCP" (4) | version (2) | reserved (2) |
+ *   record  | timestamp (8) | data size (2) | direction (1) | family (1) |
+ *           | address (6 for IPv4, 18 for IPv6) | data (data size) |
+ */
+#define RN_CAPTURE_MAGIC       "RNCP"
+#define RN_CAPTURE_HEADER_SIZE 8
+#define RN_CAPTURE_RECORD_SIZE 12
+#define RN_CAPTURE_IPV4_SIZE   6
+#define RN_CAPTURE_IPV6_SIZE   18
+
+#define RN_CAPTURE_FILE_BUFFER 65536
+
+struct RnCapture
+{
+    FILE *file;
+    uint32_t flags;
+};
+
+struct RnCaptureReader
+{
+    FILE *file;
+};
+
+// stdio failures set errno on POSIX only, EIO stands in where it did not
+static int rxCaptureError(void)
+{
+    return errno != 0 ? errno : EIO;
+}
+
+int rnCaptureOpen(const char *path, uint32_t flags, OUT RnCapture **out)
+{
+    FILE *file = NULL;
+    if (path != NULL)
+    {
+        errno = 0;
+        file  = fopen(path, "ab");
+        if (file == NULL)
+        {
+            return rxCaptureError();
+        }
+
+        setvbuf(file, NULL, _IOFBF, RN_CAPTURE_FILE_BUFFER);
+
+        // new files get a header, appending to an existing capture continues it
+        long end = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+        if (end < 0)
+        {
+            int result = rxCaptureError();
+            fclose(file);
+            return result;
+        }
+
+        if (end == 0)
+        {
+            uint8_t header[RN_CAPTURE_HEADER_SIZE] = { 0 };
+            uint16_t version = RN_CAPTURE_VERSION;
+
+            memcpy(header, RN_CAPTURE_MAGIC, 4);
+            memcpy(header + 4, &version, sizeof version);
+            if (fwrite(header, 1, sizeof header, file) != sizeof header)
+            {
+                int result = rxCaptureError();
+                fclose(file);
+                return result;
+            }
+        }
+    }
+
+    *out = malloc(sizeof(RnCapture));
+    if (*out == NULL)
+    {
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+
+        return RN_OOM;
+    }
+
+    **out = (RnCapture) { .file = file, .flags = flags };
+    return RN_OK;
+}
+
+int rnCaptureClose(IN RnCapture *capture)
+{
+    int result = RN_OK;
+    errno      = 0;
+    if (capture->file != NULL && fclose(capture->file) != 0)
+    {
+        result = rxCaptureError();
+    }
+
+    free(capture);
+    return result;
+}
+
+uint32_t rnCaptureFlags(const RnCapture *capture)
+{
+    return capture->flags;
+}
+
+static int rxCaptureWrite(
+      RnCapture *capture, enum RnCaptureDirection direction, uint8_t family, const void *address,
+      size_t address_size, const uint8_t *data, size_t data_size)
+{
+    if (capture->file == NULL)
+    {
+        return RN_OK;
+    }
+
+    uint8_t record[RN_CAPTURE_RECORD_SIZE + RN_CAPTURE_IPV6_SIZE];
+    uint64_t timestamp = rnClockMonotonic();
+    uint16_t size      = (uint16_t)data_size;
+
+    memcpy(record, &timestamp, sizeof timestamp);
+    memcpy(record + 8, &size, sizeof size);
+    record[10] = (uint8_t)direction;
+    record[11] = family;
+    memcpy(record + RN_CAPTURE_RECORD_SIZE, address, address_size);
+
+    size_t record_size = RN_CAPTURE_RECORD_SIZE + address_size;
+    errno              = 0;
+    if (fwrite(record, 1, record_size, capture->file) != record_size ||
+        fwrite(data, 1, size, capture->file) != size)
+    {
+        return rxCaptureError();
+    }
+
+    return RN_OK;
+}
+
+int rnCaptureWriteIPv4(
+      RnCapture *capture, enum RnCaptureDirection direction, const RnAddressIPv4 *address,
+      const uint8_t *data, size_t data_size)
+{
+    uint8_t bytes[RN_CAPTURE_IPV4_SIZE];
+    memcpy(bytes, address->octets, 4);
+    memcpy(bytes + 4, &address->port, 2);
+
+    return rxCaptureWrite(capture, direction, 4, bytes, sizeof bytes, data, data_size);
+}
+
+int rnCaptureWriteIPv6(
+      RnCapture *capture, enum RnCaptureDirection direction, const RnAddressIPv6 *address,
+      const uint8_t *data, size_t data_size)
+{
+    uint8_t bytes[RN_CAPTURE_IPV6_SIZE];
+    memcpy(bytes, address->groups, 16);
+    memcpy(bytes + 16, &address->port, 2);
+
+    return rxCaptureWrite(capture, direction, 6, bytes, sizeof bytes, data, data_size);
+}
+
+int rnCaptureReaderOpen(const char *path, OUT RnCaptureReader **out)
+{
+    errno      = 0;
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return rxCaptureError();
+    }
+
+    uint8_t header[RN_CAPTURE_HEADER_SIZE];
+    uint16_t version;
+    if (fread(header, 1, sizeof header, file) != sizeof header)
+    {
+        int result = ferror(file) ? rxCaptureError() : EINVAL;
+        fclose(file);
+        return result;
+    }
+
+    memcpy(&version, header + 4, sizeof version);
+    if (memcmp(header, RN_CAPTURE_MAGIC, 4) != 0 || version != RN_CAPTURE_VERSION)
+    {
+        fclose(file);
+        return EINVAL;
+    }
+
+    setvbuf(file, NULL, _IOFBF, RN_CAPTURE_FILE_BUFFER);
+
+    *out = malloc(sizeof(RnCaptureReader));
+    if (*out == NULL)
+    {
+        fclose(file);
+        return RN_OOM;
+    }
+
+    **out = (RnCaptureReader) { .file = file };
+    return RN_OK;
+}
+
+int rnCaptureReaderClose(IN RnCaptureReader *reader)
+{
+    errno      = 0;
+    int result = fclose(reader->file) == 0 ? RN_OK : rxCaptureError();
+    free(reader);
+    return result;
+}
+
+int rnCaptureReaderNext(
+      RnCaptureReader *reader, OUT RnCaptureRecord *record, OUT uint8_t *data,
+      size_t data_capacity)
+{
+    uint8_t head[RN_CAPTURE_RECORD_SIZE];
+    if (fread(head, 1, sizeof head, reader->file) != sizeof head)
+    {
+        return RN_CAPTURE_END;
+    }
+
+    memcpy(&record->timestamp, head, 8);
+    memcpy(&record->data_size, head + 8, 2);
+    record->direction = (enum RnCaptureDirection)head[10];
+    record->family    = head[11];
+    if ((record->family != 4 && record->family != 6) || head[10] > RN_CAPTURE_SESSION)
+    {
+        return EINVAL;
+    }
+
+    uint8_t address[RN_CAPTURE_IPV6_SIZE];
+    size_t address_size = record->family == 4 ? RN_CAPTURE_IPV4_SIZE : RN_CAPTURE_IPV6_SIZE;
+    if (fread(address, 1, address_size, reader->file) != address_size)
+    {
+        return RN_CAPTURE_END;
+    }
+
+    if (record->family == 4)
+    {
+        memcpy(record->ipv4.octets, address, 4);
+        memcpy(&record->ipv4.port, address + 4, 2);
+    }
+    else
+    {
+        memcpy(record->ipv6.groups, address, 16);
+        memcpy(&record->ipv6.port, address + 16, 2);
+    }
+
+    // oversized datagrams are truncated to the caller's buffer and skipped past
+    size_t copy_size = record->data_size < data_capacity ? record->data_size : data_capacity;
+    if (fread(data, 1, copy_size, reader->file) != copy_size)
+    {
+        return RN_CAPTURE_END;
+    }
+
+    if (copy_size < record->data_size)
+    {
+        fseek(reader->file, (long)(record->data_size - copy_size), SEEK_CUR);
+        record->data_size = (uint16_t)copy_size;
+    }
+
+    return RN_OK;
+}
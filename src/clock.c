@@ -0,0 +1,182 @@
+#include "../include/rnlib/clock.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+uint64_t rnClockMonotonic()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t)(counter.QuadPart / frequency.QuadPart) * 1000000000ull +
+           (uint64_t)(counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
+
+void rnClockSyncInit(OUT RnClockSync *sync, uint64_t now)
+{
+    *sync = (RnClockSync) {
+        .next_at = now,
+    };
+}
+
+bool rnClockSyncDue(RnClockSync *sync, uint64_t now)
+{
+    if (now < sync->next_at)
+    {
+        return false;
+    }
+
+    sync->next_at = now + (sync->count < RN_CLOCK_BURST ? RN_CLOCK_BURST_NS : RN_CLOCK_INTERVAL_NS);
+    return true;
+}
+
+/**
+ * Least squares slope of the offsets of samples close to the best round trip,
+ * `drift` is left as is while they span less than an interval.
+ */
+static void rxClockSyncDrift(RnClockSync *sync, const RnClockSample *best, uint32_t count)
+{
+    double sum_x = 0, sum_y = 0;
+    uint32_t used = 0;
+    uint64_t first = UINT64_MAX, last = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const RnClockSample *sample = &sync->samples[i];
+        if (sample->rtt > best->rtt * 2)
+        {
+            continue;
+        }
+
+        sum_x += (double)(int64_t)(sample->at - best->at);
+        sum_y += (double)((int64_t)(sample->remote_at - sample->at) - sync->offset);
+        first = sample->at < first ? sample->at : first;
+        last  = sample->at > last ? sample->at : last;
+        ++used;
+    }
+
+    if (used < 2 || last - first < RN_CLOCK_INTERVAL_NS)
+    {
+        return;
+    }
+
+    double mean_x = sum_x / used, mean_y = sum_y / used;
+    double covariance = 0, variance = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const RnClockSample *sample = &sync->samples[i];
+        if (sample->rtt > best->rtt * 2)
+        {
+            continue;
+        }
+
+        double x = (double)(int64_t)(sample->at - best->at) - mean_x;
+        double y = (double)((int64_t)(sample->remote_at - sample->at) - sync->offset) - mean_y;
+        covariance += x * y;
+        variance   += x * x;
+    }
+
+    double drift = covariance / variance;
+    sync->drift  = drift > RN_CLOCK_DRIFT_MAX    ? RN_CLOCK_DRIFT_MAX
+                 : drift < -RN_CLOCK_DRIFT_MAX ? -RN_CLOCK_DRIFT_MAX
+                                               : drift;
+}
+
+void rnClockSyncSample(
+      RnClockSync *sync, uint64_t sent_at, uint64_t remote_at, const RnClockTicks *remote_ticks,
+      uint64_t now)
+{
+    if (now < sent_at || now - sent_at > RN_CLOCK_RTT_MAX_NS)
+    {
+        return;
+    }
+
+    uint64_t rtt = now - sent_at;
+    sync->samples[sync->count % RN_CLOCK_SAMPLES] = (RnClockSample) {
+        .at        = sent_at + rtt / 2,
+        .remote_at = remote_at,
+        .rtt       = rtt,
+    };
+
+    ++sync->count;
+    sync->remote_ticks = *remote_ticks;
+
+    uint32_t count            = sync->count < RN_CLOCK_SAMPLES ? sync->count : RN_CLOCK_SAMPLES;
+    const RnClockSample *best = &sync->samples[0];
+    for (uint32_t i = 1; i < count; ++i)
+    {
+        best = sync->samples[i].rtt < best->rtt ? &sync->samples[i] : best;
+    }
+
+    sync->synchronized = true;
+    sync->offset       = (int64_t)(best->remote_at - best->at);
+    sync->offset_at    = best->at;
+    sync->rtt          = best->rtt;
+    rxClockSyncDrift(sync, best, count);
+}
+
+uint64_t rnClockSyncRemote(const RnClockSync *sync, uint64_t local)
+{
+    if (!sync->synchronized)
+    {
+        return local;
+    }
+
+    int64_t elapsed = (int64_t)(local - sync->offset_at);
+    return local + (uint64_t)(sync->offset + (int64_t)(sync->drift * (double)elapsed));
+}
+
+uint64_t rnClockSyncLocal(const RnClockSync *sync, uint64_t remote)
+{
+    if (!sync->synchronized)
+    {
+        return remote;
+    }
+
+    int64_t elapsed = (int64_t)(remote - sync->offset_at - (uint64_t)sync->offset);
+    return sync->offset_at + (uint64_t)(int64_t)((double)elapsed / (1.0 + sync->drift));
+}
+
+uint64_t rnClockSyncTick(const RnClockSync *sync, uint64_t local)
+{
+    const RnClockTicks *ticks = &sync->remote_ticks;
+    uint64_t remote           = rnClockSyncRemote(sync, local);
+    if (!sync->synchronized || ticks->period == 0 || remote < ticks->origin)
+    {
+        return 0;
+    }
+
+    return (remote - ticks->origin) / ticks->period;
+}
+
+bool rnClockSyncTickTarget(
+      const RnClockSync *sync, uint64_t now, uint64_t margin, OUT uint64_t *tick,
+      OUT uint64_t *send_at)
+{
+    const RnClockTicks *ticks = &sync->remote_ticks;
+    if (!sync->synchronized || ticks->period == 0)
+    {
+        return false;
+    }
+
+    // input sent now reaches the peer half a round trip later
+    uint64_t arrival = rnClockSyncRemote(sync, now) + sync->rtt / 2 + margin;
+    *tick            = arrival <= ticks->origin
+                           ? 0
+                           : (arrival - ticks->origin + ticks->period - 1) / ticks->period;
+
+    uint64_t tick_at = ticks->origin + *tick * ticks->period;
+    *send_at         = rnClockSyncLocal(sync, tick_at - margin) - sync->rtt / 2;
+    *send_at         = *send_at < now ? now : *send_at;
+    return true;
+}
@@ -1,7 +1,17 @@
+#include "../include/rnlib/checksum.h"
+#include "../include/rnlib/clock.h"
 #include "../include/rnlib/connection.h"
+#include "../include/rnlib/fec.h"
 #include "../include/rnlib/handshake.h"
+#include "../include/rnlib/metrics.h"
+#include "../include/rnlib/pmtu.h"
+#include "../include/rnlib/poly1305.h"
+#include "../include/rnlib/schema.h"
+#include "../include/rnlib/snapshot.h"
 
-#include <time.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef _WIN32
     #define SODIUM_STATIC 1
@@ -25,12 +35,15 @@ union RnPacketSequence
      * sequence number and generation to create an incrementing sequence
      * sufficiently large for most use cases.
      *
-     * Technically, this limits a secure session to 2^32 - 1 packets each
-     * way before their cryptographic integrity breaks.
+     * Nonces only ever repeat after 2^32 - 1 packets, secure sessions move on
+     * to a fresh key epoch long before that, see RnSessionKeys.
      */
     uint32_t nonce;
 };
 
+typedef union RnPacketSequence RnPacketSequence;
+typedef struct RnPacketSequenceCounter RnPacketSequenceCounter;
+
 /**
  * Increments counter by 1 and increments its generation if this number has
  * reached its maximum value.
@@ -39,7 +52,7 @@ RnPacketSequenceCounter rnPacketSequenceIncrement(RnPacketSequenceCounter counte
 {
     ++counter.number;
 
-    uint16_t overflow_mask = -uint16_t(counter.number == UINT16_MAX);
+    uint16_t overflow_mask = (uint16_t)-(counter.number == UINT16_MAX);
 
     // increment generation on overflow, increment by 0 otherwise
     counter.generation += overflow_mask & 1;
@@ -52,71 +65,168 @@ RnPacketSequenceCounter rnPacketSequenceIncrement(RnPacketSequenceCounter counte
 
 /**
  * Attempts to advance `counter` to `number`, returning a 0 counter if `number`
- * is too out-of-sync with `counter`.
+ * is too out-of-sync with `counter` or repeats it.
  */
 RnPacketSequenceCounter rnPacketSequenceAdvance(RnPacketSequenceCounter counter, uint16_t number)
 {
-    if (number >= counter.number)
+    if (number > counter.number)
     {
         if (number - counter.number < 1024)
         {
-            return PacketSequenceCounter { counter.generation, number };
+            return (RnPacketSequenceCounter){ counter.generation, number };
         }
     }
 
     if (counter.number - number > 32768)
     {
-        return PacketSequenceCounter { counter.generation + 1, number };
+        return (RnPacketSequenceCounter){ (uint16_t)(counter.generation + 1), number };
     }
 
-    return RnPacketSequenceCounter { 0, 0 };
+    return (RnPacketSequenceCounter){ 0, 0 };
 }
 
-struct RnConnectionStreamSecure
+/**
+ * Counts the outcome of reading a packet into the connection's and the global
+ * metrics.
+ */
+static void rxConnectionCountRead(
+      RnMetricsCounters *metrics, enum RnConnectionReadResult result, size_t bytes)
 {
-    RnKeyBuffer key;           // 32
-    RnPacketSequence sequence; // 4
-    uint8_t idle_since;        // 1
+    switch (result)
+    {
+        case RN_CONNECTION_READ_AVAILABLE:
+        case RN_CONNECTION_READ_HANDSHAKE:
+        case RN_CONNECTION_READ_PROBE:
+        case RN_CONNECTION_READ_MIGRATED:
+        case RN_CONNECTION_READ_PARITY:
+        {
+            rnMetricsCountConnection(metrics, RN_METRICS_PACKETS_IN, 1);
+            rnMetricsCountConnection(metrics, RN_METRICS_BYTES_IN, bytes);
+            break;
+        }
 
-    RnAddressIPv4 address; // 6
-};
+        case RN_CONNECTION_READ_ERROR_SEQUENCE:
+        {
+            rnMetricsCountConnection(metrics, RN_METRICS_DROPS_SEQUENCE, 1);
+            break;
+        }
 
-struct RnConnectionAuthenticatedIngress
-{
-    RnKeyBuffer key;           // 32
-    RnPacketSequence sequence; // 4
-};
+        case RN_CONNECTION_READ_ERROR_CONTEXT:
+        {
+            rnMetricsCountConnection(metrics, RN_METRICS_DROPS_CONTEXT, 1);
+            break;
+        }
+
+        case RN_CONNECTION_READ_ERROR_VERIFY:
+        {
+            rnMetricsCountConnection(metrics, RN_METRICS_DROPS_VERIFY, 1);
+            break;
+        }
 
-struct RnConnectionAuthenticated
+        case RN_CONNECTION_READ_EMPTY:
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * Counts a handshake step transition, or a retransmit if a handshake packet
+ * was written without the step advancing.
+ */
+static void rxConnectionCountHandshake(
+      RnMetricsCounters *metrics, enum RnHandshakeStep before, enum RnHandshakeStep after)
 {
-    RnAddressIPv4 address;
-    RnKeyPair keys;
-    RnHandshakeIPv4 handshake;
+    if (before == after)
+    {
+        rnMetricsCountConnection(metrics, RN_METRICS_RETRANSMITS, 1);
+        return;
+    }
 
-    RnPacketSequence sequence_egress;
-    RnPacketSequence sequence_ingress;
-};
+    rnMetricsCountConnection(metrics, RN_METRICS_HANDSHAKE_DISCONNECTED + after, 1);
+}
+
+#define RN_CONNECTION_LAYOUT(STRUCT, FIELD)                                                        \
+    offsetof(STRUCT, FIELD), sizeof(((STRUCT *)0)->FIELD)
 
-struct RnConnectionPoolAuthenticated
+/**
+ * FNV-1a over the offset and size of every connection field, so that snapshot
+ * records are refused by builds that moved, resized, added or removed any.
+ */
+static uint32_t rxConnectionLayout(const size_t *layout, size_t size)
 {
-    RnSocketIPv4 socket;
+    const uint8_t *bytes = (const uint8_t *)layout;
+    uint32_t hash        = 2166136261u ^ RN_SNAPSHOT_VERSION;
 
-    RnHandshakeIPv4 handshake[UINT16_MAX];
-    RnConnectionAuthenticatedEgress egress[UINT16_MAX];
-    RnConnectionAuthenticatedIngress ingress[UINT16_MAX];
-};
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
 
 #define RN_CONNECTION_SECURE_IMPL(TYPE, IP)                                                        \
     struct RnConnection##TYPE##IP                                                                  \
     {                                                                                              \
-        RnSocket##IP socket;                                                                       \
+        RnSocket##IP *socket;                                                                      \
         RnAddress##IP address;                                                                     \
+        enum RnConnectionRole role;                                                                \
         RnHandshakeSecure handshake;                                                               \
         RnPacketSequence incoming;                                                                 \
         RnPacketSequence outgoing;                                                                 \
+        RnMetricsCounters metrics;                                                                 \
+        RnPmtu pmtu;                                                                               \
+                                                                                                   \
+        /* address under challenge, see rnConnectionValidatePath */                                \
+        RnAddress##IP path_address;                                                                \
+        uint64_t path_token;                                                                       \
+        uint64_t path_sent_at;                                                                     \
+                                                                                                   \
+        /* parity groups of protected packet types, see rnConnectionConfigureFec */                \
+        RnFec *fec;                                                                                \
+                                                                                                   \
+        /* models of entropy coded packet types, see rnConnectionConfigureEntropy */               \
+        RnEntropyConfig entropy;                                                                   \
+                                                                                                   \
+        /* estimate of the peer's clock, see rnConnectionSyncClock */                              \
+        RnClockSync clock;                                                                         \
+                                                                                                   \
+        /* start of the handshake, see RN_METRICS_LATENCY_HANDSHAKE */                             \
+        uint64_t opened_at;                                                                        \
                                                                                                    \
         RnSessionKeys keys;                                                                        \
-    };
+        RnPacketSequence incoming_previous;                                                        \
+                                                                                                   \
+        /* packets written with the egress key, nonces restart with every epoch */                 \
+        uint32_t egress_count;                                                                     \
+    };                                                                                             \
+                                                                                                   \
+    uint32_t rnConnectionSnapshotLayout##TYPE##IP(void)                                            \
+    {                                                                                              \
+        const size_t layout[] = {                                                                  \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, socket),                                  \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, address),                                 \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, role),                                    \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, handshake),                               \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, incoming),                                \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, outgoing),                                \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, metrics),                                 \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, pmtu),                                    \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, path_address),                            \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, path_token),                              \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, path_sent_at),                            \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, fec),                                     \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, entropy),                                 \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, clock),                                   \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, opened_at),                               \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, keys),                                    \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, incoming_previous),                       \
+            RN_CONNECTION_LAYOUT(RnConnection##TYPE##IP, egress_count),                            \
+        };                                                                                         \
+                                                                                                   \
+        return rxConnectionLayout(layout, sizeof layout);                                          \
+    }
 
 RN_CONNECTION_SECURE_IMPL(Authenticated, IPv4)
 RN_CONNECTION_SECURE_IMPL(Authenticated, IPv6)
@@ -127,171 +237,1402 @@ RN_CONNECTION_SECURE_IMPL(Encrypted, IPv6)
 #define RN_CONNECTION_INSECURE_IMPL(IP)                                                            \
     struct RnConnectionInsecure##IP                                                                \
     {                                                                                              \
-        RnSocket##IP socket;                                                                       \
+        RnSocket##IP *socket;                                                                      \
         RnAddress##IP address;                                                                     \
+        enum RnConnectionRole role;                                                                \
         RnHandshakeInsecure handshake;                                                             \
         RnPacketSequence incoming;                                                                 \
         RnPacketSequence outgoing;                                                                 \
-    };
+        RnMetricsCounters metrics;                                                                 \
+        RnPmtu pmtu;                                                                               \
+                                                                                                   \
+        /* address under challenge, see rnConnectionValidatePath */                                \
+        RnAddress##IP path_address;                                                                \
+        uint64_t path_token;                                                                       \
+        uint64_t path_sent_at;                                                                     \
+                                                                                                   \
+        /* parity groups of protected packet types, see rnConnectionConfigureFec */                \
+        RnFec *fec;                                                                                \
+                                                                                                   \
+        /* models of entropy coded packet types, see rnConnectionConfigureEntropy */               \
+        RnEntropyConfig entropy;                                                                   \
+                                                                                                   \
+        /* estimate of the peer's clock, see rnConnectionSyncClock */                              \
+        RnClockSync clock;                                                                         \
+                                                                                                   \
+        /* start of the handshake, see RN_METRICS_LATENCY_HANDSHAKE */                             \
+        uint64_t opened_at;                                                                        \
+                                                                                                   \
+        /* checksum outgoing packets, see rnConnectionSetIntegrity */                              \
+        bool integrity;                                                                            \
+    };                                                                                             \
+                                                                                                   \
+    uint32_t rnConnectionSnapshotLayout##Insecure##IP(void)                                        \
+    {                                                                                              \
+        const size_t layout[] = {                                                                  \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, socket),                              \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, address),                             \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, role),                                \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, handshake),                           \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, incoming),                            \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, outgoing),                            \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, metrics),                             \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, pmtu),                                \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, path_address),                        \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, path_token),                          \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, path_sent_at),                        \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, fec),                                 \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, entropy),                             \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, clock),                               \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, opened_at),                           \
+            RN_CONNECTION_LAYOUT(RnConnection##Insecure##IP, integrity),                           \
+        };                                                                                         \
+                                                                                                   \
+        return rxConnectionLayout(layout, sizeof layout);                                          \
+    }
 
 RN_CONNECTION_INSECURE_IMPL(IPv4)
 RN_CONNECTION_INSECURE_IMPL(IPv6)
 
-#define RN_CONNECTION_IMPL(TYPE, IP, BUFFER)                                                       \
-    enum RnReadPacketResult rnConnectionReadPacket(                                                \
-          RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer)                      \
+#define RN_CONNECTION_OPEN_SECURE_IMPL(TYPE, IP)                                                   \
+    int rnConnectionOpen##TYPE##IP(                                                                \
+          RnSocket##IP *socket, const RnAddress##IP *address, enum RnConnectionRole role,          \
+          OUT RnConnection##TYPE##IP **out)                                                        \
     {                                                                                              \
-        RnPacketSequence sequence = rnPacketSequenceAdvance(                                       \
-              connection->incoming, buffer->header.sequence);                                      \
-        if (sequence.nonce == 0)                                                                   \
+        RnKeyPair keys;                                                                            \
+        int key_result = rnKeyPairGenerateEphemeral(&keys);                                        \
+        if (key_result != RN_OK)                                                                   \
         {                                                                                          \
-            return RN_CONNECTION_READ_ERROR_SEQUENCE;                                              \
+            return key_result;                                                                     \
+        }                                                                                          \
+                                                                                                   \
+        *out = malloc(sizeof(RnConnection##TYPE##IP));                                             \
+        if (*out == NULL)                                                                          \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        **out = (RnConnection##TYPE##IP) {                                                         \
+            .socket    = socket,                                                                   \
+            .address   = *address,                                                                 \
+            .role      = role,                                                                     \
+            .handshake = rnHandshakeCreateSecure(&keys),                                           \
+            .opened_at = rnClockMonotonic(),                                                       \
+        };                                                                                         \
+                                                                                                   \
+        rnPmtuInit(                                                                                \
+              &(*out)->pmtu, RN_PACKET_BYTES_BASE, RN_PACKET_WIRE_MAX_SECURE, rnClockMonotonic()); \
+        rnClockSyncInit(&(*out)->clock, rnClockMonotonic());                                       \
+                                                                                                   \
+        sodium_memzero(&keys, sizeof keys);                                                        \
+        return RN_OK;                                                                              \
+    }
+
+RN_CONNECTION_OPEN_SECURE_IMPL(Authenticated, IPv4)
+RN_CONNECTION_OPEN_SECURE_IMPL(Authenticated, IPv6)
+
+RN_CONNECTION_OPEN_SECURE_IMPL(Encrypted, IPv4)
+RN_CONNECTION_OPEN_SECURE_IMPL(Encrypted, IPv6)
+
+#define RN_CONNECTION_OPEN_INSECURE_IMPL(IP)                                                       \
+    int rnConnectionOpenInsecure##IP(                                                              \
+          RnSocket##IP *socket, const RnAddress##IP *address, enum RnConnectionRole role,          \
+          OUT RnConnectionInsecure##IP **out)                                                      \
+    {                                                                                              \
+        uint64_t salt;                                                                             \
+        randombytes_buf(&salt, sizeof salt);                                                       \
+                                                                                                   \
+        *out = malloc(sizeof(RnConnectionInsecure##IP));                                           \
+        if (*out == NULL)                                                                          \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        **out = (RnConnectionInsecure##IP) {                                                       \
+            .socket    = socket,                                                                   \
+            .address   = *address,                                                                 \
+            .role      = role,                                                                     \
+            .handshake = rnHandshakeCreateInsecure(salt),                                          \
+            .opened_at = rnClockMonotonic(),                                                       \
+        };                                                                                         \
+                                                                                                   \
+        rnPmtuInit(                                                                                \
+              &(*out)->pmtu, RN_PACKET_BYTES_BASE, RN_PACKET_WIRE_MAX_INSECURE,                    \
+              rnClockMonotonic());                                                                 \
+        rnClockSyncInit(&(*out)->clock, rnClockMonotonic());                                       \
+                                                                                                   \
+        return RN_OK;                                                                              \
+    }
+
+RN_CONNECTION_OPEN_INSECURE_IMPL(IPv4)
+RN_CONNECTION_OPEN_INSECURE_IMPL(IPv6)
+
+#define RN_CONNECTION_LIFETIME_IMPL(TYPE, IP)                                                      \
+    int rnConnectionClose##TYPE##IP(IN RnConnection##TYPE##IP *connection)                         \
+    {                                                                                              \
+        rnFecClose(connection->fec);                                                               \
+        sodium_memzero(connection, sizeof *connection);                                            \
+        free(connection);                                                                          \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    enum RnHandshakeStep rnConnectionHandshakeStep##TYPE##IP(                                      \
+          const RnConnection##TYPE##IP *connection)                                                \
+    {                                                                                              \
+        return connection->handshake.step;                                                         \
+    }                                                                                              \
+                                                                                                   \
+    void rnConnectionMetrics##TYPE##IP(                                                            \
+          const RnConnection##TYPE##IP *connection, OUT RnMetricsCounters *out)                    \
+    {                                                                                              \
+        for (int i = 0; i < RN_METRICS_COUNTER_COUNT; ++i)                                         \
+        {                                                                                          \
+            out->values[i] = __atomic_load_n(&connection->metrics.values[i], __ATOMIC_RELAXED);    \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    size_t rnConnectionSnapshotSize##TYPE##IP(void)                                                \
+    {                                                                                              \
+        return sizeof(RnConnection##TYPE##IP);                                                     \
+    }                                                                                              \
+                                                                                                   \
+    /* deadlines are on rnClockMonotonic, which runs on across processes of the same host */       \
+    void rnConnectionSave##TYPE##IP(const RnConnection##TYPE##IP *connection, OUT void *record)    \
+    {                                                                                              \
+        RnConnection##TYPE##IP copy = *connection;                                                 \
+        copy.socket                 = NULL;                                                        \
+        copy.fec                    = NULL;                                                        \
+        memset(&copy.entropy, 0, sizeof copy.entropy);                                             \
+                                                                                                   \
+        memcpy(record, &copy, sizeof copy);                                                        \
+        sodium_memzero(&copy, sizeof copy);                                                        \
+    }                                                                                              \
+                                                                                                   \
+    int rnConnectionRestore##TYPE##IP(                                                             \
+          RnSocket##IP *socket, const void *record, OUT RnConnection##TYPE##IP **out)              \
+    {                                                                                              \
+        *out = malloc(sizeof(RnConnection##TYPE##IP));                                             \
+        if (*out == NULL)                                                                          \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        memcpy(*out, record, sizeof **out);                                                        \
+        (*out)->socket = socket;                                                                   \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    /* runs wherever the handshake may complete, acting only once it just did */                   \
+    static void rxConnectionConnected##TYPE##IP(                                                   \
+          const RnConnection##TYPE##IP *connection, enum RnHandshakeStep before)                   \
+    {                                                                                              \
+        if (before == RN_HANDSHAKE_CONNECTED ||                                                    \
+            connection->handshake.step != RN_HANDSHAKE_CONNECTED)                                  \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        rnMetricsRecordLatency(                                                                    \
+              RN_METRICS_LATENCY_HANDSHAKE, rnClockMonotonic() - connection->opened_at);           \
+                                                                                                   \
+        /* session records let replays of the capture verify what follows the handshake */         \
+        RnCapture *capture = rnSocketCapture(connection->socket);                                  \
+        if (capture == NULL || !(rnCaptureFlags(capture) & RN_CAPTURE_SESSIONS))                   \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        uint8_t record[sizeof(uint32_t) + sizeof(RnConnection##TYPE##IP)];                         \
+        uint32_t layout = rnConnectionSnapshotLayout##TYPE##IP();                                  \
+        memcpy(record, &layout, sizeof layout);                                                    \
+        rnConnectionSave(connection, record + sizeof layout);                                      \
+                                                                                                   \
+        rnCaptureWrite(                                                                            \
+              capture, RN_CAPTURE_SESSION, &connection->address, record, sizeof record);           \
+        sodium_memzero(record, sizeof record);                                                     \
+    }
+
+
+RN_CONNECTION_LIFETIME_IMPL(Authenticated, IPv4)
+RN_CONNECTION_LIFETIME_IMPL(Authenticated, IPv6)
+
+RN_CONNECTION_LIFETIME_IMPL(Encrypted, IPv4)
+RN_CONNECTION_LIFETIME_IMPL(Encrypted, IPv6)
+
+RN_CONNECTION_LIFETIME_IMPL(Insecure, IPv4)
+RN_CONNECTION_LIFETIME_IMPL(Insecure, IPv6)
+
+#define RN_CONNECTION_HANDSHAKE_IMPL(TYPE, IP, BUFFER)                                             \
+    void rnConnectionEstablishHandshake##TYPE##IP(RnConnection##TYPE##IP *connection)              \
+    {                                                                                              \
+        RnPacketBuffer##BUFFER buffer;                                                             \
+        enum RnHandshakeStep step = connection->handshake.step;                                    \
+        bool write_result = connection->role == RN_CONNECTION_CLIENT                               \
+                                  ? rnHandshakeWritePacketClient(&connection->handshake, &buffer)  \
+                                  : rnHandshakeWritePacketServer(&connection->handshake, &buffer); \
+        if (write_result)                                                                          \
+        {                                                                                          \
+            rxConnectionCountHandshake(&connection->metrics, step, connection->handshake.step);    \
+            rxConnectionConnected##TYPE##IP(connection, step);                                     \
+            rnMetricsCountConnection(&connection->metrics, RN_METRICS_PACKETS_OUT, 1);             \
+            rnMetricsCountConnection(                                                              \
+                  &connection->metrics, RN_METRICS_BYTES_OUT, rnPacketBufferWireSize(&buffer));    \
+                                                                                                   \
+            rnSocketSendData(                                                                      \
+                  connection->socket, &connection->address, rnPacketBufferWireData(&buffer),       \
+                  rnPacketBufferWireSize(&buffer));                                                \
+        }                                                                                          \
+    }
+
+RN_CONNECTION_HANDSHAKE_IMPL(Authenticated, IPv4, Secure)
+RN_CONNECTION_HANDSHAKE_IMPL(Authenticated, IPv6, Secure)
+
+RN_CONNECTION_HANDSHAKE_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_HANDSHAKE_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_HANDSHAKE_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_HANDSHAKE_IMPL(Insecure, IPv6, Insecure)
+
+/**
+ * Key epochs of secure connections, see RnSessionKeys. Every epoch restarts
+ * the sequence, packets of the previous epoch are checked against its final
+ * sequence during the overlap.
+ */
+#define RN_CONNECTION_EPOCH_SECURE_IMPL(TYPE, IP)                                                  \
+    static const RnKeyBuffer *rxConnectionIngressEpoch##TYPE##IP(                                  \
+          RnConnection##TYPE##IP *connection, const RnPacketBufferSecure *buffer,                  \
+          OUT enum RnSessionEpoch *epoch, OUT RnPacketSequence *incoming)                          \
+    {                                                                                              \
+        const RnKeyBuffer *key = rnSessionKeysIngressSelect(                                       \
+              &connection->keys, buffer->head.protocol, rnClockMonotonic(), epoch);                \
+                                                                                                   \
+        switch (*epoch)                                                                            \
+        {                                                                                          \
+            case RN_SESSION_EPOCH_CURRENT:                                                         \
+            {                                                                                      \
+                *incoming = connection->incoming;                                                  \
+                break;                                                                             \
+            }                                                                                      \
+                                                                                                   \
+            case RN_SESSION_EPOCH_PREVIOUS:                                                        \
+            {                                                                                      \
+                *incoming = connection->incoming_previous;                                         \
+                break;                                                                             \
+            }                                                                                      \
+                                                                                                   \
+            case RN_SESSION_EPOCH_NEXT:                                                            \
+            {                                                                                      \
+                *incoming = (RnPacketSequence) { .nonce = 0 };                                     \
+                break;                                                                             \
+            }                                                                                      \
         }                                                                                          \
                                                                                                    \
-        int read_result = rnConnectionReadPacket##TYPE(connection, buffer);                        \
-        if (read_result == RN_CONNECTION_READ_AVAILABLE)                                           \
+        return key;                                                                                \
+    }                                                                                              \
+                                                                                                   \
+    static void rxConnectionIngressAccept##TYPE##IP(                                               \
+          RnConnection##TYPE##IP *connection, const RnPacketBufferSecure *buffer,                  \
+          enum RnSessionEpoch epoch, RnPacketSequence sequence)                                    \
+    {                                                                                              \
+        (void)buffer;                                                                              \
+                                                                                                   \
+        switch (epoch)                                                                             \
         {                                                                                          \
-            connection->incoming = sequence;                                                       \
-            connection->idle_since = time(0) % UINT8_MAX;                                          \
+            case RN_SESSION_EPOCH_CURRENT:                                                         \
+            {                                                                                      \
+                connection->incoming = sequence;                                                   \
+                break;                                                                             \
+            }                                                                                      \
+                                                                                                   \
+            case RN_SESSION_EPOCH_PREVIOUS:                                                        \
+            {                                                                                      \
+                connection->incoming_previous = sequence;                                          \
+                break;                                                                             \
+            }                                                                                      \
                                                                                                    \
-            int handshake_status = rnHandshakeReadPacket(packet);                                  \
-            if (handshake_status != RN_HANDSHAKE_STEP_SERVER_CONNECTED)                            \
+            case RN_SESSION_EPOCH_NEXT:                                                            \
             {                                                                                      \
-                return RN_CONNECTION_READ_IGNORE;                                                  \
+                rnSessionKeysIngressAdvance(&connection->keys, rnClockMonotonic());                \
+                connection->incoming_previous = connection->incoming;                              \
+                connection->incoming          = sequence;                                          \
+                break;                                                                             \
             }                                                                                      \
         }                                                                                          \
+    }                                                                                              \
                                                                                                    \
-        return read_result;                                                                        \
+    /* whether the sequence window of the packet's epoch is `incoming`, see rnConnectionScreen */  \
+    static bool rxConnectionIngressCurrent##TYPE##IP(                                              \
+          const RnConnection##TYPE##IP *connection, const RnPacketBufferSecure *buffer)            \
+    {                                                                                              \
+        return (buffer->head.protocol & RN_PACKET_PROTOCOL_KEY_PHASE) ==                           \
+               rnSessionKeysIngressPhase(&connection->keys);                                       \
     }                                                                                              \
                                                                                                    \
-    enum RnConnectionWriteResult rnConnectionWritePacket(                                          \
-          RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer)                      \
+    static int rxConnectionEgressEpoch##TYPE##IP(                                                  \
+          RnConnection##TYPE##IP *connection, RnPacketBufferSecure *buffer,                        \
+          OUT const RnKeyBuffer **key)                                                             \
     {                                                                                              \
-        RnPacketSequence next_sequence = rnPacketBufferSequenceIncrement(sequence);                \
-        int write_result = writer.WritePacket(handshake, sequence, packet);                        \
-        if (write_result == RN_OK)                                                                 \
+        /* the next key is ready, switching costs no more than a copy */                           \
+        if (connection->egress_count >= RN_SESSION_EPOCH_NONCES)                                   \
         {                                                                                          \
-            sequence = next_sequence;                                                              \
-            idle_since = time(0) % UINT8_MAX;                                                      \
-            \                                                                                      \
+            int advance_result = rnSessionKeysEgressAdvance(&connection->keys);                    \
+            if (advance_result != RN_OK)                                                           \
+            {                                                                                      \
+                return advance_result;                                                             \
+            }                                                                                      \
+                                                                                                   \
+            connection->outgoing.nonce = 0;                                                        \
+            connection->egress_count   = 0;                                                        \
         }                                                                                          \
                                                                                                    \
-        return write_result;                                                                       \
+        buffer->head.protocol &= (uint16_t)~RN_PACKET_PROTOCOL_KEY_PHASE;                          \
+        buffer->head.protocol |= rnSessionKeysEgressPhase(&connection->keys);                      \
+                                                                                                   \
+        *key = &connection->keys.egress.key;                                                       \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static void rxConnectionEgressCount##TYPE##IP(RnConnection##TYPE##IP *connection)              \
+    {                                                                                              \
+        ++connection->egress_count;                                                                \
     }
 
-RN_CONNECTION_IMPL(Authenticated, IPv4, Secure)
-RN_CONNECTION_IMPL(Authenticated, IPv6, Secure)
+RN_CONNECTION_EPOCH_SECURE_IMPL(Authenticated, IPv4)
+RN_CONNECTION_EPOCH_SECURE_IMPL(Authenticated, IPv6)
 
-RN_CONNECTION_IMPL(Encrypted, IPv4, Secure)
-RN_CONNECTION_IMPL(Encrypted, IPv6, Secure)
+RN_CONNECTION_EPOCH_SECURE_IMPL(Encrypted, IPv4)
+RN_CONNECTION_EPOCH_SECURE_IMPL(Encrypted, IPv6)
 
-RN_CONNECTION_IMPL(Insecure, IPv4, Insecure)
-RN_CONNECTION_IMPL(Insecure, IPv6, Insecure)
+// insecure connections renegotiate their salt instead and have a single epoch
+#define RN_CONNECTION_EPOCH_INSECURE_IMPL(IP)                                                      \
+    static const RnKeyBuffer *rxConnectionIngressEpochInsecure##IP(                                \
+          RnConnectionInsecure##IP *connection, const RnPacketBufferInsecure *buffer,              \
+          OUT enum RnSessionEpoch *epoch, OUT RnPacketSequence *incoming)                          \
+    {                                                                                              \
+        (void)buffer;                                                                              \
+                                                                                                   \
+        *epoch    = RN_SESSION_EPOCH_CURRENT;                                                      \
+        *incoming = connection->incoming;                                                          \
+        return NULL;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static void rxConnectionIngressAcceptInsecure##IP(                                             \
+          RnConnectionInsecure##IP *connection, const RnPacketBufferInsecure *buffer,              \
+          enum RnSessionEpoch epoch, RnPacketSequence sequence)                                    \
+    {                                                                                              \
+        (void)epoch;                                                                               \
+                                                                                                   \
+        connection->incoming = sequence;                                                           \
+                                                                                                   \
+        /* a peer checksumming its packets gets checksummed ones back */                           \
+        if (buffer->head.protocol & RN_PACKET_PROTOCOL_CHECKSUM)                                   \
+        {                                                                                          \
+            connection->integrity = true;                                                          \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static bool rxConnectionIngressCurrentInsecure##IP(                                            \
+          const RnConnectionInsecure##IP *connection, const RnPacketBufferInsecure *buffer)        \
+    {                                                                                              \
+        (void)connection;                                                                          \
+        (void)buffer;                                                                              \
+                                                                                                   \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static int rxConnectionEgressEpochInsecure##IP(                                                \
+          RnConnectionInsecure##IP *connection, RnPacketBufferInsecure *buffer,                    \
+          OUT const RnKeyBuffer **key)                                                             \
+    {                                                                                              \
+        buffer->head.protocol &= (uint16_t)~RN_PACKET_PROTOCOL_CHECKSUM;                           \
+        if (connection->integrity)                                                                 \
+        {                                                                                          \
+            buffer->head.protocol |= RN_PACKET_PROTOCOL_CHECKSUM;                                  \
+        }                                                                                          \
+                                                                                                   \
+        *key = NULL;                                                                               \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static void rxConnectionEgressCountInsecure##IP(RnConnectionInsecure##IP *connection)          \
+    {                                                                                              \
+        (void)connection;                                                                          \
+    }
+
+RN_CONNECTION_EPOCH_INSECURE_IMPL(IPv4)
+RN_CONNECTION_EPOCH_INSECURE_IMPL(IPv6)
 
-enum RnConnectionReadResult rxConnectionPreProcessIngressAuthenticated(
-      const RnPacketBufferSecure *buffer, RnPacketBufferMetaData meta, const RnKeyBuffer *master,
-      uint64_t context, uint64_t nonce)
+/**
+ * Secure packets carry the connection id in the clear ahead of their tag, a
+ * forged id at most routes a datagram to a session that fails to verify it.
+ * Both sides already agreed on the handshake context, its low half serves as
+ * the id without any further exchange.
+ */
+#define RN_CONNECTION_ID_SECURE_IMPL(TYPE, IP)                                                     \
+    uint32_t rnConnectionId##TYPE##IP(const RnConnection##TYPE##IP *connection)                    \
+    {                                                                                              \
+        if (connection->handshake.step != RN_HANDSHAKE_CONNECTED)                                  \
+        {                                                                                          \
+            return 0;                                                                              \
+        }                                                                                          \
+                                                                                                   \
+        return (uint32_t)connection->handshake.context;                                            \
+    }
+
+RN_CONNECTION_ID_SECURE_IMPL(Authenticated, IPv4)
+RN_CONNECTION_ID_SECURE_IMPL(Authenticated, IPv6)
+
+RN_CONNECTION_ID_SECURE_IMPL(Encrypted, IPv4)
+RN_CONNECTION_ID_SECURE_IMPL(Encrypted, IPv6)
+
+// insecure datagrams have no room for the id and could not prove a new path anyway
+#define RN_CONNECTION_ID_INSECURE_IMPL(IP)                                                         \
+    uint32_t rnConnectionIdInsecure##IP(const RnConnectionInsecure##IP *connection)                \
+    {                                                                                              \
+        (void)connection;                                                                          \
+                                                                                                   \
+        return 0;                                                                                  \
+    }
+
+RN_CONNECTION_ID_INSECURE_IMPL(IPv4)
+RN_CONNECTION_ID_INSECURE_IMPL(IPv6)
+
+#define RN_CONNECTION_INTEGRITY_IMPL(IP)                                                           \
+    void rnConnectionSetIntegrity##IP(RnConnectionInsecure##IP *connection, bool enabled)          \
+    {                                                                                              \
+        connection->integrity = enabled;                                                           \
+    }
+
+RN_CONNECTION_INTEGRITY_IMPL(IPv4)
+RN_CONNECTION_INTEGRITY_IMPL(IPv6)
+
+/**
+ * Single-use Poly1305 key of the authenticated packet with `nonce`.
+ */
+static int rxConnectionPacketKey(
+      OUT RnKeyBuffer *out, const RnKeyBuffer *master, uint64_t context, uint64_t nonce)
+{
+    return crypto_kdf_derive_from_key(*out, sizeof *out, nonce, (const char *)&context, *master);
+}
+
+/**
+ * Authenticated packets are tagged over their header and body with the
+ * single-use key of their nonce, the body stays in the clear.
+ */
+static enum RnConnectionReadResult rxConnectionIngressAuthenticated(
+      const RnPacketBufferSecure *buffer, const RnKeyBuffer *master, uint64_t context,
+      uint32_t nonce)
 {
     RnKeyBuffer key;
-    int key_result = crypto_kdf_derive_from_key(key, sizeof key, nonce, context, master);
-    if (key_result != RN_OK)
+    if (rxConnectionPacketKey(&key, master, context, nonce) != RN_OK)
     {
         return RN_CONNECTION_READ_ERROR_CONTEXT;
     }
 
-    size_t data_size = sizeof buffer.header + meta.body_size;
-    int crypto_result = crypto_onetimeauth_verify(buffer.auth, buffer.header, data_size, key);
-    if (crypto_result != RN_OK)
-    {
-        return RN_CONNECTION_READ_ERROR_VERIFY;
-    }
+    int result = crypto_onetimeauth_verify(
+          buffer->auth, (const uint8_t *)&buffer->head,
+          sizeof buffer->head + buffer->meta.body_size, key);
+    sodium_memzero(key, sizeof key);
 
-    return RN_OK;
+    return result == 0 ? RN_CONNECTION_READ_AVAILABLE : RN_CONNECTION_READ_ERROR_VERIFY;
 }
 
-enum RnConnectionWriteResult rxConnectionPreProcessEgressAuthenticated(
-      RnPacketBufferSecure *buffer, RnPacketBufferMetaData meta, const RnKeyBuffer *master,
-      uint64_t context, uint64_t nonce)
+static enum RnConnectionWriteResult rxConnectionEgressAuthenticated(
+      RnPacketBufferSecure *buffer, const RnKeyBuffer *master, uint64_t context, uint32_t nonce)
 {
     RnKeyBuffer key;
-    int key_result = crypto_kdf_derive_from_key(key, sizeof key, nonce, context, master);
-    if (key_result != RN_OK)
+    if (rxConnectionPacketKey(&key, master, context, nonce) != RN_OK)
     {
         return RN_CONNECTION_WRITE_ERROR_CONTEXT;
     }
 
-    size_t data_size = sizeof buffer.header + meta.body_size;
-    int crypto_result = crypto_onetimeauth(buffer.auth, buffer.header, data_size, key);
-    if (crypto_result != RN_OK)
-    {
-        return RN_CONNECTION_WRITE_ERROR_AUTHENTICATE;
-    }
+    int result = crypto_onetimeauth(
+          buffer->auth, (const uint8_t *)&buffer->head,
+          sizeof buffer->head + buffer->meta.body_size, key);
+    sodium_memzero(key, sizeof key);
+
+    return result == 0 ? RN_CONNECTION_WRITE_OK : RN_CONNECTION_WRITE_ERROR_AUTHENTICATE;
+}
 
-    return RN_OK;
+/**
+ * Encrypted packets encrypt their body in place with XChaCha20-Poly1305 under
+ * the epoch key. The header stays in the clear for rnConnectionScreen and is
+ * authenticated along with it, the nonce combines the context and the packet's
+ * nonce.
+ */
+static void rxConnectionNonceEncrypted(
+      OUT uint8_t nonce[crypto_aead_xchacha20poly1305_ietf_NPUBBYTES], uint64_t context,
+      uint32_t sequence)
+{
+    const uint64_t words[3] = { context, 0, sequence };
+    memcpy(nonce, words, sizeof words);
 }
 
-enum RnConnectionReadResult rxConnectionPreProcessIngressEncrypted(
-      RnPacketBufferSecure *buffer, RnPacketBufferMetaData meta, const RnKeyBuffer *master,
-      uint64_t context, uint64_t nonce)
+static enum RnConnectionReadResult rxConnectionIngressEncrypted(
+      RnPacketBufferSecure *buffer, const RnKeyBuffer *master, uint64_t context, uint32_t nonce)
 {
-    size_t data_size = sizeof buffer.header + meta.body_size;
-    uint64_t nonce_buffer[3] = { context, 0, nonce };
-    int result = crypto_box_open_easy_afternm(
-          buffer.header, buffer.auth, data_size, nonce_buffer, key);
-    if (result != RN_OK)
-    {
-        return RN_CONNECTION_READ_ERROR_VERIFY;
-    }
+    uint8_t npub[crypto_aead_xchacha20poly1305_ietf_NPUBBYTES];
+    rxConnectionNonceEncrypted(npub, context, nonce);
+
+    int result = crypto_aead_xchacha20poly1305_ietf_decrypt_detached(
+          (uint8_t *)buffer->body, NULL, (const uint8_t *)buffer->body, buffer->meta.body_size,
+          buffer->auth, (const uint8_t *)&buffer->head, sizeof buffer->head, npub, *master);
+
+    return result == 0 ? RN_CONNECTION_READ_AVAILABLE : RN_CONNECTION_READ_ERROR_VERIFY;
+}
 
-    return RN_OK;
+static enum RnConnectionWriteResult rxConnectionEgressEncrypted(
+      RnPacketBufferSecure *buffer, const RnKeyBuffer *master, uint64_t context, uint32_t nonce)
+{
+    uint8_t npub[crypto_aead_xchacha20poly1305_ietf_NPUBBYTES];
+    rxConnectionNonceEncrypted(npub, context, nonce);
+
+    int result = crypto_aead_xchacha20poly1305_ietf_encrypt_detached(
+          (uint8_t *)buffer->body, buffer->auth, NULL, (const uint8_t *)buffer->body,
+          buffer->meta.body_size, (const uint8_t *)&buffer->head, sizeof buffer->head, NULL, npub,
+          *master);
+
+    return result == 0 ? RN_CONNECTION_WRITE_OK : RN_CONNECTION_WRITE_ERROR_AUTHENTICATE;
 }
 
-enum RnConnectionWriteResult rxConnectionPreProcessEgressEncrypted(
-      RnPacketBufferSecure *buffer, RnPacketBufferMetaData meta, const RnKeyBuffer *master,
-      uint64_t context, uint64_t nonce)
+/**
+ * Insecure packets only carry the salt both sides agreed on, which at least
+ * keeps stray datagrams of other sessions out. Checksummed ones carry the salt
+ * XORed with the CRC32C of their header and body, a flipped checksum flag
+ * leaves the CRC in the salt and fails the comparison just the same.
+ */
+static uint64_t rxConnectionChecksumInsecure(const RnPacketBufferInsecure *buffer)
 {
-    size_t data_size = sizeof buffer.header + meta.body_size * 8;
-    uint64_t nonce_buffer[3] = { context, 0, nonce };
-    int result = crypto_box_easy_afternm(buffer.auth, buffer.header, data_size, nonce_buffer, key);
-    if (result != RN_OK)
+    if (!(buffer->head.protocol & RN_PACKET_PROTOCOL_CHECKSUM))
     {
-        return WritePacketResult::ERR_AUTHENTICATE;
+        return 0;
     }
 
-    return WritePacketResult::SUCCESS;
+    return rnChecksumCrc32c(0, &buffer->head, sizeof buffer->head + buffer->meta.body_size);
 }
 
-enum RnConnectionReadResult rxConnectionPreProcessIngressInsecure(
-      RnPacketBufferInsecure *buffer, RnPacketBufferMetaData meta, uint64_t salt)
+static enum RnConnectionReadResult rxConnectionIngressInsecure(
+      const RnPacketBufferInsecure *buffer, uint64_t salt)
 {
-    if (buffer.salt != salt)
+    if ((buffer->salt ^ rxConnectionChecksumInsecure(buffer)) != salt)
     {
-        return RN_CONNECTION_READ_ERROR_CONTEXT;
+        return buffer->head.protocol & RN_PACKET_PROTOCOL_CHECKSUM
+                     ? RN_CONNECTION_READ_ERROR_VERIFY
+                     : RN_CONNECTION_READ_ERROR_CONTEXT;
     }
 
-    // TODO remove
-    // uint16_t checksum = crc_16(buff.header, buff.byte_size());
-    // if (buff.tag.crc16 != checksum)
-    // {
-    //     return ReadPacketResult::ERR_VERIFY;
-    // }
+    return RN_CONNECTION_READ_AVAILABLE;
+}
 
-    return RN_OK;
+static enum RnConnectionWriteResult rxConnectionEgressInsecure(
+      RnPacketBufferInsecure *buffer, uint64_t salt)
+{
+    buffer->salt = salt ^ rxConnectionChecksumInsecure(buffer);
+    return RN_CONNECTION_WRITE_OK;
 }
 
-// TODO remove
-// WritePacketResult InsecurePacketWriter::WritePacket(_Inout_
-// InsecurePacketBuffer &buff)
-// {
-//     buff.header.sequence = ++sequence;
-//     buff.tag.crc16 = crc_16(buff.header, buff.byte_size());
+#define RN_CONNECTION_CRYPTO_SECURE_IMPL(TYPE, IP)                                                 \
+    static enum RnConnectionReadResult rxConnectionIngress##TYPE##IP(                              \
+          RnConnection##TYPE##IP *connection, RnPacketBufferSecure *buffer,                        \
+          const RnKeyBuffer *key, RnPacketSequence sequence)                                       \
+    {                                                                                              \
+        return rxConnectionIngress##TYPE(                                                          \
+              buffer, key, connection->handshake.context, sequence.nonce);                         \
+    }                                                                                              \
+                                                                                                   \
+    static enum RnConnectionWriteResult rxConnectionEgress##TYPE##IP(                              \
+          RnConnection##TYPE##IP *connection, RnPacketBufferSecure *buffer,                        \
+          const RnKeyBuffer *key, RnPacketSequence sequence)                                       \
+    {                                                                                              \
+        return rxConnectionEgress##TYPE(                                                           \
+              buffer, key, connection->handshake.context, sequence.nonce);                         \
+    }
 
-//     return TagPacket(buff);
-// }
+RN_CONNECTION_CRYPTO_SECURE_IMPL(Authenticated, IPv4)
+RN_CONNECTION_CRYPTO_SECURE_IMPL(Authenticated, IPv6)
 
-enum RnConnectionWriteResult rxConnectionPreProcessEgressInsecure(
-      RnPacketBufferInsecure *buffer, RnPacketBufferMetaData meta, uint64_t salt)
-{
-    buffer.salt = data;
-    return RN_OK;
-}
+RN_CONNECTION_CRYPTO_SECURE_IMPL(Encrypted, IPv4)
+RN_CONNECTION_CRYPTO_SECURE_IMPL(Encrypted, IPv6)
+
+#define RN_CONNECTION_CRYPTO_INSECURE_IMPL(IP)                                                     \
+    static enum RnConnectionReadResult rxConnectionIngressInsecure##IP(                            \
+          RnConnectionInsecure##IP *connection, RnPacketBufferInsecure *buffer,                    \
+          const RnKeyBuffer *key, RnPacketSequence sequence)                                       \
+    {                                                                                              \
+        (void)key;                                                                                 \
+        (void)sequence;                                                                            \
+                                                                                                   \
+        return rxConnectionIngressInsecure(buffer, connection->handshake.salt);                    \
+    }                                                                                              \
+                                                                                                   \
+    static enum RnConnectionWriteResult rxConnectionEgressInsecure##IP(                            \
+          RnConnectionInsecure##IP *connection, RnPacketBufferInsecure *buffer,                    \
+          const RnKeyBuffer *key, RnPacketSequence sequence)                                       \
+    {                                                                                              \
+        (void)key;                                                                                 \
+        (void)sequence;                                                                            \
+                                                                                                   \
+        return rxConnectionEgressInsecure(buffer, connection->handshake.salt);                     \
+    }
+
+RN_CONNECTION_CRYPTO_INSECURE_IMPL(IPv4)
+RN_CONNECTION_CRYPTO_INSECURE_IMPL(IPv6)
+
+#define RN_CONNECTION_WRITE_IMPL(TYPE, IP, BUFFER)                                                 \
+    static enum RnConnectionWriteResult rxConnectionWrite##TYPE##IP(                               \
+          RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer,                      \
+          const RnAddress##IP *address)                                                            \
+    {                                                                                              \
+        /* plain text of protected packets, coding and encryption overwrite it */                  \
+        uint16_t type = buffer->head.type;                                                         \
+        uint64_t protected_body[RN_FEC_PAYLOAD_MAX / 8];                                           \
+        size_t protected_size = 0;                                                                 \
+        if (connection->fec != NULL && rnFecProtects(connection->fec, type) &&                     \
+            buffer->meta.body_size <= RN_FEC_PAYLOAD_MAX)                                          \
+        {                                                                                          \
+            protected_size = buffer->meta.body_size;                                               \
+            memcpy(protected_body, buffer->body, protected_size);                                  \
+        }                                                                                          \
+                                                                                                   \
+        /* coded ahead of the size check, coding may be what makes the packet fit */               \
+        const RnEntropyModel *model = type < RN_PACKET_TYPE_COMPRESSED                             \
+                                            ? rnEntropyConfigModel(&connection->entropy, type)     \
+                                            : NULL;                                                \
+        if (model != NULL)                                                                         \
+        {                                                                                          \
+            RnPacketBufferCursor cursor = {                                                        \
+                buffer->meta.body_size / 8,                                                        \
+                buffer->meta.body_size % 8 * 8,                                                    \
+            };                                                                                     \
+            rnPacketBufferCompress(buffer, &cursor, model);                                        \
+        }                                                                                          \
+                                                                                                   \
+        /* larger datagrams would vanish on the path, probes are meant to find out if they do */   \
+        if (rnPacketBufferWireSize(buffer) > rnPmtuConfirmed(&connection->pmtu) &&                 \
+            type != RN_PMTU_PROBE_PACKET_TYPE)                                                     \
+        {                                                                                          \
+            return RN_CONNECTION_WRITE_ERROR_SIZE;                                                 \
+        }                                                                                          \
+                                                                                                   \
+        buffer->meta.connection_id = rnConnectionId(connection);                                   \
+                                                                                                   \
+        const RnKeyBuffer *key;                                                                    \
+        if (rxConnectionEgressEpoch##TYPE##IP(connection, buffer, &key) != RN_OK)                  \
+        {                                                                                          \
+            return RN_CONNECTION_WRITE_ERROR_CONTEXT;                                              \
+        }                                                                                          \
+                                                                                                   \
+        RnPacketSequence sequence = {                                                              \
+            .counter = rnPacketSequenceIncrement(connection->outgoing.counter),                    \
+        };                                                                                         \
+        buffer->head.sequence = sequence.counter.number;                                           \
+                                                                                                   \
+        enum RnConnectionWriteResult write_result =                                                \
+              rxConnectionEgress##TYPE##IP(connection, buffer, key, sequence);                     \
+        if (write_result == RN_CONNECTION_WRITE_OK)                                                \
+        {                                                                                          \
+            connection->outgoing = sequence;                                                       \
+            rxConnectionEgressCount##TYPE##IP(connection);                                         \
+                                                                                                   \
+            rnMetricsCountConnection(&connection->metrics, RN_METRICS_PACKETS_OUT, 1);             \
+            rnMetricsCountConnection(                                                              \
+                  &connection->metrics, RN_METRICS_BYTES_OUT, rnPacketBufferWireSize(buffer));     \
+                                                                                                   \
+            rnSocketSendData(                                                                      \
+                  connection->socket, address, rnPacketBufferWireData(buffer),                     \
+                  rnPacketBufferWireSize(buffer));                                                 \
+                                                                                                   \
+            /* the parity follows the last member of its group, parity packets are unprotected */  \
+            uint8_t parity[RN_FEC_PARITY_BYTES_MAX];                                               \
+            size_t parity_size;                                                                    \
+            if (protected_size != 0 &&                                                             \
+                rnFecEncode(                                                                       \
+                      connection->fec, type, sequence.counter.number, protected_body,              \
+                      protected_size, parity, &parity_size))                                       \
+            {                                                                                      \
+                RnPacketBuffer##BUFFER parity_buffer =                                             \
+                      rnPacketBufferCreate##BUFFER(RN_FEC_PARITY_PACKET_TYPE);                     \
+                RnPacketBufferCursor cursor = { parity_size / 8, parity_size % 8 * 8 };            \
+                                                                                                   \
+                memcpy(parity_buffer.body, parity, parity_size);                                   \
+                rnPacketBufferCommit(&parity_buffer, &cursor);                                     \
+                rxConnectionWrite##TYPE##IP(connection, &parity_buffer, address);                  \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return write_result;                                                                       \
+    }
+
+RN_CONNECTION_WRITE_IMPL(Authenticated, IPv4, Secure)
+RN_CONNECTION_WRITE_IMPL(Authenticated, IPv6, Secure)
+
+RN_CONNECTION_WRITE_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_WRITE_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_WRITE_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_WRITE_IMPL(Insecure, IPv6, Insecure)
+
+/**
+ * Path challenges and responses carry nothing but the random token.
+ */
+#define RN_CONNECTION_PATH_TOKEN_FIELDS(FIELD) FIELD(token, uint64_t, 64)
+
+RN_SCHEMA_DEFINE(PathToken, RN_CONNECTION_PATH_TOKEN_FIELDS)
+
+#define RN_CONNECTION_PATH_IMPL(TYPE, IP, BUFFER)                                                  \
+    const RnAddress##IP *rnConnectionAddress##TYPE##IP(const RnConnection##TYPE##IP *connection)   \
+    {                                                                                              \
+        return &connection->address;                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static void rxConnectionWritePath##TYPE##IP(                                                   \
+          RnConnection##TYPE##IP *connection, uint16_t type, uint64_t token,                       \
+          const RnAddress##IP *address)                                                            \
+    {                                                                                              \
+        RnPacketBuffer##BUFFER buffer = rnPacketBufferCreate##BUFFER(type);                        \
+        RnSchemaPathToken fields      = { token };                                                 \
+                                                                                                   \
+        rnSchemaWritePathToken(buffer.body, &fields);                                              \
+        RnPacketBufferCursor cursor = RN_SCHEMA_CURSOR(PathToken);                                 \
+        rnPacketBufferCommit(&buffer, &cursor);                                                    \
+                                                                                                   \
+        rxConnectionWrite##TYPE##IP(connection, &buffer, address);                                 \
+    }                                                                                              \
+                                                                                                   \
+    void rnConnectionValidatePath##TYPE##IP(                                                       \
+          RnConnection##TYPE##IP *connection, const RnAddress##IP *address)                        \
+    {                                                                                              \
+        /* one small challenge per interval, spoofed sources cannot turn it into a flood */        \
+        uint64_t now = rnClockMonotonic();                                                         \
+        if (connection->handshake.step != RN_HANDSHAKE_CONNECTED ||                                \
+            now - connection->path_sent_at < RN_CONNECTION_PATH_INTERVAL_NS)                       \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        connection->path_address = *address;                                                       \
+        connection->path_sent_at = now;                                                            \
+        randombytes_buf(&connection->path_token, sizeof connection->path_token);                   \
+                                                                                                   \
+        rxConnectionWritePath##TYPE##IP(                                                           \
+              connection, RN_CONNECTION_PATH_CHALLENGE_PACKET_TYPE, connection->path_token,        \
+              address);                                                                            \
+    }                                                                                              \
+                                                                                                   \
+    static enum RnConnectionReadResult rxConnectionReadPath##TYPE##IP(                             \
+          RnConnection##TYPE##IP *connection, const RnPacketBuffer##BUFFER *buffer)                \
+    {                                                                                              \
+        if (buffer->meta.body_size < RN_SCHEMA_BITS(PathToken) / 8)                                \
+        {                                                                                          \
+            return RN_CONNECTION_READ_PROBE;                                                       \
+        }                                                                                          \
+                                                                                                   \
+        RnSchemaPathToken fields;                                                                  \
+        rnSchemaReadPathToken(buffer->body, &fields);                                              \
+                                                                                                   \
+        /* answered the usual way, the response leaves from the address being challenged */        \
+        if (buffer->head.type == RN_CONNECTION_PATH_CHALLENGE_PACKET_TYPE)                         \
+        {                                                                                          \
+            rxConnectionWritePath##TYPE##IP(                                                       \
+                  connection, RN_CONNECTION_PATH_RESPONSE_PACKET_TYPE, fields.token,               \
+                  &connection->address);                                                           \
+            return RN_CONNECTION_READ_PROBE;                                                       \
+        }                                                                                          \
+                                                                                                   \
+        if (connection->path_token == 0 || fields.token != connection->path_token)                 \
+        {                                                                                          \
+            return RN_CONNECTION_READ_PROBE;                                                       \
+        }                                                                                          \
+                                                                                                   \
+        connection->address    = connection->path_address;                                         \
+        connection->path_token = 0;                                                                \
+                                                                                                   \
+        /* the new path has yet to prove anything beyond the base size */                          \
+        rnPmtuInit(                                                                                \
+              &connection->pmtu, connection->pmtu.base, connection->pmtu.max,                      \
+              rnClockMonotonic());                                                                 \
+        return RN_CONNECTION_READ_MIGRATED;                                                        \
+    }
+
+RN_CONNECTION_PATH_IMPL(Authenticated, IPv4, Secure)
+RN_CONNECTION_PATH_IMPL(Authenticated, IPv6, Secure)
+
+RN_CONNECTION_PATH_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_PATH_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_PATH_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_PATH_IMPL(Insecure, IPv6, Insecure)
+
+/**
+ * Acknowledgements echo the datagram size a probe arrived with, probes are
+ * padding only.
+ */
+#define RN_CONNECTION_PATH_ACK_FIELDS(FIELD) FIELD(size, uint16_t, 16)
+
+RN_SCHEMA_DEFINE(PathAck, RN_CONNECTION_PATH_ACK_FIELDS)
+
+#define RN_CONNECTION_PMTU_IMPL(TYPE, IP, BUFFER)                                                  \
+    uint16_t rnConnectionPayloadMax##TYPE##IP(const RnConnection##TYPE##IP *connection)            \
+    {                                                                                              \
+        return rnPmtuConfirmed(&connection->pmtu);                                                 \
+    }                                                                                              \
+                                                                                                   \
+    void rnConnectionProbePath##TYPE##IP(RnConnection##TYPE##IP *connection, uint64_t now)         \
+    {                                                                                              \
+        if (connection->handshake.step != RN_HANDSHAKE_CONNECTED)                                  \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        uint16_t size = rnPmtuProbeDue(&connection->pmtu, now);                                    \
+        if (size == 0)                                                                             \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        RnPacketBuffer##BUFFER buffer = rnPacketBufferCreate##BUFFER(RN_PMTU_PROBE_PACKET_TYPE);   \
+        RnPacketBufferCursor cursor   = { 0, 0 };                                                  \
+        if (rnPacketBufferWritePaddingTo(&buffer, &cursor, size) == RN_OK)                         \
+        {                                                                                          \
+            rnConnectionWritePacket(connection, &buffer);                                          \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static enum RnConnectionReadResult rxConnectionReadProbe##TYPE##IP(                            \
+          RnConnection##TYPE##IP *connection, const RnPacketBuffer##BUFFER *buffer)                \
+    {                                                                                              \
+        if (buffer->head.type == RN_PMTU_PROBE_PACKET_TYPE)                                        \
+        {                                                                                          \
+            RnPacketBuffer##BUFFER ack = rnPacketBufferCreate##BUFFER(RN_PMTU_ACK_PACKET_TYPE);    \
+            RnSchemaPathAck fields     = { (uint16_t)rnPacketBufferWireSize(buffer) };             \
+                                                                                                   \
+            rnSchemaWritePathAck(ack.body, &fields);                                               \
+            RnPacketBufferCursor cursor = RN_SCHEMA_CURSOR(PathAck);                               \
+            rnPacketBufferCommit(&ack, &cursor);                                                   \
+                                                                                                   \
+            rnConnectionWritePacket(connection, &ack);                                             \
+        }                                                                                          \
+        else if (buffer->meta.body_size >= RN_SCHEMA_BITS(PathAck) / 8)                            \
+        {                                                                                          \
+            RnSchemaPathAck fields;                                                                \
+            rnSchemaReadPathAck(buffer->body, &fields);                                            \
+            rnPmtuProbeAcked(&connection->pmtu, fields.size, rnClockMonotonic());                  \
+        }                                                                                          \
+                                                                                                   \
+        return RN_CONNECTION_READ_PROBE;                                                           \
+    }
+
+RN_CONNECTION_PMTU_IMPL(Authenticated, IPv4, Secure)
+RN_CONNECTION_PMTU_IMPL(Authenticated, IPv6, Secure)
+
+RN_CONNECTION_PMTU_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_PMTU_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_PMTU_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_PMTU_IMPL(Insecure, IPv6, Insecure)
+
+/**
+ * Clock requests carry the requester's time, responses echo it along with the
+ * responder's time and tick schedule, see clock.h.
+ */
+#define RN_CONNECTION_CLOCK_REQUEST_FIELDS(FIELD) FIELD(sent_at, uint64_t, 64)
+
+#define RN_CONNECTION_CLOCK_RESPONSE_FIELDS(FIELD)                                                 \
+    FIELD(sent_at, uint64_t, 64)                                                                   \
+    FIELD(remote_at, uint64_t, 64)                                                                 \
+    FIELD(tick_origin, uint64_t, 64)                                                               \
+    FIELD(tick_period, uint64_t, 64)
+
+RN_SCHEMA_DEFINE(ClockRequest, RN_CONNECTION_CLOCK_REQUEST_FIELDS)
+RN_SCHEMA_DEFINE(ClockResponse, RN_CONNECTION_CLOCK_RESPONSE_FIELDS)
+
+#define RN_CONNECTION_CLOCK_IMPL(TYPE, IP, BUFFER)                                                 \
+    void rnConnectionSyncClock##TYPE##IP(RnConnection##TYPE##IP *connection, uint64_t now)         \
+    {                                                                                              \
+        if (connection->handshake.step != RN_HANDSHAKE_CONNECTED ||                                \
+            !rnClockSyncDue(&connection->clock, now))                                              \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        RnPacketBuffer##BUFFER buffer =                                                            \
+              rnPacketBufferCreate##BUFFER(RN_CLOCK_REQUEST_PACKET_TYPE);                          \
+        RnSchemaClockRequest fields = { now };                                                     \
+                                                                                                   \
+        rnSchemaWriteClockRequest(buffer.body, &fields);                                           \
+        RnPacketBufferCursor cursor = RN_SCHEMA_CURSOR(ClockRequest);                              \
+        rnPacketBufferCommit(&buffer, &cursor);                                                    \
+                                                                                                   \
+        rnConnectionWritePacket(connection, &buffer);                                              \
+    }                                                                                              \
+                                                                                                   \
+    void rnConnectionSetTicks##TYPE##IP(                                                           \
+          RnConnection##TYPE##IP *connection, const RnClockTicks *ticks)                           \
+    {                                                                                              \
+        connection->clock.ticks = *ticks;                                                          \
+    }                                                                                              \
+                                                                                                   \
+    const RnClockSync *rnConnectionClock##TYPE##IP(const RnConnection##TYPE##IP *connection)       \
+    {                                                                                              \
+        return &connection->clock;                                                                 \
+    }                                                                                              \
+                                                                                                   \
+    static enum RnConnectionReadResult rxConnectionReadClock##TYPE##IP(                            \
+          RnConnection##TYPE##IP *connection, const RnPacketBuffer##BUFFER *buffer)                \
+    {                                                                                              \
+        uint64_t now = rnClockMonotonic();                                                         \
+        if (buffer->head.type == RN_CLOCK_REQUEST_PACKET_TYPE &&                                   \
+            buffer->meta.body_size >= RN_SCHEMA_BITS(ClockRequest) / 8)                            \
+        {                                                                                          \
+            RnSchemaClockRequest request;                                                          \
+            rnSchemaReadClockRequest(buffer->body, &request);                                      \
+                                                                                                   \
+            RnPacketBuffer##BUFFER response =                                                      \
+                  rnPacketBufferCreate##BUFFER(RN_CLOCK_RESPONSE_PACKET_TYPE);                     \
+            RnSchemaClockResponse fields = {                                                       \
+                .sent_at     = request.sent_at,                                                    \
+                .remote_at   = now,                                                                \
+                .tick_origin = connection->clock.ticks.origin,                                     \
+                .tick_period = connection->clock.ticks.period,                                     \
+            };                                                                                     \
+                                                                                                   \
+            rnSchemaWriteClockResponse(response.body, &fields);                                    \
+            RnPacketBufferCursor cursor = RN_SCHEMA_CURSOR(ClockResponse);                         \
+            rnPacketBufferCommit(&response, &cursor);                                              \
+                                                                                                   \
+            rnConnectionWritePacket(connection, &response);                                        \
+        }                                                                                          \
+        else if (buffer->head.type == RN_CLOCK_RESPONSE_PACKET_TYPE &&                             \
+                 buffer->meta.body_size >= RN_SCHEMA_BITS(ClockResponse) / 8)                      \
+        {                                                                                          \
+            RnSchemaClockResponse fields;                                                          \
+            rnSchemaReadClockResponse(buffer->body, &fields);                                      \
+                                                                                                   \
+            RnClockTicks ticks = { fields.tick_origin, fields.tick_period };                       \
+            rnClockSyncSample(&connection->clock, fields.sent_at, fields.remote_at, &ticks, now);  \
+        }                                                                                          \
+                                                                                                   \
+        return RN_CONNECTION_READ_PROBE;                                                           \
+    }
+
+RN_CONNECTION_CLOCK_IMPL(Authenticated, IPv4, Secure)
+RN_CONNECTION_CLOCK_IMPL(Authenticated, IPv6, Secure)
+
+RN_CONNECTION_CLOCK_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_CLOCK_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_CLOCK_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_CLOCK_IMPL(Insecure, IPv6, Insecure)
+
+#define RN_CONNECTION_FEC_IMPL(TYPE, IP, BUFFER)                                                   \
+    int rnConnectionConfigureFec##TYPE##IP(                                                        \
+          RnConnection##TYPE##IP *connection, const RnFecConfig *config)                           \
+    {                                                                                              \
+        rnFecClose(connection->fec);                                                               \
+        connection->fec = NULL;                                                                    \
+                                                                                                   \
+        for (int i = 0; i < RN_FEC_TYPES_MAX; ++i)                                                 \
+        {                                                                                          \
+            if (config->types[i].group_size != 0)                                                  \
+            {                                                                                      \
+                return rnFecOpen(config, &connection->fec);                                        \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static enum RnConnectionReadResult rxConnectionReadParity##TYPE##IP(                           \
+          RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer)                      \
+    {                                                                                              \
+        uint16_t type;                                                                             \
+        uint16_t sequence;                                                                         \
+        size_t size;                                                                               \
+        uint64_t body[RN_FEC_PAYLOAD_MAX / 8];                                                     \
+        if (connection->fec == NULL ||                                                             \
+            !rnFecRecover(                                                                         \
+                  connection->fec, buffer->body, buffer->meta.body_size, &type, &sequence, body,   \
+                  &size))                                                                          \
+        {                                                                                          \
+            return RN_CONNECTION_READ_PARITY;                                                      \
+        }                                                                                          \
+                                                                                                   \
+        /* the parity advanced the window past the group, the original can no longer arrive */     \
+        buffer->head.type      = type;                                                             \
+        buffer->head.sequence  = sequence;                                                         \
+        buffer->meta.body_size = (uint16_t)size;                                                   \
+        memcpy(buffer->body, body, size);                                                          \
+        return RN_CONNECTION_READ_AVAILABLE;                                                       \
+    }
+
+RN_CONNECTION_FEC_IMPL(Authenticated, IPv4, Secure)
+RN_CONNECTION_FEC_IMPL(Authenticated, IPv6, Secure)
+
+RN_CONNECTION_FEC_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_FEC_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_FEC_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_FEC_IMPL(Insecure, IPv6, Insecure)
+
+#define RN_CONNECTION_ENTROPY_IMPL(TYPE, IP)                                                       \
+    void rnConnectionConfigureEntropy##TYPE##IP(                                                   \
+          RnConnection##TYPE##IP *connection, const RnEntropyConfig *config)                       \
+    {                                                                                              \
+        connection->entropy = *config;                                                             \
+    }
+
+RN_CONNECTION_ENTROPY_IMPL(Authenticated, IPv4)
+RN_CONNECTION_ENTROPY_IMPL(Authenticated, IPv6)
+
+RN_CONNECTION_ENTROPY_IMPL(Encrypted, IPv4)
+RN_CONNECTION_ENTROPY_IMPL(Encrypted, IPv6)
+
+RN_CONNECTION_ENTROPY_IMPL(Insecure, IPv4)
+RN_CONNECTION_ENTROPY_IMPL(Insecure, IPv6)
+
+#define RN_CONNECTION_SCREEN_IMPL(TYPE, IP, BUFFER)                                                \
+    enum RnConnectionReadResult rnConnectionScreen##TYPE##IP(                                      \
+          const RnConnection##TYPE##IP *connection, const RnPacketBuffer##BUFFER *buffer,          \
+          const RnAddress##IP *source)                                                             \
+    {                                                                                              \
+        /* handshake packets are written before either side knows the id */                        \
+        uint32_t id = rnConnectionId(connection);                                                  \
+        if (buffer->meta.connection_id != id &&                                                    \
+            (buffer->meta.connection_id != 0 || buffer->head.type != RN_HANDSHAKE_PACKET_TYPE))    \
+        {                                                                                          \
+            return RN_CONNECTION_READ_ERROR_CONTEXT;                                               \
+        }                                                                                          \
+                                                                                                   \
+        /* other sources are only ever worth verifying as a migrating peer, see rnConnectionId */  \
+        if (id == 0 && memcmp(source, &connection->address, sizeof *source) != 0)                  \
+        {                                                                                          \
+            return RN_CONNECTION_READ_ERROR_CONTEXT;                                               \
+        }                                                                                          \
+                                                                                                   \
+        /* other key phases have their window checked once the epoch is selected, handshakes */    \
+        /* have no window yet */                                                                   \
+        RnPacketSequenceCounter window =                                                           \
+              rnPacketSequenceAdvance(connection->incoming.counter, buffer->head.sequence);        \
+        if (buffer->head.type != RN_HANDSHAKE_PACKET_TYPE &&                                       \
+            rxConnectionIngressCurrent##TYPE##IP(connection, buffer) &&                            \
+            window.generation == 0 && window.number == 0)                                          \
+        {                                                                                          \
+            return RN_CONNECTION_READ_ERROR_SEQUENCE;                                              \
+        }                                                                                          \
+                                                                                                   \
+        return RN_CONNECTION_READ_AVAILABLE;                                                       \
+    }
+
+RN_CONNECTION_SCREEN_IMPL(Authenticated, IPv4, Secure)
+RN_CONNECTION_SCREEN_IMPL(Authenticated, IPv6, Secure)
+
+RN_CONNECTION_SCREEN_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_SCREEN_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_SCREEN_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_SCREEN_IMPL(Insecure, IPv6, Insecure)
+
+#define RN_CONNECTION_HANDSHAKE_SECURE_IMPL(TYPE, IP)                                              \
+    /* true once connected, session keys are set up as soon as the handshake derived them */       \
+    static bool rxConnectionReadHandshake##TYPE##IP(                                               \
+          RnConnection##TYPE##IP *connection, RnPacketBufferSecure *buffer)                        \
+    {                                                                                              \
+        enum RnHandshakeStep step = connection->handshake.step;                                    \
+        bool connected = connection->role == RN_CONNECTION_CLIENT                                  \
+                               ? rnHandshakeReadPacketClient(&connection->handshake, buffer)       \
+                               : rnHandshakeReadPacketServer(&connection->handshake, buffer);      \
+        if (step != connection->handshake.step)                                                    \
+        {                                                                                          \
+            rxConnectionCountHandshake(&connection->metrics, step, connection->handshake.step);    \
+        }                                                                                          \
+                                                                                                   \
+        RnKeyPair session;                                                                         \
+        if (rnHandshakeTakeSession(&connection->handshake, &session))                              \
+        {                                                                                          \
+            rnSessionKeysInit(&connection->keys, &session);                                        \
+            sodium_memzero(&session, sizeof session);                                              \
+        }                                                                                          \
+                                                                                                   \
+        rxConnectionConnected##TYPE##IP(connection, step);                                         \
+        return connected;                                                                          \
+    }
+
+RN_CONNECTION_HANDSHAKE_SECURE_IMPL(Authenticated, IPv4)
+RN_CONNECTION_HANDSHAKE_SECURE_IMPL(Authenticated, IPv6)
+
+RN_CONNECTION_HANDSHAKE_SECURE_IMPL(Encrypted, IPv4)
+RN_CONNECTION_HANDSHAKE_SECURE_IMPL(Encrypted, IPv6)
+
+#define RN_CONNECTION_HANDSHAKE_INSECURE_IMPL(IP)                                                  \
+    static bool rxConnectionReadHandshakeInsecure##IP(                                             \
+          RnConnectionInsecure##IP *connection, RnPacketBufferInsecure *buffer)                    \
+    {                                                                                              \
+        enum RnHandshakeStep step = connection->handshake.step;                                    \
+        bool connected = connection->role == RN_CONNECTION_CLIENT                                  \
+                               ? rnHandshakeReadPacketClient(&connection->handshake, buffer)       \
+                               : rnHandshakeReadPacketServer(&connection->handshake, buffer);      \
+        if (step != connection->handshake.step)                                                    \
+        {                                                                                          \
+            rxConnectionCountHandshake(&connection->metrics, step, connection->handshake.step);    \
+        }                                                                                          \
+                                                                                                   \
+        rxConnectionConnectedInsecure##IP(connection, step);                                       \
+        return connected;                                                                          \
+    }
+
+RN_CONNECTION_HANDSHAKE_INSECURE_IMPL(IPv4)
+RN_CONNECTION_HANDSHAKE_INSECURE_IMPL(IPv6)
+
+#define RN_CONNECTION_IMPL(TYPE, IP, BUFFER)                                                       \
+    /* everything after verification, shared with rnConnectionReadPackets */                       \
+    static enum RnConnectionReadResult rxConnectionReadVerified##TYPE##IP(                         \
+          RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer,                      \
+          enum RnSessionEpoch epoch, RnPacketSequence sequence)                                    \
+    {                                                                                              \
+        /* verified packets also confirm the handshake to clients whose confirmation got lost */   \
+        if (!rxConnectionReadHandshake##TYPE##IP(connection, buffer))                              \
+        {                                                                                          \
+            return RN_CONNECTION_READ_ERROR_CONTEXT;                                               \
+        }                                                                                          \
+                                                                                                   \
+        rxConnectionIngressAccept##TYPE##IP(connection, buffer, epoch, sequence);                  \
+                                                                                                   \
+        if (buffer->head.type == RN_PMTU_PROBE_PACKET_TYPE ||                                      \
+            buffer->head.type == RN_PMTU_ACK_PACKET_TYPE)                                          \
+        {                                                                                          \
+            return rxConnectionReadProbe##TYPE##IP(connection, buffer);                            \
+        }                                                                                          \
+                                                                                                   \
+        if (buffer->head.type == RN_CONNECTION_PATH_CHALLENGE_PACKET_TYPE ||                       \
+            buffer->head.type == RN_CONNECTION_PATH_RESPONSE_PACKET_TYPE)                          \
+        {                                                                                          \
+            return rxConnectionReadPath##TYPE##IP(connection, buffer);                             \
+        }                                                                                          \
+                                                                                                   \
+        if (buffer->head.type == RN_CLOCK_REQUEST_PACKET_TYPE ||                                   \
+            buffer->head.type == RN_CLOCK_RESPONSE_PACKET_TYPE)                                    \
+        {                                                                                          \
+            return rxConnectionReadClock##TYPE##IP(connection, buffer);                            \
+        }                                                                                          \
+                                                                                                   \
+        if (buffer->head.type == RN_FEC_PARITY_PACKET_TYPE)                                        \
+        {                                                                                          \
+            return rxConnectionReadParity##TYPE##IP(connection, buffer);                           \
+        }                                                                                          \
+                                                                                                   \
+        /* decoded before parity groups keep the body, they hold plain text on both ends */        \
+        if (buffer->head.type & RN_PACKET_TYPE_COMPRESSED)                                         \
+        {                                                                                          \
+            const RnEntropyModel *model = rnEntropyConfigModel(                                    \
+                  &connection->entropy, buffer->head.type & ~RN_PACKET_TYPE_COMPRESSED);           \
+            if (model == NULL || rnPacketBufferDecompress(buffer, model) != RN_OK)                 \
+            {                                                                                      \
+                return RN_CONNECTION_READ_ERROR_CONTEXT;                                           \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        if (connection->fec != NULL)                                                               \
+        {                                                                                          \
+            rnFecRemember(                                                                         \
+                  connection->fec, buffer->head.type, sequence.counter.number, buffer->body,       \
+                  buffer->meta.body_size);                                                         \
+        }                                                                                          \
+                                                                                                   \
+        return RN_CONNECTION_READ_AVAILABLE;                                                       \
+    }                                                                                              \
+                                                                                                   \
+    static enum RnConnectionReadResult rxConnectionRead##TYPE##IP(                                 \
+          RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer)                      \
+    {                                                                                              \
+        /* handshake packets precede keys and sequences, the handshake checks them itself */       \
+        if (buffer->head.type == RN_HANDSHAKE_PACKET_TYPE)                                         \
+        {                                                                                          \
+            rxConnectionReadHandshake##TYPE##IP(connection, buffer);                               \
+            rxConnectionCountRead(                                                                 \
+                  &connection->metrics, RN_CONNECTION_READ_HANDSHAKE,                              \
+                  rnPacketBufferWireSize(buffer));                                                 \
+            return RN_CONNECTION_READ_HANDSHAKE;                                                   \
+        }                                                                                          \
+                                                                                                   \
+        enum RnSessionEpoch epoch;                                                                 \
+        RnPacketSequence incoming;                                                                 \
+        const RnKeyBuffer *key =                                                                   \
+              rxConnectionIngressEpoch##TYPE##IP(connection, buffer, &epoch, &incoming);           \
+        RnPacketSequence sequence = {                                                              \
+            .counter = rnPacketSequenceAdvance(incoming.counter, buffer->head.sequence),           \
+        };                                                                                         \
+        if (sequence.nonce == 0)                                                                   \
+        {                                                                                          \
+            rxConnectionCountRead(                                                                 \
+                  &connection->metrics, RN_CONNECTION_READ_ERROR_SEQUENCE,                         \
+                  rnPacketBufferWireSize(buffer));                                                 \
+            return RN_CONNECTION_READ_ERROR_SEQUENCE;                                              \
+        }                                                                                          \
+                                                                                                   \
+        enum RnConnectionReadResult read_result =                                                  \
+              rxConnectionIngress##TYPE##IP(connection, buffer, key, sequence);                    \
+        rxConnectionCountRead(&connection->metrics, read_result, rnPacketBufferWireSize(buffer));  \
+        if (read_result != RN_CONNECTION_READ_AVAILABLE)                                           \
+        {                                                                                          \
+            return read_result;                                                                    \
+        }                                                                                          \
+                                                                                                   \
+        return rxConnectionReadVerified##TYPE##IP(connection, buffer, epoch, sequence);            \
+    }                                                                                              \
+                                                                                                   \
+    enum RnConnectionReadResult rnConnectionReadPacket##TYPE##IP(                                  \
+          RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer)                      \
+    {                                                                                              \
+        uint64_t start = rnMetricsClock();                                                         \
+        enum RnConnectionReadResult read_result = rxConnectionRead##TYPE##IP(connection, buffer);  \
+        rnMetricsRecordLatency(RN_METRICS_LATENCY_INGRESS, rnMetricsClock() - start);              \
+        return read_result;                                                                        \
+    }                                                                                              \
+                                                                                                   \
+    enum RnConnectionWriteResult rnConnectionWritePacket##TYPE##IP(                                \
+          RnConnection##TYPE##IP *connection, RnPacketBuffer##BUFFER *buffer)                      \
+    {                                                                                              \
+        /* parity written along with the packet counts towards its latency */                      \
+        uint64_t start = rnMetricsClock();                                                         \
+        enum RnConnectionWriteResult write_result =                                                \
+              rxConnectionWrite##TYPE##IP(connection, buffer, &connection->address);               \
+        rnMetricsRecordLatency(RN_METRICS_LATENCY_EGRESS, rnMetricsClock() - start);               \
+        return write_result;                                                                       \
+    }
+
+RN_CONNECTION_IMPL(Authenticated, IPv4, Secure)
+RN_CONNECTION_IMPL(Authenticated, IPv6, Secure)
+
+RN_CONNECTION_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_IMPL(Insecure, IPv6, Insecure)
+
+/**
+ * Authenticated packets of connected sessions are verified up to
+ * RN_CONNECTION_READ_BATCH at a time. Their windows are checked and their keys
+ * derived up front, then their tags verified together and the packets read in
+ * order. Windows are checked again as each packet is read, the packets before
+ * it may have moved them. A packet whose epoch or nonce moved along with them
+ * was verified under the wrong key and is read on its own, as is anything else.
+ */
+#define RN_CONNECTION_READ_BATCH_IMPL(IP)                                                          \
+    void rnConnectionReadPacketsAuthenticated##IP(                                                 \
+          RnConnectionAuthenticated##IP *const *connections, RnPacketBufferSecure *const *buffers, \
+          size_t count, OUT enum RnConnectionReadResult *results)                                  \
+    {                                                                                              \
+        RnKeyBuffer keys[RN_CONNECTION_READ_BATCH];                                                \
+        RnPoly1305Job jobs[RN_CONNECTION_READ_BATCH];                                              \
+        bool valid[RN_CONNECTION_READ_BATCH];                                                      \
+        uint32_t slots[RN_CONNECTION_READ_BATCH];                                                  \
+        enum RnSessionEpoch epochs[RN_CONNECTION_READ_BATCH];                                      \
+        uint32_t nonces[RN_CONNECTION_READ_BATCH];                                                 \
+                                                                                                   \
+        for (size_t base = 0; base < count; base += RN_CONNECTION_READ_BATCH)                      \
+        {                                                                                          \
+            /* batched packets wait for the whole batch to verify, their latency includes it */    \
+            uint64_t start = rnMetricsClock();                                                     \
+            size_t end     = base + RN_CONNECTION_READ_BATCH;                                      \
+            end            = end < count ? end : count;                                            \
+            uint32_t job_count = 0;                                                                \
+            for (size_t i = base; i < end; ++i)                                                    \
+            {                                                                                      \
+                RnConnectionAuthenticated##IP *connection = connections[i];                        \
+                RnPacketBufferSecure *buffer = buffers[i];                                         \
+                slots[i - base] = UINT32_MAX;                                                      \
+                if (connection->handshake.step != RN_HANDSHAKE_CONNECTED ||                        \
+                    buffer->head.type == RN_HANDSHAKE_PACKET_TYPE)                                 \
+                {                                                                                  \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                enum RnSessionEpoch epoch;                                                         \
+                RnPacketSequence incoming;                                                         \
+                const RnKeyBuffer *key = rxConnectionIngressEpochAuthenticated##IP(                \
+                      connection, buffer, &epoch, &incoming);                                      \
+                RnPacketSequence sequence = {                                                      \
+                    .counter = rnPacketSequenceAdvance(incoming.counter, buffer->head.sequence),   \
+                };                                                                                 \
+                if (sequence.nonce == 0 ||                                                         \
+                    rxConnectionPacketKey(                                                         \
+                          &keys[job_count], key, connection->handshake.context,                    \
+                          sequence.nonce) != RN_OK)                                                \
+                {                                                                                  \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                jobs[job_count] = (RnPoly1305Job) {                                                \
+                    .data = (const uint8_t *)&buffer->head,                                        \
+                    .size = sizeof buffer->head + buffer->meta.body_size,                          \
+                    .tag  = buffer->auth,                                                          \
+                    .key  = keys[job_count],                                                       \
+                };                                                                                 \
+                epochs[job_count] = epoch;                                                         \
+                nonces[job_count] = sequence.nonce;                                                \
+                slots[i - base]   = job_count++;                                                   \
+            }                                                                                      \
+                                                                                                   \
+            rnPoly1305VerifyBatch(jobs, job_count, valid);                                         \
+            sodium_memzero(keys, sizeof keys);                                                     \
+                                                                                                   \
+            for (size_t i = base; i < end; ++i)                                                    \
+            {                                                                                      \
+                RnConnectionAuthenticated##IP *connection = connections[i];                        \
+                RnPacketBufferSecure *buffer = buffers[i];                                         \
+                uint32_t slot = slots[i - base];                                                   \
+                if (slot == UINT32_MAX)                                                            \
+                {                                                                                  \
+                    results[i] = rnConnectionReadPacket(connection, buffer);                       \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                enum RnSessionEpoch epoch;                                                         \
+                RnPacketSequence incoming;                                                         \
+                rxConnectionIngressEpochAuthenticated##IP(connection, buffer, &epoch, &incoming);  \
+                RnPacketSequence sequence = {                                                      \
+                    .counter = rnPacketSequenceAdvance(incoming.counter, buffer->head.sequence),   \
+                };                                                                                 \
+                if (sequence.nonce != 0 &&                                                         \
+                    (epoch != epochs[slot] || sequence.nonce != nonces[slot]))                     \
+                {                                                                                  \
+                    results[i] = rnConnectionReadPacket(connection, buffer);                       \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                /* in the order rnConnectionReadPacket checks them */                              \
+                results[i] = sequence.nonce == 0 ? RN_CONNECTION_READ_ERROR_SEQUENCE               \
+                             : !valid[slot]      ? RN_CONNECTION_READ_ERROR_VERIFY                 \
+                                                 : RN_CONNECTION_READ_AVAILABLE;                   \
+                rxConnectionCountRead(                                                             \
+                      &connection->metrics, results[i], rnPacketBufferWireSize(buffer));           \
+                if (results[i] == RN_CONNECTION_READ_AVAILABLE)                                    \
+                {                                                                                  \
+                    results[i] = rxConnectionReadVerifiedAuthenticated##IP(                        \
+                          connection, buffer, epoch, sequence);                                    \
+                }                                                                                  \
+                rnMetricsRecordLatency(RN_METRICS_LATENCY_INGRESS, rnMetricsClock() - start);      \
+            }                                                                                      \
+        }                                                                                          \
+    }
+
+RN_CONNECTION_READ_BATCH_IMPL(IPv4)
+RN_CONNECTION_READ_BATCH_IMPL(IPv6)
+
+// encrypted packets authenticate their ciphertext with a key that only decryption yields
+#define RN_CONNECTION_READ_EACH_IMPL(TYPE, IP, BUFFER)                                             \
+    void rnConnectionReadPackets##TYPE##IP(                                                        \
+          RnConnection##TYPE##IP *const *connections, RnPacketBuffer##BUFFER *const *buffers,      \
+          size_t count, OUT enum RnConnectionReadResult *results)                                  \
+    {                                                                                              \
+        for (size_t i = 0; i < count; ++i)                                                         \
+        {                                                                                          \
+            results[i] = rnConnectionReadPacket(connections[i], buffers[i]);                       \
+        }                                                                                          \
+    }
+
+RN_CONNECTION_READ_EACH_IMPL(Encrypted, IPv4, Secure)
+RN_CONNECTION_READ_EACH_IMPL(Encrypted, IPv6, Secure)
+
+RN_CONNECTION_READ_EACH_IMPL(Insecure, IPv4, Insecure)
+RN_CONNECTION_READ_EACH_IMPL(Insecure, IPv6, Insecure)
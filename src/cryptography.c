@@ -1,4 +1,7 @@
 #include "../include/rnlib/cryptography.h"
+#include "../include/rnlib/packet.h"
+
+#include <string.h>
 
 #ifdef _WIN32
     #define SODIUM_STATIC 1
@@ -13,13 +16,105 @@ int rnKeyPairGenerateEphemeral(OUT RnKeyPair *out)
 }
 
 int rnKeyPairComputeSessionClient(
-      const KeyPair *client, const KeyBuffer *server_pub, OUT RnKeyPair *out)
+      const RnKeyPair *client, const RnKeyBuffer *server_pub, OUT RnKeyPair *out)
 {
-    return crypto_kx_client_session_keys(out->sec, out->pub, client->pub, client->sec, server_pub);
+    return crypto_kx_client_session_keys(
+          out->sec, out->pub, client->pub, client->sec, *server_pub);
 }
 
 int rnKeyPairComputeSessionServer(
-      const KeyPair *server, const KeyBuffer *client_pub, OUT RnKeyPair *out)
+      const RnKeyPair *server, const RnKeyBuffer *client_pub, OUT RnKeyPair *out)
+{
+    return crypto_kx_server_session_keys(
+          out->sec, out->pub, server->pub, server->sec, *client_pub);
+}
+
+// crypto_kdf contexts are exactly crypto_kdf_CONTEXTBYTES long
+#define RN_SESSION_EPOCH_CONTEXT "rnepoch_"
+
+/**
+ * One step of the ratchet, epoch `epoch` + 1 takes the key derived from that
+ * of `epoch`.
+ */
+static int rxSessionDirectionDerive(struct RnSessionDirection *direction)
+{
+    return crypto_kdf_derive_from_key(
+          direction->next, sizeof direction->next, direction->epoch + 1,
+          RN_SESSION_EPOCH_CONTEXT, direction->key);
+}
+
+static int rxSessionDirectionAdvance(struct RnSessionDirection *direction)
+{
+    memcpy(direction->key, direction->next, sizeof direction->key);
+    ++direction->epoch;
+
+    return rxSessionDirectionDerive(direction);
+}
+
+int rnSessionKeysInit(OUT RnSessionKeys *keys, const RnKeyPair *session)
+{
+    sodium_memzero(keys, sizeof *keys);
+    memcpy(keys->egress.key, session->pub, sizeof keys->egress.key);
+    memcpy(keys->ingress.key, session->sec, sizeof keys->ingress.key);
+
+    int egress_result = rxSessionDirectionDerive(&keys->egress);
+    if (egress_result != RN_OK)
+    {
+        return egress_result;
+    }
+
+    return rxSessionDirectionDerive(&keys->ingress);
+}
+
+void rnSessionKeysClear(RnSessionKeys *keys)
+{
+    sodium_memzero(keys, sizeof *keys);
+}
+
+uint16_t rnSessionKeysEgressPhase(const RnSessionKeys *keys)
+{
+    return keys->egress.epoch & 1 ? RN_PACKET_PROTOCOL_KEY_PHASE : 0;
+}
+
+uint16_t rnSessionKeysIngressPhase(const RnSessionKeys *keys)
+{
+    return keys->ingress.epoch & 1 ? RN_PACKET_PROTOCOL_KEY_PHASE : 0;
+}
+
+int rnSessionKeysEgressAdvance(RnSessionKeys *keys)
+{
+    return rxSessionDirectionAdvance(&keys->egress);
+}
+
+const RnKeyBuffer *rnSessionKeysIngressSelect(
+      RnSessionKeys *keys, uint16_t phase, uint64_t now, OUT enum RnSessionEpoch *epoch)
 {
-    return crypto_kx_client_session_keys(out->sec, out->pub, server->pub, server->sec, client_pub);
+    if ((phase & RN_PACKET_PROTOCOL_KEY_PHASE) == rnSessionKeysIngressPhase(keys))
+    {
+        *epoch = RN_SESSION_EPOCH_CURRENT;
+        return &keys->ingress.key;
+    }
+
+    if (keys->ingress_previous_until != 0)
+    {
+        if (now < keys->ingress_previous_until)
+        {
+            *epoch = RN_SESSION_EPOCH_PREVIOUS;
+            return &keys->ingress_previous;
+        }
+
+        sodium_memzero(keys->ingress_previous, sizeof keys->ingress_previous);
+        keys->ingress_previous_until = 0;
+    }
+
+    *epoch = RN_SESSION_EPOCH_NEXT;
+    return &keys->ingress.next;
+}
+
+int rnSessionKeysIngressAdvance(RnSessionKeys *keys, uint64_t now)
+{
+    memcpy(keys->ingress_previous, keys->ingress.key, sizeof keys->ingress_previous);
+    keys->ingress_previous_until = now + RN_SESSION_EPOCH_OVERLAP_NS;
+
+    return rxSessionDirectionAdvance(&keys->ingress);
 }
@@ -0,0 +1,287 @@
+#include "../include/rnlib/entropy.h"
+
+#include <stdbool.h>
+
+#define RN_ENTROPY_NODES (256 * 2 - 1)
+
+/**
+ * Clamps Huffman code lengths to RN_ENTROPY_CODE_BITS_MAX and rebalances the
+ * length counts until they form a complete prefix code again, then hands the
+ * shortest lengths to the most frequent symbols.
+ */
+static void rxEntropyLimit(const uint64_t *weights, uint8_t *lengths)
+{
+    uint32_t counts[RN_ENTROPY_CODE_BITS_MAX + 1] = { 0 };
+    for (int i = 0; i < 256; ++i)
+    {
+        ++counts[lengths[i] < RN_ENTROPY_CODE_BITS_MAX ? lengths[i] : RN_ENTROPY_CODE_BITS_MAX];
+    }
+
+    uint32_t total = 0;
+    for (int length = 1; length <= RN_ENTROPY_CODE_BITS_MAX; ++length)
+    {
+        total += counts[length] << (RN_ENTROPY_CODE_BITS_MAX - length);
+    }
+
+    // moving a leaf from the longest length under a shorter one frees one slot
+    while (total > RN_ENTROPY_LOOKUP_SIZE)
+    {
+        --counts[RN_ENTROPY_CODE_BITS_MAX];
+        for (int length = RN_ENTROPY_CODE_BITS_MAX - 1; length > 0; --length)
+        {
+            if (counts[length] > 0)
+            {
+                --counts[length];
+                counts[length + 1] += 2;
+                break;
+            }
+        }
+
+        --total;
+    }
+
+    uint8_t order[256];
+    for (int i = 0; i < 256; ++i)
+    {
+        order[i] = (uint8_t)i;
+    }
+
+    // insertion sort by descending weight, stable so ties keep symbol order
+    for (int i = 1; i < 256; ++i)
+    {
+        uint8_t symbol = order[i];
+        int j          = i;
+        for (; j > 0 && weights[order[j - 1]] < weights[symbol]; --j)
+        {
+            order[j] = order[j - 1];
+        }
+
+        order[j] = symbol;
+    }
+
+    int next = 0;
+    for (int length = 1; length <= RN_ENTROPY_CODE_BITS_MAX; ++length)
+    {
+        for (uint32_t i = 0; i < counts[length]; ++i)
+        {
+            lengths[order[next++]] = (uint8_t)length;
+        }
+    }
+}
+
+void rnEntropyTrain(const uint64_t frequencies[256], OUT uint8_t table[RN_ENTROPY_TABLE_BYTES])
+{
+    uint64_t weights[RN_ENTROPY_NODES];
+    int parents[RN_ENTROPY_NODES];
+    bool active[RN_ENTROPY_NODES] = { false };
+
+    for (int i = 0; i < 256; ++i)
+    {
+        weights[i] = frequencies[i] ? frequencies[i] : 1;
+        active[i]  = true;
+    }
+
+    // plain quadratic Huffman construction, training runs offline
+    for (int node = 256; node < RN_ENTROPY_NODES; ++node)
+    {
+        int smallest[2] = { -1, -1 };
+        for (int i = 0; i < node; ++i)
+        {
+            if (!active[i])
+            {
+                continue;
+            }
+
+            if (smallest[0] < 0 || weights[i] < weights[smallest[0]])
+            {
+                smallest[1] = smallest[0];
+                smallest[0] = i;
+            }
+            else if (smallest[1] < 0 || weights[i] < weights[smallest[1]])
+            {
+                smallest[1] = i;
+            }
+        }
+
+        weights[node]        = weights[smallest[0]] + weights[smallest[1]];
+        parents[smallest[0]] = node;
+        parents[smallest[1]] = node;
+        active[smallest[0]]  = false;
+        active[smallest[1]]  = false;
+        active[node]         = true;
+    }
+
+    uint8_t lengths[256];
+    for (int i = 0; i < 256; ++i)
+    {
+        int depth = 0;
+        for (int node = i; node != RN_ENTROPY_NODES - 1; node = parents[node])
+        {
+            ++depth;
+        }
+
+        lengths[i] = (uint8_t)(depth < 255 ? depth : 255);
+    }
+
+    rxEntropyLimit(weights, lengths);
+
+    for (int i = 0; i < RN_ENTROPY_TABLE_BYTES; ++i)
+    {
+        table[i] = (uint8_t)(lengths[i * 2] | lengths[i * 2 + 1] << 4);
+    }
+}
+
+int rnEntropyModelCreate(const uint8_t table[RN_ENTROPY_TABLE_BYTES], OUT RnEntropyModel *model)
+{
+    uint32_t counts[RN_ENTROPY_CODE_BITS_MAX + 1] = { 0 };
+    uint32_t total                                = 0;
+
+    for (int i = 0; i < 256; ++i)
+    {
+        uint8_t length = (table[i / 2] >> (i % 2 * 4)) & 0xF;
+        if (length == 0 || length > RN_ENTROPY_CODE_BITS_MAX)
+        {
+            return RN_OOM;
+        }
+
+        model->lengths[i] = length;
+        ++counts[length];
+        total += 1u << (RN_ENTROPY_CODE_BITS_MAX - length);
+    }
+
+    // an incomplete code would leave lookup entries unassigned
+    if (total != RN_ENTROPY_LOOKUP_SIZE)
+    {
+        return RN_OOM;
+    }
+
+    // canonical code assignment as in deflate
+    uint32_t next[RN_ENTROPY_CODE_BITS_MAX + 1];
+    uint32_t code = 0;
+    for (int length = 1; length <= RN_ENTROPY_CODE_BITS_MAX; ++length)
+    {
+        code         = (code + counts[length - 1]) << 1;
+        next[length] = code;
+    }
+
+    for (int symbol = 0; symbol < 256; ++symbol)
+    {
+        uint8_t length   = model->lengths[symbol];
+        uint32_t forward = next[length]++;
+
+        uint32_t reversed = 0;
+        for (uint8_t bit = 0; bit < length; ++bit)
+        {
+            reversed |= ((forward >> bit) & 1) << (length - 1 - bit);
+        }
+
+        model->codes[symbol] = (uint16_t)reversed;
+        for (uint32_t index = reversed; index < RN_ENTROPY_LOOKUP_SIZE; index += 1u << length)
+        {
+            model->lookup[index] = (uint16_t)(symbol << 4 | length);
+        }
+    }
+
+    return RN_OK;
+}
+
+const RnEntropyModel *rnEntropyConfigModel(const RnEntropyConfig *config, uint16_t type)
+{
+    for (int i = 0; i < RN_ENTROPY_TYPES_MAX; ++i)
+    {
+        if (config->types[i].model != NULL && config->types[i].type == type)
+        {
+            return config->types[i].model;
+        }
+    }
+
+    return NULL;
+}
+
+int rnEntropyEncode(
+      const RnEntropyModel *model, const uint8_t *data, size_t data_size, OUT uint8_t *out,
+      size_t out_capacity, OUT size_t *out_size)
+{
+    if (data_size > UINT16_MAX || out_capacity < RN_ENTROPY_PREFIX_BYTES)
+    {
+        return RN_OOM;
+    }
+
+    out[0] = (uint8_t)data_size;
+    out[1] = (uint8_t)(data_size >> 8);
+
+    size_t size   = RN_ENTROPY_PREFIX_BYTES;
+    uint64_t acc  = 0;
+    uint32_t fill = 0;
+
+    for (size_t i = 0; i < data_size; ++i)
+    {
+        acc |= (uint64_t)model->codes[data[i]] << fill;
+        fill += model->lengths[data[i]];
+
+        for (; fill >= 8; fill -= 8, acc >>= 8)
+        {
+            if (size == out_capacity)
+            {
+                return RN_OOM;
+            }
+
+            out[size++] = (uint8_t)acc;
+        }
+    }
+
+    if (fill > 0)
+    {
+        if (size == out_capacity)
+        {
+            return RN_OOM;
+        }
+
+        out[size++] = (uint8_t)acc;
+    }
+
+    *out_size = size;
+    return RN_OK;
+}
+
+int rnEntropyDecode(
+      const RnEntropyModel *model, const uint8_t *data, size_t data_size, OUT uint8_t *out,
+      size_t out_capacity, OUT size_t *out_size)
+{
+    if (data_size < RN_ENTROPY_PREFIX_BYTES)
+    {
+        return RN_OOM;
+    }
+
+    size_t size = (size_t)data[0] | (size_t)data[1] << 8;
+    if (size > out_capacity)
+    {
+        return RN_OOM;
+    }
+
+    size_t position = RN_ENTROPY_PREFIX_BYTES;
+    uint64_t acc    = 0;
+    uint32_t fill   = 0;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        for (; fill <= 56 && position < data_size; fill += 8)
+        {
+            acc |= (uint64_t)data[position++] << fill;
+        }
+
+        uint16_t entry = model->lookup[acc & (RN_ENTROPY_LOOKUP_SIZE - 1)];
+        uint8_t length = entry & 0xF;
+        if (length > fill)
+        {
+            return RN_OOM;
+        }
+
+        out[i] = (uint8_t)(entry >> 4);
+        acc >>= length;
+        fill -= length;
+    }
+
+    *out_size = size;
+    return RN_OK;
+}
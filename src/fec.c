@@ -0,0 +1,225 @@
+#include "../include/rnlib/fec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RN_FEC_PAYLOAD_QWORDS (RN_FEC_PAYLOAD_MAX / 8)
+#define RN_FEC_PARITY_HEADER  6
+
+/**
+ * Egress group under construction and ingress history of one protected type.
+ * Payloads are kept zero padded to whole qwords, so that members of different
+ * sizes fold into the parity qword by qword.
+ */
+struct RxFecStream
+{
+    uint16_t type;
+    uint8_t group_size;
+
+    uint8_t count;
+    uint16_t size_xor;
+    uint16_t size_max;
+    uint16_t sequences[RN_FEC_GROUP_MAX];
+    uint64_t parity[RN_FEC_PAYLOAD_QWORDS];
+
+    uint8_t next;
+    uint16_t held;
+    uint16_t history_sequences[RN_FEC_GROUP_MAX];
+    uint16_t history_sizes[RN_FEC_GROUP_MAX];
+    uint64_t history[RN_FEC_GROUP_MAX][RN_FEC_PAYLOAD_QWORDS];
+};
+
+struct RnFec
+{
+    struct RxFecStream streams[RN_FEC_TYPES_MAX];
+    uint32_t count;
+};
+
+static struct RxFecStream *rxFecStream(const RnFec *fec, uint16_t type)
+{
+    for (uint32_t i = 0; i < fec->count; ++i)
+    {
+        if (fec->streams[i].type == type)
+        {
+            return (struct RxFecStream *)&fec->streams[i];
+        }
+    }
+
+    return NULL;
+}
+
+static inline void rxFecFold(uint64_t *target, const uint64_t *source, size_t qwords)
+{
+    for (size_t i = 0; i < qwords; ++i)
+    {
+        target[i] ^= source[i];
+    }
+}
+
+int rnFecOpen(const RnFecConfig *config, OUT RnFec **out)
+{
+    *out = calloc(1, sizeof(RnFec));
+    if (*out == NULL)
+    {
+        return RN_OOM;
+    }
+
+    for (int i = 0; i < RN_FEC_TYPES_MAX; ++i)
+    {
+        uint8_t group_size = config->types[i].group_size;
+        if (group_size == 0 || rxFecStream(*out, config->types[i].type) != NULL)
+        {
+            continue;
+        }
+
+        struct RxFecStream *stream = &(*out)->streams[(*out)->count++];
+        stream->type               = config->types[i].type;
+        stream->group_size = group_size < 2 ? 2
+                           : group_size > RN_FEC_GROUP_MAX ? RN_FEC_GROUP_MAX
+                                                           : group_size;
+    }
+
+    return RN_OK;
+}
+
+void rnFecClose(IN RnFec *fec)
+{
+    free(fec);
+}
+
+bool rnFecProtects(const RnFec *fec, uint16_t type)
+{
+    return rxFecStream(fec, type) != NULL;
+}
+
+bool rnFecEncode(
+      RnFec *fec, uint16_t type, uint16_t sequence, const void *data, size_t size,
+      OUT uint8_t parity[RN_FEC_PARITY_BYTES_MAX], OUT size_t *parity_size)
+{
+    struct RxFecStream *stream = rxFecStream(fec, type);
+    if (stream == NULL || size == 0 || size > RN_FEC_PAYLOAD_MAX)
+    {
+        return false;
+    }
+
+    uint64_t payload[RN_FEC_PAYLOAD_QWORDS] = { 0 };
+    memcpy(payload, data, size);
+    rxFecFold(stream->parity, payload, (size + 7) / 8);
+
+    stream->size_xor ^= (uint16_t)size;
+    stream->size_max = size > stream->size_max ? (uint16_t)size : stream->size_max;
+    stream->sequences[stream->count++] = sequence;
+    if (stream->count < stream->group_size)
+    {
+        return false;
+    }
+
+    // type, count, reserved, size XOR, sequences, parity
+    uint8_t *cursor = parity;
+    memcpy(cursor, &stream->type, sizeof stream->type);
+    cursor[2] = stream->count;
+    cursor[3] = 0;
+    memcpy(cursor + 4, &stream->size_xor, sizeof stream->size_xor);
+    cursor += RN_FEC_PARITY_HEADER;
+
+    memcpy(cursor, stream->sequences, stream->count * sizeof *stream->sequences);
+    cursor += stream->count * sizeof *stream->sequences;
+
+    memcpy(cursor, stream->parity, stream->size_max);
+    *parity_size = (size_t)(cursor - parity) + stream->size_max;
+
+    memset(stream->parity, 0, sizeof stream->parity);
+    stream->count    = 0;
+    stream->size_xor = 0;
+    stream->size_max = 0;
+    return true;
+}
+
+void rnFecRemember(RnFec *fec, uint16_t type, uint16_t sequence, const void *data, size_t size)
+{
+    struct RxFecStream *stream = rxFecStream(fec, type);
+    if (stream == NULL || size == 0 || size > RN_FEC_PAYLOAD_MAX)
+    {
+        return;
+    }
+
+    uint8_t index = stream->next;
+    stream->next  = (uint8_t)((index + 1) % RN_FEC_GROUP_MAX);
+    stream->held |= (uint16_t)(1u << index);
+
+    stream->history_sequences[index] = sequence;
+    stream->history_sizes[index]     = (uint16_t)size;
+    memset(stream->history[index], 0, sizeof stream->history[index]);
+    memcpy(stream->history[index], data, size);
+}
+
+static int rxFecHeld(const struct RxFecStream *stream, uint16_t sequence)
+{
+    for (int i = 0; i < RN_FEC_GROUP_MAX; ++i)
+    {
+        if ((stream->held & (1u << i)) && stream->history_sequences[i] == sequence)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool rnFecRecover(
+      RnFec *fec, const void *parity, size_t parity_size, OUT uint16_t *type,
+      OUT uint16_t *sequence, OUT void *data, OUT size_t *size)
+{
+    const uint8_t *cursor = parity;
+    if (parity_size < RN_FEC_PARITY_HEADER)
+    {
+        return false;
+    }
+
+    uint16_t size_xor;
+    memcpy(type, cursor, sizeof *type);
+    memcpy(&size_xor, cursor + 4, sizeof size_xor);
+
+    uint8_t count              = cursor[2];
+    size_t sequences_size      = count * sizeof(uint16_t);
+    struct RxFecStream *stream = rxFecStream(fec, *type);
+    if (stream == NULL || count < 2 || count > RN_FEC_GROUP_MAX ||
+        parity_size < RN_FEC_PARITY_HEADER + sequences_size ||
+        parity_size - RN_FEC_PARITY_HEADER - sequences_size > RN_FEC_PAYLOAD_MAX)
+    {
+        return false;
+    }
+
+    uint16_t sequences[RN_FEC_GROUP_MAX];
+    memcpy(sequences, cursor + RN_FEC_PARITY_HEADER, sequences_size);
+    cursor += RN_FEC_PARITY_HEADER + sequences_size;
+
+    size_t parity_length = parity_size - RN_FEC_PARITY_HEADER - sequences_size;
+    uint64_t payload[RN_FEC_PAYLOAD_QWORDS] = { 0 };
+    memcpy(payload, cursor, parity_length);
+
+    // every member but the missing one cancels out of the parity
+    int missing = 0;
+    for (uint8_t i = 0; i < count; ++i)
+    {
+        int index = rxFecHeld(stream, sequences[i]);
+        if (index < 0)
+        {
+            *sequence = sequences[i];
+            ++missing;
+            continue;
+        }
+
+        rxFecFold(payload, stream->history[index], RN_FEC_PAYLOAD_QWORDS);
+        size_xor ^= stream->history_sizes[index];
+    }
+
+    if (missing != 1 || size_xor == 0 || size_xor > parity_length)
+    {
+        return false;
+    }
+
+    memcpy(data, payload, size_xor);
+    *size = size_xor;
+    return true;
+}
@@ -0,0 +1,129 @@
+#include "../include/rnlib/filter.h"
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+    #define SODIUM_STATIC 1
+    #define SODIUM_EXPORT
+#endif
+
+#include <sodium.h>
+
+// FNV-1a over the source with the row key as offset basis
+static uint32_t rxFilterHash(uint64_t key, const void *source, size_t size)
+{
+    const uint8_t *bytes = source;
+    uint64_t hash        = key;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+
+    return (uint32_t)(hash ^ hash >> 32);
+}
+
+static void rxFilterDrain(RnFilter *filter, uint64_t now)
+{
+    uint64_t elapsed = now - filter->drained_at;
+    uint64_t tokens  = elapsed / 1000 * filter->rate / 1000000;
+    if (elapsed < RN_FILTER_DRAIN_NS || tokens == 0)
+    {
+        return;
+    }
+
+    // fractions of a token carry over to the next drain
+    if (tokens >= filter->burst)
+    {
+        tokens             = filter->burst;
+        filter->drained_at = now;
+    }
+    else
+    {
+        filter->drained_at += tokens * 1000000000ull / filter->rate;
+    }
+
+    size_t count = (size_t)RN_FILTER_DEPTH * (filter->mask + 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint16_t counter    = filter->counters[i];
+        filter->counters[i] = counter > tokens ? (uint16_t)(counter - tokens) : 0;
+    }
+}
+
+int rnFilterInit(OUT RnFilter *filter, const RnFilterConfig *config, uint64_t now)
+{
+    uint32_t width = config->width ? config->width : RN_FILTER_WIDTH_DEFAULT;
+    uint32_t size  = 1;
+    while (size < width)
+    {
+        size <<= 1;
+    }
+
+    uint32_t open_rate  = config->open_rate ? config->open_rate : RN_FILTER_OPEN_RATE_DEFAULT;
+    uint16_t open_burst = config->open_burst ? config->open_burst : RN_FILTER_OPEN_BURST_DEFAULT;
+    uint64_t interval   = 1000000000ull / open_rate;
+
+    *filter = (RnFilter) {
+        .counters       = calloc((size_t)RN_FILTER_DEPTH * size, sizeof(uint16_t)),
+        .mask           = size - 1,
+        .rate           = config->rate ? config->rate : RN_FILTER_RATE_DEFAULT,
+        .burst          = config->burst ? config->burst : RN_FILTER_BURST_DEFAULT,
+        .drained_at     = now,
+        .open_interval  = interval,
+        .open_tolerance = interval * (open_burst - 1),
+        .open_at        = now,
+    };
+
+    randombytes_buf(filter->keys, sizeof filter->keys);
+    return filter->counters != NULL ? RN_OK : RN_OOM;
+}
+
+void rnFilterFree(RnFilter *filter)
+{
+    free(filter->counters);
+    filter->counters = NULL;
+}
+
+bool rnFilterAdmit(RnFilter *filter, const void *source, size_t size, uint64_t now)
+{
+    rxFilterDrain(filter, now);
+
+    uint16_t *counters[RN_FILTER_DEPTH];
+    uint16_t spent = UINT16_MAX;
+    for (int row = 0; row < RN_FILTER_DEPTH; ++row)
+    {
+        uint32_t column = rxFilterHash(filter->keys[row], source, size) & filter->mask;
+        counters[row]   = &filter->counters[(size_t)row * (filter->mask + 1) + column];
+        spent           = *counters[row] < spent ? *counters[row] : spent;
+    }
+
+    if (spent >= filter->burst)
+    {
+        return false;
+    }
+
+    // conservative update, counters already above the new estimate belong to other sources
+    for (int row = 0; row < RN_FILTER_DEPTH; ++row)
+    {
+        if (*counters[row] <= spent)
+        {
+            *counters[row] = spent + 1;
+        }
+    }
+
+    return true;
+}
+
+// generic cell rate algorithm, the bucket is full once `open_at` lies in the past
+bool rnFilterAdmitOpen(RnFilter *filter, uint64_t now)
+{
+    uint64_t due = filter->open_at > now ? filter->open_at : now;
+    if (due - now > filter->open_tolerance)
+    {
+        return false;
+    }
+
+    filter->open_at = due + filter->open_interval;
+    return true;
+}
@@ -1,62 +1,136 @@
 #include "../include/rnlib/handshake.h"
+#include "../include/rnlib/schema.h"
 
-struct RnHandshakeSecure
-{
-    enum RnHandshakeStep step;
-    RnKeyBuffer pubkey;
-    uint64_t context;
-};
+#include <string.h>
 
-struct RnHandshakeInsecure
-{
-    enum RnHandshakeStep step;
-    uint64_t salt;
-};
+#ifdef _WIN32
+    #define SODIUM_STATIC 1
+    #define SODIUM_EXPORT
+#endif
+
+#include <sodium.h>
+
+/**
+ * Handshake packets consist of the handshake step followed by the 64 bit
+ * context or salt. Secure client connects and server challenges append the
+ * sender's public key.
+ */
+#define RN_HANDSHAKE_TOKEN_FIELDS(FIELD)                                                           \
+    FIELD(step, uint8_t, 8)                                                                        \
+    FIELD(token, uint64_t, 64)
 
-RnHandshakeSecure rnHandshakeCreateSecure(const RnKeyBuffer *pubkey)
+RN_SCHEMA_DEFINE(HandshakeToken, RN_HANDSHAKE_TOKEN_FIELDS)
+
+RnHandshakeSecure rnHandshakeCreateSecure(const RnKeyPair *keys)
 {
-    return RnHandshakeSecure {
+    return (RnHandshakeSecure) {
         .step    = RN_HANDSHAKE_DISCONNECTED,
-        .pubkey  = *pubkey,
+        .keys    = *keys,
         .context = 0,
     };
 }
 
-RnHandshakeSecure rnHandshakeCreateSecure(uint64_t salt)
+RnHandshakeInsecure rnHandshakeCreateInsecure(uint64_t salt)
 {
-    return RnHandshakeSecure {
+    return (RnHandshakeInsecure) {
         .step = RN_HANDSHAKE_DISCONNECTED,
         .salt = salt,
     };
 }
 
-bool rnHandshakeReadPacketClient(RnHandshakeSecure *handshake, const RnPacketBufferSecure *buffer)
+// derives the session once the peer's public key arrived, the secret key is no longer needed
+static bool rxHandshakeDerive(RnHandshakeSecure *handshake, bool client)
+{
+    int result = client ? rnKeyPairComputeSessionClient(
+                                &handshake->keys, &handshake->pubkey, &handshake->session)
+                        : rnKeyPairComputeSessionServer(
+                                &handshake->keys, &handshake->pubkey, &handshake->session);
+
+    sodium_memzero(handshake->keys.sec, sizeof handshake->keys.sec);
+    handshake->session_ready = result == RN_OK;
+    return handshake->session_ready;
+}
+
+bool rnHandshakeTakeSession(RnHandshakeSecure *handshake, OUT RnKeyPair *out)
 {
-    if (buffer.header.type != RN_HANDSHAKE_PACKET_TYPE)
+    if (!handshake->session_ready)
     {
-        return handshake->step == RN_HANDSHAKE_CONNECTED;
+        return false;
     }
 
-    uint8_t type;
-    int type_result = rnPacketBufferDeserializeUInt8(b, &type);
-    if (type_result != RN_OK)
+    *out = handshake->session;
+    sodium_memzero(&handshake->session, sizeof handshake->session);
+    handshake->session_ready = false;
+    return true;
+}
+
+/**
+ * Reads the step and token of a handshake packet, false for other packets and
+ * handshake packets too short to carry them.
+ */
+#define RN_HANDSHAKE_TOKEN_IMPL(BUFFER)                                                            \
+    static bool rxHandshakeReadToken##BUFFER(                                                      \
+          const RnPacketBuffer##BUFFER *buffer, OUT RnSchemaHandshakeToken *token)                 \
+    {                                                                                              \
+        if (buffer->head.type != RN_HANDSHAKE_PACKET_TYPE ||                                       \
+            buffer->meta.body_size < (RN_SCHEMA_BITS(HandshakeToken) + 7) / 8)                     \
+        {                                                                                          \
+            return false;                                                                          \
+        }                                                                                          \
+                                                                                                   \
+        rnSchemaReadHandshakeToken(buffer->body, token);                                           \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static RnPacketBufferCursor rxHandshakeWriteToken##BUFFER(                                     \
+          OUT RnPacketBuffer##BUFFER *buffer, enum RnHandshakeStep step, uint64_t value)           \
+    {                                                                                              \
+        *buffer                      = rnPacketBufferCreate##BUFFER(RN_HANDSHAKE_PACKET_TYPE);     \
+        RnSchemaHandshakeToken token = { (uint8_t)step, value };                                   \
+                                                                                                   \
+        rnSchemaWriteHandshakeToken(buffer->body, &token);                                         \
+        RnPacketBufferCursor cursor = RN_SCHEMA_CURSOR(HandshakeToken);                            \
+        rnPacketBufferCommit(buffer, &cursor);                                                     \
+        return cursor;                                                                             \
+    }
+
+RN_HANDSHAKE_TOKEN_IMPL(Secure)
+RN_HANDSHAKE_TOKEN_IMPL(Insecure)
+
+// the public key follows the token
+static bool rxHandshakeReadKey(const RnPacketBufferSecure *buffer, OUT RnKeyBuffer *key)
+{
+    RnPacketBufferCursor cursor = RN_SCHEMA_CURSOR(HandshakeToken);
+    return rnPacketBufferReadKey(buffer, &cursor, key) == RN_OK;
+}
+
+bool rnHandshakeReadPacketClientSecure(
+      RnHandshakeSecure *handshake, const RnPacketBufferSecure *buffer)
+{
+    RnSchemaHandshakeToken token;
+    if (!rxHandshakeReadTokenSecure(buffer, &token))
     {
-        return false;
+        // a verified packet of the session implies the confirmation that got lost
+        if (buffer->head.type != RN_HANDSHAKE_PACKET_TYPE &&
+            handshake->step == RN_HANDSHAKE_CLIENT_RESPONSE)
+        {
+            handshake->step = RN_HANDSHAKE_CONNECTED;
+        }
+
+        return handshake->step == RN_HANDSHAKE_CONNECTED;
     }
 
-    switch (type)
+    switch (token.step)
     {
         case RN_HANDSHAKE_SERVER_CHALLENGE:
         {
-            if (handshake->step == RN_HANDSHAKE_CLIENT_CONNECT)
+            if (handshake->step == RN_HANDSHAKE_CLIENT_CONNECT &&
+                rxHandshakeReadKey(buffer, &handshake->pubkey))
             {
-                uint64_t context;
-                RnPacketBufferCursor cursor = rnPacketBufferCursorInitRead(meta);
-                int result = rnPacketBufferDeserializeUInt64(buffer, cursor, &context);
-                if (result == RN_OK)
-                {
-                    handshake->context = context;
+                handshake->context = token.token;
 
+                if (rxHandshakeDerive(handshake, true))
+                {
                     handshake->step = RN_HANDSHAKE_SERVER_CHALLENGE;
                 }
             }
@@ -66,48 +140,42 @@ bool rnHandshakeReadPacketClient(RnHandshakeSecure *handshake, const RnPacketBuf
 
         case RN_HANDSHAKE_SERVER_CONNECTED:
         {
-            if (handshake->step == RN_HANDSHAKE_CLIENT_RESPONSE)
+            if (handshake->step == RN_HANDSHAKE_CLIENT_RESPONSE &&
+                token.token == handshake->context)
             {
-                handshake->step = RN_HANDSHAKE_SERVER_CONNECTED;
+                handshake->step = RN_HANDSHAKE_CONNECTED;
             }
 
             break;
         }
     }
 
-    return false;
+    return handshake->step == RN_HANDSHAKE_CONNECTED;
 }
 
-bool rnHandshakeReadPacketClient(
+bool rnHandshakeReadPacketClientInsecure(
       RnHandshakeInsecure *handshake, const RnPacketBufferInsecure *buffer)
 {
-    if (buffer.header.type != RN_HANDSHAKE_PACKET_TYPE)
+    RnSchemaHandshakeToken token;
+    if (!rxHandshakeReadTokenInsecure(buffer, &token))
     {
-        return handshake->step == RN_HANDSHAKE_CONNECTED;
-    }
+        if (buffer->head.type != RN_HANDSHAKE_PACKET_TYPE &&
+            handshake->step == RN_HANDSHAKE_CLIENT_RESPONSE)
+        {
+            handshake->step = RN_HANDSHAKE_CONNECTED;
+        }
 
-    uint8_t type;
-    int type_result = rnPacketBufferDeserializeUInt8(b, &type);
-    if (type_result != RN_OK)
-    {
-        return false;
+        return handshake->step == RN_HANDSHAKE_CONNECTED;
     }
 
-    switch (type)
+    switch (token.step)
     {
         case RN_HANDSHAKE_SERVER_CHALLENGE:
         {
             if (handshake->step == RN_HANDSHAKE_CLIENT_CONNECT)
             {
-                uint64_t salt;
-                RnPacketBufferCursor cursor = rnPacketBufferCursorInitRead(meta);
-                int result = rnPacketBufferDeserializeUInt64(buffer, cursor, &salt);
-                if (result == RN_OK)
-                {
-                    handshake->salt ^= salt;
-
-                    handshake->step = RN_HANDSHAKE_SERVER_CHALLENGE;
-                }
+                handshake->salt ^= token.token;
+                handshake->step = RN_HANDSHAKE_SERVER_CHALLENGE;
             }
 
             break;
@@ -115,31 +183,30 @@ bool rnHandshakeReadPacketClient(
 
         case RN_HANDSHAKE_SERVER_CONNECTED:
         {
-            if (handshake->step == RN_HANDSHAKE_CLIENT_RESPONSE)
+            if (handshake->step == RN_HANDSHAKE_CLIENT_RESPONSE && token.token == handshake->salt)
             {
-                handshake->step = RN_HANDSHAKE_SERVER_CONNECTED;
+                handshake->step = RN_HANDSHAKE_CONNECTED;
             }
 
             break;
         }
     }
 
-    return false;
+    return handshake->step == RN_HANDSHAKE_CONNECTED;
 }
 
-bool rnHandshakeWritePacketClient(RnHandshakeSecure *handshake, OUT RnPacketBufferSecure *buffer)
+bool rnHandshakeWritePacketClientSecure(
+      RnHandshakeSecure *handshake, OUT RnPacketBufferSecure *buffer)
 {
     switch (handshake->step)
     {
         case RN_HANDSHAKE_DISCONNECTED:
         case RN_HANDSHAKE_CLIENT_CONNECT:
         {
-            *buffer                     = rnPacketBufferCreateSecure(RN_HANDSHAKE_PACKET_TYPE);
-            RnPacketBufferCursor cursor = rnPacketBufferCursorInitWrite();
-
-            rnPacketBufferSerializeUInt8(buffer, cursor, RN_HANDSHAKE_CLIENT_CONNECT);
-            rnPacketBufferSerializeKeyBuffer(buffer, cursor, handshake->pubkey);
-            rnPacketBufferSerializePadding(buffer, cursor);
+            RnPacketBufferCursor cursor =
+                  rxHandshakeWriteTokenSecure(buffer, RN_HANDSHAKE_CLIENT_CONNECT, 0);
+            rnPacketBufferWriteKey(buffer, &cursor, &handshake->keys.pub);
+            rnPacketBufferWritePadding(buffer, &cursor);
 
             handshake->step = RN_HANDSHAKE_CLIENT_CONNECT;
             return true;
@@ -148,22 +215,22 @@ bool rnHandshakeWritePacketClient(RnHandshakeSecure *handshake, OUT RnPacketBuff
         case RN_HANDSHAKE_SERVER_CHALLENGE:
         case RN_HANDSHAKE_CLIENT_RESPONSE:
         {
-            *buffer                     = rnPacketBufferCreateSecure(RN_HANDSHAKE_PACKET_TYPE);
-            RnPacketBufferCursor cursor = rnPacketBufferCursorInitWrite();
-
-            rnPacketBufferSerializeUInt8(buffer, cursor, RN_HANDSHAKE_CLIENT_RESPONSE);
-            rnPacketBufferSerializeUInt64(buffer, cursor, handshake->context);
-            rnPacketBufferSerializePadding(buffer, cursor);
+            RnPacketBufferCursor cursor = rxHandshakeWriteTokenSecure(
+                  buffer, RN_HANDSHAKE_CLIENT_RESPONSE, handshake->context);
+            rnPacketBufferWritePadding(buffer, &cursor);
 
             handshake->step = RN_HANDSHAKE_CLIENT_RESPONSE;
             return true;
         }
-    }
 
-    return false;
+        default:
+        {
+            return false;
+        }
+    }
 }
 
-bool rnHandshakeWritePacketClient(
+bool rnHandshakeWritePacketClientInsecure(
       RnHandshakeInsecure *handshake, OUT RnPacketBufferInsecure *buffer)
 {
     switch (handshake->step)
@@ -171,12 +238,9 @@ bool rnHandshakeWritePacketClient(
         case RN_HANDSHAKE_DISCONNECTED:
         case RN_HANDSHAKE_CLIENT_CONNECT:
         {
-            *buffer                     = rnPacketBufferCreateInsecure(RN_HANDSHAKE_PACKET_TYPE);
-            RnPacketBufferCursor cursor = rnPacketBufferCursorInitWrite();
-
-            rnPacketBufferSerializeUInt8(buffer, cursor, RN_HANDSHAKE_CLIENT_CONNECT);
-            rnPacketBufferSerializeUInt64(buffer, cursor, handshake->salt);
-            rnPacketBufferSerializePadding(buffer, cursor);
+            RnPacketBufferCursor cursor = rxHandshakeWriteTokenInsecure(
+                  buffer, RN_HANDSHAKE_CLIENT_CONNECT, handshake->salt);
+            rnPacketBufferWritePadding(buffer, &cursor);
 
             handshake->step = RN_HANDSHAKE_CLIENT_CONNECT;
             return true;
@@ -185,160 +249,209 @@ bool rnHandshakeWritePacketClient(
         case RN_HANDSHAKE_SERVER_CHALLENGE:
         case RN_HANDSHAKE_CLIENT_RESPONSE:
         {
-            *buffer                     = rnPacketBufferCreateInsecure(RN_HANDSHAKE_PACKET_TYPE);
-            RnPacketBufferCursor cursor = rnPacketBufferCursorInitWrite();
-
-            rnPacketBufferSerializeUInt8(buffer, cursor, RN_HANDSHAKE_CLIENT_RESPONSE);
-            rnPacketBufferSerializeUInt64(buffer, cursor, handshake->salt);
-            rnPacketBufferSerializePadding(buffer, cursor);
+            RnPacketBufferCursor cursor = rxHandshakeWriteTokenInsecure(
+                  buffer, RN_HANDSHAKE_CLIENT_RESPONSE, handshake->salt);
+            rnPacketBufferWritePadding(buffer, &cursor);
 
             handshake->step = RN_HANDSHAKE_CLIENT_RESPONSE;
             return true;
         }
-    }
 
-    return false;
+        default:
+        {
+            return false;
+        }
+    }
 }
 
-bool rnHandshakeReadPacketServer(RnHandshakeSecure *handshake, RnPacketBuffer *buffer)
-{
-    if (buffer.header.type != RN_HANDSHAKE_PACKET_TYPE)
-    {
-        return step == RN_HANDSHAKE_SERVER_CONNECTED;
+/**
+ * Clients pad their handshake packets to the base datagram size, answers never
+ * exceed them and can't amplify spoofed traffic.
+ */
+#define RN_HANDSHAKE_SERVER_TOKEN_IMPL(BUFFER)                                                     \
+    static bool rxHandshakeServerToken##BUFFER(                                                    \
+          const RnPacketBuffer##BUFFER *buffer, OUT RnSchemaHandshakeToken *token)                 \
+    {                                                                                              \
+        return rnPacketBufferWireSize(buffer) == RN_PACKET_BYTES_BASE &&                           \
+               rxHandshakeReadToken##BUFFER(buffer, token);                                        \
     }
 
-    if (buffer.meta.body_size != 1232)
-    {
-        return false;
-    }
+RN_HANDSHAKE_SERVER_TOKEN_IMPL(Secure)
+RN_HANDSHAKE_SERVER_TOKEN_IMPL(Insecure)
 
-    uint8_t type;
-    int type_result = rnPacketBufferDeserializeUInt8(b, &type);
-    if (type_result != RN_OK)
+bool rnHandshakeReadPacketServerSecure(
+      RnHandshakeSecure *handshake, const RnPacketBufferSecure *buffer)
+{
+    RnSchemaHandshakeToken token;
+    if (!rxHandshakeServerTokenSecure(buffer, &token))
     {
-        return false;
+        return handshake->step == RN_HANDSHAKE_CONNECTED;
     }
 
-    switch (type)
+    switch (token.step)
     {
         case RN_HANDSHAKE_CLIENT_CONNECT:
         {
-            switch (handshake->step)
+            if (handshake->step == RN_HANDSHAKE_DISCONNECTED &&
+                rxHandshakeReadKey(buffer, &handshake->pubkey))
             {
-                case RN_HANDSHAKE_DISCONNECTED:
+                // never 0, which connection ids reserve for handshake packets
+                do
                 {
-                    RnKeyBuffer key;
-                    RnPacketBufferCursor cursor = rnPacketBufferCursorInitRead(meta);
-                    int result = rnPacketBufferDeserializeKeyBuffer(buffer, cursor, &key);
-                    if (result == RN_OK)
-                    {
-                        handshake->pubkey = key;
-
-                        stage = RN_HANDSHAKE_CLIENT_CONNECT;
-                    }
+                    randombytes_buf(&handshake->context, sizeof handshake->context);
+                } while ((uint32_t)handshake->context == 0);
 
-                    break;
-                }
-
-                case RN_HANDSHAKE_SERVER_CHALLENGE:
+                if (rxHandshakeDerive(handshake, false))
                 {
-                    stage = RN_HANDSHAKE_CLIENT_CONNECT;
-                    break;
+                    handshake->step = RN_HANDSHAKE_CLIENT_CONNECT;
                 }
             }
+            else if (handshake->step == RN_HANDSHAKE_SERVER_CHALLENGE)
+            {
+                // the challenge got lost, the same one is sent again
+                handshake->step = RN_HANDSHAKE_CLIENT_CONNECT;
+            }
 
             break;
         }
 
         case RN_HANDSHAKE_CLIENT_RESPONSE:
         {
-            switch (handshake->step)
+            if (token.token != handshake->context)
             {
-                case RN_HANDSHAKE_CLIENT_RESPONSE:
-                {
-                    uint64_t context;
-                    RnPacketBufferCursor cursor = rnPacketBufferCursorInitRead(meta);
-                    int result = rnPacketBufferDeserializeUInt64(buffer, &cursor, &context);
-                    if (result == RN_OK && context == handshake->context)
-                    {
-                        stage = RN_HANDSHAKE_CLIENT_RESPONSE;
-                    }
-
-                    break;
-                }
+                break;
+            }
 
-                case RN_HANDSHAKE_SERVER_CONNECTED:
-                {
-                    stage = RN_HANDSHAKE_CLIENT_RESPONSE;
-                    break;
-                }
+            if (handshake->step == RN_HANDSHAKE_SERVER_CHALLENGE)
+            {
+                handshake->step = RN_HANDSHAKE_CLIENT_RESPONSE;
+            }
+            else if (handshake->step == RN_HANDSHAKE_CONNECTED)
+            {
+                handshake->confirm = true;
             }
 
             break;
         }
     }
 
-    return false;
+    return handshake->step == RN_HANDSHAKE_CONNECTED;
 }
 
-bool rnHandshakeSendPacketServer(RnHandshakeSecure *handshake, OUT RnPacketBufferSecure *buffer)
+bool rnHandshakeReadPacketServerInsecure(
+      RnHandshakeInsecure *handshake, const RnPacketBufferInsecure *buffer)
 {
-    switch (handshake->step)
+    RnSchemaHandshakeToken token;
+    if (!rxHandshakeServerTokenInsecure(buffer, &token))
+    {
+        return handshake->step == RN_HANDSHAKE_CONNECTED;
+    }
+
+    switch (token.step)
     {
-        case RN_HANDSHAKE_STAGE_CLIENT_HELLO:
+        case RN_HANDSHAKE_CLIENT_CONNECT:
         {
-            *buffer                     = rnPacketBufferCreateSecure(RN_HANDSHAKE_PACKET_TYPE);
-            RnPacketBufferCursor cursor = rnPacketBufferCursorInitWrite();
+            if (handshake->step == RN_HANDSHAKE_DISCONNECTED ||
+                handshake->step == RN_HANDSHAKE_SERVER_CHALLENGE)
+            {
+                handshake->peer_salt = token.token;
+                handshake->step      = RN_HANDSHAKE_CLIENT_CONNECT;
+            }
 
-            rnPacketBufferSerializeUInt8(buffer, cursor, RN_HANDSHAKE_SERVER_CHALLENGE);
-            rnPacketBufferSerializeUInt64(buffer, cursor, handshake->context);
+            break;
+        }
+
+        case RN_HANDSHAKE_CLIENT_RESPONSE:
+        {
+            if (handshake->step == RN_HANDSHAKE_SERVER_CHALLENGE &&
+                token.token == (handshake->salt ^ handshake->peer_salt))
+            {
+                handshake->salt = token.token;
+                handshake->step = RN_HANDSHAKE_CLIENT_RESPONSE;
+            }
+            else if (handshake->step == RN_HANDSHAKE_CONNECTED && token.token == handshake->salt)
+            {
+                handshake->confirm = true;
+            }
 
-            handshake->stage = RN_HANDSHAKE_STAGE_SERVER_CHALLENGE;
+            break;
+        }
+    }
+
+    return handshake->step == RN_HANDSHAKE_CONNECTED;
+}
+
+bool rnHandshakeWritePacketServerSecure(
+      RnHandshakeSecure *handshake, OUT RnPacketBufferSecure *buffer)
+{
+    switch (handshake->step)
+    {
+        case RN_HANDSHAKE_CLIENT_CONNECT:
+        {
+            // the client derives the session from the server's public key
+            RnPacketBufferCursor cursor = rxHandshakeWriteTokenSecure(
+                  buffer, RN_HANDSHAKE_SERVER_CHALLENGE, handshake->context);
+            rnPacketBufferWriteKey(buffer, &cursor, &handshake->keys.pub);
+
+            handshake->step = RN_HANDSHAKE_SERVER_CHALLENGE;
             return true;
         }
 
-        case RN_HANDSHAKE_STAGE_CLIENT_CHALLENGE:
+        case RN_HANDSHAKE_CLIENT_RESPONSE:
+        case RN_HANDSHAKE_CONNECTED:
         {
-            *buffer                     = rnPacketBufferCreateSecure(RN_HANDSHAKE_PACKET_TYPE);
-            RnPacketBufferCursor cursor = rnPacketBufferCursorInitWrite();
+            if (handshake->step == RN_HANDSHAKE_CONNECTED && !handshake->confirm)
+            {
+                return false;
+            }
 
-            rnPacketBufferSerializeUInt8(buffer, cursor, RN_HANDSHAKE_SERVER_CONNECTED);
+            rxHandshakeWriteTokenSecure(
+                  buffer, RN_HANDSHAKE_SERVER_CONNECTED, handshake->context);
 
-            handshake->stage = RN_HANDSHAKE_STAGE_SERVER_CONNECTED;
+            handshake->step    = RN_HANDSHAKE_CONNECTED;
+            handshake->confirm = false;
             return true;
         }
-    }
 
-    return false;
+        default:
+        {
+            return false;
+        }
+    }
 }
 
-bool rnHandshakeSendPacketServer(RnHandshakeInsecure *handshake, OUT RnPacketBufferInsecure *buffer)
+bool rnHandshakeWritePacketServerInsecure(
+      RnHandshakeInsecure *handshake, OUT RnPacketBufferInsecure *buffer)
 {
     switch (handshake->step)
     {
-        case RN_HANDSHAKE_STAGE_CLIENT_HELLO:
+        case RN_HANDSHAKE_CLIENT_CONNECT:
         {
-            *buffer                     = rnPacketBufferCreateInsecure(RN_HANDSHAKE_PACKET_TYPE);
-            RnPacketBufferCursor cursor = rnPacketBufferCursorInitWrite();
-
-            rnPacketBufferSerializeUInt8(buffer, cursor, RN_HANDSHAKE_SERVER_CHALLENGE);
-            rnPacketBufferSerializeUInt64(buffer, cursor, handshake->salt);
+            rxHandshakeWriteTokenInsecure(
+                  buffer, RN_HANDSHAKE_SERVER_CHALLENGE, handshake->salt);
 
-            handshake->stage = RN_HANDSHAKE_STAGE_SERVER_CHALLENGE;
+            handshake->step = RN_HANDSHAKE_SERVER_CHALLENGE;
             return true;
         }
 
-        case RN_HANDSHAKE_STAGE_CLIENT_CHALLENGE:
+        case RN_HANDSHAKE_CLIENT_RESPONSE:
+        case RN_HANDSHAKE_CONNECTED:
         {
-            *buffer                     = rnPacketBufferCreateInsecure(RN_HANDSHAKE_PACKET_TYPE);
-            RnPacketBufferCursor cursor = rnPacketBufferCursorInitWrite();
+            if (handshake->step == RN_HANDSHAKE_CONNECTED && !handshake->confirm)
+            {
+                return false;
+            }
 
-            rnPacketBufferSerializeUInt8(buffer, cursor, RN_HANDSHAKE_SERVER_CONNECTED);
+            rxHandshakeWriteTokenInsecure(buffer, RN_HANDSHAKE_SERVER_CONNECTED, handshake->salt);
 
-            handshake->stage = RN_HANDSHAKE_STAGE_SERVER_CONNECTED;
+            handshake->step    = RN_HANDSHAKE_CONNECTED;
+            handshake->confirm = false;
             return true;
         }
-    }
 
-    return false;
+        default:
+        {
+            return false;
+        }
+    }
 }
@@ -0,0 +1,361 @@
+#include "../include/rnlib/clock.h"
+#include "../include/rnlib/impairment.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RN_IMPAIRMENT_QUEUE_DEFAULT 4096
+
+union RxImpairmentAddress
+{
+    RnAddressIPv4 ipv4;
+    RnAddressIPv6 ipv6;
+};
+
+struct RxImpairmentSlot
+{
+    uint64_t release;
+    uint64_t order;
+    union RxImpairmentAddress address;
+    uint16_t data_size;
+    uint8_t data[RN_IMPAIRMENT_DATAGRAM_MAX];
+};
+
+/**
+ * Datagrams in flight, ordered by release time in a binary min-heap of slot
+ * indices. Slots are preallocated so that impairing never allocates per packet.
+ */
+struct RxImpairmentQueue
+{
+    RnImpairmentConfig config;
+    RnImpairmentStats stats;
+
+    uint64_t random;
+    uint64_t link_free;
+    uint64_t order;
+    bool burst;
+
+    uint32_t capacity;
+    uint32_t count;
+    uint32_t free_count;
+    uint32_t *heap;
+    uint32_t *free;
+    struct RxImpairmentSlot *slots;
+};
+
+/**
+ * xorshift64*, plenty for simulating network conditions and reproducible from
+ * the configured seed.
+ */
+static uint64_t rxImpairmentRandom(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+static float rxImpairmentUniform(uint64_t *state)
+{
+    return (float)(rxImpairmentRandom(state) >> 40) * (1.0f / 16777216.0f);
+}
+
+static bool rxImpairmentBefore(const struct RxImpairmentSlot *a, const struct RxImpairmentSlot *b)
+{
+    return a->release < b->release || (a->release == b->release && a->order < b->order);
+}
+
+static int rxImpairmentQueueInit(struct RxImpairmentQueue *queue, const RnImpairmentConfig *config)
+{
+    uint32_t capacity = config->queue_limit ? config->queue_limit : RN_IMPAIRMENT_QUEUE_DEFAULT;
+
+    *queue = (struct RxImpairmentQueue) {
+        .config     = *config,
+        .random     = config->seed ? config->seed : 0x9E3779B97F4A7C15ull,
+        .capacity   = capacity,
+        .free_count = capacity,
+        .heap       = malloc(capacity * sizeof(uint32_t)),
+        .free       = malloc(capacity * sizeof(uint32_t)),
+        .slots      = malloc(capacity * sizeof(struct RxImpairmentSlot)),
+    };
+
+    if (queue->heap == NULL || queue->free == NULL || queue->slots == NULL)
+    {
+        free(queue->heap);
+        free(queue->free);
+        free(queue->slots);
+        return RN_OOM;
+    }
+
+    for (uint32_t i = 0; i < capacity; ++i)
+    {
+        queue->free[i] = capacity - 1 - i;
+    }
+
+    return RN_OK;
+}
+
+static void rxImpairmentQueueFree(struct RxImpairmentQueue *queue)
+{
+    free(queue->heap);
+    free(queue->free);
+    free(queue->slots);
+}
+
+static void rxImpairmentPush(struct RxImpairmentQueue *queue, uint32_t slot)
+{
+    uint32_t i = queue->count++;
+    while (i > 0)
+    {
+        uint32_t parent = (i - 1) / 2;
+        if (!rxImpairmentBefore(&queue->slots[slot], &queue->slots[queue->heap[parent]]))
+        {
+            break;
+        }
+
+        queue->heap[i] = queue->heap[parent];
+        i              = parent;
+    }
+
+    queue->heap[i] = slot;
+}
+
+static void rxImpairmentPop(struct RxImpairmentQueue *queue)
+{
+    uint32_t slot = queue->heap[0];
+    uint32_t last = queue->heap[--queue->count];
+    uint32_t i    = 0;
+
+    for (;;)
+    {
+        uint32_t child = 2 * i + 1;
+        if (child >= queue->count)
+        {
+            break;
+        }
+
+        if (child + 1 < queue->count &&
+            rxImpairmentBefore(
+                  &queue->slots[queue->heap[child + 1]], &queue->slots[queue->heap[child]]))
+        {
+            ++child;
+        }
+
+        if (!rxImpairmentBefore(&queue->slots[queue->heap[child]], &queue->slots[last]))
+        {
+            break;
+        }
+
+        queue->heap[i] = queue->heap[child];
+        i              = child;
+    }
+
+    queue->heap[i]                   = last;
+    queue->free[queue->free_count++] = slot;
+}
+
+/**
+ * Returns the earliest datagram if it is due at `now`, NULL otherwise.
+ */
+static const struct RxImpairmentSlot *rxImpairmentPeek(
+      const struct RxImpairmentQueue *queue, uint64_t now)
+{
+    if (queue->count == 0 || queue->slots[queue->heap[0]].release > now)
+    {
+        return NULL;
+    }
+
+    return &queue->slots[queue->heap[0]];
+}
+
+static uint64_t rxImpairmentNextRelease(const struct RxImpairmentQueue *queue, uint64_t now)
+{
+    if (queue->count == 0)
+    {
+        return UINT64_MAX;
+    }
+
+    uint64_t release = queue->slots[queue->heap[0]].release;
+    return release > now ? release - now : 0;
+}
+
+static bool rxImpairmentLost(struct RxImpairmentQueue *queue)
+{
+    const RnImpairmentConfig *config = &queue->config;
+
+    if (config->burst_enter > 0)
+    {
+        float transition = rxImpairmentUniform(&queue->random);
+        queue->burst     = queue->burst ? transition >= config->burst_exit
+                                        : transition < config->burst_enter;
+    }
+
+    float loss = queue->burst ? config->burst_loss : config->loss;
+    return loss > 0 && rxImpairmentUniform(&queue->random) < loss;
+}
+
+static uint64_t rxImpairmentDelay(struct RxImpairmentQueue *queue)
+{
+    const RnImpairmentConfig *config = &queue->config;
+
+    int64_t delay = (int64_t)config->latency_us * 1000;
+    if (config->jitter_us > 0)
+    {
+        float offset = rxImpairmentUniform(&queue->random) * 2.0f - 1.0f;
+        delay += (int64_t)(offset * (float)config->jitter_us * 1000.0f);
+    }
+
+    if (config->reorder > 0 && rxImpairmentUniform(&queue->random) < config->reorder)
+    {
+        delay += (int64_t)config->reorder_us * 1000;
+        ++queue->stats.reordered;
+    }
+
+    return delay > 0 ? (uint64_t)delay : 0;
+}
+
+static int rxImpairmentSubmit(
+      struct RxImpairmentQueue *queue, uint64_t now, const union RxImpairmentAddress *address,
+      const uint8_t *data, size_t data_size)
+{
+    if (data_size > RN_IMPAIRMENT_DATAGRAM_MAX)
+    {
+        return EMSGSIZE;
+    }
+
+    ++queue->stats.submitted;
+    if (rxImpairmentLost(queue))
+    {
+        ++queue->stats.lost;
+        return RN_OK;
+    }
+
+    int copies = 1;
+    if (queue->config.duplicate > 0 &&
+        rxImpairmentUniform(&queue->random) < queue->config.duplicate)
+    {
+        ++queue->stats.duplicated;
+        copies = 2;
+    }
+
+    for (int copy = 0; copy < copies; ++copy)
+    {
+        if (queue->free_count == 0)
+        {
+            ++queue->stats.overflowed;
+            continue;
+        }
+
+        // datagrams queue behind each other on a capped link, then propagate
+        uint64_t departure = now;
+        if (queue->config.bandwidth_kbps > 0)
+        {
+            uint64_t serialize = (uint64_t)data_size * 8000000ull / queue->config.bandwidth_kbps;
+            departure = (queue->link_free > now ? queue->link_free : now) + serialize;
+            queue->link_free = departure;
+        }
+
+        uint32_t slot                  = queue->free[--queue->free_count];
+        struct RxImpairmentSlot *entry = &queue->slots[slot];
+
+        entry->release   = departure + rxImpairmentDelay(queue);
+        entry->order     = queue->order++;
+        entry->address   = *address;
+        entry->data_size = (uint16_t)data_size;
+        memcpy(entry->data, data, data_size);
+
+        rxImpairmentPush(queue, slot);
+    }
+
+    return RN_OK;
+}
+
+#define RN_IMPAIRMENT_IMPL(IP, FIELD)                                                              \
+    struct RnImpairedSocket##IP                                                                    \
+    {                                                                                              \
+        RnSocket##IP *socket;                                                                      \
+        struct RxImpairmentQueue queue;                                                            \
+    };                                                                                             \
+                                                                                                   \
+    int rnImpairmentOpen##IP(                                                                      \
+          RnSocket##IP *socket, const RnImpairmentConfig *config,                                  \
+          OUT RnImpairedSocket##IP **out)                                                          \
+    {                                                                                              \
+        *out = malloc(sizeof(RnImpairedSocket##IP));                                               \
+        if (*out == NULL)                                                                          \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        (*out)->socket = socket;                                                                   \
+        int result     = rxImpairmentQueueInit(&(*out)->queue, config);                            \
+        if (result != RN_OK)                                                                       \
+        {                                                                                          \
+            free(*out);                                                                            \
+            return result;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    int rnImpairmentClose##IP(IN RnImpairedSocket##IP *impaired)                                   \
+    {                                                                                              \
+        rxImpairmentQueueFree(&impaired->queue);                                                   \
+        free(impaired);                                                                            \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static uint64_t rxImpairmentRelease##IP(RnImpairedSocket##IP *impaired, uint64_t now)          \
+    {                                                                                              \
+        const struct RxImpairmentSlot *slot;                                                       \
+        while ((slot = rxImpairmentPeek(&impaired->queue, now)) != NULL)                           \
+        {                                                                                          \
+            rnSocketSendData##IP(                                                                  \
+                  impaired->socket, &slot->address.FIELD, slot->data, slot->data_size);            \
+            ++impaired->queue.stats.delivered;                                                     \
+            rxImpairmentPop(&impaired->queue);                                                     \
+        }                                                                                          \
+                                                                                                   \
+        return rxImpairmentNextRelease(&impaired->queue, now);                                     \
+    }                                                                                              \
+                                                                                                   \
+    int rnImpairmentSendData##IP(                                                                  \
+          RnImpairedSocket##IP *impaired, const RnAddress##IP *address, const uint8_t *data,       \
+          size_t data_size)                                                                        \
+    {                                                                                              \
+        union RxImpairmentAddress queued = { .FIELD = *address };                                  \
+        uint64_t now                     = rnClockMonotonic();                                     \
+                                                                                                   \
+        int result = rxImpairmentSubmit(&impaired->queue, now, &queued, data, data_size);          \
+        rxImpairmentRelease##IP(impaired, now);                                                    \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnImpairmentReceiveData##IP(                                                               \
+          RnImpairedSocket##IP *impaired, OUT RnAddress##IP *address, OUT uint8_t *data,           \
+          OUT size_t *data_size)                                                                   \
+    {                                                                                              \
+        rxImpairmentRelease##IP(impaired, rnClockMonotonic());                                     \
+        return rnSocketReceiveData##IP(impaired->socket, address, data, data_size);                \
+    }                                                                                              \
+                                                                                                   \
+    uint64_t rnImpairmentFlush##IP(RnImpairedSocket##IP *impaired)                                 \
+    {                                                                                              \
+        return rxImpairmentRelease##IP(impaired, rnClockMonotonic());                              \
+    }                                                                                              \
+                                                                                                   \
+    void rnImpairmentStats##IP(                                                                    \
+          const RnImpairedSocket##IP *impaired, OUT RnImpairmentStats *out)                        \
+    {                                                                                              \
+        *out = impaired->queue.stats;                                                              \
+    }
+
+RN_IMPAIRMENT_IMPL(IPv4, ipv4)
+RN_IMPAIRMENT_IMPL(IPv6, ipv6)
+
+#undef RN_IMPAIRMENT_IMPL
@@ -0,0 +1,175 @@
+#include "../include/rnlib/metrics.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+RN_THREAD_LOCAL RnMetricsShard *rxMetricsLocalShard = NULL;
+
+static RnMetricsShard *rxMetricsShards = NULL;
+
+static const char *rxMetricsCounterNames[RN_METRICS_COUNTER_COUNT] = {
+    [RN_METRICS_PACKETS_IN]                 = "rnlib_packets_in_total",
+    [RN_METRICS_PACKETS_OUT]                = "rnlib_packets_out_total",
+    [RN_METRICS_BYTES_IN]                   = "rnlib_bytes_in_total",
+    [RN_METRICS_BYTES_OUT]                  = "rnlib_bytes_out_total",
+    [RN_METRICS_DROPS_SEQUENCE]             = "rnlib_drops_sequence_total",
+    [RN_METRICS_DROPS_CONTEXT]              = "rnlib_drops_context_total",
+    [RN_METRICS_DROPS_VERIFY]               = "rnlib_drops_verify_total",
+    [RN_METRICS_HANDSHAKE_DISCONNECTED]     = "rnlib_handshake_disconnected_total",
+    [RN_METRICS_HANDSHAKE_CLIENT_CONNECT]   = "rnlib_handshake_client_connect_total",
+    [RN_METRICS_HANDSHAKE_SERVER_CHALLENGE] = "rnlib_handshake_server_challenge_total",
+    [RN_METRICS_HANDSHAKE_CLIENT_RESPONSE]  = "rnlib_handshake_client_response_total",
+    [RN_METRICS_HANDSHAKE_SERVER_CONNECTED] = "rnlib_handshake_server_connected_total",
+    [RN_METRICS_HANDSHAKE_CONNECTED]        = "rnlib_handshake_connected_total",
+    [RN_METRICS_RETRANSMITS]                = "rnlib_retransmits_total",
+};
+
+static const char *rxMetricsLatencyNames[RN_METRICS_LATENCY_COUNT] = {
+    [RN_METRICS_LATENCY_HANDSHAKE] = "rnlib_handshake_latency_ns",
+    [RN_METRICS_LATENCY_INGRESS]   = "rnlib_ingress_latency_ns",
+    [RN_METRICS_LATENCY_EGRESS]    = "rnlib_egress_latency_ns",
+};
+
+static void *rxMetricsAllocateAligned(size_t size)
+{
+#ifdef _WIN32
+    void *memory = _aligned_malloc(size, 64);
+#else
+    void *memory = NULL;
+    if (posix_memalign(&memory, 64, size) != 0)
+    {
+        memory = NULL;
+    }
+#endif
+
+    if (memory != NULL)
+    {
+        memset(memory, 0, size);
+    }
+
+    return memory;
+}
+
+RnMetricsShard *rxMetricsShardRegister()
+{
+    RnMetricsShard *shard = rxMetricsAllocateAligned(sizeof(RnMetricsShard));
+    if (shard == NULL)
+    {
+        return NULL;
+    }
+
+    // lock-free push, registration happens once per thread
+    shard->next = __atomic_load_n(&rxMetricsShards, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(
+          &rxMetricsShards, &shard->next, shard, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    {
+    }
+
+    rxMetricsLocalShard = shard;
+    return shard;
+}
+
+static void rxMetricsAccumulate(uint64_t *total, const uint64_t *values, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        total[i] += __atomic_load_n(&values[i], __ATOMIC_RELAXED);
+    }
+}
+
+void rnMetricsSnapshot(OUT RnMetricsSnapshot *out)
+{
+    memset(out, 0, sizeof *out);
+
+    const RnMetricsShard *shard = __atomic_load_n(&rxMetricsShards, __ATOMIC_ACQUIRE);
+    for (; shard != NULL; shard = shard->next)
+    {
+        rxMetricsAccumulate(
+              out->counters.values, shard->counters.values, RN_METRICS_COUNTER_COUNT);
+
+        for (int i = 0; i < RN_METRICS_LATENCY_COUNT; ++i)
+        {
+            rxMetricsAccumulate(
+                  out->latency[i].counts, shard->latency[i].counts, RN_METRICS_HISTOGRAM_BUCKETS);
+            rxMetricsAccumulate(&out->latency[i].total, &shard->latency[i].total, 1);
+        }
+    }
+}
+
+static uint64_t rxMetricsHistogramValue(uint32_t bucket)
+{
+    if (bucket <= RN_METRICS_HISTOGRAM_SUB_MASK)
+    {
+        return bucket;
+    }
+
+    uint32_t shift = (bucket >> RN_METRICS_HISTOGRAM_SUB_BITS) - 1;
+    uint64_t sub   = bucket & RN_METRICS_HISTOGRAM_SUB_MASK;
+
+    return ((1ull << RN_METRICS_HISTOGRAM_SUB_BITS) | sub) << shift;
+}
+
+uint64_t rnMetricsHistogramPercentile(const RnMetricsHistogram *histogram, double percentile)
+{
+    uint64_t target = (uint64_t)(percentile * (double)histogram->total + 0.5);
+    uint64_t seen   = 0;
+
+    for (uint32_t bucket = 0; bucket < RN_METRICS_HISTOGRAM_BUCKETS; ++bucket)
+    {
+        seen += histogram->counts[bucket];
+        if (seen >= target && seen > 0)
+        {
+            return rxMetricsHistogramValue(bucket);
+        }
+    }
+
+    return 0;
+}
+
+int rnMetricsExport(const RnMetricsSnapshot *snapshot, OUT char *text, size_t text_size)
+{
+    static const double quantiles[] = { 0.5, 0.99, 0.999 };
+
+    size_t written = 0;
+
+#define RN_METRICS_PRINT(...)                                                                      \
+    do                                                                                             \
+    {                                                                                              \
+        int length = snprintf(text + written, text_size - written, __VA_ARGS__);                   \
+        if (length < 0 || (size_t)length >= text_size - written)                                   \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+        written += (size_t)length;                                                                 \
+    } while (0)
+
+    for (int i = 0; i < RN_METRICS_COUNTER_COUNT; ++i)
+    {
+        RN_METRICS_PRINT("# TYPE %s counter\n", rxMetricsCounterNames[i]);
+        RN_METRICS_PRINT(
+              "%s %llu\n", rxMetricsCounterNames[i],
+              (unsigned long long)snapshot->counters.values[i]);
+    }
+
+    for (int i = 0; i < RN_METRICS_LATENCY_COUNT; ++i)
+    {
+        const RnMetricsHistogram *histogram = &snapshot->latency[i];
+
+        RN_METRICS_PRINT("# TYPE %s summary\n", rxMetricsLatencyNames[i]);
+        for (size_t q = 0; q < sizeof quantiles / sizeof *quantiles; ++q)
+        {
+            RN_METRICS_PRINT(
+                  "%s{quantile=\"%g\"} %llu\n", rxMetricsLatencyNames[i], quantiles[q],
+                  (unsigned long long)rnMetricsHistogramPercentile(histogram, quantiles[q]));
+        }
+
+        RN_METRICS_PRINT(
+              "%s_count %llu\n", rxMetricsLatencyNames[i], (unsigned long long)histogram->total);
+    }
+
+#undef RN_METRICS_PRINT
+
+    return (int)written;
+}
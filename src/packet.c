@@ -1,115 +1,569 @@
+#include "../include/rnlib/bitpack.h"
+#include "../include/rnlib/entropy.h"
+#include "../include/rnlib/handshake.h"
 #include "../include/rnlib/packet.h"
+#include "../include/rnlib/quantize.h"
 
 #include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// writes may fill the whole body, reads stop at the serialized or received body
+#define RN_PACKET_BUFFER_WRITE_QWORDS(BUFFER) ((size_t)(BUFFER)->meta.body_capacity / 8)
+#define RN_PACKET_BUFFER_READ_QWORDS(BUFFER)  (((size_t)(BUFFER)->meta.body_size + 7) / 8)
 
 RnPacketBufferSecure rnPacketBufferCreateSecure(uint16_t type)
 {
-    return RnPacketBufferSecure {
+    return (RnPacketBufferSecure){
+        .meta = { .body_capacity = RN_PACKET_BODY_QWORDS_SECURE * 8 },
         .auth = { 0 },
         .head = { 0, 0, 0, type },
         .body = { 0 },
     };
-};
+}
 
 RnPacketBufferInsecure rnPacketBufferCreateInsecure(uint16_t type)
 {
-    return RnPacketBufferInsecure {
+    return (RnPacketBufferInsecure){
+        .meta = { .body_capacity = RN_PACKET_BODY_QWORDS_INSECURE * 8 },
         .salt = 0,
         .head = { 0, 0, 0, type },
         .body = { 0 },
     };
-};
+}
+
+static void *rxPacketBufferAllocate(size_t size)
+{
+#ifdef _WIN32
+    void *memory = _aligned_malloc(size, 64);
+#else
+    void *memory = NULL;
+    if (posix_memalign(&memory, 64, size) != 0)
+    {
+        memory = NULL;
+    }
+#endif
+
+    if (memory != NULL)
+    {
+        memset(memory, 0, size);
+    }
+
+    return memory;
+}
+
+static void rxPacketBufferFree(void *memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+static void rxPacketBufferCommit(RnPacketBufferMetaData *meta, const RnPacketBufferCursor *cursor)
+{
+    size_t size = ((size_t)cursor->qword * 64 + cursor->bit + 7) / 8;
+    if (size > meta->body_size)
+    {
+        meta->body_size = (uint16_t)size;
+    }
+}
+
+static const size_t rxPacketWireOffsetSecure   = RN_PACKET_WIRE_OFFSET_SECURE;
+static const size_t rxPacketWireOffsetInsecure = RN_PACKET_WIRE_OFFSET_INSECURE;
+
+// connection id and tag, or salt, followed by the header, ahead of the body on the wire
+#define RN_PACKET_WIRE_HEADER(BUFFER)                                                              \
+    (offsetof(RnPacketBuffer##BUFFER, body) - rxPacketWireOffset##BUFFER)
+
+#define RN_PACKET_BUFFER_LIFETIME_IMPL(BUFFER, BODY_QWORDS)                                        \
+    int rnPacketBufferOpen##BUFFER(                                                                \
+          uint16_t type, uint16_t body_capacity, OUT RnPacketBuffer##BUFFER **out)                 \
+    {                                                                                              \
+        size_t qwords = ((size_t)body_capacity + 7) / 8;                                           \
+        qwords        = qwords < BODY_QWORDS ? qwords : BODY_QWORDS;                               \
+                                                                                                   \
+        /* the allocation ends with the body, the struct is never copied */                        \
+        *out = rxPacketBufferAllocate(offsetof(RnPacketBuffer##BUFFER, body) + qwords * 8);        \
+        if (*out == NULL)                                                                          \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        (*out)->meta.body_capacity = (uint16_t)(qwords * 8);                                       \
+        (*out)->head.type          = type;                                                         \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferClose##BUFFER(IN RnPacketBuffer##BUFFER *buffer)                             \
+    {                                                                                              \
+        rxPacketBufferFree(buffer);                                                                \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    uint8_t *rnPacketBufferWireData##BUFFER(RnPacketBuffer##BUFFER *buffer)                        \
+    {                                                                                              \
+        return (uint8_t *)buffer + rxPacketWireOffset##BUFFER;                                     \
+    }                                                                                              \
+                                                                                                   \
+    size_t rnPacketBufferWireSize##BUFFER(const RnPacketBuffer##BUFFER *buffer)                    \
+    {                                                                                              \
+        return RN_PACKET_WIRE_HEADER(BUFFER) + buffer->meta.body_size;                             \
+    }                                                                                              \
+                                                                                                   \
+    size_t rnPacketBufferWireCapacity##BUFFER(const RnPacketBuffer##BUFFER *buffer)                \
+    {                                                                                              \
+        return RN_PACKET_WIRE_HEADER(BUFFER) + buffer->meta.body_capacity;                         \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferWireReceived##BUFFER(RnPacketBuffer##BUFFER *buffer, size_t size)            \
+    {                                                                                              \
+        if (size < RN_PACKET_WIRE_HEADER(BUFFER) ||                                                \
+            size > rnPacketBufferWireCapacity##BUFFER(buffer))                                     \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        size_t body_size       = size - RN_PACKET_WIRE_HEADER(BUFFER);                             \
+        size_t body_end        = (body_size + 7) / 8 * 8;                                          \
+        buffer->meta.body_size = (uint16_t)body_size;                                              \
+                                                                                                   \
+        memset((uint8_t *)buffer->body + body_size, 0, body_end - body_size);                      \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    void rnPacketBufferCommit##BUFFER(                                                             \
+          RnPacketBuffer##BUFFER *buffer, const RnPacketBufferCursor *cursor)                      \
+    {                                                                                              \
+        rxPacketBufferCommit(&buffer->meta, cursor);                                               \
+    }
 
-inline int rxPacketBufferWrite(
+RN_PACKET_BUFFER_LIFETIME_IMPL(Secure, RN_PACKET_BODY_QWORDS_SECURE)
+RN_PACKET_BUFFER_LIFETIME_IMPL(Insecure, RN_PACKET_BODY_QWORDS_INSECURE)
+
+static inline int rxPacketBufferWrite(
       uint64_t *body, size_t body_qwords, RnPacketBufferCursor *cursor, uint64_t data,
       size_t data_bits)
 {
-    int_fast8_t bits_available = 64 - cursor->bit;
-    uint64_t overflow_mask     = -uint64_t(data_bits > bits_available);
+    // heap buffers end with their body, nothing past `body_qwords` is ours
+    size_t offset = cursor->qword * 64 + cursor->bit;
+    if (offset + data_bits > body_qwords * 64)
+    {
+        return RN_OOM;
+    }
 
-    assert(cursor->word < (body_qwords - 1) || !overflow_mask);
+    // bits above `data_bits` would spill into the fields that follow
+    data = data_bits == 64 ? data : data & ((1ull << data_bits) - 1);
 
-    // store value in current qword at bit cursor
     body[cursor->qword] |= data << cursor->bit;
+    if (cursor->bit + data_bits > 64)
+    {
+        body[cursor->qword + 1] |= data >> (64 - cursor->bit);
+    }
+
+    offset += data_bits;
+    cursor->qword = offset / 64;
+    cursor->bit   = offset % 64;
+    return RN_OK;
+}
+
+static inline int rxPacketBufferRead(
+      const uint64_t *body, size_t body_qwords, RnPacketBufferCursor *cursor, OUT uint64_t *data,
+      size_t data_bits)
+{
+    size_t offset = cursor->qword * 64 + cursor->bit;
+    if (offset + data_bits > body_qwords * 64)
+    {
+        return RN_OOM;
+    }
 
-    // increment qword cursor on overflow
-    cursor->qword += overflow_mask & 1;
+    uint64_t value = body[cursor->qword] >> cursor->bit;
+    if (cursor->bit + data_bits > 64)
+    {
+        value |= body[cursor->qword + 1] << (64 - cursor->bit);
+    }
 
-    // store remainder in next qword on overflow
-    body[cursor->qword] |= overflow_mask & (data >> bits_available);
+    *data = data_bits == 64 ? value : value & ((1ull << data_bits) - 1);
 
-    // increment bit cursor by bits serialized
-    cursor->bit = cursor->bit + data_bits - overflow_mask & 64;
+    offset += data_bits;
+    cursor->qword = offset / 64;
+    cursor->bit   = offset % 64;
+    return RN_OK;
 }
 
-#define RN_PACKET_BUFFER_WRITE_INT_IMPL(BUFFER, NAME, TYPE, BITS)                                  \
-    inline int rnPacketBufferWrite##NAME(                                                          \
+#define RN_PACKET_BUFFER_INT_IMPL(BUFFER, NAME, TYPE, BITS)                                        \
+    int rnPacketBufferWrite##NAME##BUFFER(                                                         \
           RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, TYPE data)                 \
     {                                                                                              \
-        return rxPacketBufferWrite(buffer->body, sizeof buffer->body / 8, cursor, data, BITS);     \
+        int result = rxPacketBufferWrite(                                                          \
+              buffer->body, RN_PACKET_BUFFER_WRITE_QWORDS(buffer), cursor, data, BITS);            \
+        rxPacketBufferCommit(&buffer->meta, cursor);                                               \
+        return result;                                                                             \
     }                                                                                              \
                                                                                                    \
-    inline int rnPacketBufferWrite(                                                                \
-          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, TYPE data)                 \
+    int rnPacketBufferRead##NAME##BUFFER(                                                          \
+          const RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, OUT TYPE *data)      \
     {                                                                                              \
-        return rnPacketBufferWrite##NAME(buffer, cursor, data);                                    \
+        uint64_t value;                                                                            \
+        int result = rxPacketBufferRead(                                                           \
+              buffer->body, RN_PACKET_BUFFER_READ_QWORDS(buffer), cursor, &value, BITS);           \
+        if (result == RN_OK)                                                                       \
+        {                                                                                          \
+            *data = (TYPE)value;                                                                   \
+        }                                                                                          \
+                                                                                                   \
+        return result;                                                                             \
     }
 
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Secure, Bool, bool, 1)
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Insecure, Bool, bool, 1)
+RN_PACKET_BUFFER_INT_IMPL(Secure, Bool, bool, 1)
+RN_PACKET_BUFFER_INT_IMPL(Insecure, Bool, bool, 1)
 
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Secure, UInt8, uint8_t, 8)
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Insecure, UInt8, uint8_t, 8)
+RN_PACKET_BUFFER_INT_IMPL(Secure, UInt8, uint8_t, 8)
+RN_PACKET_BUFFER_INT_IMPL(Insecure, UInt8, uint8_t, 8)
 
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Secure, UInt16, uint16_t, 16)
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Insecure, UInt16, uint16_t, 16)
+RN_PACKET_BUFFER_INT_IMPL(Secure, UInt16, uint16_t, 16)
+RN_PACKET_BUFFER_INT_IMPL(Insecure, UInt16, uint16_t, 16)
 
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Secure, UInt32, uint32_t, 32)
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Insecure, UInt32, uint32_t, 32)
+RN_PACKET_BUFFER_INT_IMPL(Secure, UInt32, uint32_t, 32)
+RN_PACKET_BUFFER_INT_IMPL(Insecure, UInt32, uint32_t, 32)
 
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Secure, UInt64, uint64_t, 64)
-RN_PACKET_BUFFER_WRITE_INT_IMPL(Insecure, UInt64, uint64_t, 64)
+RN_PACKET_BUFFER_INT_IMPL(Secure, UInt64, uint64_t, 64)
+RN_PACKET_BUFFER_INT_IMPL(Insecure, UInt64, uint64_t, 64)
 
 #define RN_PACKET_BUFFER_WRITE_MISC_IMPL(BUFFER)                                                   \
-    int rnPacketBufferWriteKey(                                                                    \
+    int rnPacketBufferWriteKey##BUFFER(                                                            \
           RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, const RnKeyBuffer *key)    \
     {                                                                                              \
-        const uint64_t *data = key->data;                                                          \
-        for (int i = 0; i < 4; i += 8)                                                             \
+        uint64_t data[sizeof *key / 8];                                                            \
+        memcpy(data, *key, sizeof data);                                                           \
+                                                                                                   \
+        int result = RN_OK;                                                                        \
+        for (size_t i = 0; i < sizeof data / 8 && result == RN_OK; ++i)                            \
         {                                                                                          \
-            rnPacketSerializeUInt64(buffer, cursor, *data[i]);                                     \
+            result = rnPacketBufferWriteUInt64##BUFFER(buffer, cursor, data[i]);                   \
         }                                                                                          \
+                                                                                                   \
+        return result;                                                                             \
     }                                                                                              \
                                                                                                    \
-    void rnPacketBufferWritePadding(RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor)  \
+    int rnPacketBufferReadKey##BUFFER(                                                             \
+          const RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor,                      \
+          OUT RnKeyBuffer *key)                                                                    \
     {                                                                                              \
-        cursor->qword = sizeof buffer->body / 8;                                                   \
-        cursor->bit   = 0;                                                                         \
+        uint64_t data[sizeof *key / 8];                                                            \
+                                                                                                   \
+        int result = RN_OK;                                                                        \
+        for (size_t i = 0; i < sizeof data / 8 && result == RN_OK; ++i)                            \
+        {                                                                                          \
+            result = rnPacketBufferReadUInt64##BUFFER(buffer, cursor, &data[i]);                   \
+        }                                                                                          \
+                                                                                                   \
+        if (result == RN_OK)                                                                       \
+        {                                                                                          \
+            memcpy(*key, data, sizeof data);                                                       \
+        }                                                                                          \
+                                                                                                   \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    void rnPacketBufferWritePadding##BUFFER(                                                       \
+          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor)                            \
+    {                                                                                              \
+        /* handshakes are padded to what every path carries, not to the buffer */                  \
+        size_t size = RN_PACKET_BYTES_BASE - RN_PACKET_WIRE_HEADER(BUFFER);                        \
+        size        = size < buffer->meta.body_capacity ? size : buffer->meta.body_capacity;       \
+                                                                                                   \
+        cursor->qword = size / 8;                                                                  \
+        cursor->bit   = size % 8 * 8;                                                              \
+                                                                                                   \
+        buffer->meta.body_size = (uint16_t)size;                                                   \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferWritePaddingTo##BUFFER(                                                      \
+          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, size_t wire_size)          \
+    {                                                                                              \
+        size_t header = RN_PACKET_WIRE_HEADER(BUFFER);                                             \
+        if (wire_size < header + buffer->meta.body_size ||                                         \
+            wire_size - header > buffer->meta.body_capacity)                                       \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        size_t size   = wire_size - header;                                                        \
+        cursor->qword = size / 8;                                                                  \
+        cursor->bit   = size % 8 * 8;                                                              \
+                                                                                                   \
+        buffer->meta.body_size = (uint16_t)size;                                                   \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    void rnPacketBufferLimit##BUFFER(RnPacketBuffer##BUFFER *buffer, size_t wire_size)             \
+    {                                                                                              \
+        size_t header   = RN_PACKET_WIRE_HEADER(BUFFER);                                           \
+        size_t capacity = wire_size > header ? (wire_size - header) / 8 * 8 : 0;                   \
+        if (capacity < buffer->meta.body_capacity)                                                 \
+        {                                                                                          \
+            buffer->meta.body_capacity = (uint16_t)capacity;                                       \
+        }                                                                                          \
     }
 
 RN_PACKET_BUFFER_WRITE_MISC_IMPL(Secure)
 RN_PACKET_BUFFER_WRITE_MISC_IMPL(Insecure)
 
-int rnPacketBufferAuthenticate(RnPacketBuffer *buffer, RnPacketMetaData meta, )
-{
-}
+#define RN_PACKET_BUFFER_ARRAY_IMPL(BUFFER)                                                        \
+    int rnPacketBufferWriteArray##BUFFER(                                                          \
+          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, const uint32_t *values,    \
+          size_t count, uint32_t bits)                                                             \
+    {                                                                                              \
+        int result = rnBitpackWrite(                                                               \
+              buffer->body, RN_PACKET_BUFFER_WRITE_QWORDS(buffer), cursor, values, count, bits);   \
+        rxPacketBufferCommit(&buffer->meta, cursor);                                               \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferReadArray##BUFFER(                                                           \
+          const RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor,                      \
+          OUT uint32_t *values, size_t count, uint32_t bits)                                       \
+    {                                                                                              \
+        return rnBitpackRead(                                                                      \
+              buffer->body, RN_PACKET_BUFFER_READ_QWORDS(buffer), cursor, values, count, bits);    \
+    }
 
-int rnPacketBufferVerifyAuthentication()
-{
-}
+RN_PACKET_BUFFER_ARRAY_IMPL(Secure)
+RN_PACKET_BUFFER_ARRAY_IMPL(Insecure)
 
-int rnPacketBufferEncrypt()
-{
-}
+#define RN_PACKET_BUFFER_QUANTIZED_IMPL(BUFFER)                                                    \
+    int rnPacketBufferWriteFloat##BUFFER(                                                          \
+          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor,                            \
+          const RnQuantizeRange *range, float data)                                                \
+    {                                                                                              \
+        if (!rnQuantizeBitsValid(range->bits))                                                     \
+        {                                                                                          \
+            return EINVAL;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        int result = rxPacketBufferWrite(                                                          \
+              buffer->body, RN_PACKET_BUFFER_WRITE_QWORDS(buffer), cursor,                         \
+              rnQuantizeFloat(range, data), range->bits);                                          \
+        rxPacketBufferCommit(&buffer->meta, cursor);                                               \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferReadFloat##BUFFER(                                                           \
+          const RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor,                      \
+          const RnQuantizeRange *range, OUT float *data)                                           \
+    {                                                                                              \
+        if (!rnQuantizeBitsValid(range->bits))                                                     \
+        {                                                                                          \
+            return EINVAL;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        uint64_t quantized;                                                                        \
+        int result = rxPacketBufferRead(                                                           \
+              buffer->body, RN_PACKET_BUFFER_READ_QWORDS(buffer), cursor, &quantized,              \
+              range->bits);                                                                        \
+        if (result == RN_OK)                                                                       \
+        {                                                                                          \
+            *data = rnDequantizeFloat(range, (uint32_t)quantized);                                 \
+        }                                                                                          \
+                                                                                                   \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferWriteVector3##BUFFER(                                                        \
+          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor,                            \
+          const RnQuantizeRange *range, const RnVector3 *data)                                     \
+    {                                                                                              \
+        const float components[3] = { data->x, data->y, data->z };                                 \
+                                                                                                   \
+        int result = RN_OK;                                                                        \
+        for (int i = 0; i < 3 && result == RN_OK; ++i)                                             \
+        {                                                                                          \
+            result = rnPacketBufferWriteFloat##BUFFER(buffer, cursor, range, components[i]);       \
+        }                                                                                          \
+                                                                                                   \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferReadVector3##BUFFER(                                                         \
+          const RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor,                      \
+          const RnQuantizeRange *range, OUT RnVector3 *data)                                       \
+    {                                                                                              \
+        float *components[3] = { &data->x, &data->y, &data->z };                                   \
+                                                                                                   \
+        int result = RN_OK;                                                                        \
+        for (int i = 0; i < 3 && result == RN_OK; ++i)                                             \
+        {                                                                                          \
+            result = rnPacketBufferReadFloat##BUFFER(buffer, cursor, range, components[i]);        \
+        }                                                                                          \
+                                                                                                   \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferWriteQuaternion##BUFFER(                                                     \
+          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, uint32_t bits,             \
+          const RnQuaternion *data)                                                                \
+    {                                                                                              \
+        if (!rnQuantizeBitsValid(bits))                                                            \
+        {                                                                                          \
+            return EINVAL;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        RnQuantizedQuaternion quantized = rnQuantizeQuaternion(data, bits);                        \
+                                                                                                   \
+        int result = rxPacketBufferWrite(                                                          \
+              buffer->body, RN_PACKET_BUFFER_WRITE_QWORDS(buffer), cursor, quantized.largest, 2);  \
+        for (int i = 0; i < 3 && result == RN_OK; ++i)                                             \
+        {                                                                                          \
+            result = rxPacketBufferWrite(                                                          \
+                  buffer->body, RN_PACKET_BUFFER_WRITE_QWORDS(buffer), cursor,                     \
+                  quantized.components[i], bits);                                                  \
+        }                                                                                          \
+                                                                                                   \
+        rxPacketBufferCommit(&buffer->meta, cursor);                                               \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferReadQuaternion##BUFFER(                                                      \
+          const RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, uint32_t bits,       \
+          OUT RnQuaternion *data)                                                                  \
+    {                                                                                              \
+        if (!rnQuantizeBitsValid(bits))                                                            \
+        {                                                                                          \
+            return EINVAL;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        uint64_t largest;                                                                          \
+        int result = rxPacketBufferRead(                                                           \
+              buffer->body, RN_PACKET_BUFFER_READ_QWORDS(buffer), cursor, &largest, 2);            \
+                                                                                                   \
+        RnQuantizedQuaternion quantized = { .largest = (uint8_t)largest };                         \
+        for (int i = 0; i < 3 && result == RN_OK; ++i)                                             \
+        {                                                                                          \
+            uint64_t component;                                                                    \
+            result = rxPacketBufferRead(                                                           \
+                  buffer->body, RN_PACKET_BUFFER_READ_QWORDS(buffer), cursor, &component, bits);   \
+            quantized.components[i] = (uint32_t)component;                                         \
+        }                                                                                          \
+                                                                                                   \
+        if (result == RN_OK)                                                                       \
+        {                                                                                          \
+            *data = rnDequantizeQuaternion(&quantized, bits);                                      \
+        }                                                                                          \
+                                                                                                   \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferWriteVarInt##BUFFER(                                                         \
+          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, int64_t data)              \
+    {                                                                                              \
+        uint64_t value = rnZigzagEncode(data);                                                     \
+        int result;                                                                                \
+        do                                                                                         \
+        {                                                                                          \
+            uint64_t group = value & 0x7F;                                                         \
+            value >>= 7;                                                                           \
+                                                                                                   \
+            group |= value ? 0x80 : 0;                                                             \
+            result = rxPacketBufferWrite(                                                          \
+                  buffer->body, RN_PACKET_BUFFER_WRITE_QWORDS(buffer), cursor, group, 8);          \
+        } while (value && result == RN_OK);                                                        \
+                                                                                                   \
+        rxPacketBufferCommit(&buffer->meta, cursor);                                               \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferReadVarInt##BUFFER(                                                          \
+          const RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor, OUT int64_t *data)   \
+    {                                                                                              \
+        uint64_t value = 0;                                                                        \
+        for (int shift = 0; shift < 64; shift += 7)                                                \
+        {                                                                                          \
+            uint64_t group;                                                                        \
+            int result = rxPacketBufferRead(                                                       \
+                  buffer->body, RN_PACKET_BUFFER_READ_QWORDS(buffer), cursor, &group, 8);          \
+            if (result != RN_OK)                                                                   \
+            {                                                                                      \
+                return result;                                                                     \
+            }                                                                                      \
+                                                                                                   \
+            value |= (group & 0x7F) << shift;                                                      \
+            if (!(group & 0x80))                                                                   \
+            {                                                                                      \
+                *data = rnZigzagDecode(value);                                                     \
+                return RN_OK;                                                                      \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return RN_OOM;                                                                             \
+    }
 
-int rnPacketBufferDecrypt()
-{
-}
+RN_PACKET_BUFFER_QUANTIZED_IMPL(Secure)
+RN_PACKET_BUFFER_QUANTIZED_IMPL(Insecure)
 
-int rnPacketBufferTagSalt()
-{
-}
+#define RN_PACKET_BUFFER_ENTROPY_IMPL(BUFFER)                                                      \
+    int rnPacketBufferCompress##BUFFER(                                                            \
+          RnPacketBuffer##BUFFER *buffer, RnPacketBufferCursor *cursor,                            \
+          const RnEntropyModel *model)                                                             \
+    {                                                                                              \
+        size_t size = (cursor->qword * 64 + cursor->bit + 7) / 8;                                  \
+        if (size <= RN_ENTROPY_PREFIX_BYTES)                                                       \
+        {                                                                                          \
+            return RN_OK;                                                                          \
+        }                                                                                          \
+                                                                                                   \
+        /* only bodies that shrink by at least a byte are sent compressed */                       \
+        uint64_t encoded[sizeof buffer->body / 8];                                                 \
+        size_t encoded_size;                                                                       \
+        if (rnEntropyEncode(                                                                       \
+                  model, (const uint8_t *)buffer->body, size, (uint8_t *)encoded, size - 1,        \
+                  &encoded_size) != RN_OK)                                                         \
+        {                                                                                          \
+            return RN_OK;                                                                          \
+        }                                                                                          \
+                                                                                                   \
+        memcpy(buffer->body, encoded, encoded_size);                                               \
+        memset((uint8_t *)buffer->body + encoded_size, 0, size - encoded_size);                    \
+                                                                                                   \
+        buffer->head.type |= RN_PACKET_TYPE_COMPRESSED;                                            \
+        buffer->meta.body_size = (uint16_t)encoded_size;                                           \
+        cursor->qword          = encoded_size / 8;                                                 \
+        cursor->bit            = encoded_size % 8 * 8;                                             \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    int rnPacketBufferDecompress##BUFFER(                                                          \
+          RnPacketBuffer##BUFFER *buffer, const RnEntropyModel *model)                             \
+    {                                                                                              \
+        uint16_t type = buffer->head.type;                                                         \
+        if (!(type & RN_PACKET_TYPE_COMPRESSED) || type >= RN_PACKET_TYPE_RESERVED)                \
+        {                                                                                          \
+            return RN_OK;                                                                          \
+        }                                                                                          \
+                                                                                                   \
+        uint64_t decoded[sizeof buffer->body / 8];                                                 \
+        size_t decoded_size;                                                                       \
+        int result = rnEntropyDecode(                                                              \
+              model, (const uint8_t *)buffer->body, buffer->meta.body_size, (uint8_t *)decoded,    \
+              buffer->meta.body_capacity, &decoded_size);                                          \
+        if (result != RN_OK)                                                                       \
+        {                                                                                          \
+            return result;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        /* zero up to the end of the coded body or the decoded qword, whichever is further */      \
+        size_t zero_end = (decoded_size + 7) / 8 * 8;                                              \
+        zero_end        = zero_end > buffer->meta.body_size ? zero_end : buffer->meta.body_size;   \
+                                                                                                   \
+        memcpy(buffer->body, decoded, decoded_size);                                               \
+        memset((uint8_t *)buffer->body + decoded_size, 0, zero_end - decoded_size);                \
+                                                                                                   \
+        buffer->head.type &= (uint16_t)~RN_PACKET_TYPE_COMPRESSED;                                 \
+        buffer->meta.body_size = (uint16_t)decoded_size;                                           \
+        return RN_OK;                                                                              \
+    }
 
-int rnPacketBufferVerifySalt()
-{
-}
+RN_PACKET_BUFFER_ENTROPY_IMPL(Secure)
+RN_PACKET_BUFFER_ENTROPY_IMPL(Insecure)
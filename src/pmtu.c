@@ -0,0 +1,184 @@
+#include "../include/rnlib/pmtu.h"
+
+// probe sizes are whole qwords, the search ends once no qword fits between its bounds
+#define RN_PMTU_ALIGN(SIZE) ((uint16_t)((SIZE) & ~7u))
+
+static void rxPmtuConfirm(RnPmtu *pmtu, uint16_t size)
+{
+    __atomic_store_n(&pmtu->confirmed, size, __ATOMIC_RELAXED);
+}
+
+static uint16_t rxPmtuProbe(RnPmtu *pmtu, uint16_t size, uint64_t now)
+{
+    pmtu->probe_size    = size;
+    pmtu->probe_count   = 1;
+    pmtu->probe_sent_at = now;
+    return size;
+}
+
+static void rxPmtuLost(RnPmtu *pmtu, uint64_t now)
+{
+    uint16_t size     = pmtu->probe_size;
+    pmtu->probe_size  = 0;
+    pmtu->probe_count = 0;
+    pmtu->next_at     = now;
+
+    switch (pmtu->state)
+    {
+        case RN_PMTU_SEARCHING:
+        {
+            pmtu->high = size;
+            break;
+        }
+
+        case RN_PMTU_SEARCH_COMPLETE:
+        {
+            // black hole, fall back right away and search below the lost size once the base
+            // got through again
+            pmtu->high  = pmtu->confirmed;
+            pmtu->state = RN_PMTU_BASE;
+            rxPmtuConfirm(pmtu, pmtu->base);
+            break;
+        }
+
+        case RN_PMTU_BASE:
+        case RN_PMTU_ERROR:
+        {
+            pmtu->state   = RN_PMTU_ERROR;
+            pmtu->next_at = now + RN_PMTU_RAISE_NS;
+            break;
+        }
+    }
+}
+
+void rnPmtuInit(OUT RnPmtu *pmtu, uint16_t base, uint16_t max, uint64_t now)
+{
+    base = RN_PMTU_ALIGN(base);
+    max  = RN_PMTU_ALIGN(max < UINT16_MAX - 8 ? max : UINT16_MAX - 8);
+
+    *pmtu = (RnPmtu) {
+        .state     = RN_PMTU_SEARCHING,
+        .base      = base,
+        .confirmed = base,
+        .high      = (max > base ? max : base) + 8,
+        .max       = max > base ? max : base,
+        .next_at   = now,
+    };
+}
+
+uint16_t rnPmtuProbeDue(RnPmtu *pmtu, uint64_t now)
+{
+    if (pmtu->probe_size != 0)
+    {
+        if (now - pmtu->probe_sent_at < RN_PMTU_PROBE_TIMEOUT_NS)
+        {
+            return 0;
+        }
+
+        if (pmtu->probe_count < RN_PMTU_PROBE_ATTEMPTS)
+        {
+            ++pmtu->probe_count;
+            pmtu->probe_sent_at = now;
+            return pmtu->probe_size;
+        }
+
+        rxPmtuLost(pmtu, now);
+    }
+
+    if (now < pmtu->next_at)
+    {
+        return 0;
+    }
+
+    switch (pmtu->state)
+    {
+        case RN_PMTU_ERROR:
+        {
+            pmtu->state = RN_PMTU_BASE;
+            return rxPmtuProbe(pmtu, pmtu->base, now);
+        }
+
+        case RN_PMTU_BASE:
+        {
+            return rxPmtuProbe(pmtu, pmtu->base, now);
+        }
+
+        case RN_PMTU_SEARCH_COMPLETE:
+        {
+            // sizes below the maximum are raised again once in a while, paths change
+            if (pmtu->high <= pmtu->max && now - pmtu->searched_at >= RN_PMTU_RAISE_NS)
+            {
+                pmtu->state = RN_PMTU_SEARCHING;
+                pmtu->high  = pmtu->max + 8;
+                break;
+            }
+
+            if (pmtu->confirmed == pmtu->base)
+            {
+                pmtu->next_at = now + RN_PMTU_CONFIRM_NS;
+                return 0;
+            }
+
+            return rxPmtuProbe(pmtu, pmtu->confirmed, now);
+        }
+
+        case RN_PMTU_SEARCHING:
+        {
+            break;
+        }
+    }
+
+    uint16_t size = RN_PMTU_ALIGN(((uint32_t)pmtu->confirmed + pmtu->high) / 2);
+    if (size <= pmtu->confirmed)
+    {
+        pmtu->state       = RN_PMTU_SEARCH_COMPLETE;
+        pmtu->searched_at = now;
+        pmtu->next_at     = now + RN_PMTU_CONFIRM_NS;
+        return 0;
+    }
+
+    return rxPmtuProbe(pmtu, size, now);
+}
+
+void rnPmtuProbeAcked(RnPmtu *pmtu, uint16_t size, uint64_t now)
+{
+    if (pmtu->probe_size == 0 || size != pmtu->probe_size)
+    {
+        return;
+    }
+
+    pmtu->probe_size  = 0;
+    pmtu->probe_count = 0;
+    pmtu->next_at     = now;
+
+    switch (pmtu->state)
+    {
+        case RN_PMTU_BASE:
+        {
+            pmtu->state = RN_PMTU_SEARCHING;
+            break;
+        }
+
+        case RN_PMTU_SEARCHING:
+        {
+            rxPmtuConfirm(pmtu, size);
+            break;
+        }
+
+        case RN_PMTU_SEARCH_COMPLETE:
+        {
+            pmtu->next_at = now + RN_PMTU_CONFIRM_NS;
+            break;
+        }
+
+        case RN_PMTU_ERROR:
+        {
+            break;
+        }
+    }
+}
+
+uint16_t rnPmtuConfirmed(const RnPmtu *pmtu)
+{
+    return __atomic_load_n(&pmtu->confirmed, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,525 @@
+#include "../include/rnlib/clock.h"
+#include "../include/rnlib/poller.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+    #include <errno.h>
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <sys/timerfd.h>
+    #include <time.h>
+    #include <unistd.h>
+
+    #define RN_POLLER_EPOLL 1
+
+    // epoll_pwait2 arrived with glibc 2.35, older ones arm a timerfd instead
+    #if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 35))
+        #define RN_POLLER_PWAIT2 1
+    #endif
+#elif defined(_WIN32)
+    #include <winsock2.h>
+
+    #define RN_POLLER_POLL(FDS, COUNT, TIMEOUT) WSAPoll(FDS, COUNT, TIMEOUT)
+    #define RN_POLLER_ERR_VALUE                 WSAGetLastError()
+    #define RN_POLLER_INTERRUPTED(ERROR)        false
+
+    typedef WSAPOLLFD RxPollerDescriptor;
+#else
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <poll.h>
+    #include <unistd.h>
+
+    #define RN_POLLER_POLL(FDS, COUNT, TIMEOUT) poll(FDS, COUNT, TIMEOUT)
+    #define RN_POLLER_ERR_VALUE                 errno
+    #define RN_POLLER_INTERRUPTED(ERROR)        ((ERROR) == EINTR)
+
+    // the read end of a pipe is the first descriptor, see rnPollerWake
+    #define RN_POLLER_PIPE 1
+
+    typedef struct pollfd RxPollerDescriptor;
+#endif
+
+// epoll_wait takes at most this many events per call, the rest stay ready
+#define RN_POLLER_EVENTS_MAX 64
+
+// epoll data of the poller's own descriptors, tokens of sockets never exceed 32 bits
+#define RN_POLLER_WAKE_EVENT  (1ull << 32)
+#define RN_POLLER_TIMER_EVENT (2ull << 32)
+
+struct RnPoller
+{
+    uint64_t spin_ns;
+    uint64_t spin_min_ns;
+    uint64_t spin_max_ns;
+    uint32_t busy_poll_us;
+    uint32_t busy_poll_budget;
+
+    // set once the current wait saw rnPollerWake
+    bool woken;
+
+#ifdef RN_POLLER_EPOLL
+    int epoll;
+    int wake;
+    int timer;
+    bool pwait2;
+#else
+    uint32_t count;
+    uint32_t capacity;
+    RxPollerDescriptor *descriptors;
+    uint32_t *tokens;
+#endif
+
+#ifdef RN_POLLER_PIPE
+    int wake[2];
+#endif
+};
+
+#ifdef RN_POLLER_EPOLL
+static int rxPollerWatch(RnPoller *poller, int handle, uint64_t data)
+{
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data   = { .u64 = data },
+    };
+
+    return epoll_ctl(poller->epoll, EPOLL_CTL_ADD, handle, &event) != 0 ? errno : RN_OK;
+}
+
+static int rxPollerOpenEpoll(RnPoller *poller)
+{
+    poller->wake   = -1;
+    poller->timer  = -1;
+    poller->epoll  = epoll_create1(EPOLL_CLOEXEC);
+    poller->pwait2 = true;
+    if (poller->epoll < 0)
+    {
+        return errno;
+    }
+
+    poller->wake = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (poller->wake < 0)
+    {
+        return errno;
+    }
+
+    poller->timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (poller->timer < 0)
+    {
+        return errno;
+    }
+
+    int wake_result = rxPollerWatch(poller, poller->wake, RN_POLLER_WAKE_EVENT);
+    if (wake_result != RN_OK)
+    {
+        return wake_result;
+    }
+
+    return rxPollerWatch(poller, poller->timer, RN_POLLER_TIMER_EVENT);
+}
+#endif
+
+#ifdef RN_POLLER_PIPE
+static int rxPollerOpenPipe(RnPoller *poller)
+{
+    poller->wake[0] = -1;
+    poller->wake[1] = -1;
+    if (pipe(poller->wake) != 0)
+    {
+        return errno;
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (fcntl(poller->wake[i], F_SETFL, O_NONBLOCK) != 0 ||
+            fcntl(poller->wake[i], F_SETFD, FD_CLOEXEC) != 0)
+        {
+            return errno;
+        }
+    }
+
+    poller->capacity    = 8;
+    poller->descriptors = malloc(poller->capacity * sizeof(RxPollerDescriptor));
+    poller->tokens      = malloc(poller->capacity * sizeof(uint32_t));
+    if (poller->descriptors == NULL || poller->tokens == NULL)
+    {
+        return RN_OOM;
+    }
+
+    poller->descriptors[0] = (RxPollerDescriptor) {
+        .fd     = poller->wake[0],
+        .events = POLLIN,
+    };
+
+    poller->tokens[0] = 0;
+    poller->count     = 1;
+    return RN_OK;
+}
+#endif
+
+int rnPollerOpen(const RnPollerConfig *config, OUT RnPoller **out)
+{
+    *out = calloc(1, sizeof(RnPoller));
+    if (*out == NULL)
+    {
+        return RN_OOM;
+    }
+
+    (*out)->spin_min_ns      = (uint64_t)config->spin_min_us * 1000;
+    (*out)->spin_max_ns      = (uint64_t)config->spin_max_us * 1000;
+    (*out)->spin_ns          = (*out)->spin_min_ns;
+    (*out)->busy_poll_us     = config->busy_poll_us;
+    (*out)->busy_poll_budget = config->busy_poll_budget;
+
+    int open_result = RN_OK;
+#if defined(RN_POLLER_EPOLL)
+    open_result = rxPollerOpenEpoll(*out);
+#elif defined(RN_POLLER_PIPE)
+    open_result = rxPollerOpenPipe(*out);
+#endif
+
+    if (open_result != RN_OK)
+    {
+        rnPollerClose(*out);
+        return open_result;
+    }
+
+    return RN_OK;
+}
+
+int rnPollerClose(IN RnPoller *poller)
+{
+#ifdef RN_POLLER_EPOLL
+    // descriptors that failed to open are -1, closing them is harmless
+    close(poller->timer);
+    close(poller->wake);
+    close(poller->epoll);
+#else
+    free(poller->descriptors);
+    free(poller->tokens);
+#endif
+
+#ifdef RN_POLLER_PIPE
+    close(poller->wake[0]);
+    close(poller->wake[1]);
+#endif
+
+    free(poller);
+    return RN_OK;
+}
+
+int rnPollerWake(RnPoller *poller)
+{
+    // a full eventfd counter or pipe already holds a pending wakeup
+#if defined(RN_POLLER_EPOLL)
+    uint64_t one = 1;
+    if (write(poller->wake, &one, sizeof one) < 0 && errno != EAGAIN)
+    {
+        return errno;
+    }
+#elif defined(RN_POLLER_PIPE)
+    uint8_t one = 1;
+    if (write(poller->wake[1], &one, sizeof one) < 0 && errno != EAGAIN)
+    {
+        return errno;
+    }
+#else
+    (void)poller;
+#endif
+
+    return RN_OK;
+}
+
+static int rxPollerAdd(RnPoller *poller, int handle, uint32_t token)
+{
+#ifdef RN_POLLER_EPOLL
+    return rxPollerWatch(poller, handle, token);
+#else
+    if (poller->count == poller->capacity)
+    {
+        uint32_t capacity = poller->capacity ? poller->capacity * 2 : 8;
+
+        RxPollerDescriptor *descriptors = realloc(
+              poller->descriptors, capacity * sizeof(RxPollerDescriptor));
+        if (descriptors == NULL)
+        {
+            return RN_OOM;
+        }
+
+        poller->descriptors = descriptors;
+
+        uint32_t *tokens = realloc(poller->tokens, capacity * sizeof(uint32_t));
+        if (tokens == NULL)
+        {
+            return RN_OOM;
+        }
+
+        poller->tokens   = tokens;
+        poller->capacity = capacity;
+    }
+
+    poller->descriptors[poller->count] = (RxPollerDescriptor) {
+        .fd     = handle,
+        .events = POLLIN,
+    };
+
+    poller->tokens[poller->count++] = token;
+    return RN_OK;
+#endif
+}
+
+static int rxPollerRemove(RnPoller *poller, int handle)
+{
+#ifdef RN_POLLER_EPOLL
+    if (epoll_ctl(poller->epoll, EPOLL_CTL_DEL, handle, NULL) != 0)
+    {
+        return errno;
+    }
+#else
+    for (uint32_t i = 0; i < poller->count; ++i)
+    {
+        if ((int)poller->descriptors[i].fd == handle)
+        {
+            --poller->count;
+            poller->descriptors[i] = poller->descriptors[poller->count];
+            poller->tokens[i]      = poller->tokens[poller->count];
+            break;
+        }
+    }
+#endif
+
+    return RN_OK;
+}
+
+#define RN_POLLER_IMPL(IP)                                                                         \
+    int rnPollerAdd##IP(RnPoller *poller, RnSocket##IP *socket, uint32_t token)                    \
+    {                                                                                              \
+        if (poller->busy_poll_us > 0)                                                              \
+        {                                                                                          \
+            int busy_result = rnSocketSetBusyPoll##IP(                                             \
+                  socket, poller->busy_poll_us, poller->busy_poll_budget);                         \
+            if (busy_result != RN_OK)                                                              \
+            {                                                                                      \
+                return busy_result;                                                                \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return rxPollerAdd(poller, rnSocketHandle##IP(socket), token);                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnPollerRemove##IP(RnPoller *poller, RnSocket##IP *socket)                                 \
+    {                                                                                              \
+        return rxPollerRemove(poller, rnSocketHandle##IP(socket));                                 \
+    }
+
+RN_POLLER_IMPL(IPv4)
+RN_POLLER_IMPL(IPv6)
+
+#undef RN_POLLER_IMPL
+
+#ifdef RN_POLLER_EPOLL
+/**
+ * epoll_wait with a nanosecond timeout, 0 returns immediately and
+ * RN_POLLER_WAIT_FOREVER blocks.
+ */
+static int rxPollerEpoll(
+      RnPoller *poller, uint64_t timeout_ns, struct epoll_event *events, int limit)
+{
+    if (timeout_ns == 0 || timeout_ns == RN_POLLER_WAIT_FOREVER)
+    {
+        return epoll_wait(poller->epoll, events, limit, timeout_ns == 0 ? 0 : -1);
+    }
+
+    struct timespec timeout = {
+        .tv_sec  = (time_t)(timeout_ns / 1000000000),
+        .tv_nsec = (long)(timeout_ns % 1000000000),
+    };
+
+#ifdef RN_POLLER_PWAIT2
+    if (poller->pwait2)
+    {
+        int ready = epoll_pwait2(poller->epoll, events, limit, &timeout, NULL);
+        if (ready >= 0 || errno != ENOSYS)
+        {
+            return ready;
+        }
+
+        // kernels before 5.11 lack it, the timer takes over for good
+        poller->pwait2 = false;
+    }
+#endif
+
+    // arming also clears an expiry left over from an earlier wait
+    struct itimerspec timer = { .it_value = timeout };
+    if (timerfd_settime(poller->timer, 0, &timer, NULL) != 0)
+    {
+        return -1;
+    }
+
+    return epoll_wait(poller->epoll, events, limit, -1);
+}
+#endif
+
+/**
+ * Single poll, `timeout_ns` of 0 returns immediately and RN_POLLER_WAIT_FOREVER
+ * blocks. Only epoll honours timeouts below a millisecond, poll and WSAPoll
+ * round them up.
+ */
+static int rxPollerPoll(
+      RnPoller *poller, uint64_t timeout_ns, uint32_t *tokens, uint32_t capacity,
+      uint32_t *count)
+{
+    *count = 0;
+
+#ifdef RN_POLLER_EPOLL
+    struct epoll_event events[RN_POLLER_EVENTS_MAX];
+    int limit = capacity < RN_POLLER_EVENTS_MAX ? (int)capacity : RN_POLLER_EVENTS_MAX;
+
+    int ready = rxPollerEpoll(poller, timeout_ns, events, limit);
+    if (ready < 0)
+    {
+        return errno == EINTR ? RN_OK : errno;
+    }
+
+    for (int i = 0; i < ready; ++i)
+    {
+        uint64_t drained;
+        if (events[i].data.u64 == RN_POLLER_WAKE_EVENT)
+        {
+            poller->woken = true;
+            read(poller->wake, &drained, sizeof drained);
+        }
+        else if (events[i].data.u64 == RN_POLLER_TIMER_EVENT)
+        {
+            read(poller->timer, &drained, sizeof drained);
+        }
+        else
+        {
+            tokens[(*count)++] = (uint32_t)events[i].data.u64;
+        }
+    }
+#else
+    bool bounded      = timeout_ns != 0 && timeout_ns != RN_POLLER_WAIT_FOREVER;
+    uint64_t deadline = bounded ? rnClockMonotonic() + timeout_ns : 0;
+    int ready;
+    for (;;)
+    {
+        int timeout_ms = timeout_ns == RN_POLLER_WAIT_FOREVER ? -1 : 0;
+        if (bounded)
+        {
+            uint64_t now       = rnClockMonotonic();
+            uint64_t remaining = now < deadline ? (deadline - now + 999999) / 1000000 : 0;
+            timeout_ms         = remaining < INT32_MAX ? (int)remaining : INT32_MAX;
+        }
+
+        ready = RN_POLLER_POLL(poller->descriptors, poller->count, timeout_ms);
+        if (ready >= 0)
+        {
+            break;
+        }
+
+        // signals interrupt the wait, not the remaining timeout
+        int error = RN_POLLER_ERR_VALUE;
+        if (!RN_POLLER_INTERRUPTED(error))
+        {
+            return error;
+        }
+    }
+
+    for (uint32_t i = 0; i < poller->count && *count < capacity && ready > 0; ++i)
+    {
+        if (poller->descriptors[i].revents == 0)
+        {
+            continue;
+        }
+
+        --ready;
+
+#ifdef RN_POLLER_PIPE
+        if (i == 0)
+        {
+            uint8_t drained[64];
+            poller->woken = true;
+            while (read(poller->wake[0], drained, sizeof drained) > 0)
+            {
+            }
+
+            continue;
+        }
+#endif
+
+        tokens[(*count)++] = poller->tokens[i];
+    }
+#endif
+
+    return RN_OK;
+}
+
+static uint64_t rxPollerClamp(const RnPoller *poller, uint64_t spin_ns)
+{
+    if (spin_ns < poller->spin_min_ns)
+    {
+        return poller->spin_min_ns;
+    }
+
+    return spin_ns < poller->spin_max_ns ? spin_ns : poller->spin_max_ns;
+}
+
+int rnPollerWait(
+      RnPoller *poller, uint64_t timeout_ns, OUT uint32_t *tokens, uint32_t capacity,
+      OUT uint32_t *count)
+{
+    uint64_t start   = rnClockMonotonic();
+    uint64_t elapsed = 0;
+
+    poller->woken = false;
+
+    // spin phase, arrivals within the window cost no context switch
+    uint64_t spin = poller->spin_ns < timeout_ns ? poller->spin_ns : timeout_ns;
+    do
+    {
+        int result = rxPollerPoll(poller, 0, tokens, capacity, count);
+        if (result != RN_OK || *count > 0 || poller->woken)
+        {
+            return result;
+        }
+
+        elapsed = rnClockMonotonic() - start;
+    } while (elapsed < spin);
+
+    if (elapsed >= timeout_ns)
+    {
+        poller->spin_ns = rxPollerClamp(poller, poller->spin_ns / 2);
+        return RN_OK;
+    }
+
+    // block phase
+    uint64_t remaining = timeout_ns;
+    if (timeout_ns != RN_POLLER_WAIT_FOREVER)
+    {
+        remaining = timeout_ns - elapsed;
+    }
+
+    int result = rxPollerPoll(poller, remaining, tokens, capacity, count);
+
+    // a datagram that arrived shortly after the window widens it to cover the
+    // gap next time, long idle periods let it decay
+    uint64_t gap = rnClockMonotonic() - start;
+    if (*count > 0 && gap <= poller->spin_max_ns)
+    {
+        poller->spin_ns = rxPollerClamp(poller, gap * 2);
+    }
+    else
+    {
+        poller->spin_ns = rxPollerClamp(poller, poller->spin_ns / 2);
+    }
+
+    return result;
+}
+
+uint64_t rnPollerSpinWindow(const RnPoller *poller)
+{
+    return poller->spin_ns;
+}
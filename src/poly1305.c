@@ -0,0 +1,378 @@
+#include "../include/rnlib/poly1305.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    #define RN_POLY1305_X86 1
+    #include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+    #define SODIUM_STATIC 1
+    #define SODIUM_EXPORT
+#endif
+
+#include <sodium.h>
+
+/**
+ * The vector kernel keeps the accumulator and `r` of every lane in five limbs
+ * of 26 bits, one 64 bit lane per message, as poly1305-donna does with scalar
+ * registers. Products of limbs stay below 2^58 and fit their lane.
+ */
+#define RN_POLY1305_LIMB_MASK 0x3FFFFFF
+#define RN_POLY1305_HIBIT     (1u << 24)
+
+static inline uint64_t rxPoly1305Load64(const uint8_t *data)
+{
+    uint64_t value;
+    memcpy(&value, data, sizeof value);
+    return value;
+}
+
+static inline uint32_t rxPoly1305Load32(const uint8_t *data)
+{
+    uint32_t value;
+    memcpy(&value, data, sizeof value);
+    return value;
+}
+
+static void rxPoly1305Clamp(const uint8_t *key, OUT uint32_t r[5])
+{
+    r[0] = rxPoly1305Load32(key + 0) & 0x3FFFFFF;
+    r[1] = (rxPoly1305Load32(key + 3) >> 2) & 0x3FFFF03;
+    r[2] = (rxPoly1305Load32(key + 6) >> 4) & 0x3FFC0FF;
+    r[3] = (rxPoly1305Load32(key + 9) >> 6) & 0x3F03FFF;
+    r[4] = (rxPoly1305Load32(key + 12) >> 8) & 0x00FFFFF;
+}
+
+/**
+ * Fully reduces the accumulator `h` modulo 2^130 - 5, adds the second half of
+ * `key` and compares the result against `tag` in constant time.
+ */
+static bool rxPoly1305Finish(uint64_t h[5], const uint8_t *key, const uint8_t *tag)
+{
+    uint32_t h0 = (uint32_t)h[0];
+    uint32_t h1 = (uint32_t)h[1];
+    uint32_t h2 = (uint32_t)h[2];
+    uint32_t h3 = (uint32_t)h[3];
+    uint32_t h4 = (uint32_t)h[4];
+
+    uint32_t c;
+    c = h1 >> 26, h1 &= RN_POLY1305_LIMB_MASK, h2 += c;
+    c = h2 >> 26, h2 &= RN_POLY1305_LIMB_MASK, h3 += c;
+    c = h3 >> 26, h3 &= RN_POLY1305_LIMB_MASK, h4 += c;
+    c = h4 >> 26, h4 &= RN_POLY1305_LIMB_MASK, h0 += c * 5;
+    c = h0 >> 26, h0 &= RN_POLY1305_LIMB_MASK, h1 += c;
+
+    // h - p, taken if it does not underflow
+    uint32_t g0 = h0 + 5;
+    c = g0 >> 26, g0 &= RN_POLY1305_LIMB_MASK;
+    uint32_t g1 = h1 + c;
+    c = g1 >> 26, g1 &= RN_POLY1305_LIMB_MASK;
+    uint32_t g2 = h2 + c;
+    c = g2 >> 26, g2 &= RN_POLY1305_LIMB_MASK;
+    uint32_t g3 = h3 + c;
+    c = g3 >> 26, g3 &= RN_POLY1305_LIMB_MASK;
+    uint32_t g4 = h4 + c - (1u << 26);
+
+    uint32_t mask = (g4 >> 31) - 1;
+    h0            = (h0 & ~mask) | (g0 & mask);
+    h1            = (h1 & ~mask) | (g1 & mask);
+    h2            = (h2 & ~mask) | (g2 & mask);
+    h3            = (h3 & ~mask) | (g3 & mask);
+    h4            = (h4 & ~mask) | (g4 & mask);
+
+    uint64_t f0 = (uint64_t)(h0 | h1 << 26) + rxPoly1305Load32(key + 16);
+    uint64_t f1 = (uint64_t)(h1 >> 6 | h2 << 20) + rxPoly1305Load32(key + 20) + (f0 >> 32);
+    uint64_t f2 = (uint64_t)(h2 >> 12 | h3 << 14) + rxPoly1305Load32(key + 24) + (f1 >> 32);
+    uint64_t f3 = (uint64_t)(h3 >> 18 | h4 << 8) + rxPoly1305Load32(key + 28) + (f2 >> 32);
+
+    uint32_t diff = ((uint32_t)f0 ^ rxPoly1305Load32(tag + 0)) |
+                    ((uint32_t)f1 ^ rxPoly1305Load32(tag + 4)) |
+                    ((uint32_t)f2 ^ rxPoly1305Load32(tag + 8)) |
+                    ((uint32_t)f3 ^ rxPoly1305Load32(tag + 12));
+    return diff == 0;
+}
+
+static void rxPoly1305VerifyScalar(const RnPoly1305Job *jobs, size_t count, OUT bool *valid)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        valid[i] =
+              crypto_onetimeauth_verify(jobs[i].tag, jobs[i].data, jobs[i].size, jobs[i].key) == 0;
+    }
+}
+
+#ifdef RN_POLY1305_X86
+
+struct RxPoly1305Lanes
+{
+    __m256i h[5];
+    __m256i r[5];
+    __m256i s[5];
+};
+
+/**
+ * h = (h + m) * r for every lane, with m given as the low and high 64 bits of
+ * each lane's block.
+ */
+__attribute__((target("avx2"))) static inline void rxPoly1305BlockAVX2(
+      struct RxPoly1305Lanes *lanes, __m256i low, __m256i high, __m256i hibit)
+{
+    const __m256i mask = _mm256_set1_epi64x(RN_POLY1305_LIMB_MASK);
+
+    __m256i h0 = _mm256_add_epi64(lanes->h[0], _mm256_and_si256(low, mask));
+    __m256i h1 = _mm256_add_epi64(lanes->h[1], _mm256_and_si256(_mm256_srli_epi64(low, 26), mask));
+    __m256i h2 = _mm256_add_epi64(
+          lanes->h[2],
+          _mm256_and_si256(
+                _mm256_or_si256(_mm256_srli_epi64(low, 52), _mm256_slli_epi64(high, 12)), mask));
+    __m256i h3 = _mm256_add_epi64(lanes->h[3], _mm256_and_si256(_mm256_srli_epi64(high, 14), mask));
+    __m256i h4 = _mm256_add_epi64(
+          lanes->h[4], _mm256_or_si256(_mm256_srli_epi64(high, 40), hibit));
+
+    const __m256i *r = lanes->r;
+    const __m256i *s = lanes->s;
+
+    // s[i] is 5 * r[i], the limbs wrapping past 2^130 come back times 5
+    __m256i d0 = _mm256_mul_epu32(h0, r[0]);
+    d0         = _mm256_add_epi64(d0, _mm256_mul_epu32(h1, s[4]));
+    d0         = _mm256_add_epi64(d0, _mm256_mul_epu32(h2, s[3]));
+    d0         = _mm256_add_epi64(d0, _mm256_mul_epu32(h3, s[2]));
+    d0         = _mm256_add_epi64(d0, _mm256_mul_epu32(h4, s[1]));
+
+    __m256i d1 = _mm256_mul_epu32(h0, r[1]);
+    d1         = _mm256_add_epi64(d1, _mm256_mul_epu32(h1, r[0]));
+    d1         = _mm256_add_epi64(d1, _mm256_mul_epu32(h2, s[4]));
+    d1         = _mm256_add_epi64(d1, _mm256_mul_epu32(h3, s[3]));
+    d1         = _mm256_add_epi64(d1, _mm256_mul_epu32(h4, s[2]));
+
+    __m256i d2 = _mm256_mul_epu32(h0, r[2]);
+    d2         = _mm256_add_epi64(d2, _mm256_mul_epu32(h1, r[1]));
+    d2         = _mm256_add_epi64(d2, _mm256_mul_epu32(h2, r[0]));
+    d2         = _mm256_add_epi64(d2, _mm256_mul_epu32(h3, s[4]));
+    d2         = _mm256_add_epi64(d2, _mm256_mul_epu32(h4, s[3]));
+
+    __m256i d3 = _mm256_mul_epu32(h0, r[3]);
+    d3         = _mm256_add_epi64(d3, _mm256_mul_epu32(h1, r[2]));
+    d3         = _mm256_add_epi64(d3, _mm256_mul_epu32(h2, r[1]));
+    d3         = _mm256_add_epi64(d3, _mm256_mul_epu32(h3, r[0]));
+    d3         = _mm256_add_epi64(d3, _mm256_mul_epu32(h4, s[4]));
+
+    __m256i d4 = _mm256_mul_epu32(h0, r[4]);
+    d4         = _mm256_add_epi64(d4, _mm256_mul_epu32(h1, r[3]));
+    d4         = _mm256_add_epi64(d4, _mm256_mul_epu32(h2, r[2]));
+    d4         = _mm256_add_epi64(d4, _mm256_mul_epu32(h3, r[1]));
+    d4         = _mm256_add_epi64(d4, _mm256_mul_epu32(h4, r[0]));
+
+    // partial carry, limbs end up a few bits above 26 at most
+    __m256i c;
+    c  = _mm256_srli_epi64(d0, 26), h0 = _mm256_and_si256(d0, mask), d1 = _mm256_add_epi64(d1, c);
+    c  = _mm256_srli_epi64(d1, 26), h1 = _mm256_and_si256(d1, mask), d2 = _mm256_add_epi64(d2, c);
+    c  = _mm256_srli_epi64(d2, 26), h2 = _mm256_and_si256(d2, mask), d3 = _mm256_add_epi64(d3, c);
+    c  = _mm256_srli_epi64(d3, 26), h3 = _mm256_and_si256(d3, mask), d4 = _mm256_add_epi64(d4, c);
+    c  = _mm256_srli_epi64(d4, 26), h4 = _mm256_and_si256(d4, mask);
+    h0 = _mm256_add_epi64(h0, _mm256_add_epi64(c, _mm256_slli_epi64(c, 2)));
+    c  = _mm256_srli_epi64(h0, 26), h0 = _mm256_and_si256(h0, mask), h1 = _mm256_add_epi64(h1, c);
+
+    lanes->h[0] = h0;
+    lanes->h[1] = h1;
+    lanes->h[2] = h2;
+    lanes->h[3] = h3;
+    lanes->h[4] = h4;
+}
+
+/**
+ * Verifies RN_POLY1305_LANES jobs at once. Blocks all lanes have in full run
+ * unmasked, the rest block by block with the final partial block of each lane
+ * padded and lanes already done left untouched.
+ */
+__attribute__((target("avx2"))) static void rxPoly1305VerifyLanesAVX2(
+      const RnPoly1305Job *jobs, OUT bool *valid)
+{
+    struct RxPoly1305Lanes lanes;
+
+    uint32_t r[RN_POLY1305_LANES][5];
+    size_t common = SIZE_MAX;
+    size_t blocks = 0;
+    for (int lane = 0; lane < RN_POLY1305_LANES; ++lane)
+    {
+        rxPoly1305Clamp(jobs[lane].key, r[lane]);
+
+        size_t size = jobs[lane].size;
+        common      = size / 16 < common ? size / 16 : common;
+        blocks      = (size + 15) / 16 > blocks ? (size + 15) / 16 : blocks;
+    }
+
+    for (int limb = 0; limb < 5; ++limb)
+    {
+        lanes.h[limb] = _mm256_setzero_si256();
+        lanes.r[limb] = _mm256_set_epi64x(r[3][limb], r[2][limb], r[1][limb], r[0][limb]);
+        lanes.s[limb] =
+              _mm256_add_epi64(lanes.r[limb], _mm256_slli_epi64(lanes.r[limb], 2));
+    }
+
+    const uint8_t *data[RN_POLY1305_LANES] = {
+        jobs[0].data,
+        jobs[1].data,
+        jobs[2].data,
+        jobs[3].data,
+    };
+
+    // lanes 0 and 2, and 1 and 3, share a register, unpacking yields the low and high qwords
+    const __m256i hibit = _mm256_set1_epi64x(RN_POLY1305_HIBIT);
+    for (size_t offset = 0; offset < common * 16; offset += 16)
+    {
+        __m256i even = _mm256_inserti128_si256(
+              _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(data[0] + offset))),
+              _mm_loadu_si128((const __m128i *)(data[2] + offset)), 1);
+        __m256i odd = _mm256_inserti128_si256(
+              _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(data[1] + offset))),
+              _mm_loadu_si128((const __m128i *)(data[3] + offset)), 1);
+        rxPoly1305BlockAVX2(
+              &lanes, _mm256_unpacklo_epi64(even, odd), _mm256_unpackhi_epi64(even, odd), hibit);
+    }
+
+    for (size_t offset = common * 16; offset < blocks * 16; offset += 16)
+    {
+        uint64_t words[2][RN_POLY1305_LANES];
+        int64_t bits[RN_POLY1305_LANES];
+        int64_t active[RN_POLY1305_LANES];
+        for (int lane = 0; lane < RN_POLY1305_LANES; ++lane)
+        {
+            uint8_t block[16] = { 0 };
+            size_t size       = jobs[lane].size;
+            if (offset < size)
+            {
+                size_t length = size - offset < 16 ? size - offset : 16;
+                memcpy(block, data[lane] + offset, length);
+                if (length < 16)
+                {
+                    block[length] = 1;
+                }
+            }
+
+            words[0][lane] = rxPoly1305Load64(block);
+            words[1][lane] = rxPoly1305Load64(block + 8);
+            bits[lane]     = offset + 16 <= size ? RN_POLY1305_HIBIT : 0;
+            active[lane]   = offset < size ? -1 : 0;
+        }
+
+        struct RxPoly1305Lanes before = lanes;
+        rxPoly1305BlockAVX2(
+              &lanes, _mm256_loadu_si256((const __m256i *)words[0]),
+              _mm256_loadu_si256((const __m256i *)words[1]),
+              _mm256_loadu_si256((const __m256i *)bits));
+
+        __m256i keep = _mm256_loadu_si256((const __m256i *)active);
+        for (int limb = 0; limb < 5; ++limb)
+        {
+            lanes.h[limb] = _mm256_blendv_epi8(before.h[limb], lanes.h[limb], keep);
+        }
+    }
+
+    uint64_t h[5][RN_POLY1305_LANES];
+    for (int limb = 0; limb < 5; ++limb)
+    {
+        _mm256_storeu_si256((__m256i *)h[limb], lanes.h[limb]);
+    }
+
+    for (int lane = 0; lane < RN_POLY1305_LANES; ++lane)
+    {
+        uint64_t accumulator[5] = { h[0][lane], h[1][lane], h[2][lane], h[3][lane], h[4][lane] };
+        valid[lane] = rxPoly1305Finish(accumulator, jobs[lane].key, jobs[lane].tag);
+        sodium_memzero(accumulator, sizeof accumulator);
+    }
+
+    sodium_memzero(r, sizeof r);
+    sodium_memzero(&lanes, sizeof lanes);
+}
+
+__attribute__((target("avx2"))) static void rxPoly1305VerifyAVX2(
+      const RnPoly1305Job *jobs, size_t count, OUT bool *valid)
+{
+    size_t i = 0;
+    for (; i + RN_POLY1305_LANES <= count; i += RN_POLY1305_LANES)
+    {
+        rxPoly1305VerifyLanesAVX2(jobs + i, valid + i);
+    }
+
+    // a partial group still beats verifying two or more one by one, idle lanes hash nothing
+    if (count - i >= 2)
+    {
+        static const uint8_t idle[32];
+
+        RnPoly1305Job group[RN_POLY1305_LANES];
+        bool group_valid[RN_POLY1305_LANES];
+        for (size_t lane = 0; lane < RN_POLY1305_LANES; ++lane)
+        {
+            group[lane] = i + lane < count ? jobs[i + lane]
+                                           : (RnPoly1305Job) { idle, 0, idle, idle };
+        }
+
+        rxPoly1305VerifyLanesAVX2(group, group_valid);
+        memcpy(valid + i, group_valid, (count - i) * sizeof *valid);
+        i = count;
+    }
+
+    rxPoly1305VerifyScalar(jobs + i, count - i, valid + i);
+}
+
+#endif
+
+static int rxPoly1305Selected = -1;
+
+static enum RnPoly1305Kernel rxPoly1305Detect()
+{
+#ifdef RN_POLY1305_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return RN_POLY1305_AVX2;
+    }
+#endif
+
+    return RN_POLY1305_SCALAR;
+}
+
+enum RnPoly1305Kernel rnPoly1305Kernel()
+{
+    int kernel = __atomic_load_n(&rxPoly1305Selected, __ATOMIC_RELAXED);
+    if (kernel < 0)
+    {
+        kernel = rxPoly1305Detect();
+        __atomic_store_n(&rxPoly1305Selected, kernel, __ATOMIC_RELAXED);
+    }
+
+    return (enum RnPoly1305Kernel)kernel;
+}
+
+void rnPoly1305SelectKernel(enum RnPoly1305Kernel kernel)
+{
+    if (kernel > rxPoly1305Detect())
+    {
+        kernel = RN_POLY1305_SCALAR;
+    }
+
+    __atomic_store_n(&rxPoly1305Selected, (int)kernel, __ATOMIC_RELAXED);
+}
+
+void rnPoly1305VerifyBatch(const RnPoly1305Job *jobs, size_t count, OUT bool *valid)
+{
+    switch (rnPoly1305Kernel())
+    {
+#ifdef RN_POLY1305_X86
+        case RN_POLY1305_AVX2:
+        {
+            rxPoly1305VerifyAVX2(jobs, count, valid);
+            break;
+        }
+#endif
+
+        default:
+        {
+            rxPoly1305VerifyScalar(jobs, count, valid);
+            break;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#include "../include/rnlib/quantize.h"
+
+#include <math.h>
+
+RnQuantizeRange rnQuantizeRangeCreate(float min, float max, float precision)
+{
+    double steps  = ((double)max - min) / precision;
+    uint32_t bits = 1;
+    while (bits < 32 && (double)((1ull << bits) - 1) < steps)
+    {
+        ++bits;
+    }
+
+    return (RnQuantizeRange) {
+        .min  = min,
+        .max  = max,
+        .bits = bits,
+    };
+}
+
+RnQuantizedQuaternion rnQuantizeQuaternion(const RnQuaternion *quaternion, uint32_t bits)
+{
+    const float components[4] = { quaternion->x, quaternion->y, quaternion->z, quaternion->w };
+    const RnQuantizeRange range = {
+        .min  = -RN_QUANTIZE_QUATERNION_BOUND,
+        .max  = RN_QUANTIZE_QUATERNION_BOUND,
+        .bits = bits,
+    };
+
+    uint8_t largest = 0;
+    for (uint8_t i = 1; i < 4; ++i)
+    {
+        if (fabsf(components[i]) > fabsf(components[largest]))
+        {
+            largest = i;
+        }
+    }
+
+    // negate the whole quaternion so that the dropped component is positive
+    float sign = components[largest] < 0 ? -1.0f : 1.0f;
+
+    RnQuantizedQuaternion quantized = { .largest = largest };
+    for (uint8_t i = 0, j = 0; i < 4; ++i)
+    {
+        if (i != largest)
+        {
+            quantized.components[j++] = rnQuantizeFloat(&range, components[i] * sign);
+        }
+    }
+
+    return quantized;
+}
+
+RnQuaternion rnDequantizeQuaternion(const RnQuantizedQuaternion *quantized, uint32_t bits)
+{
+    const RnQuantizeRange range = {
+        .min  = -RN_QUANTIZE_QUATERNION_BOUND,
+        .max  = RN_QUANTIZE_QUATERNION_BOUND,
+        .bits = bits,
+    };
+
+    float components[4];
+    float sum = 0.0f;
+    for (uint8_t i = 0, j = 0; i < 4; ++i)
+    {
+        if (i != quantized->largest)
+        {
+            components[i] = rnDequantizeFloat(&range, quantized->components[j++]);
+            sum += components[i] * components[i];
+        }
+    }
+
+    components[quantized->largest & 3] = sum < 1.0f ? sqrtf(1.0f - sum) : 0.0f;
+
+    return (RnQuaternion) {
+        .x = components[0],
+        .y = components[1],
+        .z = components[2],
+        .w = components[3],
+    };
+}
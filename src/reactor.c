@@ -0,0 +1,992 @@
+#include "../include/rnlib/clock.h"
+#include "../include/rnlib/reactor.h"
+#include "../include/rnlib/snapshot.h"
+#include "../include/rnlib/table.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+
+    typedef HANDLE RxReactorThread;
+    typedef LPTHREAD_START_ROUTINE RxReactorThreadEntry;
+
+    #define RN_REACTOR_THREAD_RESULT DWORD WINAPI
+    #define RN_REACTOR_THREAD_RETURN 0
+#else
+    #include <pthread.h>
+
+    typedef pthread_t RxReactorThread;
+    typedef void *(*RxReactorThreadEntry)(void *);
+
+    #define RN_REACTOR_THREAD_RESULT void *
+    #define RN_REACTOR_THREAD_RETURN NULL
+#endif
+
+/**
+ * Upper bound of datagrams or events handled per direction before switching
+ * to the other, so that neither starves under load.
+ */
+#define RN_REACTOR_BATCH 64
+
+/**
+ * Snapshot records hold the I/O thread index (4) and whether the handshake of
+ * the connection completed (1), then the connection's own record. Snapshots
+ * of another connection type or layout are refused.
+ */
+#define RN_REACTOR_RECORD_HEADER 8
+#define RN_REACTOR_SNAPSHOT_KIND(TYPE, IP)                                                         \
+    (rxReactorHash(#TYPE #IP, sizeof(#TYPE #IP) - 1) ^ rnConnectionSnapshotLayout##TYPE##IP())
+
+static void *rxReactorAllocateAligned(size_t size)
+{
+#ifdef _WIN32
+    void *memory = _aligned_malloc(size, 64);
+#else
+    void *memory = NULL;
+    if (posix_memalign(&memory, 64, size) != 0)
+    {
+        memory = NULL;
+    }
+#endif
+
+    if (memory != NULL)
+    {
+        memset(memory, 0, size);
+    }
+
+    return memory;
+}
+
+static void rxReactorFreeAligned(void *memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+static int rxReactorThreadStart(RxReactorThread *thread, RxReactorThreadEntry run, void *argument)
+{
+#ifdef _WIN32
+    *thread = CreateThread(NULL, 0, run, argument, 0, NULL);
+    return *thread != NULL ? RN_OK : (int)GetLastError();
+#else
+    return pthread_create(thread, NULL, run, argument);
+#endif
+}
+
+static void rxReactorThreadJoin(RxReactorThread thread)
+{
+#ifdef _WIN32
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+static uint32_t rxReactorHash(const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    uint32_t hash        = 2166136261u;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void rxReactorCount(uint64_t *counter)
+{
+    __atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
+#define RN_REACTOR_IMPL(TYPE, IP, BUFFER)                                                          \
+    RN_RING_DEFINE(Event##TYPE##IP, RnReactorEvent##TYPE##IP)                                      \
+                                                                                                   \
+    struct RxReactorSlot##TYPE##IP                                                                 \
+    {                                                                                              \
+        RnConnection##TYPE##IP *connection;                                                        \
+        RnAddress##IP address;                                                                     \
+        bool connected;                                                                            \
+        /* the application was handed the connection, see rxReactorAnnounce */                     \
+        bool announced;                                                                            \
+        uint64_t opened_at;                                                                        \
+    };                                                                                             \
+                                                                                                   \
+    /* state of a single I/O thread, the rings and `sleeping` are its only shared members */       \
+    struct RxReactorWorker##TYPE##IP                                                               \
+    {                                                                                              \
+        RnRingEvent##TYPE##IP ingress;                                                             \
+        RnRingEvent##TYPE##IP egress;                                                              \
+                                                                                                   \
+        RnSocket##IP *socket;                                                                      \
+        uint32_t idle_us;                                                                          \
+        uint64_t handshake_ns;                                                                     \
+        RnPoller *poller;                                                                          \
+        RnFilter filter;                                                                           \
+        RnFecConfig fec;                                                                           \
+        int running;                                                                               \
+                                                                                                   \
+        /* set while the worker may block in rnPollerWait, see rnReactorSubmit */                  \
+        int sleeping;                                                                              \
+                                                                                                   \
+        /* `connections_max` slots, the indices of those without a connection are in `free` */     \
+        uint32_t connections_max;                                                                  \
+        struct RxReactorSlot##TYPE##IP *slots;                                                     \
+        uint32_t *free;                                                                            \
+        uint32_t free_count;                                                                       \
+                                                                                                   \
+        /**                                                                                        \
+         * Slots by address, and connected secure sessions by connection id for peers whose        \
+         * address changed. The worker is their only reader, see rxReactorRun.                     \
+         */                                                                                        \
+        RnTable *addresses;                                                                        \
+        RnTable *routes;                                                                           \
+        uint64_t probe_at;                                                                         \
+                                                                                                   \
+        RnReactorStats stats;                                                                      \
+        RxReactorThread thread;                                                                    \
+                                                                                                   \
+        /* receives datagrams while the ingress ring is full */                                    \
+        RnReactorEvent##TYPE##IP overflow[RN_CONNECTION_READ_BATCH];                               \
+    };                                                                                             \
+                                                                                                   \
+    struct RnReactor##TYPE##IP                                                                     \
+    {                                                                                              \
+        uint32_t count;                                                                            \
+        struct RxReactorWorker##TYPE##IP *workers;                                                 \
+    };                                                                                             \
+                                                                                                   \
+    static struct RxReactorSlot##TYPE##IP *rxReactorFind##TYPE##IP(                                \
+          struct RxReactorWorker##TYPE##IP *worker, const RnAddress##IP *address)                  \
+    {                                                                                              \
+        return rnTableFind(worker->addresses, address);                                            \
+    }                                                                                              \
+                                                                                                   \
+    /* slot of `connection`, which may have moved on from its address, see rxReactorMigrate */     \
+    static struct RxReactorSlot##TYPE##IP *rxReactorSlot##TYPE##IP(                                \
+          struct RxReactorWorker##TYPE##IP *worker, RnConnection##TYPE##IP *connection)            \
+    {                                                                                              \
+        struct RxReactorSlot##TYPE##IP *slot =                                                     \
+              rxReactorFind##TYPE##IP(worker, rnConnectionAddress(connection));                    \
+        for (uint32_t i = 0; i < worker->connections_max &&                                        \
+                             (slot == NULL || slot->connection != connection); ++i)                \
+        {                                                                                          \
+            slot = &worker->slots[i];                                                              \
+        }                                                                                          \
+                                                                                                   \
+        return slot != NULL && slot->connection == connection ? slot : NULL;                       \
+    }                                                                                              \
+                                                                                                   \
+    /* takes a free slot for `connection`, there has to be one */                                  \
+    static struct RxReactorSlot##TYPE##IP *rxReactorLink##TYPE##IP(                                \
+          struct RxReactorWorker##TYPE##IP *worker, RnConnection##TYPE##IP *connection,            \
+          const RnAddress##IP *address)                                                            \
+    {                                                                                              \
+        struct RxReactorSlot##TYPE##IP *slot =                                                     \
+              &worker->slots[worker->free[worker->free_count - 1]];                                \
+        if (rnTableInsert(worker->addresses, address, slot) != RN_OK)                              \
+        {                                                                                          \
+            return NULL;                                                                           \
+        }                                                                                          \
+                                                                                                   \
+        --worker->free_count;                                                                      \
+        slot->connection = connection;                                                             \
+        slot->address    = *address;                                                               \
+        slot->connected  = false;                                                                  \
+        slot->announced  = false;                                                                  \
+        slot->opened_at  = rnClockMonotonic();                                                     \
+        rxReactorCount(&worker->stats.connections);                                                \
+        return slot;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static struct RxReactorSlot##TYPE##IP *rxReactorOpen##TYPE##IP(                                \
+          struct RxReactorWorker##TYPE##IP *worker, const RnAddress##IP *address,                  \
+          enum RnConnectionRole role)                                                              \
+    {                                                                                              \
+        struct RxReactorSlot##TYPE##IP *slot = rxReactorFind##TYPE##IP(worker, address);           \
+        if (slot != NULL)                                                                          \
+        {                                                                                          \
+            return slot;                                                                           \
+        }                                                                                          \
+                                                                                                   \
+        RnConnection##TYPE##IP *connection;                                                        \
+        if (worker->free_count == 0 ||                                                             \
+            rnConnectionOpen(worker->socket, address, role, &connection) != RN_OK)                 \
+        {                                                                                          \
+            return NULL;                                                                           \
+        }                                                                                          \
+                                                                                                   \
+        if (rnConnectionConfigureFec(connection, &worker->fec) == RN_OK)                           \
+        {                                                                                          \
+            slot = rxReactorLink##TYPE##IP(worker, connection, address);                           \
+        }                                                                                          \
+                                                                                                   \
+        if (slot == NULL)                                                                          \
+        {                                                                                          \
+            rnConnectionClose(connection);                                                         \
+        }                                                                                          \
+                                                                                                   \
+        return slot;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static RnConnection##TYPE##IP *rxReactorRoute##TYPE##IP(                                       \
+          struct RxReactorWorker##TYPE##IP *worker, uint32_t id)                                   \
+    {                                                                                              \
+        return rnTableFind(worker->routes, &id);                                                   \
+    }                                                                                              \
+                                                                                                   \
+    /* ids colliding with a routed session leave the newcomer unable to migrate, nothing worse */  \
+    static void rxReactorRouteAdd##TYPE##IP(                                                       \
+          struct RxReactorWorker##TYPE##IP *worker, RnConnection##TYPE##IP *connection)            \
+    {                                                                                              \
+        uint32_t id = rnConnectionId(connection);                                                  \
+        if (id != 0 && rxReactorRoute##TYPE##IP(worker, id) == NULL)                               \
+        {                                                                                          \
+            rnTableInsert(worker->routes, &id, connection);                                        \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void rxReactorRouteRemove##TYPE##IP(                                                    \
+          struct RxReactorWorker##TYPE##IP *worker, RnConnection##TYPE##IP *connection)            \
+    {                                                                                              \
+        uint32_t id = rnConnectionId(connection);                                                  \
+        if (id != 0 && rxReactorRoute##TYPE##IP(worker, id) == connection)                         \
+        {                                                                                          \
+            rnTableRemove(worker->routes, &id);                                                    \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    /* frees `slot` without closing its connection, see rxReactorDiscard */                        \
+    static void rxReactorUnlink##TYPE##IP(                                                         \
+          struct RxReactorWorker##TYPE##IP *worker, struct RxReactorSlot##TYPE##IP *slot)          \
+    {                                                                                              \
+        rnTableRemove(worker->addresses, &slot->address);                                          \
+        slot->connection                   = NULL;                                                 \
+        worker->free[worker->free_count++] = (uint32_t)(slot - worker->slots);                     \
+    }                                                                                              \
+                                                                                                   \
+    /* closes a connection that was unlinked already */                                            \
+    static void rxReactorDiscard##TYPE##IP(                                                        \
+          struct RxReactorWorker##TYPE##IP *worker, RnConnection##TYPE##IP *connection)            \
+    {                                                                                              \
+        rxReactorRouteRemove##TYPE##IP(worker, connection);                                        \
+        rnConnectionClose(connection);                                                             \
+        __atomic_store_n(                                                                          \
+              &worker->stats.connections, worker->stats.connections - 1, __ATOMIC_RELAXED);        \
+    }                                                                                              \
+                                                                                                   \
+    static void rxReactorRemove##TYPE##IP(                                                         \
+          struct RxReactorWorker##TYPE##IP *worker, RnConnection##TYPE##IP *connection)            \
+    {                                                                                              \
+        struct RxReactorSlot##TYPE##IP *slot = rxReactorSlot##TYPE##IP(worker, connection);        \
+        if (slot != NULL)                                                                          \
+        {                                                                                          \
+            rxReactorUnlink##TYPE##IP(worker, slot);                                               \
+            rxReactorDiscard##TYPE##IP(worker, connection);                                        \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    /* closes a server connection opened for a datagram that did not start a handshake */          \
+    static void rxReactorReject##TYPE##IP(                                                         \
+          struct RxReactorWorker##TYPE##IP *worker, RnConnection##TYPE##IP *connection)            \
+    {                                                                                              \
+        struct RxReactorSlot##TYPE##IP *slot =                                                     \
+              rxReactorFind##TYPE##IP(worker, rnConnectionAddress(connection));                    \
+        if (slot != NULL && slot->connection == connection)                                        \
+        {                                                                                          \
+            rxReactorUnlink##TYPE##IP(worker, slot);                                               \
+            rxReactorDiscard##TYPE##IP(worker, connection);                                        \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    /* moves a verified session to the address its path challenge was answered from */             \
+    static void rxReactorMigrate##TYPE##IP(                                                        \
+          struct RxReactorWorker##TYPE##IP *worker, RnConnection##TYPE##IP *connection)            \
+    {                                                                                              \
+        const RnAddress##IP *address = rnConnectionAddress(connection);                            \
+        struct RxReactorSlot##TYPE##IP *slot = rxReactorSlot##TYPE##IP(worker, connection);        \
+        if (slot == NULL || rxReactorFind##TYPE##IP(worker, address) != NULL ||                    \
+            rnTableInsert(worker->addresses, address, slot) != RN_OK)                              \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        rnTableRemove(worker->addresses, &slot->address);                                          \
+        slot->address   = *address;                                                                \
+        slot->connected = true;                                                                    \
+    }                                                                                              \
+                                                                                                   \
+    /**                                                                                            \
+     * Raises RN_REACTOR_CONNECTED for a connection whose handshake completed, false while the     \
+     * ingress ring is full. Those left unannounced are retried by rxReactorProbe.                 \
+     */                                                                                            \
+    static bool rxReactorAnnounce##TYPE##IP(                                                       \
+          struct RxReactorWorker##TYPE##IP *worker, struct RxReactorSlot##TYPE##IP *slot)          \
+    {                                                                                              \
+        RnReactorEvent##TYPE##IP *event = rnRingEvent##TYPE##IP##Acquire(&worker->ingress);        \
+        if (event == NULL)                                                                         \
+        {                                                                                          \
+            return false;                                                                          \
+        }                                                                                          \
+                                                                                                   \
+        event->kind       = RN_REACTOR_CONNECTED;                                                  \
+        event->connection = slot->connection;                                                      \
+        event->address    = slot->address;                                                         \
+        slot->announced   = true;                                                                  \
+        rxReactorCount(&worker->stats.ingress_events);                                             \
+        rnRingEvent##TYPE##IP##Publish(&worker->ingress);                                          \
+        return true;                                                                               \
+    }                                                                                              \
+                                                                                                   \
+    /**                                                                                            \
+     * Received datagrams are staged in consecutive ring slots, screened and read                  \
+     * RN_CONNECTION_READ_BATCH at a time so that their tags are verified together. Events are     \
+     * then published in order, those past a dropped one are moved up into its slot.               \
+     */                                                                                            \
+    static bool rxReactorIngress##TYPE##IP(struct RxReactorWorker##TYPE##IP *worker)               \
+    {                                                                                              \
+        bool active  = false;                                                                      \
+        bool drained = false;                                                                      \
+        for (int batch = 0; batch < RN_REACTOR_BATCH && !drained;                                  \
+             batch += RN_CONNECTION_READ_BATCH)                                                    \
+        {                                                                                          \
+            RnReactorEvent##TYPE##IP *staged[RN_CONNECTION_READ_BATCH];                            \
+            RnConnection##TYPE##IP *connections[RN_CONNECTION_READ_BATCH];                         \
+            RnPacketBuffer##BUFFER *buffers[RN_CONNECTION_READ_BATCH];                             \
+            enum RnConnectionReadResult results[RN_CONNECTION_READ_BATCH];                         \
+            bool opened[RN_CONNECTION_READ_BATCH];                                                 \
+            uint32_t count = 0;                                                                    \
+                                                                                                   \
+            for (int i = 0; i < RN_CONNECTION_READ_BATCH; ++i)                                     \
+            {                                                                                      \
+                RnReactorEvent##TYPE##IP *target =                                                 \
+                      rnRingEvent##TYPE##IP##AcquireAt(&worker->ingress, count);                   \
+                target = target != NULL ? target : &worker->overflow[count];                       \
+                                                                                                   \
+                /* ring slots are reused as is, only their bookkeeping is reset */                 \
+                target->buffer.meta.body_capacity = sizeof target->buffer.body;                    \
+                target->buffer.meta.connection_id = 0;                                             \
+                                                                                                   \
+                size_t size  = rnPacketBufferWireCapacity(&target->buffer);                        \
+                int received = rnSocketReceiveData(                                                \
+                      worker->socket, &target->address, rnPacketBufferWireData(&target->buffer),   \
+                      &size);                                                                      \
+                if (received != RN_OK)                                                             \
+                {                                                                                  \
+                    drained = true;                                                                \
+                    break;                                                                         \
+                }                                                                                  \
+                                                                                                   \
+                active = true;                                                                     \
+                if (rnPacketBufferWireReceived(&target->buffer, size) != RN_OK)                    \
+                {                                                                                  \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                /* junk and floods are dropped here, ahead of any cryptography */                  \
+                bool handshake = target->buffer.head.type == RN_HANDSHAKE_PACKET_TYPE;             \
+                if (handshake && !rnFilterAdmit(                                                   \
+                                       &worker->filter, &target->address, sizeof target->address,  \
+                                       rnClockMonotonic()))                                        \
+                {                                                                                  \
+                    rxReactorCount(&worker->stats.ingress_filtered);                               \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                /* unknown addresses with an id are known peers on a new path, never new ones */   \
+                struct RxReactorSlot##TYPE##IP *slot = rxReactorFind##TYPE##IP(                    \
+                      worker, &target->address);                                                   \
+                RnConnection##TYPE##IP *connection = slot != NULL ? slot->connection : NULL;       \
+                uint32_t id = target->buffer.meta.connection_id;                                   \
+                bool fresh  = false;                                                               \
+                if (connection == NULL && id != 0)                                                 \
+                {                                                                                  \
+                    connection = rxReactorRoute##TYPE##IP(worker, id);                             \
+                }                                                                                  \
+                else if (connection == NULL && handshake &&                                        \
+                         rnFilterAdmitOpen(&worker->filter, rnClockMonotonic()))                   \
+                {                                                                                  \
+                    slot = rxReactorOpen##TYPE##IP(                                                \
+                          worker, &target->address, RN_CONNECTION_SERVER);                         \
+                    connection = slot != NULL ? slot->connection : NULL;                           \
+                    fresh      = connection != NULL;                                               \
+                }                                                                                  \
+                                                                                                   \
+                if (connection == NULL ||                                                          \
+                    rnConnectionScreen(connection, &target->buffer, &target->address) !=           \
+                          RN_CONNECTION_READ_AVAILABLE)                                            \
+                {                                                                                  \
+                    if (fresh)                                                                     \
+                    {                                                                              \
+                        rxReactorReject##TYPE##IP(worker, connection);                             \
+                    }                                                                              \
+                                                                                                   \
+                    rxReactorCount(&worker->stats.ingress_filtered);                               \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                staged[count]      = target;                                                       \
+                connections[count] = connection;                                                   \
+                buffers[count]     = &target->buffer;                                              \
+                opened[count]      = fresh;                                                        \
+                ++count;                                                                           \
+            }                                                                                      \
+                                                                                                   \
+            rnConnectionReadPackets(connections, buffers, count, results);                         \
+                                                                                                   \
+            for (uint32_t i = 0; i < count; ++i)                                                   \
+            {                                                                                      \
+                RnReactorEvent##TYPE##IP *target   = staged[i];                                    \
+                RnConnection##TYPE##IP *connection = connections[i];                               \
+                enum RnConnectionReadResult read_result = results[i];                              \
+                if (read_result == RN_CONNECTION_READ_MIGRATED)                                    \
+                {                                                                                  \
+                    rxReactorMigrate##TYPE##IP(worker, connection);                                \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                /* only verified datagrams may start moving the session elsewhere */               \
+                if (read_result == RN_CONNECTION_READ_AVAILABLE &&                                 \
+                    memcmp(rnConnectionAddress(connection), &target->address,                      \
+                           sizeof target->address) != 0)                                           \
+                {                                                                                  \
+                    rnConnectionValidatePath(connection, &target->address);                        \
+                }                                                                                  \
+                                                                                                   \
+                if (read_result == RN_CONNECTION_READ_HANDSHAKE)                                   \
+                {                                                                                  \
+                    struct RxReactorSlot##TYPE##IP *slot = rxReactorFind##TYPE##IP(                \
+                          worker, &target->address);                                               \
+                    rnConnectionEstablishHandshake(connection);                                    \
+                    if (slot == NULL || slot->connection != connection || slot->connected ||       \
+                        rnConnectionHandshakeStep(connection) != RN_HANDSHAKE_CONNECTED)           \
+                    {                                                                              \
+                        continue;                                                                  \
+                    }                                                                              \
+                                                                                                   \
+                    slot->connected = true;                                                        \
+                    rxReactorRouteAdd##TYPE##IP(worker, connection);                               \
+                                                                                                   \
+                    /* the event takes the ring slot of this datagram or an earlier one */         \
+                    rxReactorAnnounce##TYPE##IP(worker, slot);                                     \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                if (read_result != RN_CONNECTION_READ_AVAILABLE)                                   \
+                {                                                                                  \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                target->kind = RN_REACTOR_PACKET;                                                  \
+                                                                                                   \
+                RnReactorEvent##TYPE##IP *event =                                                  \
+                      rnRingEvent##TYPE##IP##Acquire(&worker->ingress);                            \
+                if (event == NULL)                                                                 \
+                {                                                                                  \
+                    rxReactorCount(&worker->stats.ingress_overflows);                              \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                if (event != target)                                                               \
+                {                                                                                  \
+                    memcpy(event, target, sizeof *event);                                          \
+                }                                                                                  \
+                                                                                                   \
+                event->connection = connection;                                                    \
+                rxReactorCount(&worker->stats.ingress_events);                                     \
+                rnRingEvent##TYPE##IP##Publish(&worker->ingress);                                  \
+            }                                                                                      \
+                                                                                                   \
+            /* after the whole batch, others in it may have read into the same connection */       \
+            for (uint32_t i = 0; i < count; ++i)                                                   \
+            {                                                                                      \
+                if (opened[i] &&                                                                   \
+                    rnConnectionHandshakeStep(connections[i]) == RN_HANDSHAKE_DISCONNECTED)        \
+                {                                                                                  \
+                    rxReactorReject##TYPE##IP(worker, connections[i]);                             \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return active;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    static bool rxReactorEgress##TYPE##IP(struct RxReactorWorker##TYPE##IP *worker)                \
+    {                                                                                              \
+        bool active = false;                                                                       \
+        for (int batch = 0; batch < RN_REACTOR_BATCH; ++batch)                                     \
+        {                                                                                          \
+            RnReactorEvent##TYPE##IP *event = rnRingEvent##TYPE##IP##Peek(&worker->egress);        \
+            if (event == NULL)                                                                     \
+            {                                                                                      \
+                break;                                                                             \
+            }                                                                                      \
+                                                                                                   \
+            active = true;                                                                         \
+            switch (event->kind)                                                                   \
+            {                                                                                      \
+                case RN_REACTOR_PACKET:                                                            \
+                {                                                                                  \
+                    enum RnConnectionWriteResult write_result =                                    \
+                          rnConnectionWritePacket(event->connection, &event->buffer);              \
+                    rxReactorCount(write_result == RN_CONNECTION_WRITE_OK                          \
+                                         ? &worker->stats.egress_packets                           \
+                                         : &worker->stats.egress_failures);                        \
+                    break;                                                                         \
+                }                                                                                  \
+                                                                                                   \
+                case RN_REACTOR_CONNECT:                                                           \
+                {                                                                                  \
+                    struct RxReactorSlot##TYPE##IP *slot = rxReactorOpen##TYPE##IP(                \
+                          worker, &event->address, RN_CONNECTION_CLIENT);                          \
+                    if (slot != NULL)                                                              \
+                    {                                                                              \
+                        rnConnectionEstablishHandshake(slot->connection);                          \
+                    }                                                                              \
+                                                                                                   \
+                    break;                                                                         \
+                }                                                                                  \
+                                                                                                   \
+                case RN_REACTOR_DISCONNECT:                                                        \
+                {                                                                                  \
+                    rxReactorRemove##TYPE##IP(worker, event->connection);                          \
+                    break;                                                                         \
+                }                                                                                  \
+                                                                                                   \
+                default:                                                                           \
+                {                                                                                  \
+                    break;                                                                         \
+                }                                                                                  \
+            }                                                                                      \
+                                                                                                   \
+            rnRingEvent##TYPE##IP##Release(&worker->egress);                                       \
+        }                                                                                          \
+                                                                                                   \
+        return active;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    /**                                                                                            \
+     * Path MTU probes and clock requests of all connections, at the interval pmtu.h asks for.     \
+     * Connections whose handshake did not complete within handshake_ns are closed on the way,     \
+     * those which completed but could not be announced yet are announced.                         \
+     */                                                                                            \
+    static void rxReactorProbe##TYPE##IP(struct RxReactorWorker##TYPE##IP *worker)                 \
+    {                                                                                              \
+        uint64_t now = rnClockMonotonic();                                                         \
+        if (now < worker->probe_at)                                                                \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        worker->probe_at = now + RN_PMTU_POLL_INTERVAL_NS;                                         \
+        bool announcing  = true;                                                                   \
+        for (uint32_t i = 0; i < worker->connections_max; ++i)                                     \
+        {                                                                                          \
+            struct RxReactorSlot##TYPE##IP *slot = &worker->slots[i];                              \
+            if (slot->connection == NULL)                                                          \
+            {                                                                                      \
+                continue;                                                                          \
+            }                                                                                      \
+                                                                                                   \
+            if (!slot->connected && now - slot->opened_at >= worker->handshake_ns)                 \
+            {                                                                                      \
+                RnConnection##TYPE##IP *connection = slot->connection;                             \
+                rxReactorUnlink##TYPE##IP(worker, slot);                                           \
+                rxReactorDiscard##TYPE##IP(worker, connection);                                    \
+                continue;                                                                          \
+            }                                                                                      \
+                                                                                                   \
+            rnConnectionProbePath(slot->connection, now);                                          \
+            rnConnectionSyncClock(slot->connection, now);                                          \
+                                                                                                   \
+            if (slot->connected && !slot->announced && announcing)                                 \
+            {                                                                                      \
+                announcing = rxReactorAnnounce##TYPE##IP(worker, slot);                            \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static RN_REACTOR_THREAD_RESULT rxReactorRun##TYPE##IP(void *argument)                         \
+    {                                                                                              \
+        struct RxReactorWorker##TYPE##IP *worker = argument;                                       \
+                                                                                                   \
+        while (__atomic_load_n(&worker->running, __ATOMIC_ACQUIRE))                                \
+        {                                                                                          \
+            /* a read section per round rather than per lookup, left before sleeping */            \
+            rnTableReadBegin(worker->addresses, 0);                                                \
+            rnTableReadBegin(worker->routes, 0);                                                   \
+            bool egress  = rxReactorEgress##TYPE##IP(worker);                                      \
+            bool ingress = rxReactorIngress##TYPE##IP(worker);                                     \
+            rxReactorProbe##TYPE##IP(worker);                                                      \
+            rnTableReadEnd(worker->routes, 0);                                                     \
+            rnTableReadEnd(worker->addresses, 0);                                                  \
+                                                                                                   \
+            if (!egress && !ingress)                                                               \
+            {                                                                                      \
+                /* egress published from here on wakes the poller, see rnReactorSubmit */          \
+                __atomic_store_n(&worker->sleeping, 1, __ATOMIC_RELAXED);                          \
+                __atomic_thread_fence(__ATOMIC_SEQ_CST);                                           \
+                if (rnRingEvent##TYPE##IP##Peek(&worker->egress) == NULL)                          \
+                {                                                                                  \
+                    uint32_t token;                                                                \
+                    uint32_t ready;                                                                \
+                    rnPollerWait(worker->poller, worker->idle_us * 1000ull, &token, 1, &ready);    \
+                }                                                                                  \
+                                                                                                   \
+                __atomic_store_n(&worker->sleeping, 0, __ATOMIC_RELAXED);                          \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return RN_REACTOR_THREAD_RETURN;                                                           \
+    }                                                                                              \
+                                                                                                   \
+    static uint32_t rxReactorRecordSize##TYPE##IP(void)                                            \
+    {                                                                                              \
+        size_t size = RN_REACTOR_RECORD_HEADER + rnConnectionSnapshotSize##TYPE##IP();             \
+        return (uint32_t)((size + 7) / 8 * 8);                                                     \
+    }                                                                                              \
+                                                                                                   \
+    static void rxReactorAdopt##TYPE##IP(                                                          \
+          struct RxReactorWorker##TYPE##IP *worker, uint32_t thread, RnSnapshot *snapshot)         \
+    {                                                                                              \
+        rnTableReadBegin(worker->addresses, 0);                                                    \
+        rnTableReadBegin(worker->routes, 0);                                                       \
+                                                                                                   \
+        uint8_t *record;                                                                           \
+        for (uint32_t i = 0; (record = rnSnapshotRecord(snapshot, i)) != NULL; ++i)                \
+        {                                                                                          \
+            uint32_t record_thread;                                                                \
+            memcpy(&record_thread, record, sizeof record_thread);                                  \
+                                                                                                   \
+            RnConnection##TYPE##IP *connection;                                                    \
+            if (record_thread != thread ||                                                         \
+                worker->free_count == 0 ||                                                         \
+                rnConnectionRestore(                                                               \
+                      worker->socket, record + RN_REACTOR_RECORD_HEADER, &connection) != RN_OK)    \
+            {                                                                                      \
+                continue;                                                                          \
+            }                                                                                      \
+                                                                                                   \
+            const RnAddress##IP *address = rnConnectionAddress(connection);                        \
+            struct RxReactorSlot##TYPE##IP *slot = NULL;                                           \
+            if (rxReactorFind##TYPE##IP(worker, address) == NULL &&                                \
+                rnConnectionConfigureFec(connection, &worker->fec) == RN_OK)                       \
+            {                                                                                      \
+                slot = rxReactorLink##TYPE##IP(worker, connection, address);                       \
+            }                                                                                      \
+                                                                                                   \
+            if (slot == NULL)                                                                      \
+            {                                                                                      \
+                rnConnectionClose(connection);                                                     \
+                continue;                                                                          \
+            }                                                                                      \
+                                                                                                   \
+            slot->connected = record[4] != 0;                                                      \
+                                                                                                   \
+            /* the application learns of adopted sessions through rxReactorProbe */                \
+            if (slot->connected)                                                                   \
+            {                                                                                      \
+                rxReactorRouteAdd##TYPE##IP(worker, connection);                                   \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        rnTableReadEnd(worker->routes, 0);                                                         \
+        rnTableReadEnd(worker->addresses, 0);                                                      \
+    }                                                                                              \
+                                                                                                   \
+    static void rxReactorWorkerFree##TYPE##IP(struct RxReactorWorker##TYPE##IP *worker)            \
+    {                                                                                              \
+        if (worker->slots != NULL)                                                                 \
+        {                                                                                          \
+            for (uint32_t i = 0; i < worker->connections_max; ++i)                                 \
+            {                                                                                      \
+                if (worker->slots[i].connection != NULL)                                           \
+                {                                                                                  \
+                    rnConnectionClose(worker->slots[i].connection);                                \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        if (worker->poller != NULL)                                                                \
+        {                                                                                          \
+            rnPollerClose(worker->poller);                                                         \
+        }                                                                                          \
+                                                                                                   \
+        if (worker->addresses != NULL)                                                             \
+        {                                                                                          \
+            rnTableClose(worker->addresses);                                                       \
+        }                                                                                          \
+                                                                                                   \
+        if (worker->routes != NULL)                                                                \
+        {                                                                                          \
+            rnTableClose(worker->routes);                                                          \
+        }                                                                                          \
+                                                                                                   \
+        rnFilterFree(&worker->filter);                                                             \
+                                                                                                   \
+        free(worker->slots);                                                                       \
+        free(worker->free);                                                                        \
+        rnRingEvent##TYPE##IP##Free(&worker->ingress);                                             \
+        rnRingEvent##TYPE##IP##Free(&worker->egress);                                              \
+    }                                                                                              \
+                                                                                                   \
+    int rnReactorOpen##TYPE##IP(                                                                   \
+          RnSocket##IP *const *sockets, uint32_t socket_count, const RnReactorConfig *config,      \
+          OUT RnReactor##TYPE##IP **out)                                                           \
+    {                                                                                              \
+        uint32_t ring_capacity = config->ring_capacity ? config->ring_capacity                     \
+                                                       : RN_REACTOR_RING_DEFAULT;                  \
+        uint32_t connections_max = config->connections_max ? config->connections_max               \
+                                                           : RN_REACTOR_CONNECTIONS_DEFAULT;       \
+        uint32_t idle_us    = config->idle_us ? config->idle_us : RN_REACTOR_IDLE_DEFAULT_US;      \
+        uint32_t handshake_ms = config->handshake_ms ? config->handshake_ms                        \
+                                                     : RN_REACTOR_HANDSHAKE_DEFAULT_MS;            \
+                                                                                                   \
+        *out = malloc(sizeof(RnReactor##TYPE##IP));                                                \
+        if (*out == NULL)                                                                          \
+        {                                                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        /* a snapshot that cannot be used leaves the reactor to start out empty */                 \
+        RnSnapshot *snapshot = NULL;                                                               \
+        if (config->snapshot != NULL &&                                                            \
+            rnSnapshotOpen(                                                                        \
+                  config->snapshot, RN_REACTOR_SNAPSHOT_KIND(TYPE, IP),                            \
+                  rxReactorRecordSize##TYPE##IP(), &snapshot) != RN_OK)                            \
+        {                                                                                          \
+            snapshot = NULL;                                                                       \
+        }                                                                                          \
+                                                                                                   \
+        (*out)->count   = socket_count;                                                            \
+        (*out)->workers = rxReactorAllocateAligned(                                                \
+              socket_count * sizeof(struct RxReactorWorker##TYPE##IP));                            \
+        if ((*out)->workers == NULL)                                                               \
+        {                                                                                          \
+            free(*out);                                                                            \
+            if (snapshot != NULL)                                                                  \
+            {                                                                                      \
+                rnSnapshotClose(snapshot);                                                         \
+            }                                                                                      \
+                                                                                                   \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        for (uint32_t i = 0; i < socket_count; ++i)                                                \
+        {                                                                                          \
+            struct RxReactorWorker##TYPE##IP *worker = &(*out)->workers[i];                        \
+                                                                                                   \
+            worker->socket          = sockets[i];                                                  \
+            worker->idle_us         = idle_us;                                                     \
+            worker->handshake_ns    = handshake_ms * 1000000ull;                                   \
+            worker->fec             = config->fec;                                                 \
+            worker->running         = 1;                                                           \
+            worker->connections_max = connections_max;                                             \
+            worker->slots = calloc(connections_max, sizeof(struct RxReactorSlot##TYPE##IP));       \
+            worker->free  = malloc(connections_max * sizeof(uint32_t));                            \
+            for (uint32_t j = 0; worker->free != NULL && j < connections_max; ++j)                 \
+            {                                                                                      \
+                worker->free[worker->free_count++] = connections_max - 1 - j;                      \
+            }                                                                                      \
+                                                                                                   \
+            if (rnTableOpen(sizeof(RnAddress##IP), connections_max, 1, &worker->addresses) !=      \
+                RN_OK)                                                                             \
+            {                                                                                      \
+                worker->addresses = NULL;                                                          \
+            }                                                                                      \
+                                                                                                   \
+            if (rnTableOpen(sizeof(uint32_t), connections_max, 1, &worker->routes) != RN_OK)       \
+            {                                                                                      \
+                worker->routes = NULL;                                                             \
+            }                                                                                      \
+                                                                                                   \
+            int ingress_result = rnRingEvent##TYPE##IP##Init(&worker->ingress, ring_capacity);     \
+            int egress_result  = rnRingEvent##TYPE##IP##Init(&worker->egress, ring_capacity);      \
+            int filter_result  = rnFilterInit(                                                     \
+                  &worker->filter, &config->filter, rnClockMonotonic());                           \
+            int poller_result  = rnPollerOpen(&config->poll, &worker->poller);                     \
+            if (poller_result == RN_OK)                                                            \
+            {                                                                                      \
+                poller_result = rnPollerAdd(worker->poller, sockets[i], 0);                        \
+            }                                                                                      \
+            else                                                                                   \
+            {                                                                                      \
+                worker->poller = NULL;                                                             \
+            }                                                                                      \
+                                                                                                   \
+            int thread_result = RN_OOM;                                                            \
+            if (worker->slots != NULL && worker->free != NULL && worker->addresses != NULL &&      \
+                worker->routes != NULL && ingress_result == RN_OK && egress_result == RN_OK &&     \
+                filter_result == RN_OK && poller_result == RN_OK)                                  \
+            {                                                                                      \
+                if (snapshot != NULL)                                                              \
+                {                                                                                  \
+                    rxReactorAdopt##TYPE##IP(worker, i, snapshot);                                 \
+                }                                                                                  \
+                                                                                                   \
+                thread_result = rxReactorThreadStart(                                              \
+                      &worker->thread, rxReactorRun##TYPE##IP, worker);                            \
+            }                                                                                      \
+                                                                                                   \
+            if (thread_result != RN_OK)                                                            \
+            {                                                                                      \
+                rxReactorWorkerFree##TYPE##IP(worker);                                             \
+                (*out)->count = i;                                                                 \
+                rnReactorClose(*out);                                                              \
+                if (snapshot != NULL)                                                              \
+                {                                                                                  \
+                    rnSnapshotClose(snapshot);                                                     \
+                }                                                                                  \
+                                                                                                   \
+                return thread_result;                                                              \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        /* adopted state is wiped right away, keys must not linger in the file */                  \
+        if (snapshot != NULL)                                                                      \
+        {                                                                                          \
+            rnSnapshotClose(snapshot);                                                             \
+        }                                                                                          \
+                                                                                                   \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    static void rxReactorStop##TYPE##IP(RnReactor##TYPE##IP *reactor)                              \
+    {                                                                                              \
+        for (uint32_t i = 0; i < reactor->count; ++i)                                              \
+        {                                                                                          \
+            __atomic_store_n(&reactor->workers[i].running, 0, __ATOMIC_RELEASE);                   \
+        }                                                                                          \
+                                                                                                   \
+        for (uint32_t i = 0; i < reactor->count; ++i)                                              \
+        {                                                                                          \
+            rxReactorThreadJoin(reactor->workers[i].thread);                                       \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void rxReactorRelease##TYPE##IP(RnReactor##TYPE##IP *reactor)                           \
+    {                                                                                              \
+        for (uint32_t i = 0; i < reactor->count; ++i)                                              \
+        {                                                                                          \
+            rxReactorWorkerFree##TYPE##IP(&reactor->workers[i]);                                   \
+        }                                                                                          \
+                                                                                                   \
+        rxReactorFreeAligned(reactor->workers);                                                    \
+        free(reactor);                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    int rnReactorClose##TYPE##IP(IN RnReactor##TYPE##IP *reactor)                                  \
+    {                                                                                              \
+        rxReactorStop##TYPE##IP(reactor);                                                          \
+        rxReactorRelease##TYPE##IP(reactor);                                                       \
+        return RN_OK;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    int rnReactorHandover##TYPE##IP(IN RnReactor##TYPE##IP *reactor, const char *path)             \
+    {                                                                                              \
+        rxReactorStop##TYPE##IP(reactor);                                                          \
+                                                                                                   \
+        uint32_t capacity = 0;                                                                     \
+        for (uint32_t i = 0; i < reactor->count; ++i)                                              \
+        {                                                                                          \
+            capacity += (uint32_t)reactor->workers[i].stats.connections;                           \
+        }                                                                                          \
+                                                                                                   \
+        RnSnapshot *snapshot;                                                                      \
+        int result = rnSnapshotCreate(                                                             \
+              path, RN_REACTOR_SNAPSHOT_KIND(TYPE, IP), rxReactorRecordSize##TYPE##IP(),           \
+              capacity, &snapshot);                                                                \
+        if (result == RN_OK)                                                                       \
+        {                                                                                          \
+            uint32_t count = 0;                                                                    \
+            for (uint32_t i = 0; i < reactor->count; ++i)                                          \
+            {                                                                                      \
+                const struct RxReactorWorker##TYPE##IP *worker = &reactor->workers[i];             \
+                for (uint32_t j = 0; j < worker->connections_max; ++j)                             \
+                {                                                                                  \
+                    uint8_t *record = rnSnapshotRecord(snapshot, count);                           \
+                    if (worker->slots[j].connection == NULL || record == NULL)                     \
+                    {                                                                              \
+                        continue;                                                                  \
+                    }                                                                              \
+                                                                                                   \
+                    memcpy(record, &i, sizeof i);                                                  \
+                    record[4] = worker->slots[j].connected;                                        \
+                    rnConnectionSave(                                                              \
+                          worker->slots[j].connection, record + RN_REACTOR_RECORD_HEADER);         \
+                    ++count;                                                                       \
+                }                                                                                  \
+            }                                                                                      \
+                                                                                                   \
+            result = rnSnapshotCommit(snapshot, count);                                            \
+        }                                                                                          \
+                                                                                                   \
+        rxReactorRelease##TYPE##IP(reactor);                                                       \
+        return result;                                                                             \
+    }                                                                                              \
+                                                                                                   \
+    uint32_t rnReactorThreadCount##TYPE##IP(const RnReactor##TYPE##IP *reactor)                    \
+    {                                                                                              \
+        return reactor->count;                                                                     \
+    }                                                                                              \
+                                                                                                   \
+    RnReactorEvent##TYPE##IP *rnReactorPeek##TYPE##IP(                                             \
+          RnReactor##TYPE##IP *reactor, uint32_t thread)                                           \
+    {                                                                                              \
+        return rnRingEvent##TYPE##IP##Peek(&reactor->workers[thread].ingress);                     \
+    }                                                                                              \
+                                                                                                   \
+    void rnReactorConsume##TYPE##IP(RnReactor##TYPE##IP *reactor, uint32_t thread)                 \
+    {                                                                                              \
+        rnRingEvent##TYPE##IP##Release(&reactor->workers[thread].ingress);                         \
+    }                                                                                              \
+                                                                                                   \
+    RnReactorEvent##TYPE##IP *rnReactorAcquire##TYPE##IP(                                          \
+          RnReactor##TYPE##IP *reactor, uint32_t thread)                                           \
+    {                                                                                              \
+        return rnRingEvent##TYPE##IP##Acquire(&reactor->workers[thread].egress);                   \
+    }                                                                                              \
+                                                                                                   \
+    void rnReactorSubmit##TYPE##IP(RnReactor##TYPE##IP *reactor, uint32_t thread)                  \
+    {                                                                                              \
+        struct RxReactorWorker##TYPE##IP *worker = &reactor->workers[thread];                      \
+        rnRingEvent##TYPE##IP##Publish(&worker->egress);                                           \
+                                                                                                   \
+        /* pairs with the fence in rxReactorRun, busy workers cost no wakeup */                    \
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);                                                   \
+        if (__atomic_exchange_n(&worker->sleeping, 0, __ATOMIC_RELAXED))                           \
+        {                                                                                          \
+            rnPollerWake(worker->poller);                                                          \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    void rnReactorStats##TYPE##IP(                                                                 \
+          const RnReactor##TYPE##IP *reactor, uint32_t thread, OUT RnReactorStats *out)            \
+    {                                                                                              \
+        const RnReactorStats *stats = &reactor->workers[thread].stats;                             \
+                                                                                                   \
+        out->ingress_events    = __atomic_load_n(&stats->ingress_events, __ATOMIC_RELAXED);        \
+        out->ingress_overflows = __atomic_load_n(&stats->ingress_overflows, __ATOMIC_RELAXED);     \
+        out->ingress_filtered  = __atomic_load_n(&stats->ingress_filtered, __ATOMIC_RELAXED);      \
+        out->egress_packets    = __atomic_load_n(&stats->egress_packets, __ATOMIC_RELAXED);        \
+        out->egress_failures   = __atomic_load_n(&stats->egress_failures, __ATOMIC_RELAXED);       \
+        out->connections       = __atomic_load_n(&stats->connections, __ATOMIC_RELAXED);           \
+    }
+
+RN_REACTOR_IMPL(Authenticated, IPv4, Secure)
+RN_REACTOR_IMPL(Authenticated, IPv6, Secure)
+
+RN_REACTOR_IMPL(Encrypted, IPv4, Secure)
+RN_REACTOR_IMPL(Encrypted, IPv6, Secure)
+
+RN_REACTOR_IMPL(Insecure, IPv4, Insecure)
+RN_REACTOR_IMPL(Insecure, IPv6, Insecure)
+
+#undef RN_REACTOR_IMPL
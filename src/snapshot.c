@@ -0,0 +1,321 @@
+#include "../include/rnlib/snapshot.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <stdio.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+/**
+ * Snapshot files start with a 64 byte header followed by the records, all
+ * fields in host byte order:
+ *
+ *   header  | magic "RNSNAPSH" (8) | version (4) | kind (4) | record size (4) |
+ *           | count (4) | reserved (40) |
+ *
+ * The magic is written last, files without it were never committed.
+ */
+#define RN_SNAPSHOT_MAGIC       "RNSNAPSH"
+#define RN_SNAPSHOT_HEADER_SIZE 64
+
+struct RxSnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t record_size;
+    uint32_t count;
+};
+
+struct RnSnapshot
+{
+    uint8_t *memory;
+    size_t size;
+    uint32_t record_size;
+    uint32_t capacity;
+
+    // file mapped, and where it goes once committed, NULL for opened snapshots
+    char *path;
+    char *target;
+
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+};
+
+static int rxSnapshotMap(RnSnapshot *snapshot, bool create)
+{
+#ifdef _WIN32
+    snapshot->file = CreateFileA(
+          snapshot->path, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+          create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (snapshot->file == INVALID_HANDLE_VALUE)
+    {
+        return (int)GetLastError();
+    }
+
+    if (!create)
+    {
+        LARGE_INTEGER size;
+        GetFileSizeEx(snapshot->file, &size);
+        snapshot->size = (size_t)size.QuadPart;
+    }
+
+    snapshot->mapping = snapshot->size < RN_SNAPSHOT_HEADER_SIZE
+                              ? NULL
+                              : CreateFileMappingA(
+                                      snapshot->file, NULL, PAGE_READWRITE,
+                                      (DWORD)((uint64_t)snapshot->size >> 32),
+                                      (DWORD)snapshot->size, NULL);
+    snapshot->memory = snapshot->mapping == NULL
+                             ? NULL
+                             : MapViewOfFile(snapshot->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (snapshot->memory == NULL)
+    {
+        int result = snapshot->size < RN_SNAPSHOT_HEADER_SIZE ? ERROR_INVALID_DATA
+                                                              : (int)GetLastError();
+        if (snapshot->mapping != NULL)
+        {
+            CloseHandle(snapshot->mapping);
+        }
+
+        CloseHandle(snapshot->file);
+        return result;
+    }
+#else
+    snapshot->file = open(snapshot->path, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0600);
+    if (snapshot->file < 0)
+    {
+        return errno;
+    }
+
+    struct stat info;
+    int size_result = create ? ftruncate(snapshot->file, (off_t)snapshot->size)
+                             : fstat(snapshot->file, &info);
+    if (size_result == 0 && !create)
+    {
+        snapshot->size = (size_t)info.st_size;
+    }
+
+    if (size_result != 0 || snapshot->size < RN_SNAPSHOT_HEADER_SIZE)
+    {
+        int result = size_result != 0 ? errno : EINVAL;
+        close(snapshot->file);
+        return result;
+    }
+
+    void *memory = mmap(
+          NULL, snapshot->size, PROT_READ | PROT_WRITE, MAP_SHARED, snapshot->file, 0);
+    if (memory == MAP_FAILED)
+    {
+        int result = errno;
+        close(snapshot->file);
+        return result;
+    }
+
+    snapshot->memory = memory;
+#endif
+
+    return RN_OK;
+}
+
+static int rxSnapshotUnmap(RnSnapshot *snapshot, bool flush)
+{
+    int result = RN_OK;
+
+#ifdef _WIN32
+    if (flush && (!FlushViewOfFile(snapshot->memory, 0) || !FlushFileBuffers(snapshot->file)))
+    {
+        result = (int)GetLastError();
+    }
+
+    UnmapViewOfFile(snapshot->memory);
+    CloseHandle(snapshot->mapping);
+    CloseHandle(snapshot->file);
+#else
+    if (flush && msync(snapshot->memory, snapshot->size, MS_SYNC) != 0)
+    {
+        result = errno;
+    }
+
+    munmap(snapshot->memory, snapshot->size);
+    close(snapshot->file);
+#endif
+
+    return result;
+}
+
+static void rxSnapshotFree(RnSnapshot *snapshot)
+{
+    free(snapshot->path);
+    free(snapshot->target);
+    free(snapshot);
+}
+
+int rnSnapshotCreate(
+      const char *path, uint32_t kind, uint32_t record_size, uint32_t capacity,
+      OUT RnSnapshot **out)
+{
+    *out = calloc(1, sizeof(RnSnapshot));
+    if (*out == NULL)
+    {
+        return RN_OOM;
+    }
+
+    // records are written next to the target and renamed over it once complete
+    size_t length  = strlen(path);
+    (*out)->path   = malloc(length + sizeof ".tmp");
+    (*out)->target = malloc(length + 1);
+    if ((*out)->path == NULL || (*out)->target == NULL)
+    {
+        rxSnapshotFree(*out);
+        return RN_OOM;
+    }
+
+    memcpy((*out)->path, path, length);
+    memcpy((*out)->path + length, ".tmp", sizeof ".tmp");
+    memcpy((*out)->target, path, length + 1);
+
+    (*out)->record_size = record_size;
+    (*out)->capacity    = capacity;
+    (*out)->size        = RN_SNAPSHOT_HEADER_SIZE + (size_t)record_size * capacity;
+
+    int result = rxSnapshotMap(*out, true);
+    if (result != RN_OK)
+    {
+        rxSnapshotFree(*out);
+        return result;
+    }
+
+    struct RxSnapshotHeader *header = (struct RxSnapshotHeader *)(*out)->memory;
+    header->version                 = RN_SNAPSHOT_VERSION;
+    header->kind                    = kind;
+    header->record_size             = record_size;
+    return RN_OK;
+}
+
+void *rnSnapshotRecord(RnSnapshot *snapshot, uint32_t index)
+{
+    if (index >= snapshot->capacity)
+    {
+        return NULL;
+    }
+
+    return snapshot->memory + RN_SNAPSHOT_HEADER_SIZE + (size_t)index * snapshot->record_size;
+}
+
+int rnSnapshotCommit(IN RnSnapshot *snapshot, uint32_t count)
+{
+    struct RxSnapshotHeader *header = (struct RxSnapshotHeader *)snapshot->memory;
+    header->count = count < snapshot->capacity ? count : snapshot->capacity;
+    memcpy(header->magic, RN_SNAPSHOT_MAGIC, sizeof header->magic);
+
+    int result = rxSnapshotUnmap(snapshot, true);
+    if (result == RN_OK)
+    {
+#ifdef _WIN32
+        if (!MoveFileExA(snapshot->path, snapshot->target, MOVEFILE_REPLACE_EXISTING))
+        {
+            result = (int)GetLastError();
+        }
+#else
+        if (rename(snapshot->path, snapshot->target) != 0)
+        {
+            result = errno;
+        }
+#endif
+    }
+
+    rxSnapshotFree(snapshot);
+    return result;
+}
+
+int rnSnapshotOpen(
+      const char *path, uint32_t kind, uint32_t record_size, OUT RnSnapshot **out)
+{
+    *out = calloc(1, sizeof(RnSnapshot));
+    if (*out == NULL)
+    {
+        return RN_OOM;
+    }
+
+    size_t length = strlen(path);
+    (*out)->path  = malloc(length + 1);
+    if ((*out)->path == NULL)
+    {
+        rxSnapshotFree(*out);
+        return RN_OOM;
+    }
+
+    memcpy((*out)->path, path, length + 1);
+
+    int result = rxSnapshotMap(*out, false);
+    if (result != RN_OK)
+    {
+        rxSnapshotFree(*out);
+        return result;
+    }
+
+    const struct RxSnapshotHeader *header = (const struct RxSnapshotHeader *)(*out)->memory;
+    if (memcmp(header->magic, RN_SNAPSHOT_MAGIC, sizeof header->magic) != 0 ||
+        header->version != RN_SNAPSHOT_VERSION || header->kind != kind || record_size == 0 ||
+        header->record_size != record_size ||
+        ((*out)->size - RN_SNAPSHOT_HEADER_SIZE) / record_size < header->count)
+    {
+        rxSnapshotUnmap(*out, false);
+        rxSnapshotFree(*out);
+#ifdef _WIN32
+        return ERROR_INVALID_DATA;
+#else
+        return EINVAL;
+#endif
+    }
+
+    (*out)->record_size = record_size;
+    (*out)->capacity    = header->count;
+    return RN_OK;
+}
+
+uint32_t rnSnapshotCount(const RnSnapshot *snapshot)
+{
+    return snapshot->capacity;
+}
+
+int rnSnapshotClose(IN RnSnapshot *snapshot)
+{
+    // wiped through the mapping, so that no key outlives the handover on disk either
+    volatile uint8_t *memory = snapshot->memory;
+    for (size_t i = 0; i < snapshot->size; ++i)
+    {
+        memory[i] = 0;
+    }
+
+    int result = rxSnapshotUnmap(snapshot, true);
+
+#ifdef _WIN32
+    if (!DeleteFileA(snapshot->path) && result == RN_OK)
+    {
+        result = (int)GetLastError();
+    }
+#else
+    if (unlink(snapshot->path) != 0 && result == RN_OK)
+    {
+        result = errno;
+    }
+#endif
+
+    rxSnapshotFree(snapshot);
+    return result;
+}
@@ -1,11 +1,17 @@
+#include "../include/rnlib/capture.h"
+#include "../include/rnlib/impairment.h"
 #include "../include/rnlib/socket.h"
 
+#include <stdlib.h>
+
 #ifdef _WIN32
     #include <ws2tcpip.h>
 
-    #define SOCKAPI_ERR_HANDLE INVALID_SOCKET
-    #define SOCKAPI_ERR_RESULT SOCKET_ERROR
-    #define SOCKAPI_ERR_VALUE  WSAGetLastError()
+    #define SOCKAPI_ERR_HANDLE     INVALID_SOCKET
+    #define SOCKAPI_ERR_RESULT     SOCKET_ERROR
+    #define SOCKAPI_ERR_VALUE      WSAGetLastError()
+    #define SOCKAPI_ERR_WOULDBLOCK WSAEWOULDBLOCK
+    #define SOCKAPI_ERR_NOBUFS     WSAENOBUFS
 
     #define SOCKAPI_CLOSE(HANDLE)      closesocket(HANDLE)
     #define SOCKAPI_NBIO(HANDLE, DATA) ioctlsocket(HANDLE, FIONBIO, &DATA)
@@ -13,11 +19,17 @@
     #include <errno.h>
     #include <fcntl.h>
     #include <netinet/in.h>
+    #include <string.h>
     #include <sys/socket.h>
+    #include <sys/uio.h>
+    #include <time.h>
+    #include <unistd.h>
 
-    #define SOCKAPI_ERR_HANDLE -1
-    #define SOCKAPI_ERR_RESULT -1
-    #define SOCKAPI_ERR_VALUE  errno
+    #define SOCKAPI_ERR_HANDLE     -1
+    #define SOCKAPI_ERR_RESULT     -1
+    #define SOCKAPI_ERR_VALUE      errno
+    #define SOCKAPI_ERR_WOULDBLOCK EAGAIN
+    #define SOCKAPI_ERR_NOBUFS     ENOBUFS
 
     #define SOCKAPI_CLOSE(HANDLE)      close(HANDLE)
     #define SOCKAPI_NBIO(HANDLE, DATA) fcntl(HANDLE, F_SETFL, O_NONBLOCK, DATA)
@@ -50,28 +62,462 @@ int rnSocketsCleanup()
     return RN_OK;
 }
 
+/**
+ * SO_PREFER_BUSY_POLL and SO_BUSY_POLL_BUDGET need Linux 5.11, older kernels
+ * reject them and keep plain busy polling.
+ */
+static int rxSocketSetBusyPoll(
+      int handle, uint32_t microseconds, uint32_t budget)
+{
+#ifdef __linux__
+    #ifndef SO_PREFER_BUSY_POLL
+        #define SO_PREFER_BUSY_POLL 69
+    #endif
+    #ifndef SO_BUSY_POLL_BUDGET
+        #define SO_BUSY_POLL_BUDGET 70
+    #endif
+
+    int value  = (int)microseconds;
+    int result = setsockopt(
+          handle, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof value);
+    if (result == SOCKAPI_ERR_RESULT)
+    {
+        return SOCKAPI_ERR_VALUE;
+    }
+
+    int prefer = microseconds > 0;
+    setsockopt(
+          handle, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof prefer);
+
+    if (budget > 0)
+    {
+        int packets = (int)budget;
+        setsockopt(
+              handle, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &packets,
+              sizeof packets);
+    }
+#else
+    (void)handle;
+    (void)microseconds;
+    (void)budget;
+#endif
+
+    return RN_OK;
+}
+
+/**
+ * Sets the don't fragment bit on every datagram without letting the kernel
+ * shrink them to its cached path MTU, path MTU probes must leave as they are.
+ * Oversized datagrams are then dropped on the path rather than fragmented.
+ */
+static int rxSocketSetPathProbe(int handle, int family)
+{
+#if defined(__linux__)
+    int value  = family == AF_INET6 ? IPV6_PMTUDISC_PROBE : IP_PMTUDISC_PROBE;
+    int result = family == AF_INET6
+                       ? setsockopt(
+                               handle, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &value,
+                               sizeof value)
+                       : setsockopt(
+                               handle, IPPROTO_IP, IP_MTU_DISCOVER, &value,
+                               sizeof value);
+#elif defined(_WIN32)
+    DWORD value = 1;
+    int result  = family == AF_INET6
+                       ? setsockopt(
+                               handle, IPPROTO_IPV6, IPV6_DONTFRAG,
+                               (const char *)&value, sizeof value)
+                       : setsockopt(
+                               handle, IPPROTO_IP, IP_DONTFRAGMENT,
+                               (const char *)&value, sizeof value);
+#else
+    (void)handle;
+    (void)family;
+    int result = 0;
+#endif
+
+    if (result == SOCKAPI_ERR_RESULT)
+    {
+        return SOCKAPI_ERR_VALUE;
+    }
+
+    return RN_OK;
+}
+
+/**
+ * Lets an IPv6 socket exchange IPv4 datagrams as IPv4-mapped addresses. Has to
+ * precede bind, the default follows net.ipv6.bindv6only on Linux and is IPv6
+ * only on Windows.
+ */
+static int rxSocketSetDualStack(int handle)
+{
+#ifdef _WIN32
+    DWORD value = 0;
+    int result  = setsockopt(
+          handle, IPPROTO_IPV6, IPV6_V6ONLY, (const char *)&value,
+          sizeof value);
+#else
+    int value  = 0;
+    int result = setsockopt(
+          handle, IPPROTO_IPV6, IPV6_V6ONLY, &value, sizeof value);
+#endif
+
+    if (result == SOCKAPI_ERR_RESULT)
+    {
+        return SOCKAPI_ERR_VALUE;
+    }
+
+    return RN_OK;
+}
+
+// kernel memory charged per datagram on top of its payload, roughly
+#define RX_SOCKET_DATAGRAM_OVERHEAD 768
+
+/**
+ * Autotuning and instrumentation state, only ever written by the thread using
+ * the socket, except for the limits set by rnSocketSetBufferMax from any
+ * thread. `burst_bytes` is charged since the socket last ran dry.
+ */
+struct RxSocketState
+{
+    RnSocketStats stats;
+    uint64_t burst_bytes;
+    uint32_t drops;
+    uint32_t receive_max;
+    uint32_t send_max;
+};
+
+static void rxSocketStore(uint64_t *counter, uint64_t value)
+{
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+static uint32_t rxSocketBufferSize(int handle, int option)
+{
+    int value           = 0;
+    socklen_t value_len = sizeof value;
+    getsockopt(handle, SOL_SOCKET, option, (char *)&value, &value_len);
+
+    return value > 0 ? (uint32_t)value : 0;
+}
+
+/**
+ * Grows the buffer behind `option` to at least `wanted` bytes, or twice its
+ * size, within `*max`. Buffers clamped by the system limit set `*max` to what
+ * they got, so that a full buffer does not cost a syscall per burst.
+ */
+static void rxSocketGrow(
+      struct RxSocketState *state, int handle, int option, uint64_t wanted,
+      uint32_t *size, uint32_t *max)
+{
+    uint32_t limit = __atomic_load_n(max, __ATOMIC_RELAXED);
+    if (*size >= limit)
+    {
+        return;
+    }
+
+    uint64_t target = (uint64_t)*size * 2 > wanted ? (uint64_t)*size * 2
+                                                    : wanted;
+    target          = target < limit ? target : limit;
+
+    // Linux doubles the size set for its overhead and reports the doubled one
+#ifdef __linux__
+    int value = (int)(target / 2);
+#else
+    int value = (int)target;
+#endif
+    setsockopt(handle, SOL_SOCKET, option, (const char *)&value, sizeof value);
+
+    uint32_t grown = rxSocketBufferSize(handle, option);
+    // the kernel's own limit was reached, stop asking until the next
+    // rnSocketSetBufferMax
+    if (grown <= *size)
+    {
+        __atomic_store_n(max, *size, __ATOMIC_RELAXED);
+        return;
+    }
+
+    __atomic_store_n(size, grown, __ATOMIC_RELAXED);
+    rxSocketStore(&state->stats.buffer_grows, state->stats.buffer_grows + 1);
+}
+
+/**
+ * Has the kernel attach its drop counter and receive timestamp to every
+ * datagram, see rxSocketReceive, and starts autotuning from the buffer sizes
+ * the socket has.
+ */
+static int rxSocketInstrument(int handle, OUT struct RxSocketState *state)
+{
+    *state = (struct RxSocketState) {
+        .stats.receive_buffer = rxSocketBufferSize(handle, SO_RCVBUF),
+        .stats.send_buffer    = rxSocketBufferSize(handle, SO_SNDBUF),
+        .receive_max          = RN_SOCKET_BUFFER_MAX_DEFAULT,
+        .send_max             = RN_SOCKET_BUFFER_MAX_DEFAULT,
+    };
+
+#ifdef __linux__
+    int value = 1;
+    if (setsockopt(
+              handle, SOL_SOCKET, SO_RXQ_OVFL, &value, sizeof value) ==
+              SOCKAPI_ERR_RESULT ||
+        setsockopt(
+              handle, SOL_SOCKET, SO_TIMESTAMPNS, &value, sizeof value) ==
+              SOCKAPI_ERR_RESULT)
+    {
+        return SOCKAPI_ERR_VALUE;
+    }
+#endif
+
+    return RN_OK;
+}
+
+#ifdef __linux__
+// drop counter and receive timestamp of the datagram `message` delivered
+static void rxSocketInspect(
+      struct RxSocketState *state, int handle, struct msghdr *message)
+{
+    RnSocketStats *stats = &state->stats;
+
+    struct cmsghdr *control = CMSG_FIRSTHDR(message);
+    for (; control != NULL; control = CMSG_NXTHDR(message, control))
+    {
+        if (control->cmsg_level != SOL_SOCKET)
+        {
+            continue;
+        }
+
+        if (control->cmsg_type == SO_RXQ_OVFL)
+        {
+            uint32_t drops;
+            memcpy(&drops, CMSG_DATA(control), sizeof drops);
+
+            // the kernel counts since the socket opened, wrapping around
+            uint32_t dropped = drops - state->drops;
+            state->drops     = drops;
+            if (dropped > 0)
+            {
+                rxSocketStore(
+                      &stats->ingress_dropped,
+                      stats->ingress_dropped + dropped);
+                rxSocketGrow(
+                      state, handle, SO_RCVBUF, 0, &stats->receive_buffer,
+                      &state->receive_max);
+            }
+        }
+        else if (control->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec at, now;
+            memcpy(&at, CMSG_DATA(control), sizeof at);
+            clock_gettime(CLOCK_REALTIME, &now);
+
+            int64_t latency = (int64_t)(now.tv_sec - at.tv_sec) * 1000000000 +
+                              (now.tv_nsec - at.tv_nsec);
+            latency         = latency > 0 ? latency : 0;
+
+            // smoothed like round trip times, by an eighth of the difference
+            int64_t smoothed = (int64_t)stats->ingress_latency_ns;
+            smoothed         = stats->ingress_datagrams == 0
+                                     ? latency
+                                     : smoothed + (latency - smoothed) / 8;
+
+            rxSocketStore(&stats->ingress_latency_ns, (uint64_t)smoothed);
+            if ((uint64_t)latency > stats->ingress_latency_max_ns)
+            {
+                rxSocketStore(&stats->ingress_latency_max_ns, latency);
+            }
+        }
+    }
+}
+#endif
+
+/**
+ * Receives through recvmsg on Linux to pick up the kernel's ancillary data.
+ * Running dry ends a burst, which grows the receive buffer when it charged
+ * more than half of it.
+ */
+static int rxSocketReceive(
+      struct RxSocketState *state, int handle, struct sockaddr *addr,
+      socklen_t addr_bytes, OUT uint8_t *data, OUT size_t *data_size)
+{
+#ifdef __linux__
+    union
+    {
+        struct cmsghdr align;
+        char bytes[CMSG_SPACE(sizeof(struct timespec)) +
+                   CMSG_SPACE(sizeof(uint32_t))];
+    } control;
+
+    struct iovec vector    = { .iov_base = data, .iov_len = *data_size };
+    struct msghdr message  = {
+         .msg_name       = addr,
+         .msg_namelen    = addr_bytes,
+         .msg_iov        = &vector,
+         .msg_iovlen     = 1,
+         .msg_control    = control.bytes,
+         .msg_controllen = sizeof control.bytes,
+    };
+
+    ssize_t result = recvmsg(handle, &message, 0);
+#else
+    int result = recvfrom(
+          handle, (char *)data, (int)*data_size, 0, addr, &addr_bytes);
+#endif
+    if (result == SOCKAPI_ERR_RESULT)
+    {
+        int error = SOCKAPI_ERR_VALUE;
+        if (error == SOCKAPI_ERR_WOULDBLOCK)
+        {
+            uint64_t burst     = state->burst_bytes;
+            state->burst_bytes = 0;
+            if (burst * 2 > state->stats.receive_buffer)
+            {
+                rxSocketGrow(
+                      state, handle, SO_RCVBUF, burst * 4,
+                      &state->stats.receive_buffer, &state->receive_max);
+            }
+        }
+
+        return error;
+    }
+
+#ifdef __linux__
+    rxSocketInspect(state, handle, &message);
+#endif
+
+    *data_size = (size_t)result;
+    state->burst_bytes += *data_size + RX_SOCKET_DATAGRAM_OVERHEAD;
+    rxSocketStore(
+          &state->stats.ingress_datagrams, state->stats.ingress_datagrams + 1);
+
+    return RN_OK;
+}
+
+// sends that would block or find no buffer grow the send buffer
+static int rxSocketSend(
+      struct RxSocketState *state, int handle, const struct sockaddr *addr,
+      socklen_t addr_bytes, const uint8_t *data, size_t data_size)
+{
+    int result = sendto(
+          handle, (const char *)data, (int)data_size, 0, addr, addr_bytes);
+    if (result == SOCKAPI_ERR_RESULT)
+    {
+        int error = SOCKAPI_ERR_VALUE;
+        if (error == SOCKAPI_ERR_WOULDBLOCK || error == SOCKAPI_ERR_NOBUFS)
+        {
+            rxSocketGrow(
+                  state, handle, SO_SNDBUF, 0, &state->stats.send_buffer,
+                  &state->send_max);
+        }
+
+        return error;
+    }
+
+    return RN_OK;
+}
+
+static void rxSocketStats(
+      const struct RxSocketState *state, OUT RnSocketStats *out)
+{
+    const RnSocketStats *stats = &state->stats;
+
+    out->ingress_datagrams =
+          __atomic_load_n(&stats->ingress_datagrams, __ATOMIC_RELAXED);
+    out->ingress_dropped =
+          __atomic_load_n(&stats->ingress_dropped, __ATOMIC_RELAXED);
+    out->ingress_latency_ns =
+          __atomic_load_n(&stats->ingress_latency_ns, __ATOMIC_RELAXED);
+    out->ingress_latency_max_ns =
+          __atomic_load_n(&stats->ingress_latency_max_ns, __ATOMIC_RELAXED);
+    out->buffer_grows =
+          __atomic_load_n(&stats->buffer_grows, __ATOMIC_RELAXED);
+    out->receive_buffer =
+          __atomic_load_n(&stats->receive_buffer, __ATOMIC_RELAXED);
+    out->send_buffer =
+          __atomic_load_n(&stats->send_buffer, __ATOMIC_RELAXED);
+}
+
 #define RN_SOCKET_IMPL(IP, SOCKADDR)                                           \
     struct RnSocket##IP                                                        \
     {                                                                          \
         int handle;                                                            \
+        RnCapture *capture;                                                    \
+        RnImpairedSocket##IP *impairment;                                      \
+        struct RxSocketState state;                                            \
     };                                                                         \
                                                                                \
-    int rnSocketOpen(const RnAddress##IP *host, OUT RnSocket##IP **out)        \
+    int rnSocketOpen##IP(const RnAddress##IP *host, OUT RnSocket##IP **out)    \
     {                                                                          \
-        SOCKADDR addr = rnAddressToNetwork(host);                              \
+        struct SOCKADDR addr = rnAddressToNetwork##IP(*host);                  \
+        int family           = ((struct sockaddr *)&addr)->sa_family;          \
                                                                                \
-        int handle = socket(addr->sa_family, SOCK_DGRAM, IPPROTO_UDP);         \
+        int handle = socket(family, SOCK_DGRAM, IPPROTO_UDP);                  \
         if (handle == SOCKAPI_ERR_HANDLE)                                      \
         {                                                                      \
             return SOCKAPI_ERR_VALUE;                                          \
         }                                                                      \
                                                                                \
-        int bind_result = bind(handle, addr, host_bytes);                      \
+        int bind_result = bind(                                                \
+              handle, (struct sockaddr *)&addr, sizeof addr);                  \
         if (bind_result == SOCKAPI_ERR_RESULT)                                 \
+        {                                                                      \
+            int error = SOCKAPI_ERR_VALUE;                                     \
+            SOCKAPI_CLOSE(handle);                                             \
+            return error;                                                      \
+        }                                                                      \
+                                                                               \
+        int probe_result = rxSocketSetPathProbe(handle, family);               \
+        if (probe_result != RN_OK)                                             \
+        {                                                                      \
+            SOCKAPI_CLOSE(handle);                                             \
+            return probe_result;                                               \
+        }                                                                      \
+                                                                               \
+        int non_blocking = 1;                                                  \
+        int nbio_result  = SOCKAPI_NBIO(handle, non_blocking);                 \
+        if (nbio_result == SOCKAPI_ERR_RESULT)                                 \
+        {                                                                      \
+            int error = SOCKAPI_ERR_VALUE;                                     \
+            SOCKAPI_CLOSE(handle);                                             \
+            return error;                                                      \
+        }                                                                      \
+                                                                               \
+        struct RxSocketState state;                                            \
+        int instrument_result = rxSocketInstrument(handle, &state);            \
+        if (instrument_result != RN_OK)                                        \
+        {                                                                      \
+            SOCKAPI_CLOSE(handle);                                             \
+            return instrument_result;                                          \
+        }                                                                      \
+                                                                               \
+        *out = malloc(sizeof(RnSocket##IP));                                   \
+        if (*out == NULL)                                                      \
+        {                                                                      \
+            SOCKAPI_CLOSE(handle);                                             \
+            return RN_OOM;                                                     \
+        }                                                                      \
+                                                                               \
+        **out = (RnSocket##IP) { handle, NULL, NULL, state };                  \
+        return RN_OK;                                                          \
+    }                                                                          \
+                                                                               \
+    int rnSocketAdopt##IP(int handle, OUT RnSocket##IP **out)                  \
+    {                                                                          \
+        struct sockaddr_storage host;                                          \
+        socklen_t host_bytes = sizeof host;                                    \
+        int name_result      = getsockname(                                    \
+              handle, (struct sockaddr *)&host, &host_bytes);                  \
+        if (name_result == SOCKAPI_ERR_RESULT)                                 \
         {                                                                      \
             return SOCKAPI_ERR_VALUE;                                          \
         }                                                                      \
                                                                                \
+        /* the previous owner may not have set any of them up */               \
+        int probe_result = rxSocketSetPathProbe(handle, host.ss_family);       \
+        if (probe_result != RN_OK)                                             \
+        {                                                                      \
+            return probe_result;                                               \
+        }                                                                      \
+                                                                               \
         int non_blocking = 1;                                                  \
         int nbio_result  = SOCKAPI_NBIO(handle, non_blocking);                 \
         if (nbio_result == SOCKAPI_ERR_RESULT)                                 \
@@ -79,17 +525,64 @@ int rnSocketsCleanup()
             return SOCKAPI_ERR_VALUE;                                          \
         }                                                                      \
                                                                                \
-        *out = malloc(sizeof RnSocket##IP);                                    \
+        struct RxSocketState state;                                            \
+        int instrument_result = rxSocketInstrument(handle, &state);            \
+        if (instrument_result != RN_OK)                                        \
+        {                                                                      \
+            return instrument_result;                                          \
+        }                                                                      \
+                                                                               \
+        *out = malloc(sizeof(RnSocket##IP));                                   \
         if (*out == NULL)                                                      \
         {                                                                      \
             return RN_OOM;                                                     \
         }                                                                      \
                                                                                \
-        **out = RnSocket##IP { handle };                                       \
+        **out = (RnSocket##IP) { handle, NULL, NULL, state };                  \
         return RN_OK;                                                          \
     }                                                                          \
                                                                                \
-    int rnSocketClose(IN RnSocket##IP *in)                                     \
+    void rnSocketSetCapture##IP(RnSocket##IP *socket, RnCapture *capture)      \
+    {                                                                          \
+        socket->capture = capture;                                             \
+    }                                                                          \
+                                                                               \
+    RnCapture *rnSocketCapture##IP(const RnSocket##IP *socket)                 \
+    {                                                                          \
+        return socket->capture;                                                \
+    }                                                                          \
+                                                                               \
+    void rnSocketSetImpairment##IP(                                            \
+          RnSocket##IP *socket, RnImpairedSocket##IP *impairment)              \
+    {                                                                          \
+        socket->impairment = impairment;                                       \
+    }                                                                          \
+                                                                               \
+    int rnSocketHandle##IP(const RnSocket##IP *socket)                         \
+    {                                                                          \
+        return socket->handle;                                                 \
+    }                                                                          \
+                                                                               \
+    int rnSocketSetBusyPoll##IP(                                               \
+          RnSocket##IP *socket, uint32_t microseconds, uint32_t budget)        \
+    {                                                                          \
+        return rxSocketSetBusyPoll(socket->handle, microseconds, budget);      \
+    }                                                                          \
+                                                                               \
+    void rnSocketSetBufferMax##IP(RnSocket##IP *socket, uint32_t bytes)        \
+    {                                                                          \
+        __atomic_store_n(                                                      \
+              &socket->state.receive_max, bytes, __ATOMIC_RELAXED);            \
+        __atomic_store_n(&socket->state.send_max, bytes, __ATOMIC_RELAXED);    \
+    }                                                                          \
+                                                                               \
+    void rnSocketStats##IP(                                                    \
+          const RnSocket##IP *socket, OUT RnSocketStats *out)                  \
+    {                                                                          \
+        rxSocketStats(&socket->state, out);                                    \
+    }                                                                          \
+                                                                               \
+    int rnSocketClose##IP(IN RnSocket##IP *in)                                 \
     {                                                                          \
         int result = SOCKAPI_CLOSE(in->handle);                                \
         if (result == SOCKAPI_ERR_RESULT)                                      \
@@ -101,35 +594,72 @@ int rnSocketsCleanup()
         return result;                                                         \
     }                                                                          \
                                                                                \
-    int rnSocketSendData(                                                      \
-          const RnSocket##IP *socket, const RnAddress##IP *address,            \
+    int rnSocketSendData##IP(                                                  \
+          RnSocket##IP *socket, const RnAddress##IP *address,                  \
           const uint8_t *data, size_t data_size)                               \
     {                                                                          \
-        SOCKADDR addr = rnAddressToNetwork(*address);                          \
+        /* detached meanwhile, the datagrams it releases go out directly */    \
+        RnImpairedSocket##IP *impairment = socket->impairment;                 \
+        if (impairment != NULL)                                                \
+        {                                                                      \
+            socket->impairment = NULL;                                         \
+            int result         = rnImpairmentSendData(                         \
+                  impairment, address, data, data_size);                       \
+            socket->impairment = impairment;                                   \
+            return result;                                                     \
+        }                                                                      \
                                                                                \
-        int result = sendto(handle, data, data_size, 0, &addr, sizeof addr);   \
-        if (result == SOCKAPI_ERR_RESULT)                                      \
+        if (socket->capture != NULL)                                           \
         {                                                                      \
-            return SOCKAPI_ERR_VALUE;                                          \
+            rnCaptureWrite(                                                    \
+                  socket->capture, RN_CAPTURE_EGRESS, address, data,           \
+                  data_size);                                                  \
+                                                                               \
+            uint32_t flags = rnCaptureFlags(socket->capture);                  \
+            if (flags & RN_CAPTURE_SUPPRESS_EGRESS)                            \
+            {                                                                  \
+                return RN_OK;                                                  \
+            }                                                                  \
         }                                                                      \
                                                                                \
-        return RN_OK;                                                          \
+        struct SOCKADDR addr = rnAddressToNetwork##IP(*address);               \
+                                                                               \
+        return rxSocketSend(                                                   \
+              &socket->state, socket->handle, (struct sockaddr *)&addr,        \
+              sizeof addr, data, data_size);                                   \
     }                                                                          \
                                                                                \
-    int rnSocketReceiveData(                                                   \
-          const RnSocket##IP *socket, OUT RnAddress##IP *address,              \
+    int rnSocketReceiveData##IP(                                               \
+          RnSocket##IP *socket, OUT RnAddress##IP *address,                    \
           OUT uint8_t *data, OUT size_t *data_size)                            \
     {                                                                          \
-        SOCKADDR addr;                                                         \
+        RnImpairedSocket##IP *impairment = socket->impairment;                 \
+        if (impairment != NULL)                                                \
+        {                                                                      \
+            socket->impairment = NULL;                                         \
+            rnImpairmentFlush(impairment);                                     \
+            socket->impairment = impairment;                                   \
+        }                                                                      \
                                                                                \
-        int result = recvfrom(handle, data, *data_size, 0, addr, sizeof addr); \
-        if (result == SOCKAPI_ERR_RESULT)                                      \
+        struct SOCKADDR addr;                                                  \
+                                                                               \
+        int result = rxSocketReceive(                                          \
+              &socket->state, socket->handle, (struct sockaddr *)&addr,        \
+              sizeof addr, data, data_size);                                   \
+        if (result != RN_OK)                                                   \
         {                                                                      \
-            return SOCKAPI_ERR_VALUE;                                          \
+            return result;                                                     \
+        }                                                                      \
+                                                                               \
+        *address = rnAddressFromNetwork##IP(addr);                             \
+                                                                               \
+        if (socket->capture != NULL)                                           \
+        {                                                                      \
+            rnCaptureWrite(                                                    \
+                  socket->capture, RN_CAPTURE_INGRESS, address, data,          \
+                  *data_size);                                                 \
         }                                                                      \
                                                                                \
-        *address   = rnAddressFromNetwork(addr);                               \
-        *data_size = result;                                                   \
         return RN_OK;                                                          \
     }
 
@@ -137,3 +667,69 @@ RN_SOCKET_IMPL(IPv4, sockaddr_in)
 RN_SOCKET_IMPL(IPv6, sockaddr_in6)
 
 #undef RN_SOCKET_IMPL
+
+int rnSocketOpenDualStack(const RnAddressIPv6 *host, OUT RnSocketIPv6 **out)
+{
+    struct sockaddr_in6 addr = rnAddressToNetworkIPv6(*host);
+
+    int handle = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == SOCKAPI_ERR_HANDLE)
+    {
+        return SOCKAPI_ERR_VALUE;
+    }
+
+    int dual_result = rxSocketSetDualStack(handle);
+    if (dual_result != RN_OK)
+    {
+        SOCKAPI_CLOSE(handle);
+        return dual_result;
+    }
+
+    int bind_result = bind(handle, (struct sockaddr *)&addr, sizeof addr);
+    if (bind_result == SOCKAPI_ERR_RESULT)
+    {
+        int error = SOCKAPI_ERR_VALUE;
+        SOCKAPI_CLOSE(handle);
+        return error;
+    }
+
+    // mapped IPv4 datagrams leave under the IPv4 options of the socket
+    int probe_result = rxSocketSetPathProbe(handle, AF_INET6);
+    if (probe_result == RN_OK)
+    {
+        probe_result = rxSocketSetPathProbe(handle, AF_INET);
+    }
+
+    if (probe_result != RN_OK)
+    {
+        SOCKAPI_CLOSE(handle);
+        return probe_result;
+    }
+
+    int non_blocking = 1;
+    int nbio_result  = SOCKAPI_NBIO(handle, non_blocking);
+    if (nbio_result == SOCKAPI_ERR_RESULT)
+    {
+        int error = SOCKAPI_ERR_VALUE;
+        SOCKAPI_CLOSE(handle);
+        return error;
+    }
+
+    struct RxSocketState state;
+    int instrument_result = rxSocketInstrument(handle, &state);
+    if (instrument_result != RN_OK)
+    {
+        SOCKAPI_CLOSE(handle);
+        return instrument_result;
+    }
+
+    *out = malloc(sizeof(RnSocketIPv6));
+    if (*out == NULL)
+    {
+        SOCKAPI_CLOSE(handle);
+        return RN_OOM;
+    }
+
+    **out = (RnSocketIPv6) { handle, NULL, NULL, state };
+    return RN_OK;
+}
@@ -0,0 +1,421 @@
+#include "../include/rnlib/table.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+    #define SODIUM_STATIC 1
+    #define SODIUM_EXPORT
+#endif
+
+#include <sodium.h>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sched.h>
+#endif
+
+/**
+ * Slots are published by their hash, 0 while empty. A published slot keeps its
+ * key for the lifetime of its array, removal only clears the value.
+ */
+struct RxTableSlot
+{
+    uint64_t hash;
+    void *value;
+    uint8_t key[RN_TABLE_KEY_MAX];
+};
+
+struct RxTableArray
+{
+    uint32_t mask;
+    uint32_t used;
+    struct RxTableSlot slots[];
+};
+
+// epoch the reader entered its section in, 0 outside of one
+struct RxTableReader
+{
+    __attribute__((aligned(64))) uint64_t epoch;
+};
+
+struct RxTableRetired
+{
+    struct RxTableRetired *next;
+    uint64_t epoch;
+    void *pointer;
+    void (*release)(void *);
+};
+
+/**
+ * Readers only ever load the first cache line, writers keep their state on the
+ * second so that taking the lock does not invalidate it.
+ */
+struct RnTable
+{
+    struct RxTableArray *array;
+    uint64_t epoch;
+    uint64_t seed;
+    uint32_t key_size;
+    uint32_t readers_max;
+    struct RxTableReader *readers;
+
+    __attribute__((aligned(64))) char lock;
+    uint32_t count;
+    struct RxTableRetired *retired;
+};
+
+// readers' announcements each take a cache line of their own
+static void *rxTableAllocateReaders(uint32_t count)
+{
+    size_t size = count * sizeof(struct RxTableReader);
+#ifdef _WIN32
+    void *memory = _aligned_malloc(size, 64);
+#else
+    void *memory = NULL;
+    if (posix_memalign(&memory, 64, size) != 0)
+    {
+        memory = NULL;
+    }
+#endif
+
+    if (memory != NULL)
+    {
+        memset(memory, 0, size);
+    }
+
+    return memory;
+}
+
+static void rxTableFreeReaders(void *memory)
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    free(memory);
+#endif
+}
+
+// yields rather than pausing, the thread waited on may share the core
+static inline void rxTableRelax()
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+// FNV-1a over the key with the seed as offset basis, never 0
+static uint64_t rxTableHash(const RnTable *table, const void *key)
+{
+    const uint8_t *bytes = key;
+    uint64_t hash        = table->seed;
+
+    for (uint32_t i = 0; i < table->key_size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+
+    return hash | 1;
+}
+
+static struct RxTableArray *rxTableArray(uint32_t capacity)
+{
+    uint32_t size = 16;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+
+    struct RxTableArray *array =
+          calloc(1, sizeof(struct RxTableArray) + size * sizeof(struct RxTableSlot));
+    if (array != NULL)
+    {
+        array->mask = size - 1;
+    }
+
+    return array;
+}
+
+static struct RxTableSlot *rxTableProbe(
+      const RnTable *table, const struct RxTableArray *array, const void *key, uint64_t hash)
+{
+    for (uint32_t i = (uint32_t)hash & array->mask;; i = (i + 1) & array->mask)
+    {
+        struct RxTableSlot *slot = (struct RxTableSlot *)&array->slots[i];
+        uint64_t slot_hash       = __atomic_load_n(&slot->hash, __ATOMIC_ACQUIRE);
+        if (slot_hash == 0 || (slot_hash == hash && memcmp(slot->key, key, table->key_size) == 0))
+        {
+            return slot;
+        }
+    }
+}
+
+static void rxTableLock(RnTable *table)
+{
+    while (__atomic_test_and_set(&table->lock, __ATOMIC_ACQUIRE))
+    {
+        rxTableRelax();
+    }
+}
+
+static void rxTableUnlock(RnTable *table)
+{
+    __atomic_clear(&table->lock, __ATOMIC_RELEASE);
+}
+
+// oldest epoch a reader is still in, UINT64_MAX if none is
+static uint64_t rxTableOldestReader(const RnTable *table)
+{
+    // pairs with the fence in rnTableReadBegin, either the reader's announcement is seen here or
+    // the reader sees everything published before
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint64_t oldest = UINT64_MAX;
+    for (uint32_t i = 0; i < table->readers_max; ++i)
+    {
+        uint64_t epoch = __atomic_load_n(&table->readers[i].epoch, __ATOMIC_ACQUIRE);
+        if (epoch != 0 && epoch < oldest)
+        {
+            oldest = epoch;
+        }
+    }
+
+    return oldest;
+}
+
+// releases what no reader can hold anymore, under the lock
+static void rxTableReclaim(RnTable *table)
+{
+    uint64_t oldest                = rxTableOldestReader(table);
+    struct RxTableRetired **cursor = &table->retired;
+    while (*cursor != NULL)
+    {
+        struct RxTableRetired *retired = *cursor;
+        if (retired->epoch < oldest)
+        {
+            *cursor = retired->next;
+            retired->release(retired->pointer);
+            free(retired);
+        }
+        else
+        {
+            cursor = &retired->next;
+        }
+    }
+}
+
+/**
+ * Under the lock and after `pointer` was unpublished, readers entering from here
+ * on are in a later epoch and cannot reach it anymore.
+ */
+static void rxTableRetire(
+      RnTable *table, struct RxTableRetired *retired, void *pointer, void (*release)(void *))
+{
+    *retired = (struct RxTableRetired) {
+        .next    = table->retired,
+        .epoch   = __atomic_fetch_add(&table->epoch, 1, __ATOMIC_SEQ_CST),
+        .pointer = pointer,
+        .release = release,
+    };
+
+    table->retired = retired;
+    rxTableReclaim(table);
+}
+
+// rebuilds the live slots into a fresh array of room for twice as many, under the lock
+static int rxTableRebuild(RnTable *table)
+{
+    struct RxTableArray *array     = table->array;
+    struct RxTableArray *next      = rxTableArray((table->count + 1) * 4);
+    struct RxTableRetired *retired = malloc(sizeof(struct RxTableRetired));
+    if (next == NULL || retired == NULL)
+    {
+        free(next);
+        free(retired);
+        return RN_OOM;
+    }
+
+    for (uint32_t i = 0; i <= array->mask; ++i)
+    {
+        struct RxTableSlot *slot = &array->slots[i];
+        if (slot->hash == 0 || slot->value == NULL)
+        {
+            continue;
+        }
+
+        *rxTableProbe(table, next, slot->key, slot->hash) = *slot;
+        ++next->used;
+    }
+
+    __atomic_store_n(&table->array, next, __ATOMIC_RELEASE);
+    rxTableRetire(table, retired, array, free);
+    return RN_OK;
+}
+
+int rnTableOpen(uint32_t key_size, uint32_t capacity, uint32_t readers_max, OUT RnTable **out)
+{
+    if (key_size == 0 || key_size > RN_TABLE_KEY_MAX || readers_max == 0)
+    {
+        return EINVAL;
+    }
+
+    *out = calloc(1, sizeof(RnTable));
+    if (*out == NULL)
+    {
+        return RN_OOM;
+    }
+
+    (*out)->array       = rxTableArray((capacity ? capacity : RN_TABLE_CAPACITY_DEFAULT) * 2);
+    (*out)->readers     = rxTableAllocateReaders(readers_max);
+    (*out)->epoch       = 1;
+    (*out)->key_size    = key_size;
+    (*out)->readers_max = readers_max;
+    randombytes_buf(&(*out)->seed, sizeof (*out)->seed);
+
+    if ((*out)->array == NULL || (*out)->readers == NULL)
+    {
+        rnTableClose(*out);
+        return RN_OOM;
+    }
+
+    return RN_OK;
+}
+
+void rnTableClose(IN RnTable *table)
+{
+    while (table->retired != NULL)
+    {
+        struct RxTableRetired *retired = table->retired;
+        table->retired                 = retired->next;
+        retired->release(retired->pointer);
+        free(retired);
+    }
+
+    free(table->array);
+    rxTableFreeReaders(table->readers);
+    free(table);
+}
+
+void rnTableReadBegin(RnTable *table, uint32_t reader)
+{
+    uint64_t epoch = __atomic_load_n(&table->epoch, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&table->readers[reader].epoch, epoch, __ATOMIC_RELAXED);
+
+    // the announcement has to be visible before the array is loaded, see rxTableOldestReader
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void rnTableReadEnd(RnTable *table, uint32_t reader)
+{
+    __atomic_store_n(&table->readers[reader].epoch, 0, __ATOMIC_RELEASE);
+}
+
+void *rnTableFind(const RnTable *table, const void *key)
+{
+    const struct RxTableArray *array = __atomic_load_n(&table->array, __ATOMIC_ACQUIRE);
+    uint64_t hash                    = rxTableHash(table, key);
+    struct RxTableSlot *slot         = rxTableProbe(table, array, key, hash);
+
+    // an empty slot may be filled for another key meanwhile, its value is not ours
+    if (__atomic_load_n(&slot->hash, __ATOMIC_ACQUIRE) != hash ||
+        memcmp(slot->key, key, table->key_size) != 0)
+    {
+        return NULL;
+    }
+
+    return __atomic_load_n(&slot->value, __ATOMIC_ACQUIRE);
+}
+
+int rnTableInsert(RnTable *table, const void *key, void *value)
+{
+    uint64_t hash = rxTableHash(table, key);
+    rxTableLock(table);
+
+    struct RxTableSlot *slot = rxTableProbe(table, table->array, key, hash);
+    if (slot->hash == 0 && (table->array->used + 1) * 2 > table->array->mask + 1)
+    {
+        int rebuild_result = rxTableRebuild(table);
+        if (rebuild_result != RN_OK)
+        {
+            rxTableUnlock(table);
+            return rebuild_result;
+        }
+
+        slot = rxTableProbe(table, table->array, key, hash);
+    }
+
+    if (slot->value == NULL)
+    {
+        ++table->count;
+    }
+
+    // fresh slots are published by their hash only once key and value are in place
+    if (slot->hash == 0)
+    {
+        memcpy(slot->key, key, table->key_size);
+        slot->value = value;
+        ++table->array->used;
+        __atomic_store_n(&slot->hash, hash, __ATOMIC_RELEASE);
+    }
+    else
+    {
+        __atomic_store_n(&slot->value, value, __ATOMIC_RELEASE);
+    }
+
+    rxTableUnlock(table);
+    return RN_OK;
+}
+
+void *rnTableRemove(RnTable *table, const void *key)
+{
+    uint64_t hash = rxTableHash(table, key);
+    rxTableLock(table);
+
+    struct RxTableSlot *slot = rxTableProbe(table, table->array, key, hash);
+    void *value              = slot->value;
+    if (value != NULL)
+    {
+        __atomic_store_n(&slot->value, NULL, __ATOMIC_RELEASE);
+        --table->count;
+    }
+
+    rxTableUnlock(table);
+    return value;
+}
+
+int rnTableRetire(RnTable *table, void *pointer, void (*release)(void *))
+{
+    struct RxTableRetired *retired = malloc(sizeof(struct RxTableRetired));
+    if (retired == NULL)
+    {
+        return RN_OOM;
+    }
+
+    rxTableLock(table);
+    rxTableRetire(table, retired, pointer, release);
+    rxTableUnlock(table);
+
+    return RN_OK;
+}
+
+void rnTableSynchronize(RnTable *table)
+{
+    uint64_t epoch = __atomic_fetch_add(&table->epoch, 1, __ATOMIC_SEQ_CST);
+    while (rxTableOldestReader(table) <= epoch)
+    {
+        rxTableRelax();
+    }
+
+    rxTableLock(table);
+    rxTableReclaim(table);
+    rxTableUnlock(table);
+}
+
+uint32_t rnTableCount(const RnTable *table)
+{
+    return __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,140 @@
+#include "../include/rnlib/bitpack.h"
+#include "test.h"
+
+#include <string.h>
+
+/**
+ * Every kernel the CPU supports packing and unpacking every width at every
+ * alignment bit for bit like a plain least significant bit first stream.
+ */
+
+#define RN_TEST_QWORDS 40
+#define RN_TEST_VALUES 67
+
+static uint64_t rxTestNext(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return *state >> 32;
+}
+
+// the stream as written one bit at a time
+static void rxTestReference(
+      uint64_t *body, uint64_t offset, const uint32_t *values, size_t count, uint32_t bits)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        for (uint32_t bit = 0; bit < bits; ++bit, ++offset)
+        {
+            body[offset / 64] |= (uint64_t)(values[i] >> bit & 1) << (offset % 64);
+        }
+    }
+}
+
+static void rxTestKernel(enum RnBitpackKernel kernel)
+{
+    rnBitpackSelectKernel(kernel);
+    RN_TEST_ASSERT(rnBitpackKernel() == kernel || rnBitpackKernel() == RN_BITPACK_SCALAR);
+
+    static const uint32_t starts[] = { 0, 1, 7, 31, 32, 61, 64 + 17 };
+    static const size_t counts[]   = { 0, 1, 3, 4, 7, 8, 9, 16, 33, RN_TEST_VALUES };
+
+    uint64_t state = 1;
+    for (uint32_t bits = 1; bits <= RN_BITPACK_BITS_MAX; ++bits)
+    {
+        for (size_t s = 0; s < sizeof starts / sizeof *starts; ++s)
+        {
+            for (size_t c = 0; c < sizeof counts / sizeof *counts; ++c)
+            {
+                // values carry bits above their width, those are not written
+                uint32_t values[RN_TEST_VALUES];
+                uint32_t mask = bits == 32 ? UINT32_MAX : (1u << bits) - 1;
+                for (size_t i = 0; i < counts[c]; ++i)
+                {
+                    values[i] = (uint32_t)rxTestNext(&state);
+                }
+
+                uint64_t expected[RN_TEST_QWORDS] = { 0 };
+                uint64_t body[RN_TEST_QWORDS]     = { 0 };
+                rxTestReference(expected, starts[s], values, counts[c], bits);
+
+                RnPacketBufferCursor cursor = { starts[s] / 64, starts[s] % 64 };
+                RN_TEST_ASSERT(
+                      rnBitpackWrite(body, RN_TEST_QWORDS, &cursor, values, counts[c], bits) ==
+                      RN_OK);
+                RN_TEST_ASSERT(memcmp(body, expected, sizeof body) == 0);
+
+                uint64_t end = starts[s] + counts[c] * bits;
+                RN_TEST_ASSERT(cursor.qword == end / 64 && cursor.bit == end % 64);
+
+                // reads run up to the end of the body, where the gather has to stop short
+                uint32_t read[RN_TEST_VALUES];
+                size_t qwords = (size_t)(end + 63) / 64;
+                cursor        = (RnPacketBufferCursor){ starts[s] / 64, starts[s] % 64 };
+                RN_TEST_ASSERT(
+                      rnBitpackRead(body, qwords, &cursor, read, counts[c], bits) == RN_OK);
+                RN_TEST_ASSERT(cursor.qword == end / 64 && cursor.bit == end % 64);
+
+                for (size_t i = 0; i < counts[c]; ++i)
+                {
+                    RN_TEST_ASSERT(read[i] == (values[i] & mask));
+                }
+            }
+        }
+    }
+
+    // widths out of range and values past the body are refused without touching anything
+    uint32_t values[RN_TEST_VALUES] = { 0xFFFFFFFF };
+    uint64_t body[RN_TEST_QWORDS]   = { 0 };
+    RnPacketBufferCursor cursor     = { 1, 3 };
+    RN_TEST_ASSERT(rnBitpackWrite(body, RN_TEST_QWORDS, &cursor, values, 1, 0) == RN_OOM);
+    RN_TEST_ASSERT(rnBitpackWrite(body, RN_TEST_QWORDS, &cursor, values, 1, 33) == RN_OOM);
+    RN_TEST_ASSERT(rnBitpackWrite(body, 2, &cursor, values, 4, 32) == RN_OOM);
+    RN_TEST_ASSERT(rnBitpackRead(body, 2, &cursor, values, 4, 32) == RN_OOM);
+    RN_TEST_ASSERT(cursor.qword == 1 && cursor.bit == 3);
+    RN_TEST_ASSERT(body[1] == 0 && body[2] == 0);
+
+    RN_TEST_ASSERT(rnBitpackWrite(body, 2, &cursor, values, 61, 1) == RN_OK);
+    RN_TEST_ASSERT(cursor.qword == 2 && cursor.bit == 0);
+    RN_TEST_ASSERT(body[1] == 1ull << 3);
+}
+
+static void rxTestBuffer(void)
+{
+    // arrays continue where single writes stopped and the other way round
+    uint32_t values[RN_TEST_VALUES];
+    for (uint32_t i = 0; i < RN_TEST_VALUES; ++i)
+    {
+        values[i] = i * 37 % 1024;
+    }
+
+    RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);
+    RnPacketBufferCursor cursor = { 0, 0 };
+    RN_TEST_ASSERT(rnPacketBufferWriteUInt8(&buffer, &cursor, 0xA5) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferWriteArray(&buffer, &cursor, values, RN_TEST_VALUES, 10) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferWriteUInt16(&buffer, &cursor, 0xBEEF) == RN_OK);
+    RN_TEST_ASSERT(buffer.meta.body_size == (8 + RN_TEST_VALUES * 10 + 16 + 7) / 8);
+
+    uint8_t first;
+    uint16_t last;
+    uint32_t read[RN_TEST_VALUES];
+    cursor = (RnPacketBufferCursor){ 0, 0 };
+    RN_TEST_ASSERT(rnPacketBufferReadUInt8(&buffer, &cursor, &first) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferReadArray(&buffer, &cursor, read, RN_TEST_VALUES, 10) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferReadUInt16(&buffer, &cursor, &last) == RN_OK);
+    RN_TEST_ASSERT(first == 0xA5 && last == 0xBEEF);
+    RN_TEST_ASSERT(memcmp(read, values, sizeof read) == 0);
+
+    // nothing is read past the serialized body
+    RN_TEST_ASSERT(rnPacketBufferReadArray(&buffer, &cursor, read, 8, 8) == RN_OOM);
+}
+
+int main(void)
+{
+    rxTestKernel(RN_BITPACK_SCALAR);
+    rxTestKernel(RN_BITPACK_SSE41);
+    rxTestKernel(RN_BITPACK_AVX2);
+
+    rxTestBuffer();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include "../include/rnlib/capture.h"
+#include "test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * A capture of a real session with RN_CAPTURE_SESSIONS, replayed the way the
+ * replay tool does: the recorded session restored in place of the handshake,
+ * then fed the datagrams that followed it.
+ */
+
+#define RN_TEST_PORT 41028
+
+#define RN_TEST_PATH "/dev/shm/rnlib_test_capture"
+
+#define RN_TEST_PACKETS 3
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    struct RnTestPairAuthenticatedIPv4 pair;
+    rxTestPairOpenAuthenticatedIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+
+    // captures append, start from an empty one
+    remove(RN_TEST_PATH);
+
+    RnCapture *capture;
+    RN_TEST_ASSERT(rnCaptureOpen(RN_TEST_PATH, RN_CAPTURE_SESSIONS, &capture) == RN_OK);
+    rnSocketSetCapture(pair.server_socket, capture);
+
+    // the server records its session as its handshake completes, before any data arrives
+    rxTestPairConnectAuthenticatedIPv4(&pair);
+    for (uint64_t i = 0; i < RN_TEST_PACKETS; ++i)
+    {
+        RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);
+        RnPacketBufferCursor cursor = { 0, 0 };
+        rnPacketBufferWriteUInt64(&buffer, &cursor, i);
+        RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+        RN_TEST_ASSERT(
+              rxTestPairNextAuthenticatedIPv4(&pair, true, &buffer) ==
+              RN_CONNECTION_READ_AVAILABLE);
+    }
+
+    rnSocketSetCapture(pair.server_socket, NULL);
+    RN_TEST_ASSERT(rnCaptureClose(capture) == RN_OK);
+
+    // replies of the restored session go to a socket nobody reads
+    RnAddressIPv4 sink_address = RN_TEST_LOOPBACK_IPV4;
+    sink_address.port          = RN_TEST_PORT + 2;
+    RnSocketIPv4 *sink;
+    RN_TEST_ASSERT(rnSocketOpen(&sink_address, &sink) == RN_OK);
+
+    RnCaptureReader *reader;
+    RN_TEST_ASSERT(rnCaptureReaderOpen(RN_TEST_PATH, &reader) == RN_OK);
+
+    RnConnectionAuthenticatedIPv4 *session = NULL;
+    uint64_t sessions                      = 0;
+    uint64_t egress                        = 0;
+    uint64_t replayed                      = 0;
+    RnCaptureRecord record;
+    uint8_t data[RN_PACKET_WIRE_MAX_SECURE];
+    int next_result;
+    while ((next_result = rnCaptureReaderNext(reader, &record, data, sizeof data)) == RN_OK)
+    {
+        RN_TEST_ASSERT(record.family == 4);
+        RN_TEST_ASSERT(record.ipv4.port == pair.client_address.port);
+
+        if (record.direction == RN_CAPTURE_EGRESS)
+        {
+            ++egress;
+        }
+        else if (record.direction == RN_CAPTURE_SESSION)
+        {
+            uint32_t layout;
+            memcpy(&layout, data, sizeof layout);
+            RN_TEST_ASSERT(layout == rnConnectionSnapshotLayoutAuthenticatedIPv4());
+            RN_TEST_ASSERT(
+                  record.data_size ==
+                  sizeof layout + rnConnectionSnapshotSizeAuthenticatedIPv4());
+            RN_TEST_ASSERT(rnConnectionRestore(sink, data + sizeof layout, &session) == RN_OK);
+            ++sessions;
+        }
+        else if (session != NULL)
+        {
+            // everything after the session verifies against its keys
+            RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(0);
+            RN_TEST_ASSERT(record.data_size <= rnPacketBufferWireCapacitySecure(&buffer));
+            memcpy(rnPacketBufferWireDataSecure(&buffer), data, record.data_size);
+            RN_TEST_ASSERT(rnPacketBufferWireReceivedSecure(&buffer, record.data_size) == RN_OK);
+            RN_TEST_ASSERT(
+                  rnConnectionReadPacket(session, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+            RnPacketBufferCursor cursor = { 0, 0 };
+            uint64_t value;
+            RN_TEST_ASSERT(rnPacketBufferReadUInt64(&buffer, &cursor, &value) == RN_OK);
+            RN_TEST_ASSERT(value == replayed++);
+        }
+    }
+
+    RN_TEST_ASSERT(next_result == RN_CAPTURE_END);
+    RN_TEST_ASSERT(sessions == 1);
+    RN_TEST_ASSERT(egress > 0);
+    RN_TEST_ASSERT(replayed == RN_TEST_PACKETS);
+
+    RN_TEST_ASSERT(rnCaptureReaderClose(reader) == RN_OK);
+    remove(RN_TEST_PATH);
+
+    rnConnectionClose(session);
+    rnSocketClose(sink);
+    rxTestPairCloseAuthenticatedIPv4(&pair);
+    return EXIT_SUCCESS;
+}
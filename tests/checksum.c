@@ -0,0 +1,121 @@
+#include "../include/rnlib/checksum.h"
+#include "test.h"
+
+/**
+ * CRC32C kernels against the standard check value and against each other, and
+ * the integrity mode of insecure connections end to end.
+ */
+
+#define RN_TEST_PORT 41040
+
+#define RN_TEST_LENGTHS 5000
+
+static const enum RnChecksumKernel kernels[] = {
+    RN_CHECKSUM_SCALAR,
+    RN_CHECKSUM_ARMV8,
+    RN_CHECKSUM_SSE42,
+};
+
+static void rxTestCheckValue(void)
+{
+    for (size_t i = 0; i < sizeof kernels / sizeof *kernels; ++i)
+    {
+        rnChecksumSelectKernel(kernels[i]);
+        RN_TEST_ASSERT(rnChecksumCrc32c(0, "123456789", 9) == 0xE3069283);
+        RN_TEST_ASSERT(rnChecksumCrc32c(rnChecksumCrc32c(0, "1234", 4), "56789", 5) == 0xE3069283);
+    }
+}
+
+static void rxTestKernels(void)
+{
+    // one spare byte for every misalignment
+    static uint8_t data[RN_TEST_LENGTHS + 8];
+
+    uint32_t state = 0x9E3779B9;
+    for (size_t i = 0; i < sizeof data; ++i)
+    {
+        state   = state * 1664525 + 1013904223;
+        data[i] = (uint8_t)(state >> 24);
+    }
+
+    for (size_t size = 0; size < RN_TEST_LENGTHS; ++size)
+    {
+        const uint8_t *start = data + size % 8;
+
+        rnChecksumSelectKernel(RN_CHECKSUM_SCALAR);
+        uint32_t expected = rnChecksumCrc32c(0, start, size);
+
+        // unsupported kernels fall back to scalar and agree trivially
+        for (size_t i = 1; i < sizeof kernels / sizeof *kernels; ++i)
+        {
+            rnChecksumSelectKernel(kernels[i]);
+            RN_TEST_ASSERT(rnChecksumCrc32c(0, start, size) == expected);
+            RN_TEST_ASSERT(
+                  rnChecksumCrc32c(rnChecksumCrc32c(0, start, size / 3), start + size / 3,
+                                   size - size / 3) == expected);
+        }
+    }
+}
+
+static void rxTestIntegrity(void)
+{
+    struct RnTestPairInsecureIPv4 pair;
+    rxTestPairOpenInsecureIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestPairConnectInsecureIPv4(&pair);
+
+    rnConnectionSetIntegrity(pair.client, true);
+
+    RnPacketBufferInsecure buffer = rnPacketBufferCreateInsecure(1);
+    RnPacketBufferCursor cursor   = { 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, 0x0123456789ABCDEF);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(buffer.head.protocol & RN_PACKET_PROTOCOL_CHECKSUM);
+
+    // the server verifies the checksum and checksums its own packets from then on
+    RN_TEST_ASSERT(
+          rxTestPairNextInsecureIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+    RN_TEST_ASSERT(buffer.body[0] == 0x0123456789ABCDEF);
+
+    buffer = rnPacketBufferCreateInsecure(1);
+    cursor = (RnPacketBufferCursor){ 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, 42);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.server, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(buffer.head.protocol & RN_PACKET_PROTOCOL_CHECKSUM);
+    RN_TEST_ASSERT(
+          rxTestPairNextInsecureIPv4(&pair, false, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+    // a single flipped bit in the body fails verification
+    buffer = rnPacketBufferCreateInsecure(1);
+    cursor = (RnPacketBufferCursor){ 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, 7);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(rxTestPairReceiveInsecureIPv4(&pair, true, &buffer));
+    buffer.body[0] ^= 1u << 5;
+    RN_TEST_ASSERT(
+          rxTestPairReadInsecureIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_ERROR_VERIFY);
+
+    // so does a stripped checksum flag, the CRC remains in the salt
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(rxTestPairReceiveInsecureIPv4(&pair, true, &buffer));
+    buffer.head.protocol &= (uint16_t)~RN_PACKET_PROTOCOL_CHECKSUM;
+    RN_TEST_ASSERT(
+          rxTestPairReadInsecureIPv4(&pair, true, &buffer) != RN_CONNECTION_READ_AVAILABLE);
+
+    // intact packets still read after the corrupted ones
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(
+          rxTestPairNextInsecureIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+    rxTestPairCloseInsecureIPv4(&pair);
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    rxTestCheckValue();
+    rxTestKernels();
+    rxTestIntegrity();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,150 @@
+#include "../include/rnlib/clock.h"
+#include "test.h"
+
+/**
+ * Offset and drift estimation against a simulated peer clock, and clock
+ * requests and responses synchronizing a real connection.
+ */
+
+#define RN_TEST_PORT 41047
+
+#define RN_TEST_OFFSET_NS 5000000000ll
+#define RN_TEST_DRIFT     20e-6
+
+#define RN_TEST_TICK_NS 16666667
+
+// the simulated peer's clock, gaining RN_TEST_DRIFT on the local one
+static uint64_t rxTestRemote(uint64_t local)
+{
+    return local + (uint64_t)(RN_TEST_OFFSET_NS + (int64_t)((double)local * RN_TEST_DRIFT));
+}
+
+static uint64_t rxTestDistance(uint64_t a, uint64_t b)
+{
+    return a > b ? a - b : b - a;
+}
+
+static void rxTestEstimate(void)
+{
+    uint64_t now = 1000000000;
+    RnClockSync sync;
+    rnClockSyncInit(&sync, now);
+
+    RN_TEST_ASSERT(!sync.synchronized);
+    RN_TEST_ASSERT(rnClockSyncRemote(&sync, now) == now);
+    RN_TEST_ASSERT(rnClockSyncLocal(&sync, now) == now);
+    RN_TEST_ASSERT(rnClockSyncTick(&sync, now) == 0);
+
+    // the first requests go out in a quick burst, the rest once per interval
+    RN_TEST_ASSERT(rnClockSyncDue(&sync, now));
+    RN_TEST_ASSERT(!rnClockSyncDue(&sync, now + RN_CLOCK_BURST_NS - 1));
+    RN_TEST_ASSERT(rnClockSyncDue(&sync, now + RN_CLOCK_BURST_NS));
+
+    // responses from the future or after too long a round trip say nothing
+    RnClockTicks ticks = { .origin = rxTestRemote(now), .period = RN_TEST_TICK_NS };
+    rnClockSyncSample(&sync, now, rxTestRemote(now), &ticks, now - 1);
+    rnClockSyncSample(&sync, now, rxTestRemote(now), &ticks, now + RN_CLOCK_RTT_MAX_NS + 1);
+    RN_TEST_ASSERT(sync.count == 0);
+
+    // one round trip in four is held up by queueing on the way out, skewing its midpoint
+    for (uint64_t i = 0; i < RN_CLOCK_SAMPLES * 2; ++i)
+    {
+        uint64_t sent_at = now + i * RN_CLOCK_INTERVAL_NS;
+        uint64_t back    = 1000000 + i % 3 * 10000;
+        uint64_t out     = i % 4 == 0 ? 20000000 : back;
+
+        uint64_t remote_at = rxTestRemote(sent_at + out);
+        rnClockSyncSample(&sync, sent_at, remote_at, &ticks, sent_at + out + back);
+    }
+
+    RN_TEST_ASSERT(sync.synchronized);
+    RN_TEST_ASSERT(sync.count == RN_CLOCK_SAMPLES * 2);
+    RN_TEST_ASSERT(sync.rtt < 3000000);
+    RN_TEST_ASSERT(sync.drift > RN_TEST_DRIFT * 0.9 && sync.drift < RN_TEST_DRIFT * 1.1);
+
+    // later local times map to the peer's clock and back within a few microseconds
+    uint64_t later = now + RN_CLOCK_SAMPLES * 3 * RN_CLOCK_INTERVAL_NS;
+    RN_TEST_ASSERT(rxTestDistance(rnClockSyncRemote(&sync, later), rxTestRemote(later)) < 10000);
+    RN_TEST_ASSERT(
+          rxTestDistance(rnClockSyncLocal(&sync, rnClockSyncRemote(&sync, later)), later) < 10);
+
+    // the peer's ticks, and when to send to make one with a margin to spare
+    uint64_t expected = (rxTestRemote(later) - ticks.origin) / ticks.period;
+    RN_TEST_ASSERT(rxTestDistance(rnClockSyncTick(&sync, later), expected) <= 1);
+
+    uint64_t tick;
+    uint64_t send_at;
+    uint64_t margin = 2000000;
+    RN_TEST_ASSERT(rnClockSyncTickTarget(&sync, later, margin, &tick, &send_at));
+    RN_TEST_ASSERT(send_at >= later);
+
+    uint64_t arrival = rxTestRemote(send_at) + sync.rtt / 2;
+    uint64_t tick_at = ticks.origin + tick * ticks.period;
+    RN_TEST_ASSERT(arrival <= tick_at - margin + 10000);
+    RN_TEST_ASSERT(tick_at - margin - arrival < ticks.period);
+
+    // drift estimates beyond what crystals do are clamped
+    rnClockSyncInit(&sync, now);
+    for (uint64_t i = 0; i < RN_CLOCK_SAMPLES; ++i)
+    {
+        uint64_t sent_at = now + i * RN_CLOCK_INTERVAL_NS;
+        rnClockSyncSample(&sync, sent_at, sent_at * 2, &ticks, sent_at + 1000000);
+    }
+
+    RN_TEST_ASSERT(sync.drift == RN_CLOCK_DRIFT_MAX);
+}
+
+static void rxTestConnection(void)
+{
+    struct RnTestPairAuthenticatedIPv4 pair;
+    rxTestPairOpenAuthenticatedIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestPairConnectAuthenticatedIPv4(&pair);
+
+    RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);
+    RnPacketBufferCursor cursor = { 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, 0);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(
+          rxTestPairNextAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+    RnClockTicks ticks = { .origin = rnClockMonotonic(), .period = RN_TEST_TICK_NS };
+    rnConnectionSetTicks(pair.server, &ticks);
+    RN_TEST_ASSERT(!rnConnectionClock(pair.client)->synchronized);
+
+    // the server answers the request itself, the client samples the response
+    rnConnectionSyncClock(pair.client, rnClockMonotonic());
+    RN_TEST_ASSERT(rxTestPairReceiveAuthenticatedIPv4(&pair, true, &buffer));
+    RN_TEST_ASSERT(buffer.head.type == RN_CLOCK_REQUEST_PACKET_TYPE);
+    RN_TEST_ASSERT(
+          rxTestPairReadAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_PROBE);
+
+    RN_TEST_ASSERT(rxTestPairReceiveAuthenticatedIPv4(&pair, false, &buffer));
+    RN_TEST_ASSERT(buffer.head.type == RN_CLOCK_RESPONSE_PACKET_TYPE);
+    RN_TEST_ASSERT(
+          rxTestPairReadAuthenticatedIPv4(&pair, false, &buffer) == RN_CONNECTION_READ_PROBE);
+
+    // both ends share the host's monotonic clock, the offset is within the round trip
+    const RnClockSync *clock = rnConnectionClock(pair.client);
+    RN_TEST_ASSERT(clock->synchronized);
+    RN_TEST_ASSERT(clock->count == 1);
+    RN_TEST_ASSERT(clock->rtt > 0 && clock->rtt < RN_CLOCK_RTT_MAX_NS);
+    RN_TEST_ASSERT((uint64_t)(clock->offset < 0 ? -clock->offset : clock->offset) <= clock->rtt);
+    RN_TEST_ASSERT(clock->remote_ticks.origin == ticks.origin);
+    RN_TEST_ASSERT(clock->remote_ticks.period == ticks.period);
+
+    // the next request waits for the burst interval
+    rnConnectionSyncClock(pair.client, rnClockMonotonic());
+    RN_TEST_ASSERT(!rxTestPairReceiveAuthenticatedIPv4(&pair, true, &buffer));
+
+    rxTestPairCloseAuthenticatedIPv4(&pair);
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    rxTestEstimate();
+    rxTestConnection();
+
+    return EXIT_SUCCESS;
+}
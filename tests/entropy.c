@@ -0,0 +1,225 @@
+#include "../include/rnlib/entropy.h"
+#include "test.h"
+
+#include <string.h>
+
+/**
+ * Models trained from byte frequencies coding arbitrary input losslessly, and
+ * a real connection sending bodies of configured packet types coded.
+ */
+
+#define RN_TEST_PORT 41033
+
+#define RN_TEST_TYPE 5
+
+// small counters and flags, the usual game state, most bytes are zero
+#define RN_TEST_FIELDS 12
+
+static uint64_t rxTestNext(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return *state >> 33;
+}
+
+static size_t rxTestState(uint64_t *state, OUT uint8_t *data)
+{
+    size_t size = 0;
+    for (int i = 0; i < RN_TEST_FIELDS; ++i)
+    {
+        uint64_t value = rxTestNext(state) % 64;
+        memcpy(data + size, &value, sizeof value);
+        size += sizeof value;
+    }
+
+    return size;
+}
+
+static void rxTestTrain(OUT uint8_t table[RN_ENTROPY_TABLE_BYTES])
+{
+    uint64_t frequencies[256] = { 0 };
+    uint64_t state            = 1;
+    uint8_t data[RN_TEST_FIELDS * 8];
+    for (int sample = 0; sample < 256; ++sample)
+    {
+        size_t size = rxTestState(&state, data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            ++frequencies[data[i]];
+        }
+    }
+
+    rnEntropyTrain(frequencies, table);
+}
+
+static void rxTestModel(const RnEntropyModel *model)
+{
+    // every byte value has a code that resolves with a single lookup
+    for (int symbol = 0; symbol < 256; ++symbol)
+    {
+        RN_TEST_ASSERT(model->lengths[symbol] >= 1);
+        RN_TEST_ASSERT(model->lengths[symbol] <= RN_ENTROPY_CODE_BITS_MAX);
+    }
+
+    RN_TEST_ASSERT(model->lengths[0] < model->lengths[0xFF]);
+
+    // the traffic trained on shrinks, anything else still decodes to what it was
+    uint64_t state = 2;
+    uint8_t data[1024];
+    uint8_t encoded[1024 + 512];
+    uint8_t decoded[1024];
+    for (size_t size = 0; size <= sizeof data; size += size / 4 + 1)
+    {
+        for (int skewed = 0; skewed < 2; ++skewed)
+        {
+            for (size_t i = 0; i < size; ++i)
+            {
+                data[i] = (uint8_t)(skewed ? rxTestNext(&state) % 4 : rxTestNext(&state));
+            }
+
+            size_t encoded_size;
+            size_t decoded_size;
+            RN_TEST_ASSERT(
+                  rnEntropyEncode(model, data, size, encoded, sizeof encoded, &encoded_size) ==
+                  RN_OK);
+            RN_TEST_ASSERT(
+                  rnEntropyDecode(
+                        model, encoded, encoded_size, decoded, sizeof decoded, &decoded_size) ==
+                  RN_OK);
+            RN_TEST_ASSERT(decoded_size == size);
+            RN_TEST_ASSERT(memcmp(decoded, data, size) == 0);
+
+            if (skewed && size >= 16)
+            {
+                RN_TEST_ASSERT(encoded_size < size);
+            }
+        }
+    }
+
+    // coding into too little room, truncated input and too little room to decode into fail
+    size_t encoded_size;
+    size_t decoded_size;
+    RN_TEST_ASSERT(
+          rnEntropyEncode(model, data, 64, encoded, sizeof encoded, &encoded_size) == RN_OK);
+    RN_TEST_ASSERT(
+          rnEntropyEncode(model, data, 64, encoded, encoded_size - 1, &encoded_size) == RN_OOM);
+    RN_TEST_ASSERT(
+          rnEntropyDecode(model, encoded, 1, decoded, sizeof decoded, &decoded_size) == RN_OOM);
+    RN_TEST_ASSERT(
+          rnEntropyDecode(model, encoded, encoded_size, decoded, 63, &decoded_size) == RN_OOM);
+}
+
+static void rxTestWrite(RnConnectionAuthenticatedIPv4 *connection, uint16_t type, uint64_t *state)
+{
+    RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(type);
+    RnPacketBufferCursor cursor = { 0, 0 };
+    uint8_t data[RN_TEST_FIELDS * 8];
+    size_t size = rxTestState(state, data);
+    for (size_t i = 0; i < size; i += 8)
+    {
+        uint64_t value;
+        memcpy(&value, data + i, sizeof value);
+        rnPacketBufferWriteUInt64(&buffer, &cursor, value);
+    }
+
+    rnPacketBufferCommit(&buffer, &cursor);
+    RN_TEST_ASSERT(rnConnectionWritePacket(connection, &buffer) == RN_CONNECTION_WRITE_OK);
+}
+
+static void rxTestRead(RnPacketBufferSecure *buffer, uint16_t type, uint64_t *state)
+{
+    RN_TEST_ASSERT(buffer->head.type == type);
+    RN_TEST_ASSERT(buffer->meta.body_size == RN_TEST_FIELDS * 8);
+
+    uint8_t data[RN_TEST_FIELDS * 8];
+    rxTestState(state, data);
+    RN_TEST_ASSERT(memcmp(buffer->body, data, sizeof data) == 0);
+}
+
+static void rxTestConnection(const RnEntropyModel *model)
+{
+    struct RnTestPairAuthenticatedIPv4 pair;
+    rxTestPairOpenAuthenticatedIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestPairConnectAuthenticatedIPv4(&pair);
+
+    RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(RN_TEST_TYPE + 1);
+    RnPacketBufferCursor cursor = { 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, 0);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(
+          rxTestPairNextAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+    RnEntropyConfig config = { .types = { { RN_TEST_TYPE, model } } };
+    RN_TEST_ASSERT(rnEntropyConfigModel(&config, RN_TEST_TYPE) == model);
+    RN_TEST_ASSERT(rnEntropyConfigModel(&config, RN_TEST_TYPE + 1) == NULL);
+    rnConnectionConfigureEntropy(pair.client, &config);
+    rnConnectionConfigureEntropy(pair.server, &config);
+
+    // configured types go out coded and read back as written, in either direction
+    uint64_t sent     = 3;
+    uint64_t received = 3;
+    for (int i = 0; i < 4; ++i)
+    {
+        bool from_server                      = i % 2 == 1;
+        RnConnectionAuthenticatedIPv4 *writer = from_server ? pair.server : pair.client;
+        rxTestWrite(writer, RN_TEST_TYPE, &sent);
+
+        RN_TEST_ASSERT(rxTestPairReceiveAuthenticatedIPv4(&pair, !from_server, &buffer));
+        RN_TEST_ASSERT(buffer.head.type == (RN_TEST_TYPE | RN_PACKET_TYPE_COMPRESSED));
+        RN_TEST_ASSERT(buffer.meta.body_size < RN_TEST_FIELDS * 8);
+        RN_TEST_ASSERT(
+              rxTestPairReadAuthenticatedIPv4(&pair, !from_server, &buffer) ==
+              RN_CONNECTION_READ_AVAILABLE);
+        rxTestRead(&buffer, RN_TEST_TYPE, &received);
+    }
+
+    // other types go out as they are
+    rxTestWrite(pair.client, RN_TEST_TYPE + 1, &sent);
+    RN_TEST_ASSERT(rxTestPairReceiveAuthenticatedIPv4(&pair, true, &buffer));
+    RN_TEST_ASSERT(buffer.head.type == RN_TEST_TYPE + 1);
+    RN_TEST_ASSERT(
+          rxTestPairReadAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+    rxTestRead(&buffer, RN_TEST_TYPE + 1, &received);
+
+    // and so do bodies that would not shrink
+    buffer = rnPacketBufferCreateSecure(RN_TEST_TYPE);
+    cursor = (RnPacketBufferCursor){ 0, 0 };
+    for (int i = 0; i < RN_TEST_FIELDS; ++i)
+    {
+        rnPacketBufferWriteUInt64(&buffer, &cursor, 0xF7E6D5C4B3A29180ull * (uint64_t)(i + 1));
+    }
+
+    rnPacketBufferCommit(&buffer, &cursor);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(rxTestPairReceiveAuthenticatedIPv4(&pair, true, &buffer));
+    RN_TEST_ASSERT(buffer.head.type == RN_TEST_TYPE);
+    RN_TEST_ASSERT(
+          rxTestPairReadAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+    // coded bodies verify but cannot be read without the model
+    RnEntropyConfig none = { 0 };
+    rnConnectionConfigureEntropy(pair.server, &none);
+    rxTestWrite(pair.client, RN_TEST_TYPE, &sent);
+    RN_TEST_ASSERT(
+          rxTestPairNextAuthenticatedIPv4(&pair, true, &buffer) ==
+          RN_CONNECTION_READ_ERROR_CONTEXT);
+
+    rxTestPairCloseAuthenticatedIPv4(&pair);
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    // tables that do not describe a complete prefix code are refused
+    uint8_t table[RN_ENTROPY_TABLE_BYTES] = { 0 };
+    RnEntropyModel model;
+    RN_TEST_ASSERT(rnEntropyModelCreate(table, &model) == RN_OOM);
+
+    rxTestTrain(table);
+    RN_TEST_ASSERT(rnEntropyModelCreate(table, &model) == RN_OK);
+
+    rxTestModel(&model);
+    rxTestConnection(&model);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,132 @@
+#include "test.h"
+
+/**
+ * Secure connections crossing a key epoch in either direction. Built against
+ * its own copy of the library with a short RN_SESSION_EPOCH_NONCES.
+ */
+
+#if RN_SESSION_EPOCH_NONCES > 64
+    #error "the epoch test needs a library built with short key epochs"
+#endif
+
+#define RN_TEST_PORT 41039
+
+// one boundary, whoever of the pair sent the packet completing the handshake
+#define RN_TEST_PACKETS (RN_SESSION_EPOCH_NONCES + 4)
+
+#define RN_TEST_EPOCH_IMPL(TYPE, IP)                                                               \
+    static enum RnConnectionReadResult rxTestRead##TYPE##IP(                                       \
+          RnConnection##TYPE##IP *connection, const RnPacketBufferSecure *wire, uint64_t value)    \
+    {                                                                                              \
+        /* encrypted packets decrypt in place, every read gets a fresh copy */                     \
+        RnPacketBufferSecure buffer = *wire;                                                       \
+        enum RnConnectionReadResult read_result = rnConnectionReadPacket(connection, &buffer);     \
+        if (read_result == RN_CONNECTION_READ_AVAILABLE)                                           \
+        {                                                                                          \
+            RN_TEST_ASSERT(buffer.body[0] == value);                                               \
+        }                                                                                          \
+                                                                                                   \
+        return read_result;                                                                        \
+    }                                                                                              \
+                                                                                                   \
+    static void rxTestCross##TYPE##IP(struct RnTestPair##TYPE##IP *pair, bool from_server)         \
+    {                                                                                              \
+        RnConnection##TYPE##IP *writer = from_server ? pair->server : pair->client;                \
+        RnConnection##TYPE##IP *reader = from_server ? pair->client : pair->server;                \
+                                                                                                   \
+        static RnPacketBufferSecure wire[RN_TEST_PACKETS];                                         \
+        size_t boundary = 0;                                                                       \
+        for (size_t i = 0; i < RN_TEST_PACKETS; ++i)                                               \
+        {                                                                                          \
+            RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);                           \
+            RnPacketBufferCursor cursor = { 0, 0 };                                                \
+            rnPacketBufferWriteUInt64(&buffer, &cursor, i + 1);                                    \
+            RN_TEST_ASSERT(rnConnectionWritePacket(writer, &buffer) == RN_CONNECTION_WRITE_OK);    \
+            RN_TEST_ASSERT(rxTestPairReceive##TYPE##IP(pair, !from_server, &wire[i]));             \
+                                                                                                   \
+            if (i != 0 && (wire[i].head.protocol ^ wire[i - 1].head.protocol) &                    \
+                                RN_PACKET_PROTOCOL_KEY_PHASE)                                      \
+            {                                                                                      \
+                RN_TEST_ASSERT(boundary == 0);                                                     \
+                boundary = i;                                                                      \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        /* the sequence restarts with the epoch */                                                 \
+        RN_TEST_ASSERT(boundary > 1);                                                              \
+        RN_TEST_ASSERT(wire[boundary].head.sequence == 1);                                         \
+                                                                                                   \
+        for (size_t i = 0; i + 1 < boundary; ++i)                                                  \
+        {                                                                                          \
+            RN_TEST_ASSERT(                                                                        \
+                  rxTestRead##TYPE##IP(reader, &wire[i], i + 1) == RN_CONNECTION_READ_AVAILABLE);  \
+        }                                                                                          \
+                                                                                                   \
+        /* the first packet of the next epoch switches ingress over, the last one of the */        \
+        /* previous epoch arriving late still reads during the overlap */                          \
+        RN_TEST_ASSERT(                                                                            \
+              rxTestRead##TYPE##IP(reader, &wire[boundary], boundary + 1) ==                       \
+              RN_CONNECTION_READ_AVAILABLE);                                                       \
+        RN_TEST_ASSERT(                                                                            \
+              rxTestRead##TYPE##IP(reader, &wire[boundary - 1], boundary) ==                       \
+              RN_CONNECTION_READ_AVAILABLE);                                                       \
+                                                                                                   \
+        /* replays fail the window of their own epoch on either side of the boundary */            \
+        RN_TEST_ASSERT(                                                                            \
+              rxTestRead##TYPE##IP(reader, &wire[boundary - 1], boundary) ==                       \
+              RN_CONNECTION_READ_ERROR_SEQUENCE);                                                  \
+        RN_TEST_ASSERT(                                                                            \
+              rxTestRead##TYPE##IP(reader, &wire[boundary - 2], boundary - 1) ==                   \
+              RN_CONNECTION_READ_ERROR_SEQUENCE);                                                  \
+        RN_TEST_ASSERT(                                                                            \
+              rxTestRead##TYPE##IP(reader, &wire[boundary], boundary + 1) ==                       \
+              RN_CONNECTION_READ_ERROR_SEQUENCE);                                                  \
+                                                                                                   \
+        /* a packet moved to the other epoch's key phase is never read */                          \
+        RnPacketBufferSecure forged = wire[boundary + 1];                                          \
+        forged.head.protocol ^= RN_PACKET_PROTOCOL_KEY_PHASE;                                      \
+        RN_TEST_ASSERT(                                                                            \
+              rxTestRead##TYPE##IP(reader, &forged, boundary + 2) !=                               \
+              RN_CONNECTION_READ_AVAILABLE);                                                       \
+                                                                                                   \
+        for (size_t i = boundary + 1; i < RN_TEST_PACKETS; ++i)                                    \
+        {                                                                                          \
+            RN_TEST_ASSERT(                                                                        \
+                  rxTestRead##TYPE##IP(reader, &wire[i], i + 1) == RN_CONNECTION_READ_AVAILABLE);  \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void rxTestEpochs##TYPE##IP(const RnAddress##IP *loopback, uint16_t port)               \
+    {                                                                                              \
+        struct RnTestPair##TYPE##IP pair;                                                          \
+        rxTestPairOpen##TYPE##IP(&pair, loopback, port);                                           \
+        rxTestPairConnect##TYPE##IP(&pair);                                                        \
+                                                                                                   \
+        /* the first data packet completes the server's handshake */                               \
+        RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);                               \
+        RnPacketBufferCursor cursor = { 0, 0 };                                                    \
+        rnPacketBufferWriteUInt64(&buffer, &cursor, 0);                                            \
+        RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);   \
+        RN_TEST_ASSERT(                                                                            \
+              rxTestPairNext##TYPE##IP(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);     \
+                                                                                                   \
+        rxTestCross##TYPE##IP(&pair, false);                                                       \
+        rxTestCross##TYPE##IP(&pair, true);                                                        \
+                                                                                                   \
+        rxTestPairClose##TYPE##IP(&pair);                                                          \
+    }
+
+RN_TEST_EPOCH_IMPL(Authenticated, IPv4)
+RN_TEST_EPOCH_IMPL(Encrypted, IPv6)
+
+#undef RN_TEST_EPOCH_IMPL
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    rxTestEpochsAuthenticatedIPv4(&RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestEpochsEncryptedIPv6(&RN_TEST_LOOPBACK_IPV6, RN_TEST_PORT + 2);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,202 @@
+#include "../include/rnlib/fec.h"
+#include "test.h"
+
+#include <string.h>
+
+/**
+ * Parity groups rebuilding any single lost member, and parity packets of a
+ * real connection rebuilding a datagram that never got read.
+ */
+
+#define RN_TEST_PORT 41046
+
+#define RN_TEST_TYPE  7
+#define RN_TEST_GROUP 4
+
+static void rxTestFill(uint8_t *data, size_t size, uint8_t seed)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        data[i] = (uint8_t)(seed * 31 + i * 7);
+    }
+}
+
+static void rxTestGroups(void)
+{
+    // group sizes are clamped to 2, repeated types keep their first entry
+    RnFecConfig config = {
+        .types = {
+            { RN_TEST_TYPE, RN_TEST_GROUP },
+            { 9, 1 },
+            { RN_TEST_TYPE, 8 },
+        },
+    };
+
+    RnFec *sender;
+    RnFec *receiver;
+    RN_TEST_ASSERT(rnFecOpen(&config, &sender) == RN_OK);
+    RN_TEST_ASSERT(rnFecProtects(sender, RN_TEST_TYPE));
+    RN_TEST_ASSERT(rnFecProtects(sender, 9));
+    RN_TEST_ASSERT(!rnFecProtects(sender, 0));
+
+    // sizes from a single byte to the maximum, each member in turn goes missing
+    static const size_t sizes[RN_TEST_GROUP] = { 1, RN_FEC_PAYLOAD_MAX, 13, 64 };
+    uint8_t bodies[RN_TEST_GROUP][RN_FEC_PAYLOAD_MAX];
+    for (uint16_t missing = 0; missing < RN_TEST_GROUP; ++missing)
+    {
+        RN_TEST_ASSERT(rnFecOpen(&config, &receiver) == RN_OK);
+
+        uint8_t parity[RN_FEC_PARITY_BYTES_MAX];
+        size_t parity_size = 0;
+        for (uint16_t i = 0; i < RN_TEST_GROUP; ++i)
+        {
+            uint16_t sequence = (uint16_t)(missing * RN_TEST_GROUP + i + 1);
+            rxTestFill(bodies[i], sizes[i], (uint8_t)sequence);
+
+            bool complete = rnFecEncode(
+                  sender, RN_TEST_TYPE, sequence, bodies[i], sizes[i], parity, &parity_size);
+            RN_TEST_ASSERT(complete == (i == RN_TEST_GROUP - 1));
+
+            if (i != missing)
+            {
+                rnFecRemember(receiver, RN_TEST_TYPE, sequence, bodies[i], sizes[i]);
+            }
+        }
+
+        uint16_t type;
+        uint16_t sequence;
+        uint8_t data[RN_FEC_PAYLOAD_MAX];
+        size_t size;
+        RN_TEST_ASSERT(
+              rnFecRecover(receiver, parity, parity_size, &type, &sequence, data, &size));
+        RN_TEST_ASSERT(type == RN_TEST_TYPE);
+        RN_TEST_ASSERT(sequence == missing * RN_TEST_GROUP + missing + 1);
+        RN_TEST_ASSERT(size == sizes[missing]);
+        RN_TEST_ASSERT(memcmp(data, bodies[missing], size) == 0);
+
+        // truncated parity packets rebuild nothing
+        RN_TEST_ASSERT(!rnFecRecover(receiver, parity, 5, &type, &sequence, data, &size));
+
+        // neither do complete groups
+        rnFecRemember(receiver, RN_TEST_TYPE, sequence, data, size);
+        RN_TEST_ASSERT(
+              !rnFecRecover(receiver, parity, parity_size, &type, &sequence, data, &size));
+
+        rnFecClose(receiver);
+    }
+
+    // nor groups missing more than one member
+    RN_TEST_ASSERT(rnFecOpen(&config, &receiver) == RN_OK);
+    uint8_t parity[RN_FEC_PARITY_BYTES_MAX];
+    size_t parity_size;
+    for (uint16_t i = 0; i < RN_TEST_GROUP; ++i)
+    {
+        rnFecEncode(sender, RN_TEST_TYPE, i, bodies[i], sizes[i], parity, &parity_size);
+        if (i > 1)
+        {
+            rnFecRemember(receiver, RN_TEST_TYPE, i, bodies[i], sizes[i]);
+        }
+    }
+
+    uint16_t type;
+    uint16_t sequence;
+    uint8_t data[RN_FEC_PAYLOAD_MAX];
+    size_t size;
+    RN_TEST_ASSERT(!rnFecRecover(receiver, parity, parity_size, &type, &sequence, data, &size));
+
+    // empty and oversized packets are not protected and do not count towards a group
+    RN_TEST_ASSERT(!rnFecEncode(sender, 9, 0, data, 0, parity, &parity_size));
+    RN_TEST_ASSERT(
+          !rnFecEncode(sender, 9, 0, data, RN_FEC_PAYLOAD_MAX + 1, parity, &parity_size));
+    RN_TEST_ASSERT(!rnFecEncode(sender, 9, 1, data, 8, parity, &parity_size));
+    RN_TEST_ASSERT(rnFecEncode(sender, 9, 2, data, 8, parity, &parity_size));
+
+    rnFecClose(receiver);
+    rnFecClose(sender);
+}
+
+static void rxTestConnection(void)
+{
+    struct RnTestPairInsecureIPv4 pair;
+    rxTestPairOpenInsecureIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestPairConnectInsecureIPv4(&pair);
+
+    RnFecConfig config = { .types = { { RN_TEST_TYPE, RN_TEST_GROUP } } };
+    RN_TEST_ASSERT(rnConnectionConfigureFec(pair.client, &config) == RN_OK);
+    RN_TEST_ASSERT(rnConnectionConfigureFec(pair.server, &config) == RN_OK);
+
+    for (int round = 0; round < 2; ++round)
+    {
+        uint16_t lost_sequence = 0;
+        for (uint64_t i = 0; i < RN_TEST_GROUP; ++i)
+        {
+            RnPacketBufferInsecure buffer = rnPacketBufferCreateInsecure(RN_TEST_TYPE);
+            RnPacketBufferCursor cursor   = { 0, 0 };
+            rnPacketBufferWriteUInt64(&buffer, &cursor, 100 + i);
+            rnPacketBufferWriteUInt32(&buffer, &cursor, (uint32_t)i);
+            RN_TEST_ASSERT(
+                  rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+
+            // the second packet of the first round is lost on the way
+            RN_TEST_ASSERT(rxTestPairReceiveInsecureIPv4(&pair, true, &buffer));
+            if (round == 0 && i == 1)
+            {
+                lost_sequence = buffer.head.sequence;
+                continue;
+            }
+
+            RN_TEST_ASSERT(
+                  rxTestPairReadInsecureIPv4(&pair, true, &buffer) ==
+                  RN_CONNECTION_READ_AVAILABLE);
+        }
+
+        // the parity follows the last member of the group
+        RnPacketBufferInsecure parity;
+        RN_TEST_ASSERT(rxTestPairReceiveInsecureIPv4(&pair, true, &parity));
+        RN_TEST_ASSERT(parity.head.type == RN_FEC_PARITY_PACKET_TYPE);
+
+        enum RnConnectionReadResult read_result =
+              rxTestPairReadInsecureIPv4(&pair, true, &parity);
+        if (round == 0)
+        {
+            RnPacketBufferCursor cursor = { 0, 0 };
+            uint64_t value;
+            uint32_t index;
+            RN_TEST_ASSERT(read_result == RN_CONNECTION_READ_AVAILABLE);
+            RN_TEST_ASSERT(parity.head.type == RN_TEST_TYPE);
+            RN_TEST_ASSERT(parity.head.sequence == lost_sequence);
+            RN_TEST_ASSERT(rnPacketBufferReadUInt64(&parity, &cursor, &value) == RN_OK);
+            RN_TEST_ASSERT(rnPacketBufferReadUInt32(&parity, &cursor, &index) == RN_OK);
+            RN_TEST_ASSERT(value == 101 && index == 1);
+        }
+        else
+        {
+            RN_TEST_ASSERT(read_result == RN_CONNECTION_READ_PARITY);
+        }
+    }
+
+    // unprotected types go out without parity
+    RnPacketBufferInsecure buffer = rnPacketBufferCreateInsecure(RN_TEST_TYPE + 1);
+    RnPacketBufferCursor cursor   = { 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, 0);
+    for (int i = 0; i < RN_TEST_GROUP; ++i)
+    {
+        RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+        RN_TEST_ASSERT(
+              rxTestPairNextInsecureIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+    }
+
+    RN_TEST_ASSERT(!rxTestPairReceiveInsecureIPv4(&pair, true, &buffer));
+
+    rxTestPairCloseInsecureIPv4(&pair);
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    rxTestGroups();
+    rxTestConnection();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+#include "../include/rnlib/metrics.h"
+#include "test.h"
+
+#include <string.h>
+
+/**
+ * Histogram buckets and percentiles, and the counters and latencies a real
+ * exchange of packets leaves in the connection and the global snapshot.
+ */
+
+#define RN_TEST_PORT 41027
+
+#define RN_TEST_PACKETS 3
+
+static void rxTestHistogram(void)
+{
+    // exact below 2^SUB_BITS, monotonic and within 1/16 above
+    for (uint64_t value = 0; value <= RN_METRICS_HISTOGRAM_SUB_MASK; ++value)
+    {
+        RN_TEST_ASSERT(rnMetricsHistogramBucket(value) == value);
+    }
+
+    for (uint64_t value = 1; value < (1ull << 20); value += value / 7 + 1)
+    {
+        RN_TEST_ASSERT(rnMetricsHistogramBucket(value) >= rnMetricsHistogramBucket(value - 1));
+        RN_TEST_ASSERT(rnMetricsHistogramBucket(value) < RN_METRICS_HISTOGRAM_BUCKETS);
+    }
+
+    RN_TEST_ASSERT(rnMetricsHistogramBucket(UINT64_MAX) < RN_METRICS_HISTOGRAM_BUCKETS);
+
+    static RnMetricsHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value)
+    {
+        rnMetricsHistogramRecord(&histogram, value * 1000);
+    }
+
+    RN_TEST_ASSERT(histogram.total == 1000);
+
+    uint64_t median = rnMetricsHistogramPercentile(&histogram, 0.5);
+    RN_TEST_ASSERT(median <= 500000 && median >= 500000 - 500000 / 16);
+
+    uint64_t tail = rnMetricsHistogramPercentile(&histogram, 0.99);
+    RN_TEST_ASSERT(tail <= 990000 && tail >= 990000 - 990000 / 16);
+}
+
+static void rxTestConnection(void)
+{
+    RnMetricsSnapshot start;
+    rnMetricsSnapshot(&start);
+
+    struct RnTestPairInsecureIPv4 pair;
+    rxTestPairOpenInsecureIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestPairConnectInsecureIPv4(&pair);
+
+    RnMetricsCounters client;
+    rnConnectionMetrics(pair.client, &client);
+    RN_TEST_ASSERT(client.values[RN_METRICS_HANDSHAKE_CLIENT_CONNECT] == 1);
+    RN_TEST_ASSERT(client.values[RN_METRICS_HANDSHAKE_CONNECTED] == 1);
+
+    RnMetricsCounters server_before;
+    RnMetricsCounters client_before = client;
+    rnConnectionMetrics(pair.server, &server_before);
+    RN_TEST_ASSERT(server_before.values[RN_METRICS_HANDSHAKE_SERVER_CHALLENGE] == 1);
+
+    RnPacketBufferInsecure buffer;
+    uint64_t bytes = 0;
+    for (uint64_t i = 0; i < RN_TEST_PACKETS; ++i)
+    {
+        buffer                      = rnPacketBufferCreateInsecure(1);
+        RnPacketBufferCursor cursor = { 0, 0 };
+        rnPacketBufferWriteUInt64(&buffer, &cursor, i);
+        RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+        bytes += rnPacketBufferWireSize(&buffer);
+
+        RN_TEST_ASSERT(rxTestPairReceiveInsecureIPv4(&pair, true, &buffer));
+        RN_TEST_ASSERT(
+              rxTestPairReadInsecureIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+    }
+
+    // the last packet once more fails its window
+    RN_TEST_ASSERT(
+          rxTestPairReadInsecureIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_ERROR_SEQUENCE);
+
+    RnMetricsCounters server;
+    rnConnectionMetrics(pair.client, &client);
+    rnConnectionMetrics(pair.server, &server);
+
+    RN_TEST_ASSERT(
+          client.values[RN_METRICS_PACKETS_OUT] - client_before.values[RN_METRICS_PACKETS_OUT] ==
+          RN_TEST_PACKETS);
+    RN_TEST_ASSERT(
+          client.values[RN_METRICS_BYTES_OUT] - client_before.values[RN_METRICS_BYTES_OUT] ==
+          bytes);
+    RN_TEST_ASSERT(
+          server.values[RN_METRICS_PACKETS_IN] - server_before.values[RN_METRICS_PACKETS_IN] ==
+          RN_TEST_PACKETS);
+    RN_TEST_ASSERT(
+          server.values[RN_METRICS_BYTES_IN] - server_before.values[RN_METRICS_BYTES_IN] == bytes);
+    RN_TEST_ASSERT(server.values[RN_METRICS_DROPS_SEQUENCE] == 1);
+    RN_TEST_ASSERT(server.values[RN_METRICS_HANDSHAKE_CONNECTED] == 1);
+
+    // connections count into the shard of the thread that owns them as well
+    RnMetricsSnapshot end;
+    rnMetricsSnapshot(&end);
+
+    RN_TEST_ASSERT(
+          end.counters.values[RN_METRICS_PACKETS_IN] -
+                start.counters.values[RN_METRICS_PACKETS_IN] ==
+          client.values[RN_METRICS_PACKETS_IN] + server.values[RN_METRICS_PACKETS_IN]);
+    RN_TEST_ASSERT(
+          end.counters.values[RN_METRICS_DROPS_SEQUENCE] -
+                start.counters.values[RN_METRICS_DROPS_SEQUENCE] ==
+          1);
+    RN_TEST_ASSERT(
+          end.latency[RN_METRICS_LATENCY_HANDSHAKE].total -
+                start.latency[RN_METRICS_LATENCY_HANDSHAKE].total ==
+          2);
+    RN_TEST_ASSERT(
+          end.latency[RN_METRICS_LATENCY_INGRESS].total -
+                start.latency[RN_METRICS_LATENCY_INGRESS].total >=
+          RN_TEST_PACKETS + 1);
+    RN_TEST_ASSERT(
+          end.latency[RN_METRICS_LATENCY_EGRESS].total -
+                start.latency[RN_METRICS_LATENCY_EGRESS].total ==
+          RN_TEST_PACKETS);
+
+    static char text[16384];
+    RN_TEST_ASSERT(rnMetricsExport(&end, text, sizeof text) > 0);
+    RN_TEST_ASSERT(strstr(text, "rnlib_drops_sequence_total 1\n") != NULL);
+    RN_TEST_ASSERT(strstr(text, "rnlib_egress_latency_ns_count 3\n") != NULL);
+    RN_TEST_ASSERT(rnMetricsExport(&end, text, 16) == RN_OOM);
+
+    rxTestPairCloseInsecureIPv4(&pair);
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    rxTestHistogram();
+    rxTestConnection();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+#include "../include/rnlib/pmtu.h"
+#include "test.h"
+
+/**
+ * The path MTU search against simulated paths, and probes and their
+ * acknowledgements raising the payload limit of a real connection.
+ */
+
+#define RN_TEST_PORT 41038
+
+// more than any search from base to max takes, timeouts included
+#define RN_TEST_STEPS 256
+
+/**
+ * Runs the search at `*now` over a path passing datagrams of up to `path`
+ * bytes until it completes or fails, lost probes time out.
+ */
+static void rxTestSearch(RnPmtu *pmtu, uint16_t path, uint64_t *now)
+{
+    for (int step = 0; step < RN_TEST_STEPS; ++step)
+    {
+        uint16_t size = rnPmtuProbeDue(pmtu, *now);
+        if (size != 0)
+        {
+            RN_TEST_ASSERT(size % 8 == 0);
+            RN_TEST_ASSERT(size >= pmtu->base && size <= pmtu->max);
+
+            if (size <= path)
+            {
+                rnPmtuProbeAcked(pmtu, size, *now);
+            }
+            else
+            {
+                *now += RN_PMTU_PROBE_TIMEOUT_NS;
+            }
+
+            continue;
+        }
+
+        if (pmtu->state == RN_PMTU_SEARCH_COMPLETE || pmtu->state == RN_PMTU_ERROR)
+        {
+            return;
+        }
+
+        *now += RN_PMTU_PROBE_TIMEOUT_NS;
+    }
+
+    RN_TEST_ASSERT(!"search did not complete");
+}
+
+static void rxTestStateMachine(void)
+{
+    uint64_t now = 1;
+    RnPmtu pmtu;
+    rnPmtuInit(&pmtu, 1232, 1500, now);
+    RN_TEST_ASSERT(rnPmtuConfirmed(&pmtu) == 1232);
+
+    rxTestSearch(&pmtu, 1403, &now);
+    RN_TEST_ASSERT(pmtu.state == RN_PMTU_SEARCH_COMPLETE);
+    RN_TEST_ASSERT(rnPmtuConfirmed(&pmtu) == 1400);
+
+    // stale and foreign acknowledgements change nothing
+    rnPmtuProbeAcked(&pmtu, 1480, now);
+    RN_TEST_ASSERT(rnPmtuConfirmed(&pmtu) == 1400);
+
+    // the confirmed size is probed again once due, and reverts to base once it stops
+    // getting through
+    now += RN_PMTU_CONFIRM_NS;
+    RN_TEST_ASSERT(rnPmtuProbeDue(&pmtu, now) == 1400);
+    for (int attempt = 1; attempt < RN_PMTU_PROBE_ATTEMPTS; ++attempt)
+    {
+        RN_TEST_ASSERT(rnPmtuProbeDue(&pmtu, now) == 0);
+        now += RN_PMTU_PROBE_TIMEOUT_NS;
+        RN_TEST_ASSERT(rnPmtuProbeDue(&pmtu, now) == 1400);
+    }
+
+    now += RN_PMTU_PROBE_TIMEOUT_NS;
+    RN_TEST_ASSERT(rnPmtuProbeDue(&pmtu, now) == 1232);
+    RN_TEST_ASSERT(pmtu.state == RN_PMTU_BASE);
+    RN_TEST_ASSERT(rnPmtuConfirmed(&pmtu) == 1232);
+
+    // once the base got through the search continues below the lost size
+    rnPmtuProbeAcked(&pmtu, 1232, now);
+    rxTestSearch(&pmtu, 1300, &now);
+    RN_TEST_ASSERT(rnPmtuConfirmed(&pmtu) == 1296);
+
+    // a path not even passing the base any longer waits RN_PMTU_RAISE_NS before trying again
+    rnPmtuInit(&pmtu, 1232, 1500, now);
+    rxTestSearch(&pmtu, 1403, &now);
+    now += RN_PMTU_CONFIRM_NS;
+    rxTestSearch(&pmtu, 0, &now);
+    RN_TEST_ASSERT(pmtu.state == RN_PMTU_ERROR);
+    RN_TEST_ASSERT(rnPmtuConfirmed(&pmtu) == 1232);
+    RN_TEST_ASSERT(rnPmtuProbeDue(&pmtu, now + RN_PMTU_RAISE_NS - 1) == 0);
+    RN_TEST_ASSERT(rnPmtuProbeDue(&pmtu, now + RN_PMTU_RAISE_NS) == 1232);
+}
+
+static void rxTestConnection(void)
+{
+    struct RnTestPairAuthenticatedIPv4 pair;
+    rxTestPairOpenAuthenticatedIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestPairConnectAuthenticatedIPv4(&pair);
+
+    uint16_t base = rnConnectionPayloadMax(pair.client);
+    RN_TEST_ASSERT(base == (RN_PACKET_BYTES_BASE & ~7u));
+
+    // datagrams above the confirmed size are refused until a probe got through
+    RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);
+    RnPacketBufferCursor cursor = { 0, 0 };
+    RN_TEST_ASSERT(rnPacketBufferWritePaddingTo(&buffer, &cursor, base + 64) == RN_OK);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_ERROR_SIZE);
+
+    buffer = rnPacketBufferCreateSecure(1);
+    cursor = (RnPacketBufferCursor){ 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, 0);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(
+          rxTestPairNextAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+    // loopback passes everything, every probe is acknowledged up to the maximum
+    int probes = 0;
+    for (; probes < RN_TEST_STEPS; ++probes)
+    {
+        rnConnectionProbePath(pair.client, rnClockMonotonic());
+        if (!rxTestPairReceiveAuthenticatedIPv4(&pair, true, &buffer))
+        {
+            break;
+        }
+
+        RN_TEST_ASSERT(buffer.head.type == RN_PMTU_PROBE_PACKET_TYPE);
+        RN_TEST_ASSERT(
+              rxTestPairReadAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_PROBE);
+        RN_TEST_ASSERT(
+              rxTestPairNextAuthenticatedIPv4(&pair, false, &buffer) == RN_CONNECTION_READ_PROBE);
+        RN_TEST_ASSERT(buffer.head.type == RN_PMTU_ACK_PACKET_TYPE);
+        RN_TEST_ASSERT(rnConnectionPayloadMax(pair.client) > base);
+    }
+
+    RN_TEST_ASSERT(probes > 1);
+    RN_TEST_ASSERT(rnConnectionPayloadMax(pair.client) == (RN_PACKET_WIRE_MAX_SECURE & ~7u));
+
+    buffer = rnPacketBufferCreateSecure(1);
+    cursor = (RnPacketBufferCursor){ 0, 0 };
+    RN_TEST_ASSERT(rnPacketBufferWritePaddingTo(&buffer, &cursor, base + 64) == RN_OK);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(
+          rxTestPairNextAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+    rxTestPairCloseAuthenticatedIPv4(&pair);
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    rxTestStateMachine();
+    rxTestConnection();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+#include "../include/rnlib/poly1305.h"
+#include "test.h"
+
+#include <sodium.h>
+#include <string.h>
+
+/**
+ * Batched Poly1305 verification against crypto_onetimeauth_verify, and the
+ * batched read of authenticated connections against reading one by one.
+ */
+
+#define RN_TEST_PORT 41045
+
+#define RN_TEST_VECTORS 400
+
+// longer than any datagram so the kernels run their full block loops
+#define RN_TEST_MESSAGE_MAX 2048
+
+// enough packets for a full and a partial RN_CONNECTION_READ_BATCH
+#define RN_TEST_PACKETS (RN_CONNECTION_READ_BATCH * 2 + 5)
+
+struct RnTestVector
+{
+    uint8_t key[crypto_onetimeauth_KEYBYTES];
+    uint8_t tag[crypto_onetimeauth_BYTES];
+    uint8_t message[RN_TEST_MESSAGE_MAX];
+    size_t size;
+};
+
+static void rxTestVerifyBatch(void)
+{
+    static struct RnTestVector vectors[RN_TEST_VECTORS];
+    RnPoly1305Job jobs[RN_TEST_VECTORS];
+    bool expected[RN_TEST_VECTORS];
+
+    for (uint32_t i = 0; i < RN_TEST_VECTORS; ++i)
+    {
+        struct RnTestVector *vector = &vectors[i];
+
+        // every length around the block and lane boundaries, random ones after
+        vector->size = i < 80 ? i : randombytes_uniform(RN_TEST_MESSAGE_MAX + 1);
+        randombytes_buf(vector->key, sizeof vector->key);
+        randombytes_buf(vector->message, vector->size);
+        crypto_onetimeauth(vector->tag, vector->message, vector->size, vector->key);
+
+        // every third tag is forged by a flipped bit in its tag, message or key
+        if (i % 3 == 1)
+        {
+            switch (i % 9 / 3)
+            {
+                case 0: vector->tag[i % sizeof vector->tag] ^= 0x80; break;
+                case 1: vector->key[i % sizeof vector->key] ^= 0x01; break;
+                default: vector->message[0] ^= vector->size != 0 ? 0x10 : 0; break;
+            }
+        }
+
+        jobs[i] = (RnPoly1305Job){ vector->message, vector->size, vector->tag, vector->key };
+        expected[i] =
+              crypto_onetimeauth_verify(vector->tag, vector->message, vector->size, vector->key) ==
+              0;
+    }
+
+    static const enum RnPoly1305Kernel kernels[] = { RN_POLY1305_SCALAR, RN_POLY1305_AVX2 };
+    for (size_t k = 0; k < sizeof kernels / sizeof *kernels; ++k)
+    {
+        rnPoly1305SelectKernel(kernels[k]);
+
+        // batches of every size up to a few rounds of lanes, partial ones included
+        for (size_t batch = 1; batch <= RN_POLY1305_LANES * 3; ++batch)
+        {
+            for (size_t base = 0; base < RN_TEST_VECTORS; base += batch)
+            {
+                size_t count = RN_TEST_VECTORS - base < batch ? RN_TEST_VECTORS - base : batch;
+                bool valid[RN_POLY1305_LANES * 3];
+                memset(valid, 0xFF, sizeof valid);
+
+                rnPoly1305VerifyBatch(jobs + base, count, valid);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    RN_TEST_ASSERT(valid[i] == expected[base + i]);
+                }
+            }
+        }
+    }
+}
+
+static void rxTestReadPackets(void)
+{
+    struct RnTestPairAuthenticatedIPv4 pair;
+    rxTestPairOpenAuthenticatedIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestPairConnectAuthenticatedIPv4(&pair);
+
+    // the first data packet completes the server's handshake, batches only cover connected ones
+    RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);
+    RnPacketBufferCursor cursor = { 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, 0);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+    RN_TEST_ASSERT(
+          rxTestPairNextAuthenticatedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+    RN_TEST_ASSERT(rnConnectionHandshakeStep(pair.server) == RN_HANDSHAKE_CONNECTED);
+
+    static RnPacketBufferSecure packets[RN_TEST_PACKETS];
+    RnPacketBufferSecure *buffers[RN_TEST_PACKETS];
+    RnConnectionAuthenticatedIPv4 *connections[RN_TEST_PACKETS];
+    enum RnConnectionReadResult results[RN_TEST_PACKETS];
+    enum RnConnectionReadResult expected[RN_TEST_PACKETS];
+
+    for (uint64_t i = 0; i < RN_TEST_PACKETS; ++i)
+    {
+        buffer = rnPacketBufferCreateSecure(1);
+        cursor = (RnPacketBufferCursor){ 0, 0 };
+        rnPacketBufferWriteUInt64(&buffer, &cursor, i + 1);
+        RN_TEST_ASSERT(rnConnectionWritePacket(pair.client, &buffer) == RN_CONNECTION_WRITE_OK);
+
+        RN_TEST_ASSERT(rxTestPairReceiveAuthenticatedIPv4(&pair, true, &packets[i]));
+        buffers[i]     = &packets[i];
+        connections[i] = pair.server;
+        expected[i]    = RN_CONNECTION_READ_AVAILABLE;
+    }
+
+    // forged bodies and tags fail, a replay within the same batch fails its window
+    packets[3].body[0] ^= 1;
+    packets[RN_CONNECTION_READ_BATCH].auth[0] ^= 1;
+    packets[RN_TEST_PACKETS - 1] = packets[RN_TEST_PACKETS - 2];
+    expected[3]                        = RN_CONNECTION_READ_ERROR_VERIFY;
+    expected[RN_CONNECTION_READ_BATCH] = RN_CONNECTION_READ_ERROR_VERIFY;
+    expected[RN_TEST_PACKETS - 1]      = RN_CONNECTION_READ_ERROR_SEQUENCE;
+
+    RnMetricsCounters before;
+    rnConnectionMetrics(pair.server, &before);
+
+    rnConnectionReadPackets(connections, buffers, RN_TEST_PACKETS, results);
+
+    uint64_t available = 0;
+    for (uint64_t i = 0; i < RN_TEST_PACKETS; ++i)
+    {
+        RN_TEST_ASSERT(results[i] == expected[i]);
+        if (results[i] == RN_CONNECTION_READ_AVAILABLE)
+        {
+            RN_TEST_ASSERT(packets[i].body[0] == i + 1);
+            ++available;
+        }
+    }
+
+#ifndef RN_METRICS_DISABLED
+    // counted as rnConnectionReadPacket counts them
+    RnMetricsCounters after;
+    rnConnectionMetrics(pair.server, &after);
+    RN_TEST_ASSERT(
+          after.values[RN_METRICS_PACKETS_IN] - before.values[RN_METRICS_PACKETS_IN] == available);
+    RN_TEST_ASSERT(
+          after.values[RN_METRICS_DROPS_VERIFY] - before.values[RN_METRICS_DROPS_VERIFY] == 2);
+    RN_TEST_ASSERT(
+          after.values[RN_METRICS_DROPS_SEQUENCE] - before.values[RN_METRICS_DROPS_SEQUENCE] == 1);
+#else
+    (void)available;
+#endif
+
+    rxTestPairCloseAuthenticatedIPv4(&pair);
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(sodium_init() >= 0);
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    rxTestVerifyBatch();
+    rxTestReadPackets();
+
+    return EXIT_SUCCESS;
+}
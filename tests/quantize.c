@@ -0,0 +1,166 @@
+#include "../include/rnlib/quantize.h"
+#include "test.h"
+
+#include <errno.h>
+#include <math.h>
+
+/**
+ * Quantized floats, vectors and quaternions within half a step of what was
+ * written, and zigzag variable length integers of every magnitude.
+ */
+
+static uint64_t rxTestNext(uint64_t *state)
+{
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    return *state >> 33;
+}
+
+static float rxTestUniform(uint64_t *state, float min, float max)
+{
+    return min + (float)((double)rxTestNext(state) / (double)(1ull << 31) * (max - min));
+}
+
+static void rxTestRange(void)
+{
+    // the fewest bits that resolve the precision asked for
+    RnQuantizeRange range = rnQuantizeRangeCreate(-50.0f, 50.0f, 0.01f);
+    RN_TEST_ASSERT(range.bits == 14);
+    RN_TEST_ASSERT(rnQuantizeRangeCreate(0.0f, 1.0f, 1.0f).bits == 1);
+    RN_TEST_ASSERT(rnQuantizeRangeCreate(0.0f, 1.0f, 1e-12f).bits == 32);
+
+    double step    = (range.max - range.min) / (double)((1u << range.bits) - 1);
+    uint64_t state = 1;
+    for (int i = 0; i < 10000; ++i)
+    {
+        float value        = rxTestUniform(&state, range.min, range.max);
+        uint32_t quantized = rnQuantizeFloat(&range, value);
+        RN_TEST_ASSERT(quantized < 1u << range.bits);
+        RN_TEST_ASSERT(fabs(rnDequantizeFloat(&range, quantized) - value) <= step / 2 + 1e-5);
+    }
+
+    // the ends are exact, values beyond them clamped
+    RN_TEST_ASSERT(rnQuantizeFloat(&range, range.min) == 0);
+    RN_TEST_ASSERT(rnQuantizeFloat(&range, -1000.0f) == 0);
+    RN_TEST_ASSERT(rnQuantizeFloat(&range, 1000.0f) == (1u << range.bits) - 1);
+    RN_TEST_ASSERT(rnDequantizeFloat(&range, 0) == range.min);
+    RN_TEST_ASSERT(rnDequantizeFloat(&range, (1u << range.bits) - 1) == range.max);
+
+    // ranges without bits quantize to nothing
+    RnQuantizeRange empty = { .min = 1.0f, .max = 2.0f, .bits = 0 };
+    RN_TEST_ASSERT(rnQuantizeFloat(&empty, 1.5f) == 0);
+    RN_TEST_ASSERT(rnDequantizeFloat(&empty, 1) == 1.0f);
+}
+
+static void rxTestQuaternion(void)
+{
+    uint64_t state = 2;
+    for (int i = 0; i < 10000; ++i)
+    {
+        RnQuaternion q = {
+            rxTestUniform(&state, -1.0f, 1.0f),
+            rxTestUniform(&state, -1.0f, 1.0f),
+            rxTestUniform(&state, -1.0f, 1.0f),
+            rxTestUniform(&state, -1.0f, 1.0f),
+        };
+
+        float length = sqrtf(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+        q            = (RnQuaternion){ q.x / length, q.y / length, q.z / length, q.w / length };
+
+        RnQuantizedQuaternion quantized = rnQuantizeQuaternion(&q, 10);
+        RnQuaternion restored           = rnDequantizeQuaternion(&quantized, 10);
+
+        // the same rotation, possibly as -q, with the dropped component positive
+        const float components[4] = { restored.x, restored.y, restored.z, restored.w };
+        float dot = q.x * restored.x + q.y * restored.y + q.z * restored.z + q.w * restored.w;
+        RN_TEST_ASSERT(quantized.largest < 4);
+        RN_TEST_ASSERT(components[quantized.largest] >= 0.0f);
+        RN_TEST_ASSERT(fabsf(dot) > 0.9999f);
+    }
+}
+
+static void rxTestZigzag(void)
+{
+    static const int64_t values[] = { 0, -1, 1, -2, 2 };
+    for (uint64_t i = 0; i < sizeof values / sizeof *values; ++i)
+    {
+        RN_TEST_ASSERT(rnZigzagEncode(values[i]) == i);
+        RN_TEST_ASSERT(rnZigzagDecode(i) == values[i]);
+    }
+
+    RN_TEST_ASSERT(rnZigzagEncode(INT64_MAX) == UINT64_MAX - 1);
+    RN_TEST_ASSERT(rnZigzagEncode(INT64_MIN) == UINT64_MAX);
+    RN_TEST_ASSERT(rnZigzagDecode(UINT64_MAX) == INT64_MIN);
+}
+
+static void rxTestBuffer(void)
+{
+    RnQuantizeRange range = rnQuantizeRangeCreate(-1000.0f, 1000.0f, 0.05f);
+    double step           = (range.max - range.min) / (double)((1u << range.bits) - 1);
+
+    RnVector3 position    = { 12.5f, -999.0f, 0.0f };
+    RnQuaternion rotation = { 0.0f, 0.0f, 0.70710678f, -0.70710678f };
+
+    // variable length integers take a byte per 7 bits of zigzag magnitude
+    static const int64_t integers[] = { 0, -64, 64, 300, -1000000, INT64_MIN, INT64_MAX };
+    static const uint32_t bytes[]   = { 1, 1, 2, 2, 3, 10, 10 };
+
+    RnPacketBufferInsecure buffer = rnPacketBufferCreateInsecure(1);
+    RnPacketBufferCursor cursor   = { 0, 0 };
+    RN_TEST_ASSERT(rnPacketBufferWriteFloat(&buffer, &cursor, &range, 3.25f) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferWriteVector3(&buffer, &cursor, &range, &position) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferWriteQuaternion(&buffer, &cursor, 9, &rotation) == RN_OK);
+
+    uint32_t bits = range.bits * 4 + 2 + 3 * 9;
+    RN_TEST_ASSERT(cursor.qword * 64 + cursor.bit == bits);
+
+    for (size_t i = 0; i < sizeof integers / sizeof *integers; ++i)
+    {
+        RN_TEST_ASSERT(rnPacketBufferWriteVarInt(&buffer, &cursor, integers[i]) == RN_OK);
+        bits += bytes[i] * 8;
+        RN_TEST_ASSERT(cursor.qword * 64 + cursor.bit == bits);
+    }
+
+    // ranges and quaternions without bits are refused
+    RnQuantizeRange empty = { .min = 0.0f, .max = 1.0f, .bits = 0 };
+    RN_TEST_ASSERT(rnPacketBufferWriteFloat(&buffer, &cursor, &empty, 0.5f) == EINVAL);
+    RN_TEST_ASSERT(rnPacketBufferWriteQuaternion(&buffer, &cursor, 0, &rotation) == EINVAL);
+    RN_TEST_ASSERT(cursor.qword * 64 + cursor.bit == bits);
+
+    float value;
+    RnVector3 vector;
+    RnQuaternion quaternion;
+    cursor = (RnPacketBufferCursor){ 0, 0 };
+    RN_TEST_ASSERT(rnPacketBufferReadFloat(&buffer, &cursor, &range, &value) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferReadVector3(&buffer, &cursor, &range, &vector) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferReadQuaternion(&buffer, &cursor, 9, &quaternion) == RN_OK);
+
+    RN_TEST_ASSERT(fabs(value - 3.25f) <= step / 2 + 1e-4);
+    RN_TEST_ASSERT(fabs(vector.x - position.x) <= step / 2 + 1e-4);
+    RN_TEST_ASSERT(fabs(vector.y - position.y) <= step / 2 + 1e-4);
+    RN_TEST_ASSERT(fabs(vector.z - position.z) <= step / 2 + 1e-4);
+    RN_TEST_ASSERT(
+          fabsf(quaternion.z * rotation.z + quaternion.w * rotation.w) > 0.999f &&
+          fabsf(quaternion.x) < 0.01f && fabsf(quaternion.y) < 0.01f);
+
+    for (size_t i = 0; i < sizeof integers / sizeof *integers; ++i)
+    {
+        int64_t integer;
+        RN_TEST_ASSERT(rnPacketBufferReadVarInt(&buffer, &cursor, &integer) == RN_OK);
+        RN_TEST_ASSERT(integer == integers[i]);
+    }
+
+    // nothing is read past the last qword of the serialized body
+    int64_t integer;
+    cursor = (RnPacketBufferCursor){ (buffer.meta.body_size + 7) / 8 - 1, 60 };
+    RN_TEST_ASSERT(rnPacketBufferReadVarInt(&buffer, &cursor, &integer) == RN_OOM);
+}
+
+int main(void)
+{
+    rxTestRange();
+    rxTestQuaternion();
+    rxTestZigzag();
+    rxTestBuffer();
+
+    return EXIT_SUCCESS;
+}
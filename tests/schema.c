@@ -0,0 +1,125 @@
+#include "../include/rnlib/schema.h"
+#include "test.h"
+
+#include <string.h>
+
+/**
+ * Schema fields laid out bit for bit like a least significant bit first stream,
+ * as cursor writes lay them out, and schemas mixed with cursor serialization.
+ */
+
+// fields straddle qwords, the 64 bit one included
+#define RN_TEST_STATE_FIELDS(FIELD)                                                                \
+    FIELD(entity, uint16_t, 11)                                                                    \
+    FIELD(x, uint16_t, 14)                                                                         \
+    FIELD(y, uint16_t, 14)                                                                         \
+    FIELD(flags, uint8_t, 3)                                                                       \
+    FIELD(time, uint64_t, 64)                                                                      \
+    FIELD(health, uint32_t, 30)                                                                    \
+    FIELD(alive, bool, 1)
+
+#define RN_TEST_WHOLE_FIELDS(FIELD)                                                                \
+    FIELD(a, uint8_t, 8)                                                                           \
+    FIELD(b, uint16_t, 16)                                                                         \
+    FIELD(c, uint32_t, 32)                                                                         \
+    FIELD(d, uint64_t, 64)                                                                         \
+    FIELD(e, bool, 1)
+
+RN_SCHEMA_DEFINE(TestState, RN_TEST_STATE_FIELDS)
+RN_SCHEMA_DEFINE(TestWhole, RN_TEST_WHOLE_FIELDS)
+
+static void rxTestPut(uint64_t *body, uint64_t *offset, uint64_t value, uint32_t bits)
+{
+    for (uint32_t bit = 0; bit < bits; ++bit, ++*offset)
+    {
+        body[*offset / 64] |= (value >> bit & 1) << (*offset % 64);
+    }
+}
+
+static void rxTestState(void)
+{
+    RN_TEST_ASSERT(RN_SCHEMA_BITS(TestState) == 137);
+
+    // bits above each field's width are not written
+    RnSchemaTestState state = {
+        .entity = 0xFFFF,
+        .x      = 0x1234,
+        .y      = 0x2ABC,
+        .flags  = 5,
+        .time   = 0xF0E1D2C3B4A59687ull,
+        .health = 0xC0000001,
+        .alive  = true,
+    };
+
+    uint64_t expected[RN_PACKET_BODY_QWORDS_SECURE] = { 0 };
+    uint64_t offset                                  = 0;
+#define RN_TEST_PUT_FIELD(NAME, TYPE, BITS) rxTestPut(expected, &offset, state.NAME, BITS);
+    RN_TEST_STATE_FIELDS(RN_TEST_PUT_FIELD)
+#undef RN_TEST_PUT_FIELD
+
+    RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);
+    RN_TEST_ASSERT(RN_SCHEMA_FITS(TestState, &buffer));
+    rnSchemaWriteTestState(buffer.body, &state);
+    RN_TEST_ASSERT(memcmp(buffer.body, expected, sizeof expected) == 0);
+
+    RnSchemaTestState read;
+    rnSchemaReadTestState(buffer.body, &read);
+    RN_TEST_ASSERT(read.entity == 0x7FF && read.x == 0x1234 && read.y == 0x2ABC);
+    RN_TEST_ASSERT(read.flags == 5 && read.time == state.time);
+    RN_TEST_ASSERT(read.health == 1 && read.alive);
+
+    // cursor serialization continues right after the schema
+    RnPacketBufferCursor cursor = RN_SCHEMA_CURSOR(TestState);
+    RN_TEST_ASSERT(cursor.qword == 2 && cursor.bit == 9);
+    RN_TEST_ASSERT(rnPacketBufferWriteUInt16(&buffer, &cursor, 0xBEEF) == RN_OK);
+    RN_TEST_ASSERT(buffer.meta.body_size == (137 + 16 + 7) / 8);
+
+    uint16_t trailer;
+    cursor = RN_SCHEMA_CURSOR(TestState);
+    RN_TEST_ASSERT(rnPacketBufferReadUInt16(&buffer, &cursor, &trailer) == RN_OK);
+    RN_TEST_ASSERT(trailer == 0xBEEF);
+
+    // buffers limited below the schema have to be told apart before writing
+    rnPacketBufferLimit(&buffer, 16);
+    RN_TEST_ASSERT(!RN_SCHEMA_FITS(TestState, &buffer));
+}
+
+static void rxTestWhole(void)
+{
+    RnSchemaTestWhole whole = {
+        .a = 0xA5,
+        .b = 0xBEEF,
+        .c = 0xDEADBEEF,
+        .d = 0x0123456789ABCDEFull,
+        .e = true,
+    };
+
+    RnPacketBufferInsecure schema = rnPacketBufferCreateInsecure(1);
+    rnSchemaWriteTestWhole(schema.body, &whole);
+
+    // the same layout as cursor writes of whole integers
+    RnPacketBufferInsecure written = rnPacketBufferCreateInsecure(1);
+    RnPacketBufferCursor cursor    = { 0, 0 };
+    RN_TEST_ASSERT(rnPacketBufferWriteUInt8(&written, &cursor, whole.a) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferWriteUInt16(&written, &cursor, whole.b) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferWriteUInt32(&written, &cursor, whole.c) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferWriteUInt64(&written, &cursor, whole.d) == RN_OK);
+    RN_TEST_ASSERT(rnPacketBufferWriteBool(&written, &cursor, whole.e) == RN_OK);
+
+    RnPacketBufferCursor end = RN_SCHEMA_CURSOR(TestWhole);
+    RN_TEST_ASSERT(cursor.qword == end.qword && cursor.bit == end.bit);
+    RN_TEST_ASSERT(memcmp(schema.body, written.body, sizeof schema.body) == 0);
+
+    RnSchemaTestWhole read;
+    rnSchemaReadTestWhole(written.body, &read);
+    RN_TEST_ASSERT(read.a == whole.a && read.b == whole.b && read.c == whole.c);
+    RN_TEST_ASSERT(read.d == whole.d && read.e == whole.e);
+}
+
+int main(void)
+{
+    rxTestState();
+    rxTestWhole();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#include "../include/rnlib/snapshot.h"
+#include "test.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * A live session handed over the way a restarting server does: saved into a
+ * snapshot, its socket adopted and the session restored, then read from.
+ */
+
+#define RN_TEST_PORT 41042
+
+#define RN_TEST_PATH "/dev/shm/rnlib_test_snapshot"
+
+static void rxTestWrite(RnConnectionEncryptedIPv4 *connection, uint64_t value)
+{
+    RnPacketBufferSecure buffer = rnPacketBufferCreateSecure(1);
+    RnPacketBufferCursor cursor = { 0, 0 };
+    rnPacketBufferWriteUInt64(&buffer, &cursor, value);
+    RN_TEST_ASSERT(rnConnectionWritePacket(connection, &buffer) == RN_CONNECTION_WRITE_OK);
+}
+
+static uint64_t rxTestValue(RnPacketBufferSecure *buffer)
+{
+    RnPacketBufferCursor cursor = { 0, 0 };
+    uint64_t value;
+    RN_TEST_ASSERT(rnPacketBufferReadUInt64(buffer, &cursor, &value) == RN_OK);
+    return value;
+}
+
+// a bound socket as the previous process would have passed it on
+static int rxTestBind(uint16_t port)
+{
+    int handle = socket(AF_INET, SOCK_DGRAM, 0);
+    RN_TEST_ASSERT(handle >= 0);
+
+    struct sockaddr_in host = {
+        .sin_family      = AF_INET,
+        .sin_port        = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    RN_TEST_ASSERT(bind(handle, (struct sockaddr *)&host, sizeof host) == 0);
+    return handle;
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    struct RnTestPairEncryptedIPv4 pair;
+    rxTestPairOpenEncryptedIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+    rxTestPairConnectEncryptedIPv4(&pair);
+
+    // packets decrypt in place, the first one is kept as it arrived to be replayed later
+    RnPacketBufferSecure first;
+    rxTestWrite(pair.client, 1);
+    RN_TEST_ASSERT(rxTestPairReceiveEncryptedIPv4(&pair, true, &first));
+
+    RnPacketBufferSecure buffer = first;
+    RN_TEST_ASSERT(
+          rxTestPairReadEncryptedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+
+    // a packet arriving while the server restarts, received by the old process but not read
+    RnPacketBufferSecure pending;
+    rxTestWrite(pair.client, 2);
+    RN_TEST_ASSERT(rxTestPairReceiveEncryptedIPv4(&pair, true, &pending));
+
+    uint32_t kind = rnConnectionSnapshotLayoutEncryptedIPv4();
+    uint32_t size = (uint32_t)rnConnectionSnapshotSizeEncryptedIPv4();
+
+    RnSnapshot *snapshot;
+    RN_TEST_ASSERT(rnSnapshotCreate(RN_TEST_PATH, kind, size, 1, &snapshot) == RN_OK);
+    RN_TEST_ASSERT(rnSnapshotRecord(snapshot, 1) == NULL);
+    rnConnectionSave(pair.server, rnSnapshotRecord(snapshot, 0));
+    RN_TEST_ASSERT(rnSnapshotCommit(snapshot, 1) == RN_OK);
+
+    rnConnectionClose(pair.server);
+    rnSocketClose(pair.server_socket);
+
+    // other layouts are refused, the matching one adopted once
+    RN_TEST_ASSERT(rnSnapshotOpen(RN_TEST_PATH, kind + 1, size, &snapshot) == EINVAL);
+    RN_TEST_ASSERT(rnSnapshotOpen(RN_TEST_PATH, kind, size - 8, &snapshot) == EINVAL);
+    RN_TEST_ASSERT(rnSnapshotOpen(RN_TEST_PATH, kind, size, &snapshot) == RN_OK);
+    RN_TEST_ASSERT(rnSnapshotCount(snapshot) == 1);
+
+    RN_TEST_ASSERT(rnSocketAdoptIPv4(rxTestBind(RN_TEST_PORT), &pair.server_socket) == RN_OK);
+    RN_TEST_ASSERT(
+          rnConnectionRestore(pair.server_socket, rnSnapshotRecord(snapshot, 0), &pair.server) ==
+          RN_OK);
+    RN_TEST_ASSERT(rnSnapshotClose(snapshot) == RN_OK);
+    RN_TEST_ASSERT(access(RN_TEST_PATH, F_OK) != 0);
+
+    // keys and windows carried over, the pending packet reads, replays do not
+    RN_TEST_ASSERT(rnConnectionHandshakeStep(pair.server) == RN_HANDSHAKE_CONNECTED);
+    RN_TEST_ASSERT(
+          rxTestPairReadEncryptedIPv4(&pair, true, &pending) == RN_CONNECTION_READ_AVAILABLE);
+    RN_TEST_ASSERT(rxTestValue(&pending) == 2);
+    RN_TEST_ASSERT(
+          rxTestPairReadEncryptedIPv4(&pair, true, &first) == RN_CONNECTION_READ_ERROR_SEQUENCE);
+
+    // the session goes on in both directions on the adopted socket
+    rxTestWrite(pair.client, 3);
+    RN_TEST_ASSERT(
+          rxTestPairNextEncryptedIPv4(&pair, true, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+    RN_TEST_ASSERT(rxTestValue(&buffer) == 3);
+
+    rxTestWrite(pair.server, 4);
+    RN_TEST_ASSERT(
+          rxTestPairNextEncryptedIPv4(&pair, false, &buffer) == RN_CONNECTION_READ_AVAILABLE);
+    RN_TEST_ASSERT(rxTestValue(&buffer) == 4);
+
+    rxTestPairCloseEncryptedIPv4(&pair);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,304 @@
+#include "../include/rnlib/reactor.h"
+#include "../include/rnlib/table.h"
+#include "test.h"
+
+#include <errno.h>
+#include <pthread.h>
+
+/**
+ * Lookups, growth and reclamation of the table, readers on threads of their own
+ * racing a writer, and a reactor finding its connections through it.
+ */
+
+#define RN_TEST_PORT 41049
+
+#define RN_TEST_READERS 3
+#define RN_TEST_KEYS    64
+#define RN_TEST_ROUNDS  20000
+
+// values a reader may still hold, poisoned rather than freed once released
+struct RnTestValue
+{
+    uint32_t key;
+    uint32_t released;
+};
+
+static struct RnTestValue rxTestValues[RN_TEST_ROUNDS];
+
+static uint64_t rxTestReleased;
+
+static void rxTestRelease(void *pointer)
+{
+    struct RnTestValue *value = pointer;
+    __atomic_store_n(&value->released, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&rxTestReleased, 1, __ATOMIC_RELAXED);
+}
+
+static void rxTestTable(void)
+{
+    RnTable *table;
+    RN_TEST_ASSERT(rnTableOpen(0, 0, 1, &table) == EINVAL);
+    RN_TEST_ASSERT(rnTableOpen(RN_TABLE_KEY_MAX + 1, 0, 1, &table) == EINVAL);
+    RN_TEST_ASSERT(rnTableOpen(sizeof(uint32_t), 0, 0, &table) == EINVAL);
+
+    // far more keys than the capacity asked for, the table grows as they come
+    RN_TEST_ASSERT(rnTableOpen(sizeof(uint32_t), 4, 1, &table) == RN_OK);
+    rnTableReadBegin(table, 0);
+    for (uint32_t key = 0; key < RN_TEST_ROUNDS; ++key)
+    {
+        rxTestValues[key] = (struct RnTestValue){ .key = key };
+        RN_TEST_ASSERT(rnTableInsert(table, &key, &rxTestValues[key]) == RN_OK);
+    }
+
+    RN_TEST_ASSERT(rnTableCount(table) == RN_TEST_ROUNDS);
+    for (uint32_t key = 0; key < RN_TEST_ROUNDS; ++key)
+    {
+        RN_TEST_ASSERT(rnTableFind(table, &key) == &rxTestValues[key]);
+    }
+
+    uint32_t absent = RN_TEST_ROUNDS;
+    RN_TEST_ASSERT(rnTableFind(table, &absent) == NULL);
+    RN_TEST_ASSERT(rnTableRemove(table, &absent) == NULL);
+
+    // removal, replacement and reinsertion of the same keys
+    for (uint32_t key = 0; key < RN_TEST_ROUNDS; key += 2)
+    {
+        RN_TEST_ASSERT(rnTableRemove(table, &key) == &rxTestValues[key]);
+        RN_TEST_ASSERT(rnTableFind(table, &key) == NULL);
+    }
+
+    RN_TEST_ASSERT(rnTableCount(table) == RN_TEST_ROUNDS / 2);
+
+    uint32_t key = 1;
+    RN_TEST_ASSERT(rnTableInsert(table, &key, &rxTestValues[0]) == RN_OK);
+    RN_TEST_ASSERT(rnTableFind(table, &key) == &rxTestValues[0]);
+    key = 0;
+    RN_TEST_ASSERT(rnTableInsert(table, &key, &rxTestValues[0]) == RN_OK);
+    RN_TEST_ASSERT(rnTableFind(table, &key) == &rxTestValues[0]);
+    RN_TEST_ASSERT(rnTableCount(table) == RN_TEST_ROUNDS / 2 + 1);
+
+    // nothing retired is released while a reader that may hold it is in its section
+    RN_TEST_ASSERT(rnTableRetire(table, &rxTestValues[2], rxTestRelease) == RN_OK);
+    RN_TEST_ASSERT(rxTestReleased == 0);
+    rnTableReadEnd(table, 0);
+
+    rnTableReadBegin(table, 0);
+    RN_TEST_ASSERT(rnTableRetire(table, &rxTestValues[4], rxTestRelease) == RN_OK);
+    RN_TEST_ASSERT(rxTestReleased == 1);
+    RN_TEST_ASSERT(rxTestValues[2].released && !rxTestValues[4].released);
+    rnTableReadEnd(table, 0);
+
+    rnTableSynchronize(table);
+    RN_TEST_ASSERT(rxTestReleased == 2);
+
+    rnTableClose(table);
+    rxTestReleased = 0;
+}
+
+struct RnTestReader
+{
+    RnTable *table;
+    uint32_t reader;
+    const int *done;
+    uint64_t found;
+};
+
+static void *rxTestRead(void *argument)
+{
+    struct RnTestReader *reader = argument;
+    uint32_t key                = reader->reader;
+    while (!__atomic_load_n(reader->done, __ATOMIC_ACQUIRE))
+    {
+        rnTableReadBegin(reader->table, reader->reader);
+        for (int i = 0; i < RN_TEST_KEYS; ++i)
+        {
+            key                       = (key * 7 + 1) % RN_TEST_KEYS;
+            struct RnTestValue *value = rnTableFind(reader->table, &key);
+            if (value == NULL)
+            {
+                continue;
+            }
+
+            // values found stay valid for their key until the section ends
+            RN_TEST_ASSERT(value->key == key);
+            RN_TEST_ASSERT(!__atomic_load_n(&value->released, __ATOMIC_RELAXED));
+            __atomic_store_n(&reader->found, reader->found + 1, __ATOMIC_RELAXED);
+        }
+
+        rnTableReadEnd(reader->table, reader->reader);
+    }
+
+    return NULL;
+}
+
+static void rxTestConcurrent(void)
+{
+    RnTable *table;
+    RN_TEST_ASSERT(rnTableOpen(sizeof(uint32_t), 4, RN_TEST_READERS, &table) == RN_OK);
+
+    for (uint32_t key = 0; key < RN_TEST_KEYS; ++key)
+    {
+        rxTestValues[key] = (struct RnTestValue){ .key = key };
+        RN_TEST_ASSERT(rnTableInsert(table, &key, &rxTestValues[key]) == RN_OK);
+    }
+
+    int done = 0;
+    pthread_t threads[RN_TEST_READERS];
+    struct RnTestReader readers[RN_TEST_READERS];
+    for (uint32_t i = 0; i < RN_TEST_READERS; ++i)
+    {
+        readers[i] = (struct RnTestReader){ .table = table, .reader = i, .done = &done };
+        RN_TEST_ASSERT(pthread_create(&threads[i], NULL, rxTestRead, &readers[i]) == 0);
+    }
+
+    // the writer starts once every reader is reading
+    for (uint32_t i = 0; i < RN_TEST_READERS; ++i)
+    {
+        while (__atomic_load_n(&readers[i].found, __ATOMIC_RELAXED) == 0)
+        {
+            rxTestSleep();
+        }
+    }
+
+    // every round replaces a key's value with a fresh one, the old one is retired
+    uint64_t retired = 0;
+    for (uint32_t round = RN_TEST_KEYS; round < RN_TEST_ROUNDS; ++round)
+    {
+        uint32_t key             = round * 13 % RN_TEST_KEYS;
+        rxTestValues[round]      = (struct RnTestValue){ .key = key };
+        struct RnTestValue *last = rnTableRemove(table, &key);
+        if (last != NULL)
+        {
+            RN_TEST_ASSERT(rnTableRetire(table, last, rxTestRelease) == RN_OK);
+            ++retired;
+        }
+
+        if (round % 3 != 0)
+        {
+            RN_TEST_ASSERT(rnTableInsert(table, &key, &rxTestValues[round]) == RN_OK);
+        }
+    }
+
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    for (uint32_t i = 0; i < RN_TEST_READERS; ++i)
+    {
+        RN_TEST_ASSERT(pthread_join(threads[i], NULL) == 0);
+    }
+
+    rnTableSynchronize(table);
+    RN_TEST_ASSERT(__atomic_load_n(&rxTestReleased, __ATOMIC_RELAXED) == retired);
+
+    rnTableClose(table);
+}
+
+static RnReactorEventAuthenticatedIPv4 *rxTestEvent(RnReactorAuthenticatedIPv4 *reactor)
+{
+    for (int attempt = 0; attempt < RN_TEST_RECEIVE_ATTEMPTS; ++attempt)
+    {
+        RnReactorEventAuthenticatedIPv4 *event = rnReactorPeek(reactor, 0);
+        if (event != NULL)
+        {
+            return event;
+        }
+
+        rxTestSleep();
+    }
+
+    return NULL;
+}
+
+// a client of the reactor's only connection, handed back by its RN_REACTOR_CONNECTED
+static RnConnectionAuthenticatedIPv4 *rxTestSession(
+      RnReactorAuthenticatedIPv4 *reactor, struct RnTestPairAuthenticatedIPv4 *pair)
+{
+    RnPacketBufferSecure buffer;
+    for (int round = 0; round < RN_TEST_HANDSHAKE_ROUNDS &&
+                        rnConnectionHandshakeStep(pair->client) != RN_HANDSHAKE_CONNECTED;
+         ++round)
+    {
+        rnConnectionEstablishHandshake(pair->client);
+        rxTestPairNextAuthenticatedIPv4(pair, false, &buffer);
+    }
+
+    RN_TEST_ASSERT(rnConnectionHandshakeStep(pair->client) == RN_HANDSHAKE_CONNECTED);
+
+    RnReactorEventAuthenticatedIPv4 *event = rxTestEvent(reactor);
+    RN_TEST_ASSERT(event != NULL && event->kind == RN_REACTOR_CONNECTED);
+    RN_TEST_ASSERT(event->address.port == pair->client_address.port);
+    RnConnectionAuthenticatedIPv4 *session = event->connection;
+    rnReactorConsume(reactor, 0);
+
+    // the address lookup finds the session for what the client sends
+    RnPacketBufferSecure packet = rnPacketBufferCreateSecure(1);
+    RnPacketBufferCursor cursor = { 0, 0 };
+    rnPacketBufferWriteUInt64(&packet, &cursor, 7);
+    RN_TEST_ASSERT(rnConnectionWritePacket(pair->client, &packet) == RN_CONNECTION_WRITE_OK);
+
+    event = rxTestEvent(reactor);
+    RN_TEST_ASSERT(event != NULL && event->kind == RN_REACTOR_PACKET);
+    RN_TEST_ASSERT(event->connection == session);
+
+    uint64_t value;
+    cursor = (RnPacketBufferCursor){ 0, 0 };
+    RN_TEST_ASSERT(rnPacketBufferReadUInt64(&event->buffer, &cursor, &value) == RN_OK);
+    RN_TEST_ASSERT(value == 7);
+    rnReactorConsume(reactor, 0);
+
+    return session;
+}
+
+static void rxTestReactor(void)
+{
+    struct RnTestPairAuthenticatedIPv4 pair;
+    rxTestPairOpenAuthenticatedIPv4(&pair, &RN_TEST_LOOPBACK_IPV4, RN_TEST_PORT);
+
+    // room for a single connection, slots go back to the pool as connections close
+    RnReactorConfig config = { .connections_max = 1 };
+    RnReactorAuthenticatedIPv4 *reactor;
+    RN_TEST_ASSERT(rnReactorOpen(&pair.server_socket, 1, &config, &reactor) == RN_OK);
+
+    for (int session = 0; session < 2; ++session)
+    {
+        RnConnectionAuthenticatedIPv4 *connection = rxTestSession(reactor, &pair);
+
+        RnReactorStats stats;
+        rnReactorStats(reactor, 0, &stats);
+        RN_TEST_ASSERT(stats.connections == 1);
+
+        RnReactorEventAuthenticatedIPv4 *event = rnReactorAcquire(reactor, 0);
+        RN_TEST_ASSERT(event != NULL);
+        event->kind       = RN_REACTOR_DISCONNECT;
+        event->connection = connection;
+        rnReactorSubmit(reactor, 0);
+
+        for (int attempt = 0; attempt < RN_TEST_RECEIVE_ATTEMPTS && stats.connections != 0;
+             ++attempt)
+        {
+            rxTestSleep();
+            rnReactorStats(reactor, 0, &stats);
+        }
+
+        RN_TEST_ASSERT(stats.connections == 0);
+
+        // the next session starts over with a client of its own
+        rnConnectionClose(pair.client);
+        RN_TEST_ASSERT(
+              rnConnectionOpen(
+                    pair.client_socket, &pair.server_address, RN_CONNECTION_CLIENT,
+                    &pair.client) == RN_OK);
+    }
+
+    RN_TEST_ASSERT(rnReactorClose(reactor) == RN_OK);
+    rxTestPairCloseAuthenticatedIPv4(&pair);
+}
+
+int main(void)
+{
+    RN_TEST_ASSERT(rnSocketsInitialize() == RN_OK);
+
+    rxTestTable();
+    rxTestConcurrent();
+    rxTestReactor();
+
+    return EXIT_SUCCESS;
+}
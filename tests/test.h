@@ -0,0 +1,171 @@
+#ifndef RN_TEST_H
+#define RN_TEST_H
+
+#include "../include/rnlib/connection.h"
+#include "../include/rnlib/socket.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Minimal test support, every test is an executable of its own that exits with
+ * a failure on the first assertion that does not hold.
+ */
+
+#define RN_TEST_ASSERT(condition)                                                                  \
+    do                                                                                             \
+    {                                                                                              \
+        if (!(condition))                                                                          \
+        {                                                                                          \
+            fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #condition);      \
+            exit(EXIT_FAILURE);                                                                    \
+        }                                                                                          \
+    } while (0)
+
+// loopback datagrams arrive within microseconds, a second means they never will
+#define RN_TEST_RECEIVE_ATTEMPTS 1000
+
+#define RN_TEST_HANDSHAKE_ROUNDS 8
+
+// addresses are stored least significant octet/group first
+static const RnAddressIPv4 RN_TEST_LOOPBACK_IPV4 = { .octets = { 1, 0, 0, 127 } };
+static const RnAddressIPv6 RN_TEST_LOOPBACK_IPV6 = { .groups = { 1, 0, 0, 0, 0, 0, 0, 0 } };
+
+static inline void rxTestSleep(void)
+{
+    struct timespec duration = { .tv_sec = 0, .tv_nsec = 1000000 };
+    nanosleep(&duration, NULL);
+}
+
+/**
+ * A client and a server connection on two loopback sockets, `port` and the one
+ * above it. Tests running in parallel pick distinct ports.
+ */
+#define RN_TEST_PAIR_IMPL(TYPE, IP, BUFFER)                                                        \
+    struct RnTestPair##TYPE##IP                                                                    \
+    {                                                                                              \
+        RnSocket##IP *server_socket;                                                               \
+        RnSocket##IP *client_socket;                                                               \
+        RnConnection##TYPE##IP *server;                                                            \
+        RnConnection##TYPE##IP *client;                                                            \
+        RnAddress##IP server_address;                                                              \
+        RnAddress##IP client_address;                                                              \
+    };                                                                                             \
+                                                                                                   \
+    static inline void rxTestPairOpen##TYPE##IP(                                                   \
+          OUT struct RnTestPair##TYPE##IP *pair, const RnAddress##IP *loopback, uint16_t port)     \
+    {                                                                                              \
+        *pair                     = (struct RnTestPair##TYPE##IP){ 0 };                            \
+        pair->server_address      = *loopback;                                                     \
+        pair->server_address.port = port;                                                          \
+        pair->client_address      = *loopback;                                                     \
+        pair->client_address.port = (uint16_t)(port + 1);                                          \
+                                                                                                   \
+        RN_TEST_ASSERT(rnSocketOpen##IP(&pair->server_address, &pair->server_socket) == RN_OK);    \
+        RN_TEST_ASSERT(rnSocketOpen##IP(&pair->client_address, &pair->client_socket) == RN_OK);    \
+        RN_TEST_ASSERT(                                                                            \
+              rnConnectionOpen##TYPE##IP(                                                          \
+                    pair->client_socket, &pair->server_address, RN_CONNECTION_CLIENT,              \
+                    &pair->client) == RN_OK);                                                      \
+    }                                                                                              \
+                                                                                                   \
+    static inline void rxTestPairClose##TYPE##IP(struct RnTestPair##TYPE##IP *pair)                \
+    {                                                                                              \
+        if (pair->server != NULL)                                                                  \
+        {                                                                                          \
+            rnConnectionClose##TYPE##IP(pair->server);                                             \
+        }                                                                                          \
+                                                                                                   \
+        rnConnectionClose##TYPE##IP(pair->client);                                                 \
+        rnSocketClose##IP(pair->client_socket);                                                    \
+        rnSocketClose##IP(pair->server_socket);                                                    \
+    }                                                                                              \
+                                                                                                   \
+    /* the next datagram on the server or client socket, false if none arrives */                  \
+    static inline bool rxTestPairReceive##TYPE##IP(                                                \
+          struct RnTestPair##TYPE##IP *pair, bool server, OUT RnPacketBuffer##BUFFER *buffer)      \
+    {                                                                                              \
+        RnSocket##IP *socket = server ? pair->server_socket : pair->client_socket;                 \
+        *buffer              = rnPacketBufferCreate##BUFFER(0);                                    \
+                                                                                                   \
+        for (int attempt = 0; attempt < RN_TEST_RECEIVE_ATTEMPTS; ++attempt)                       \
+        {                                                                                          \
+            RnAddress##IP address;                                                                 \
+            size_t size = rnPacketBufferWireCapacity##BUFFER(buffer);                              \
+            if (rnSocketReceiveData##IP(                                                           \
+                      socket, &address, rnPacketBufferWireData##BUFFER(buffer), &size) == RN_OK)   \
+            {                                                                                      \
+                return rnPacketBufferWireReceived##BUFFER(buffer, size) == RN_OK;                  \
+            }                                                                                      \
+                                                                                                   \
+            rxTestSleep();                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        return false;                                                                              \
+    }                                                                                              \
+                                                                                                   \
+    /* reads a received datagram into its side's connection, the server's opens on the first */    \
+    static inline enum RnConnectionReadResult rxTestPairRead##TYPE##IP(                            \
+          struct RnTestPair##TYPE##IP *pair, bool server, RnPacketBuffer##BUFFER *buffer)          \
+    {                                                                                              \
+        if (server && pair->server == NULL)                                                        \
+        {                                                                                          \
+            RN_TEST_ASSERT(                                                                        \
+                  rnConnectionOpen##TYPE##IP(                                                      \
+                        pair->server_socket, &pair->client_address, RN_CONNECTION_SERVER,          \
+                        &pair->server) == RN_OK);                                                  \
+        }                                                                                          \
+                                                                                                   \
+        return rnConnectionReadPacket##TYPE##IP(server ? pair->server : pair->client, buffer);     \
+    }                                                                                              \
+                                                                                                   \
+    /* receives and reads the next datagram, RN_CONNECTION_READ_EMPTY if none arrives */           \
+    static inline enum RnConnectionReadResult rxTestPairNext##TYPE##IP(                            \
+          struct RnTestPair##TYPE##IP *pair, bool server, OUT RnPacketBuffer##BUFFER *buffer)      \
+    {                                                                                              \
+        if (!rxTestPairReceive##TYPE##IP(pair, server, buffer))                                    \
+        {                                                                                          \
+            return RN_CONNECTION_READ_EMPTY;                                                       \
+        }                                                                                          \
+                                                                                                   \
+        return rxTestPairRead##TYPE##IP(pair, server, buffer);                                     \
+    }                                                                                              \
+                                                                                                   \
+    /* runs the handshake the way the load test does until the client is connected */              \
+    static inline void rxTestPairConnect##TYPE##IP(struct RnTestPair##TYPE##IP *pair)              \
+    {                                                                                              \
+        RnPacketBuffer##BUFFER buffer;                                                             \
+                                                                                                   \
+        for (int round = 0; round < RN_TEST_HANDSHAKE_ROUNDS; ++round)                             \
+        {                                                                                          \
+            if (rnConnectionHandshakeStep##TYPE##IP(pair->client) == RN_HANDSHAKE_CONNECTED)       \
+            {                                                                                      \
+                return;                                                                            \
+            }                                                                                      \
+                                                                                                   \
+            rnConnectionEstablishHandshake##TYPE##IP(pair->client);                                \
+            if (rxTestPairNext##TYPE##IP(pair, true, &buffer) == RN_CONNECTION_READ_HANDSHAKE)     \
+            {                                                                                      \
+                rnConnectionEstablishHandshake##TYPE##IP(pair->server);                            \
+                rxTestPairNext##TYPE##IP(pair, false, &buffer);                                    \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        RN_TEST_ASSERT(!"handshake did not complete");                                             \
+    }
+
+RN_TEST_PAIR_IMPL(Authenticated, IPv4, Secure)
+RN_TEST_PAIR_IMPL(Authenticated, IPv6, Secure)
+
+RN_TEST_PAIR_IMPL(Encrypted, IPv4, Secure)
+RN_TEST_PAIR_IMPL(Encrypted, IPv6, Secure)
+
+RN_TEST_PAIR_IMPL(Insecure, IPv4, Insecure)
+RN_TEST_PAIR_IMPL(Insecure, IPv6, Insecure)
+
+#undef RN_TEST_PAIR_IMPL
+
+#endif // RN_TEST_H
@@ -0,0 +1,233 @@
+#include "../include/rnlib/capture.h"
+#include "../include/rnlib/entropy.h"
+#include "../include/rnlib/packet.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Entropy model trainer.
+ *
+ * Counts body byte frequencies per packet type over one or more captures
+ * written via rnSocketSetCapture and prints a C header with one serialized
+ * model per type, ready for rnEntropyModelCreate. Encrypted traffic has
+ * uniformly distributed bodies and cannot be trained on, record insecure or
+ * authenticated sessions instead; their plaintext bodies are the same.
+ */
+
+#define RN_ENTROPY_TRAIN_TYPES_MAX 256
+
+enum RnEntropyTrainType
+{
+    RN_ENTROPY_TRAIN_INSECURE,
+    RN_ENTROPY_TRAIN_AUTHENTICATED,
+};
+
+struct RnEntropyTrainModel
+{
+    uint16_t type;
+    uint64_t datagrams;
+    uint64_t bytes;
+    uint64_t frequencies[256];
+};
+
+struct RnEntropyTrainState
+{
+    size_t type_offset;
+    size_t body_offset;
+    uint32_t model_count;
+    struct RnEntropyTrainModel models[RN_ENTROPY_TRAIN_TYPES_MAX];
+};
+
+static struct RnEntropyTrainModel *rxEntropyTrainFind(
+      struct RnEntropyTrainState *state, uint16_t type)
+{
+    for (uint32_t i = 0; i < state->model_count; ++i)
+    {
+        if (state->models[i].type == type)
+        {
+            return &state->models[i];
+        }
+    }
+
+    if (state->model_count == RN_ENTROPY_TRAIN_TYPES_MAX)
+    {
+        return NULL;
+    }
+
+    struct RnEntropyTrainModel *model = &state->models[state->model_count++];
+    memset(model, 0, sizeof *model);
+    model->type = type;
+    return model;
+}
+
+static int rxEntropyTrainCount(struct RnEntropyTrainState *state, const char *path)
+{
+    RnCaptureReader *reader;
+    int result = rnCaptureReaderOpen(path, &reader);
+    if (result != RN_OK)
+    {
+        return result;
+    }
+
+    uint8_t data[UINT16_MAX];
+    RnCaptureRecord record;
+    while (rnCaptureReaderNext(reader, &record, data, sizeof data) == RN_OK)
+    {
+        if (record.direction == RN_CAPTURE_SESSION || record.data_size <= state->body_offset)
+        {
+            continue;
+        }
+
+        uint16_t type;
+        memcpy(&type, data + state->type_offset, sizeof type);
+
+        // already compressed datagrams say nothing about the plaintext
+        if (type & RN_PACKET_TYPE_COMPRESSED)
+        {
+            continue;
+        }
+
+        struct RnEntropyTrainModel *model = rxEntropyTrainFind(state, type);
+        if (model == NULL)
+        {
+            continue;
+        }
+
+        ++model->datagrams;
+        for (size_t i = state->body_offset; i < record.data_size; ++i)
+        {
+            ++model->frequencies[data[i]];
+            ++model->bytes;
+        }
+    }
+
+    rnCaptureReaderClose(reader);
+    return RN_OK;
+}
+
+/**
+ * Order-0 estimate of the coded size, without prefixes and byte rounding.
+ */
+static uint64_t rxEntropyTrainEstimate(
+      const struct RnEntropyTrainModel *model, const RnEntropyModel *entropy)
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < 256; ++i)
+    {
+        bits += model->frequencies[i] * entropy->lengths[i];
+    }
+
+    return (bits + 7) / 8;
+}
+
+static void rxEntropyTrainPrint(const struct RnEntropyTrainState *state)
+{
+    static RnEntropyModel entropy;
+
+    printf("/* generated by rnlib_entropy, do not edit */\n\n");
+    printf("#include <stdint.h>\n\n");
+
+    for (uint32_t i = 0; i < state->model_count; ++i)
+    {
+        const struct RnEntropyTrainModel *model = &state->models[i];
+
+        uint8_t table[RN_ENTROPY_TABLE_BYTES];
+        rnEntropyTrain(model->frequencies, table);
+        rnEntropyModelCreate(table, &entropy);
+
+        uint64_t estimate = rxEntropyTrainEstimate(model, &entropy);
+        fprintf(stderr, "type %5u  %10llu datagrams  %12llu bytes  -> %12llu (%.1f%%)\n",
+                model->type, (unsigned long long)model->datagrams,
+                (unsigned long long)model->bytes, (unsigned long long)estimate,
+                model->bytes ? 100.0 * (double)estimate / (double)model->bytes : 0.0);
+
+        printf("static const uint8_t rnEntropyTableType%u[%d] = {", model->type,
+               RN_ENTROPY_TABLE_BYTES);
+        for (int j = 0; j < RN_ENTROPY_TABLE_BYTES; ++j)
+        {
+            printf("%s0x%02X,", j % 12 == 0 ? "\n    " : " ", table[j]);
+        }
+
+        printf("\n};\n\n");
+    }
+}
+
+static void rxEntropyTrainUsage(const char *program)
+{
+    fprintf(stderr, "usage: %s CAPTURE... [--type insecure|authenticated] > tables.h\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    static struct RnEntropyTrainState state;
+
+    enum RnEntropyTrainType type = RN_ENTROPY_TRAIN_INSECURE;
+    int paths                    = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--type") != 0)
+        {
+            ++paths;
+            continue;
+        }
+
+        const char *value = i + 1 < argc ? argv[++i] : "";
+        if (strcmp(value, "insecure") == 0)
+        {
+            type = RN_ENTROPY_TRAIN_INSECURE;
+        }
+        else if (strcmp(value, "authenticated") == 0)
+        {
+            type = RN_ENTROPY_TRAIN_AUTHENTICATED;
+        }
+        else
+        {
+            rxEntropyTrainUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (paths == 0)
+    {
+        rxEntropyTrainUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // captures hold wire data, which starts within the buffer bookkeeping
+    if (type == RN_ENTROPY_TRAIN_AUTHENTICATED)
+    {
+        state.type_offset =
+              offsetof(RnPacketBufferSecure, head.type) - RN_PACKET_WIRE_OFFSET_SECURE;
+        state.body_offset = offsetof(RnPacketBufferSecure, body) - RN_PACKET_WIRE_OFFSET_SECURE;
+    }
+    else
+    {
+        state.type_offset =
+              offsetof(RnPacketBufferInsecure, head.type) - RN_PACKET_WIRE_OFFSET_INSECURE;
+        state.body_offset = offsetof(RnPacketBufferInsecure, body) - RN_PACKET_WIRE_OFFSET_INSECURE;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--type") == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        if (rxEntropyTrainCount(&state, argv[i]) != RN_OK)
+        {
+            fprintf(stderr, "failed to read %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    rxEntropyTrainPrint(&state);
+    return EXIT_SUCCESS;
+}
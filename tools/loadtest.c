@@ -0,0 +1,539 @@
+#include "../include/rnlib/connection.h"
+#include "../include/rnlib/metrics.h"
+#include "../include/rnlib/socket.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Loopback load generator.
+ *
+ * Runs a single server socket and `--clients` simulated clients, each with its
+ * own socket bound to consecutive ports above the server port, all serviced by
+ * one thread. Every client completes the real handshake and then sends one
+ * timestamped packet per tick, which the server verifies and answers with a
+ * timestamped packet of its own.
+ *
+ * Latency is taken from the timestamp written ahead of rnConnectionWritePacket
+ * to the return of rnConnectionReadPacket on the other end, for requests and
+ * replies alike. It covers cryptography, both syscalls and the loopback, but
+ * also the time a datagram waits for the loop to come round to its socket, so
+ * it bounds the library's own latency from above. Packet and byte counts cover
+ * data packets of both directions, handshakes are counted separately. CPU time
+ * is that of the whole process, clients and polling included.
+ *
+ * Large client counts need one file descriptor per client, raise `ulimit -n`
+ * accordingly.
+ */
+
+#define RN_LOADTEST_PACKET_TYPE 1
+
+#define RN_LOADTEST_IDLE_NS 50000
+
+// clients stop waiting for a reply this long after their last send, it counts as lost
+#define RN_LOADTEST_REPLY_TIMEOUT_NS 50000000
+
+enum RnLoadTestType
+{
+    RN_LOADTEST_INSECURE,
+    RN_LOADTEST_AUTHENTICATED,
+    RN_LOADTEST_ENCRYPTED,
+};
+
+struct RnLoadTestConfig
+{
+    uint32_t clients;
+    uint32_t tick_rate;
+    uint32_t duration;
+    uint16_t port;
+    enum RnLoadTestType type;
+    bool ipv6;
+};
+
+struct RnLoadTestReport
+{
+    uint64_t packets_sent;
+    uint64_t packets_received;
+    uint64_t bytes_sent;
+    uint64_t replies_lost;
+    uint64_t handshakes;
+    uint64_t handshake_ns;
+    uint64_t elapsed_ns;
+    uint64_t cpu_ns;
+
+    RnMetricsHistogram latency;
+};
+
+static uint64_t rxLoadTestClock(clockid_t clock)
+{
+    struct timespec now;
+    clock_gettime(clock, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static void rxLoadTestSleep(uint64_t ns)
+{
+    struct timespec duration = { .tv_sec = 0, .tv_nsec = (long)ns };
+    nanosleep(&duration, NULL);
+}
+
+#define RN_LOADTEST_IMPL(TYPE, IP, BUFFER)                                                         \
+    struct RnLoadTestClient##TYPE##IP                                                              \
+    {                                                                                              \
+        RnSocket##IP *socket;                                                                      \
+        RnConnection##TYPE##IP *connection;                                                        \
+        uint64_t next_tick;                                                                        \
+        uint64_t handshake_start;                                                                  \
+        uint64_t awaiting_until;                                                                   \
+        bool awaiting;                                                                             \
+        bool connected;                                                                            \
+    };                                                                                             \
+                                                                                                   \
+    static void rxLoadTestSend##TYPE##IP(                                                          \
+          RnConnection##TYPE##IP *connection, struct RnLoadTestReport *report)                     \
+    {                                                                                              \
+        RnPacketBuffer##BUFFER buffer = rnPacketBufferCreate##BUFFER(RN_LOADTEST_PACKET_TYPE);     \
+        RnPacketBufferCursor cursor   = { 0, 0 };                                                  \
+                                                                                                   \
+        rnPacketBufferWriteUInt64(&buffer, &cursor, rxLoadTestClock(CLOCK_MONOTONIC));             \
+                                                                                                   \
+        if (rnConnectionWritePacket(connection, &buffer) == RN_CONNECTION_WRITE_OK)                \
+        {                                                                                          \
+            ++report->packets_sent;                                                                \
+            report->bytes_sent += rnPacketBufferWireSize(&buffer);                                 \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void rxLoadTestRecord##TYPE##IP(                                                        \
+          const RnPacketBuffer##BUFFER *buffer, struct RnLoadTestReport *report)                   \
+    {                                                                                              \
+        /* the send timestamp is the first field serialized into the body */                       \
+        uint64_t sent_at = buffer->body[0];                                                        \
+        uint64_t now     = rxLoadTestClock(CLOCK_MONOTONIC);                                       \
+                                                                                                   \
+        ++report->packets_received;                                                                \
+        rnMetricsHistogramRecord(&report->latency, now > sent_at ? now - sent_at : 0);             \
+    }                                                                                              \
+                                                                                                   \
+    static void rxLoadTestServe##TYPE##IP(                                                         \
+          const struct RnLoadTestConfig *config, RnSocket##IP *socket,                             \
+          RnConnection##TYPE##IP **connections, struct RnLoadTestReport *report)                   \
+    {                                                                                              \
+        RnPacketBuffer##BUFFER buffer = rnPacketBufferCreate##BUFFER(0);                           \
+        uint8_t *data                 = rnPacketBufferWireData(&buffer);                           \
+        RnAddress##IP address;                                                                     \
+        size_t size = rnPacketBufferWireCapacity(&buffer);                                         \
+                                                                                                   \
+        while (rnSocketReceiveData(socket, &address, data, &size) == RN_OK)                        \
+        {                                                                                          \
+            int received = rnPacketBufferWireReceived(&buffer, size);                              \
+            size         = rnPacketBufferWireCapacity(&buffer);                                    \
+            if (received != RN_OK)                                                                 \
+            {                                                                                      \
+                continue;                                                                          \
+            }                                                                                      \
+                                                                                                   \
+            /* clients are bound to consecutive ports directly above the server */                 \
+            uint32_t index = (uint32_t)(address.port - config->port - 1);                          \
+            if (index >= config->clients)                                                          \
+            {                                                                                      \
+                continue;                                                                          \
+            }                                                                                      \
+                                                                                                   \
+            RnConnection##TYPE##IP **connection = &connections[index];                             \
+            if (*connection == NULL)                                                               \
+            {                                                                                      \
+                int open_result = rnConnectionOpen(                                                \
+                      socket, &address, RN_CONNECTION_SERVER, connection);                         \
+                if (open_result != RN_OK)                                                          \
+                {                                                                                  \
+                    continue;                                                                      \
+                }                                                                                  \
+            }                                                                                      \
+                                                                                                   \
+            enum RnConnectionReadResult read_result =                                              \
+                  rnConnectionReadPacket(*connection, &buffer);                                    \
+            if (read_result == RN_CONNECTION_READ_HANDSHAKE)                                       \
+            {                                                                                      \
+                rnConnectionEstablishHandshake(*connection);                                       \
+            }                                                                                      \
+            else if (read_result == RN_CONNECTION_READ_AVAILABLE)                                  \
+            {                                                                                      \
+                rxLoadTestRecord##TYPE##IP(&buffer, report);                                       \
+                rxLoadTestSend##TYPE##IP(*connection, report);                                     \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static void rxLoadTestReceive##TYPE##IP(                                                       \
+          struct RnLoadTestClient##TYPE##IP *client, struct RnLoadTestReport *report)              \
+    {                                                                                              \
+        RnPacketBuffer##BUFFER buffer = rnPacketBufferCreate##BUFFER(0);                           \
+        uint8_t *data                 = rnPacketBufferWireData(&buffer);                           \
+        RnAddress##IP address;                                                                     \
+        size_t size = rnPacketBufferWireCapacity(&buffer);                                         \
+                                                                                                   \
+        while (rnSocketReceiveData(client->socket, &address, data, &size) == RN_OK)                \
+        {                                                                                          \
+            int received     = rnPacketBufferWireReceived(&buffer, size);                          \
+            size             = rnPacketBufferWireCapacity(&buffer);                                \
+            client->awaiting = false;                                                              \
+            if (received != RN_OK)                                                                 \
+            {                                                                                      \
+                continue;                                                                          \
+            }                                                                                      \
+                                                                                                   \
+            enum RnConnectionReadResult read_result =                                              \
+                  rnConnectionReadPacket(client->connection, &buffer);                             \
+            if (read_result == RN_CONNECTION_READ_AVAILABLE)                                       \
+            {                                                                                      \
+                rxLoadTestRecord##TYPE##IP(&buffer, report);                                       \
+            }                                                                                      \
+            else if (read_result == RN_CONNECTION_READ_HANDSHAKE)                                  \
+            {                                                                                      \
+                /* resent confirmations reach clients that are already connected */                \
+                if (rnConnectionHandshakeStep(client->connection) == RN_HANDSHAKE_CONNECTED)       \
+                {                                                                                  \
+                    if (!client->connected)                                                        \
+                    {                                                                              \
+                        client->connected = true;                                                  \
+                        ++report->handshakes;                                                      \
+                        report->handshake_ns +=                                                    \
+                              rxLoadTestClock(CLOCK_MONOTONIC) - client->handshake_start;          \
+                    }                                                                              \
+                }                                                                                  \
+                else                                                                               \
+                {                                                                                  \
+                    /* answer immediately rather than waiting for the next tick */                 \
+                    rnConnectionEstablishHandshake(client->connection);                            \
+                    client->awaiting       = true;                                                 \
+                    client->awaiting_until =                                                       \
+                          rxLoadTestClock(CLOCK_MONOTONIC) + RN_LOADTEST_REPLY_TIMEOUT_NS;         \
+                }                                                                                  \
+            }                                                                                      \
+        }                                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    static int rxLoadTestRun##TYPE##IP(                                                            \
+          const struct RnLoadTestConfig *config, const RnAddress##IP *loopback,                    \
+          struct RnLoadTestReport *report)                                                         \
+    {                                                                                              \
+        RnAddress##IP server_address = *loopback;                                                  \
+        server_address.port          = config->port;                                               \
+                                                                                                   \
+        RnSocket##IP *server_socket;                                                               \
+        int result = rnSocketOpen(&server_address, &server_socket);                                \
+        if (result != RN_OK)                                                                       \
+        {                                                                                          \
+            return result;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        struct RnLoadTestClient##TYPE##IP *clients = calloc(config->clients, sizeof *clients);     \
+        RnConnection##TYPE##IP **connections = calloc(config->clients, sizeof *connections);       \
+        if (clients == NULL || connections == NULL)                                                \
+        {                                                                                          \
+            free(clients);                                                                         \
+            free(connections);                                                                     \
+            rnSocketClose(server_socket);                                                          \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        uint64_t period = 1000000000ull / config->tick_rate;                                       \
+        uint64_t start  = rxLoadTestClock(CLOCK_MONOTONIC);                                        \
+                                                                                                   \
+        uint32_t opened = 0;                                                                       \
+        for (; opened < config->clients; ++opened)                                                 \
+        {                                                                                          \
+            struct RnLoadTestClient##TYPE##IP *client = &clients[opened];                          \
+                                                                                                   \
+            RnAddress##IP client_address = *loopback;                                              \
+            client_address.port          = (uint16_t)(config->port + 1 + opened);                  \
+                                                                                                   \
+            result = rnSocketOpen(&client_address, &client->socket);                               \
+            if (result != RN_OK)                                                                   \
+            {                                                                                      \
+                break;                                                                             \
+            }                                                                                      \
+                                                                                                   \
+            result = rnConnectionOpen(                                                             \
+                  client->socket, &server_address, RN_CONNECTION_CLIENT, &client->connection);     \
+            if (result != RN_OK)                                                                   \
+            {                                                                                      \
+                rnSocketClose(client->socket);                                                     \
+                break;                                                                             \
+            }                                                                                      \
+                                                                                                   \
+            /* stagger clients across one tick so the server sees a steady rate, not bursts */     \
+            client->next_tick       = start + period * opened / config->clients;                   \
+            client->handshake_start = client->next_tick;                                           \
+        }                                                                                          \
+                                                                                                   \
+        uint64_t cpu_start = rxLoadTestClock(CLOCK_PROCESS_CPUTIME_ID);                            \
+        uint64_t end       = start + (uint64_t)config->duration * 1000000000ull;                   \
+        uint64_t now       = start;                                                                \
+                                                                                                   \
+        while (result == RN_OK && now < end)                                                       \
+        {                                                                                          \
+            uint64_t next_wake = end;                                                              \
+                                                                                                   \
+            for (uint32_t i = 0; i < opened; ++i)                                                  \
+            {                                                                                      \
+                struct RnLoadTestClient##TYPE##IP *client = &clients[i];                           \
+                if (client->awaiting && client->awaiting_until <= now)                             \
+                {                                                                                  \
+                    ++report->replies_lost;                                                        \
+                    client->awaiting = false;                                                      \
+                }                                                                                  \
+                                                                                                   \
+                if (client->next_tick <= now)                                                      \
+                {                                                                                  \
+                    client->next_tick += period;                                                   \
+                    client->awaiting       = true;                                                 \
+                    client->awaiting_until = now + RN_LOADTEST_REPLY_TIMEOUT_NS;                   \
+                                                                                                   \
+                    if (rnConnectionHandshakeStep(client->connection) == RN_HANDSHAKE_CONNECTED)   \
+                    {                                                                              \
+                        rxLoadTestSend##TYPE##IP(client->connection, report);                      \
+                    }                                                                              \
+                    else                                                                           \
+                    {                                                                              \
+                        rnConnectionEstablishHandshake(client->connection);                        \
+                    }                                                                              \
+                }                                                                                  \
+                                                                                                   \
+                if (client->next_tick < next_wake)                                                 \
+                {                                                                                  \
+                    next_wake = client->next_tick;                                                 \
+                }                                                                                  \
+            }                                                                                      \
+                                                                                                   \
+            rxLoadTestServe##TYPE##IP(config, server_socket, connections, report);                 \
+                                                                                                   \
+            bool awaiting = false;                                                                 \
+            for (uint32_t i = 0; i < opened; ++i)                                                  \
+            {                                                                                      \
+                if (clients[i].awaiting)                                                           \
+                {                                                                                  \
+                    rxLoadTestReceive##TYPE##IP(&clients[i], report);                              \
+                    awaiting |= clients[i].awaiting;                                               \
+                }                                                                                  \
+            }                                                                                      \
+                                                                                                   \
+            now = rxLoadTestClock(CLOCK_MONOTONIC);                                                \
+            if (!awaiting && next_wake > now + RN_LOADTEST_IDLE_NS)                                \
+            {                                                                                      \
+                rxLoadTestSleep(RN_LOADTEST_IDLE_NS);                                              \
+                now = rxLoadTestClock(CLOCK_MONOTONIC);                                            \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        report->elapsed_ns = now - start;                                                          \
+        report->cpu_ns     = rxLoadTestClock(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;                \
+                                                                                                   \
+        for (uint32_t i = 0; i < config->clients; ++i)                                             \
+        {                                                                                          \
+            if (connections[i] != NULL)                                                            \
+            {                                                                                      \
+                rnConnectionClose(connections[i]);                                                 \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        for (uint32_t i = 0; i < opened; ++i)                                                      \
+        {                                                                                          \
+            rnConnectionClose(clients[i].connection);                                              \
+            rnSocketClose(clients[i].socket);                                                      \
+        }                                                                                          \
+                                                                                                   \
+        free(connections);                                                                         \
+        free(clients);                                                                             \
+        rnSocketClose(server_socket);                                                              \
+        return result;                                                                             \
+    }
+
+RN_LOADTEST_IMPL(Authenticated, IPv4, Secure)
+RN_LOADTEST_IMPL(Authenticated, IPv6, Secure)
+
+RN_LOADTEST_IMPL(Encrypted, IPv4, Secure)
+RN_LOADTEST_IMPL(Encrypted, IPv6, Secure)
+
+RN_LOADTEST_IMPL(Insecure, IPv4, Insecure)
+RN_LOADTEST_IMPL(Insecure, IPv6, Insecure)
+
+#undef RN_LOADTEST_IMPL
+
+static int rxLoadTestRun(const struct RnLoadTestConfig *config, struct RnLoadTestReport *report)
+{
+    // addresses are stored least significant octet/group first
+    RnAddressIPv4 loopback_ipv4 = { .octets = { 1, 0, 0, 127 } };
+    RnAddressIPv6 loopback_ipv6 = { .groups = { 1, 0, 0, 0, 0, 0, 0, 0 } };
+
+    switch (config->type)
+    {
+        case RN_LOADTEST_INSECURE:
+        {
+            return config->ipv6 ? rxLoadTestRunInsecureIPv6(config, &loopback_ipv6, report)
+                                : rxLoadTestRunInsecureIPv4(config, &loopback_ipv4, report);
+        }
+
+        case RN_LOADTEST_AUTHENTICATED:
+        {
+            return config->ipv6 ? rxLoadTestRunAuthenticatedIPv6(config, &loopback_ipv6, report)
+                                : rxLoadTestRunAuthenticatedIPv4(config, &loopback_ipv4, report);
+        }
+
+        case RN_LOADTEST_ENCRYPTED:
+        {
+            return config->ipv6 ? rxLoadTestRunEncryptedIPv6(config, &loopback_ipv6, report)
+                                : rxLoadTestRunEncryptedIPv4(config, &loopback_ipv4, report);
+        }
+    }
+
+    return RN_OK;
+}
+
+static void rxLoadTestPrintReport(
+      const struct RnLoadTestConfig *config, const struct RnLoadTestReport *report)
+{
+    static const char *type_names[] = { "insecure", "authenticated", "encrypted" };
+
+    double seconds = (double)report->elapsed_ns / 1e9;
+    uint64_t packets = report->packets_sent + report->packets_received;
+
+    printf("type            %s/%s\n", type_names[config->type], config->ipv6 ? "ipv6" : "ipv4");
+    printf("clients         %u @ %u Hz for %.2f s\n", config->clients, config->tick_rate, seconds);
+    printf("handshakes      %llu (%.1f/s, mean %.1f us)\n",
+           (unsigned long long)report->handshakes, (double)report->handshakes / seconds,
+           report->handshakes ? (double)report->handshake_ns / report->handshakes / 1e3 : 0.0);
+    printf("data packets    %llu sent, %llu received, %llu replies lost\n",
+           (unsigned long long)report->packets_sent, (unsigned long long)report->packets_received,
+           (unsigned long long)report->replies_lost);
+    printf("throughput      %.0f pps sent and received, %.2f MB/s sent\n",
+           (double)packets / seconds, (double)report->bytes_sent / seconds / 1e6);
+    printf("cpu per packet  %.0f ns (whole process, clients and polling included)\n",
+           packets ? (double)report->cpu_ns / packets : 0.0);
+    printf("latency p50     %.1f us (one way, loop wait included)\n",
+           rnMetricsHistogramPercentile(&report->latency, 0.50) / 1e3);
+    printf("latency p99     %.1f us\n",
+           rnMetricsHistogramPercentile(&report->latency, 0.99) / 1e3);
+    printf("latency p999    %.1f us\n",
+           rnMetricsHistogramPercentile(&report->latency, 0.999) / 1e3);
+}
+
+static void rxLoadTestUsage(const char *program)
+{
+    fprintf(stderr,
+          "usage: %s [--clients N] [--rate HZ] [--duration S] [--port P]\n"
+          "          [--type insecure|authenticated|encrypted] [--ipv6]\n",
+          program);
+}
+
+int main(int argc, char **argv)
+{
+    struct RnLoadTestConfig config = {
+        .clients   = 1000,
+        .tick_rate = 30,
+        .duration  = 10,
+        .port      = 20000,
+        .type      = RN_LOADTEST_INSECURE,
+        .ipv6      = false,
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg   = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--ipv6") == 0)
+        {
+            config.ipv6 = true;
+            continue;
+        }
+
+        if (value == NULL)
+        {
+            rxLoadTestUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        if (strcmp(arg, "--clients") == 0)
+        {
+            config.clients = (uint32_t)strtoul(value, NULL, 10);
+        }
+        else if (strcmp(arg, "--rate") == 0)
+        {
+            config.tick_rate = (uint32_t)strtoul(value, NULL, 10);
+        }
+        else if (strcmp(arg, "--duration") == 0)
+        {
+            config.duration = (uint32_t)strtoul(value, NULL, 10);
+        }
+        else if (strcmp(arg, "--port") == 0)
+        {
+            config.port = (uint16_t)strtoul(value, NULL, 10);
+        }
+        else if (strcmp(arg, "--type") == 0)
+        {
+            if (strcmp(value, "insecure") == 0)
+            {
+                config.type = RN_LOADTEST_INSECURE;
+            }
+            else if (strcmp(value, "authenticated") == 0)
+            {
+                config.type = RN_LOADTEST_AUTHENTICATED;
+            }
+            else if (strcmp(value, "encrypted") == 0)
+            {
+                config.type = RN_LOADTEST_ENCRYPTED;
+            }
+            else
+            {
+                rxLoadTestUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            rxLoadTestUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        ++i;
+    }
+
+    if (config.clients == 0 || config.tick_rate == 0 ||
+        (uint32_t)config.port + config.clients > UINT16_MAX)
+    {
+        fprintf(stderr, "clients must fit in the port range above --port\n");
+        return EXIT_FAILURE;
+    }
+
+    if (rnSocketsInitialize() != RN_OK)
+    {
+        return EXIT_FAILURE;
+    }
+
+    struct RnLoadTestReport *report = calloc(1, sizeof *report);
+    if (report == NULL)
+    {
+        return EXIT_FAILURE;
+    }
+
+    int result = rxLoadTestRun(&config, report);
+    if (result != RN_OK)
+    {
+        // errors are errno values, except for RN_OOM
+        fprintf(stderr, "load test aborted: %s\n",
+                result == RN_OOM ? "out of memory" : strerror(result));
+    }
+
+    rxLoadTestPrintReport(&config, report);
+
+    free(report);
+    rnSocketsCleanup();
+    return result == RN_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
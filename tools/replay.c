@@ -0,0 +1,506 @@
+#include "../include/rnlib/capture.h"
+#include "../include/rnlib/clock.h"
+#include "../include/rnlib/connection.h"
+#include "../include/rnlib/socket.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/**
+ * Deterministic capture replay.
+ *
+ * Feeds the ingress records of a capture written via rnSocketSetCapture back
+ * through server-side connections, one per recorded source address, either
+ * paced by the recorded timestamps or as fast as possible. Replies produced by
+ * the handshake are swallowed by a sink socket, nothing touches the network.
+ *
+ * Replayed handshakes derive keys and salts of their own, so that the packets
+ * after them would fail verification. Captures written with RN_CAPTURE_SESSIONS
+ * carry the recorded session of every connection once its handshake completed,
+ * which replaces the replayed one from there on.
+ */
+
+#define RN_REPLAY_TABLE_BITS 16
+#define RN_REPLAY_TABLE_SIZE (1u << RN_REPLAY_TABLE_BITS)
+
+enum RnReplayType
+{
+    RN_REPLAY_INSECURE,
+    RN_REPLAY_AUTHENTICATED,
+    RN_REPLAY_ENCRYPTED,
+};
+
+struct RnReplayConfig
+{
+    const char *path;
+    enum RnReplayType type;
+    uint32_t loops;
+    bool recorded_speed;
+};
+
+struct RnReplayReport
+{
+    uint64_t records;
+    uint64_t datagrams;
+    uint64_t bytes;
+    uint64_t connections;
+    uint64_t sessions;
+    uint64_t results[RN_CONNECTION_READ_ERROR_VERIFY + 1];
+    uint64_t elapsed_ns;
+};
+
+static uint32_t rxReplayHash(const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    uint32_t hash        = 2166136261u;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * Waits until `offset` nanoseconds have passed since `start`, sleeping for the
+ * bulk of long gaps and spinning for the remainder to keep pacing accurate.
+ */
+static void rxReplayWait(uint64_t start, uint64_t offset)
+{
+    for (;;)
+    {
+        uint64_t elapsed = rnClockMonotonic() - start;
+        if (elapsed >= offset)
+        {
+            return;
+        }
+
+        uint64_t remaining = offset - elapsed;
+        if (remaining > 200000)
+        {
+            uint64_t sleep = remaining - 100000;
+            struct timespec duration = {
+                .tv_sec  = (time_t)(sleep / 1000000000ull),
+                .tv_nsec = (long)(sleep % 1000000000ull),
+            };
+
+            nanosleep(&duration, NULL);
+        }
+    }
+}
+
+#define RN_REPLAY_TABLE_IMPL(TYPE, IP, BUFFER)                                                     \
+    struct RnReplayTable##TYPE##IP                                                                 \
+    {                                                                                              \
+        RnSocket##IP *socket;                                                                      \
+        RnAddress##IP addresses[RN_REPLAY_TABLE_SIZE];                                             \
+        RnConnection##TYPE##IP *connections[RN_REPLAY_TABLE_SIZE];                                 \
+    };                                                                                             \
+                                                                                                   \
+    /* slot of `address` or the free one it goes to, RN_REPLAY_TABLE_SIZE once full */             \
+    static uint32_t rxReplaySlot##TYPE##IP(                                                        \
+          const struct RnReplayTable##TYPE##IP *table, const RnAddress##IP *address)               \
+    {                                                                                              \
+        uint32_t mask  = RN_REPLAY_TABLE_SIZE - 1;                                                 \
+        uint32_t index = rxReplayHash(address, sizeof *address) & mask;                            \
+                                                                                                   \
+        for (uint32_t probe = 0; probe < RN_REPLAY_TABLE_SIZE; ++probe)                            \
+        {                                                                                          \
+            uint32_t slot = (index + probe) & mask;                                                \
+            if (table->connections[slot] == NULL ||                                                \
+                memcmp(&table->addresses[slot], address, sizeof *address) == 0)                    \
+            {                                                                                      \
+                return slot;                                                                       \
+            }                                                                                      \
+        }                                                                                          \
+                                                                                                   \
+        return RN_REPLAY_TABLE_SIZE;                                                               \
+    }                                                                                              \
+                                                                                                   \
+    static RnConnection##TYPE##IP *rxReplayLookup##TYPE##IP(                                       \
+          struct RnReplayTable##TYPE##IP *table, const RnAddress##IP *address,                     \
+          struct RnReplayReport *report)                                                           \
+    {                                                                                              \
+        uint32_t slot = rxReplaySlot##TYPE##IP(table, address);                                    \
+        if (slot == RN_REPLAY_TABLE_SIZE || table->connections[slot] != NULL)                      \
+        {                                                                                          \
+            return slot == RN_REPLAY_TABLE_SIZE ? NULL : table->connections[slot];                 \
+        }                                                                                          \
+                                                                                                   \
+        int open_result = rnConnectionOpen(                                                        \
+              table->socket, address, RN_CONNECTION_SERVER, &table->connections[slot]);            \
+        if (open_result != RN_OK)                                                                  \
+        {                                                                                          \
+            table->connections[slot] = NULL;                                                       \
+            return NULL;                                                                           \
+        }                                                                                          \
+                                                                                                   \
+        table->addresses[slot] = *address;                                                         \
+        ++report->connections;                                                                     \
+        return table->connections[slot];                                                           \
+    }                                                                                              \
+                                                                                                   \
+    /* sessions of another connection type or library layout are skipped */                        \
+    static void rxReplayRestore##TYPE##IP(                                                         \
+          struct RnReplayTable##TYPE##IP *table, const RnAddress##IP *address,                     \
+          const uint8_t *data, size_t data_size, struct RnReplayReport *report)                    \
+    {                                                                                              \
+        uint32_t layout;                                                                           \
+        uint32_t slot = rxReplaySlot##TYPE##IP(table, address);                                    \
+        if (slot == RN_REPLAY_TABLE_SIZE ||                                                        \
+            data_size != sizeof layout + rnConnectionSnapshotSize##TYPE##IP())                     \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        memcpy(&layout, data, sizeof layout);                                                      \
+        if (layout != rnConnectionSnapshotLayout##TYPE##IP())                                      \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        if (table->connections[slot] != NULL)                                                      \
+        {                                                                                          \
+            rnConnectionClose(table->connections[slot]);                                           \
+        }                                                                                          \
+        else                                                                                       \
+        {                                                                                          \
+            ++report->connections;                                                                 \
+        }                                                                                          \
+                                                                                                   \
+        if (rnConnectionRestore(                                                                   \
+                  table->socket, data + sizeof layout, &table->connections[slot]) != RN_OK)        \
+        {                                                                                          \
+            table->connections[slot] = NULL;                                                       \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        table->addresses[slot] = *address;                                                         \
+        ++report->sessions;                                                                        \
+    }                                                                                              \
+                                                                                                   \
+    static void rxReplayFeed##TYPE##IP(                                                            \
+          struct RnReplayTable##TYPE##IP *table, const RnAddress##IP *address,                     \
+          const uint8_t *data, size_t data_size, struct RnReplayReport *report)                    \
+    {                                                                                              \
+        RnConnection##TYPE##IP *connection = rxReplayLookup##TYPE##IP(table, address, report);     \
+        if (connection == NULL)                                                                    \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        RnPacketBuffer##BUFFER buffer = rnPacketBufferCreate##BUFFER(0);                           \
+        size_t capacity               = rnPacketBufferWireCapacity(&buffer);                       \
+        size_t size                   = data_size < capacity ? data_size : capacity;               \
+                                                                                                   \
+        memcpy(rnPacketBufferWireData(&buffer), data, size);                                       \
+        if (rnPacketBufferWireReceived(&buffer, size) != RN_OK)                                    \
+        {                                                                                          \
+            return;                                                                                \
+        }                                                                                          \
+                                                                                                   \
+        enum RnConnectionReadResult read_result = rnConnectionReadPacket(connection, &buffer);     \
+        if (read_result == RN_CONNECTION_READ_HANDSHAKE)                                           \
+        {                                                                                          \
+            rnConnectionEstablishHandshake(connection);                                            \
+        }                                                                                          \
+                                                                                                   \
+        ++report->results[read_result];                                                            \
+        ++report->datagrams;                                                                       \
+        report->bytes += data_size;                                                                \
+    }                                                                                              \
+                                                                                                   \
+    static void rxReplayTableClear##TYPE##IP(struct RnReplayTable##TYPE##IP *table)                \
+    {                                                                                              \
+        for (uint32_t slot = 0; slot < RN_REPLAY_TABLE_SIZE; ++slot)                               \
+        {                                                                                          \
+            if (table->connections[slot] != NULL)                                                  \
+            {                                                                                      \
+                rnConnectionClose(table->connections[slot]);                                       \
+                table->connections[slot] = NULL;                                                   \
+            }                                                                                      \
+        }                                                                                          \
+    }
+
+RN_REPLAY_TABLE_IMPL(Authenticated, IPv4, Secure)
+RN_REPLAY_TABLE_IMPL(Authenticated, IPv6, Secure)
+
+RN_REPLAY_TABLE_IMPL(Encrypted, IPv4, Secure)
+RN_REPLAY_TABLE_IMPL(Encrypted, IPv6, Secure)
+
+RN_REPLAY_TABLE_IMPL(Insecure, IPv4, Insecure)
+RN_REPLAY_TABLE_IMPL(Insecure, IPv6, Insecure)
+
+#undef RN_REPLAY_TABLE_IMPL
+
+#define RN_REPLAY_RUN_IMPL(TYPE)                                                                   \
+    static int rxReplayRun##TYPE(                                                                  \
+          const struct RnReplayConfig *config, RnSocketIPv4 *sink_ipv4, RnSocketIPv6 *sink_ipv6,   \
+          struct RnReplayReport *report)                                                           \
+    {                                                                                              \
+        struct RnReplayTable##TYPE##IPv4 *table_ipv4 = calloc(1, sizeof *table_ipv4);              \
+        struct RnReplayTable##TYPE##IPv6 *table_ipv6 = calloc(1, sizeof *table_ipv6);              \
+        if (table_ipv4 == NULL || table_ipv6 == NULL)                                              \
+        {                                                                                          \
+            free(table_ipv4);                                                                      \
+            free(table_ipv6);                                                                      \
+            return RN_OOM;                                                                         \
+        }                                                                                          \
+                                                                                                   \
+        table_ipv4->socket = sink_ipv4;                                                            \
+        table_ipv6->socket = sink_ipv6;                                                            \
+                                                                                                   \
+        uint8_t data[UINT16_MAX];                                                                  \
+        RnCaptureRecord record;                                                                    \
+        int result     = RN_OK;                                                                    \
+        uint64_t start = rnClockMonotonic();                                                       \
+                                                                                                   \
+        for (uint32_t loop = 0; loop < config->loops && result == RN_OK; ++loop)                   \
+        {                                                                                          \
+            RnCaptureReader *reader;                                                               \
+            result = rnCaptureReaderOpen(config->path, &reader);                                   \
+            if (result != RN_OK)                                                                   \
+            {                                                                                      \
+                break;                                                                             \
+            }                                                                                      \
+                                                                                                   \
+            uint64_t loop_start = rnClockMonotonic();                                              \
+            uint64_t first      = 0;                                                               \
+            bool paced          = false;                                                           \
+                                                                                                   \
+            while (rnCaptureReaderNext(reader, &record, data, sizeof data) == RN_OK)               \
+            {                                                                                      \
+                ++report->records;                                                                 \
+                if (record.direction == RN_CAPTURE_SESSION && record.family == 4)                  \
+                {                                                                                  \
+                    rxReplayRestore##TYPE##IPv4(                                                   \
+                          table_ipv4, &record.ipv4, data, record.data_size, report);               \
+                }                                                                                  \
+                else if (record.direction == RN_CAPTURE_SESSION)                                   \
+                {                                                                                  \
+                    rxReplayRestore##TYPE##IPv6(                                                   \
+                          table_ipv6, &record.ipv6, data, record.data_size, report);               \
+                }                                                                                  \
+                                                                                                   \
+                if (record.direction != RN_CAPTURE_INGRESS)                                        \
+                {                                                                                  \
+                    continue;                                                                      \
+                }                                                                                  \
+                                                                                                   \
+                if (config->recorded_speed)                                                        \
+                {                                                                                  \
+                    if (!paced)                                                                    \
+                    {                                                                              \
+                        first = record.timestamp;                                                  \
+                        paced = true;                                                              \
+                    }                                                                              \
+                                                                                                   \
+                    rxReplayWait(loop_start, record.timestamp - first);                            \
+                }                                                                                  \
+                                                                                                   \
+                if (record.family == 4)                                                            \
+                {                                                                                  \
+                    rxReplayFeed##TYPE##IPv4(                                                      \
+                          table_ipv4, &record.ipv4, data, record.data_size, report);               \
+                }                                                                                  \
+                else                                                                               \
+                {                                                                                  \
+                    rxReplayFeed##TYPE##IPv6(                                                      \
+                          table_ipv6, &record.ipv6, data, record.data_size, report);               \
+                }                                                                                  \
+            }                                                                                      \
+                                                                                                   \
+            rnCaptureReaderClose(reader);                                                          \
+                                                                                                   \
+            /* every loop replays against fresh sessions, as the capture did */                    \
+            rxReplayTableClear##TYPE##IPv4(table_ipv4);                                            \
+            rxReplayTableClear##TYPE##IPv6(table_ipv6);                                            \
+        }                                                                                          \
+                                                                                                   \
+        report->elapsed_ns = rnClockMonotonic() - start;                                           \
+                                                                                                   \
+        free(table_ipv4);                                                                          \
+        free(table_ipv6);                                                                          \
+        return result;                                                                             \
+    }
+
+RN_REPLAY_RUN_IMPL(Authenticated)
+RN_REPLAY_RUN_IMPL(Encrypted)
+RN_REPLAY_RUN_IMPL(Insecure)
+
+#undef RN_REPLAY_RUN_IMPL
+
+static void rxReplayPrintReport(const struct RnReplayReport *report)
+{
+    static const char *result_names[] = {
+        [RN_CONNECTION_READ_AVAILABLE]      = "available",
+        [RN_CONNECTION_READ_EMPTY]          = "empty",
+        [RN_CONNECTION_READ_HANDSHAKE]      = "handshake",
+        [RN_CONNECTION_READ_PROBE]          = "probe",
+        [RN_CONNECTION_READ_MIGRATED]       = "migrated",
+        [RN_CONNECTION_READ_PARITY]         = "parity",
+        [RN_CONNECTION_READ_ERROR_SEQUENCE] = "error sequence",
+        [RN_CONNECTION_READ_ERROR_CONTEXT]  = "error context",
+        [RN_CONNECTION_READ_ERROR_VERIFY]   = "error verify",
+    };
+
+    double seconds = (double)report->elapsed_ns / 1e9;
+
+    printf("records         %llu (%llu ingress datagrams)\n",
+           (unsigned long long)report->records, (unsigned long long)report->datagrams);
+    printf("connections     %llu (%llu recorded sessions restored)\n",
+           (unsigned long long)report->connections, (unsigned long long)report->sessions);
+    printf("elapsed         %.3f s\n", seconds);
+    printf("throughput      %.0f pps, %.2f MB/s\n", (double)report->datagrams / seconds,
+           (double)report->bytes / seconds / 1e6);
+    printf("time per packet %.1f ns\n",
+           report->datagrams ? (double)report->elapsed_ns / report->datagrams : 0.0);
+
+    for (size_t i = 0; i < sizeof result_names / sizeof *result_names; ++i)
+    {
+        printf("  %-14s %llu\n", result_names[i], (unsigned long long)report->results[i]);
+    }
+}
+
+static void rxReplayUsage(const char *program)
+{
+    fprintf(stderr,
+          "usage: %s CAPTURE [--type insecure|authenticated|encrypted]\n"
+          "          [--speed recorded|max] [--loops N]\n",
+          program);
+}
+
+int main(int argc, char **argv)
+{
+    struct RnReplayConfig config = {
+        .path           = NULL,
+        .type           = RN_REPLAY_INSECURE,
+        .loops          = 1,
+        .recorded_speed = false,
+    };
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg   = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (arg[0] != '-')
+        {
+            config.path = arg;
+            continue;
+        }
+
+        if (value == NULL)
+        {
+            rxReplayUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        if (strcmp(arg, "--type") == 0)
+        {
+            if (strcmp(value, "insecure") == 0)
+            {
+                config.type = RN_REPLAY_INSECURE;
+            }
+            else if (strcmp(value, "authenticated") == 0)
+            {
+                config.type = RN_REPLAY_AUTHENTICATED;
+            }
+            else if (strcmp(value, "encrypted") == 0)
+            {
+                config.type = RN_REPLAY_ENCRYPTED;
+            }
+            else
+            {
+                rxReplayUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcmp(arg, "--speed") == 0)
+        {
+            config.recorded_speed = strcmp(value, "recorded") == 0;
+        }
+        else if (strcmp(arg, "--loops") == 0)
+        {
+            config.loops = (uint32_t)strtoul(value, NULL, 10);
+        }
+        else
+        {
+            rxReplayUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+
+        ++i;
+    }
+
+    if (config.path == NULL)
+    {
+        rxReplayUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (rnSocketsInitialize() != RN_OK)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // sink sockets bound to ephemeral loopback ports, egress is never sent
+    RnAddressIPv4 loopback_ipv4 = { .octets = { 1, 0, 0, 127 }, .port = 0 };
+    RnAddressIPv6 loopback_ipv6 = { .groups = { 1, 0, 0, 0, 0, 0, 0, 0 }, .port = 0 };
+
+    RnCapture *sink;
+    RnSocketIPv4 *sink_ipv4;
+    RnSocketIPv6 *sink_ipv6;
+    if (rnCaptureOpen(NULL, RN_CAPTURE_SUPPRESS_EGRESS, &sink) != RN_OK ||
+        rnSocketOpen(&loopback_ipv4, &sink_ipv4) != RN_OK ||
+        rnSocketOpen(&loopback_ipv6, &sink_ipv6) != RN_OK)
+    {
+        fprintf(stderr, "failed to open sink sockets\n");
+        return EXIT_FAILURE;
+    }
+
+    rnSocketSetCapture(sink_ipv4, sink);
+    rnSocketSetCapture(sink_ipv6, sink);
+
+    struct RnReplayReport report = { 0 };
+    int result = RN_OK;
+
+    switch (config.type)
+    {
+        case RN_REPLAY_INSECURE:
+        {
+            result = rxReplayRunInsecure(&config, sink_ipv4, sink_ipv6, &report);
+            break;
+        }
+
+        case RN_REPLAY_AUTHENTICATED:
+        {
+            result = rxReplayRunAuthenticated(&config, sink_ipv4, sink_ipv6, &report);
+            break;
+        }
+
+        case RN_REPLAY_ENCRYPTED:
+        {
+            result = rxReplayRunEncrypted(&config, sink_ipv4, sink_ipv6, &report);
+            break;
+        }
+    }
+
+    if (result != RN_OK)
+    {
+        fprintf(stderr, "replay aborted, failed to read %s\n", config.path);
+    }
+
+    rxReplayPrintReport(&report);
+
+    rnSocketClose(sink_ipv4);
+    rnSocketClose(sink_ipv6);
+    rnCaptureClose(sink);
+    rnSocketsCleanup();
+    return result == RN_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}